@@ -33,7 +33,9 @@
 #include "bitmask.h"
 #include "funconv.h"   //simple_interpolation()
 #include "magnitude.h"
+#include "profiler.h"
 #include "secu3.h"
+#include "trace.h"
 
 /**     */
 #define ADCI_MAP                2
@@ -78,8 +80,28 @@ typedef struct
 #endif
  volatile uint8_t sensors_ready; //!<       
  uint8_t  measure_all;           //!<  1,     
+
+ uint8_t  map_only;              //!< if 1, then only MAP is measured (crank-angle resolved sample)
+ uint8_t  map_cyc_new;           //!< if 1, then next MAP sample begins new engine cycle
+ uint16_t map_cyc_sum;           //!< sum of MAP samples taken during current cycle
+ uint16_t map_cyc_min;           //!< minimum of MAP samples taken during current cycle
+ uint8_t  map_cyc_cnt;           //!< number of MAP samples taken during current cycle
+ volatile uint16_t map_cycle_sum;//!< sum of MAP samples of the last completed cycle
+ volatile uint16_t map_cycle_min;//!< minimum MAP sample of the last completed cycle
+ volatile uint8_t map_cycle_cnt; //!< number of MAP samples of the last completed cycle, 0 - no new data
+ volatile uint8_t pending;       //!< measurements requested while MAP sample was being measured (see ADCP_xxx)
 }adcstate_t;
 
+//Measurements requested while ADC is busy. They are started from ADC_vect after completion of
+//current measurement. Measurement of sensors and knock is queued only behind crank-angle resolved
+//MAP sample, MAP sample is queued behind any measurement (,   )
+#define ADCP_SENSORS            0x01  //!< measurement of all sensors (adc_begin_measure())
+#define ADCP_SENSORS_2X         0x02  //!< double ADC clock for measurement of sensors
+#define ADCP_KNOCK              0x04  //!< measurement of knock integrator (adc_begin_measure_knock())
+#define ADCP_KNOCK_2X           0x08  //!< double ADC clock for measurement of knock
+#define ADCP_MAP                0x10  //!< crank-angle resolved MAP sample (adc_begin_measure_map())
+#define ADCP_MAP_2X             0x20  //!< double ADC clock for MAP sample
+
 /**    */
 adcstate_t adc;
 
@@ -157,15 +179,13 @@ uint16_t adc_get_tps_value(void)
 }
 #endif
 
-void adc_begin_measure(uint8_t speed2x)
+/**Starts conversion of specified channel
+ * \param channel number of channel (ADCI_xxx)
+ * \param speed2x Double ADC clock (0,1)
+ */
+static void adc_start(uint8_t channel, uint8_t speed2x)
 {
- //     ,    
- // 
- if (!adc.sensors_ready)
-  return;
-
- adc.sensors_ready = 0;
- ADMUX = ADCI_MAP|ADC_VREF_TYPE;
+ ADMUX = channel|ADC_VREF_TYPE;
  if (speed2x)
   CLEARBIT(ADCSRA, ADPS0); //250kHz
  else
@@ -173,20 +193,72 @@ void adc_begin_measure(uint8_t speed2x)
  SETBIT(ADCSRA, ADSC);
 }
 
+/**Starts measurement which was queued while ADC was busy. Knock is measured first, because
+ * integrator holds its value only for limited time, then MAP sample, because its position in the
+ * cycle matters, and then sensors. Called from ADC_vect after completion of current measurement.
+ * \return 1 - measurement has been started, 0 - there are no queued requests
+ */
+static uint8_t adc_start_pending(void)
+{
+ uint8_t p = adc.pending;
+ if (p & ADCP_KNOCK)
+ {
+  adc.pending = p & ~(ADCP_KNOCK | ADCP_KNOCK_2X);
+  adc_start(ADCI_STUB, p & ADCP_KNOCK_2X);
+  return 1;
+ }
+ if (p & ADCP_MAP)
+ {
+  adc.pending = p & ~(ADCP_MAP | ADCP_MAP_2X);
+  adc.map_only = 1;
+  adc_start(ADCI_MAP, p & ADCP_MAP_2X);
+  return 1;
+ }
+ if (p & ADCP_SENSORS)
+ {
+  adc.pending = p & ~(ADCP_SENSORS | ADCP_SENSORS_2X);
+  adc_start(ADCI_MAP, p & ADCP_SENSORS_2X);
+  return 1;
+ }
+ return 0;
+}
+
+/**Queues measurement if ADC is busy with crank-angle resolved MAP sample (MAP sample itself is
+ * queued behind any measurement)
+ * \param req request and its speed (ADCP_xxx)
+ * \return 1 - ADC is free and caller must start measurement, 0 - ADC is busy
+ */
+static uint8_t adc_acquire(uint8_t req)
+{
+ uint8_t free;
+ _BEGIN_ATOMIC_BLOCK();
+ free = adc.sensors_ready;
+ if (free)
+  adc.sensors_ready = 0;
+ else if (adc.map_only || (req & ADCP_MAP)) //MAP sample is short, so request is not lost but started after it
+  adc.pending|= req;
+ _END_ATOMIC_BLOCK();
+ return free;
+}
+
+void adc_begin_measure(uint8_t speed2x)
+{
+ //     ,    
+ //  (but request is queued if only MAP sample is being measured)
+ if (!adc_acquire(ADCP_SENSORS | (speed2x ? ADCP_SENSORS_2X : 0)))
+  return;
+
+ adc_start(ADCI_MAP, speed2x);
+}
+
 void adc_begin_measure_knock(uint8_t speed2x)
 {
  //     ,    
- // 
- if (!adc.sensors_ready)
+ //  (but request is queued if only MAP sample is being measured)
+ if (!adc_acquire(ADCP_KNOCK | (speed2x ? ADCP_KNOCK_2X : 0)))
   return;
 
- adc.sensors_ready = 0;
- ADMUX = ADCI_STUB|ADC_VREF_TYPE;
- if (speed2x)
-  CLEARBIT(ADCSRA, ADPS0); //250kHz
- else
-  SETBIT(ADCSRA, ADPS0);   //125kHz
- SETBIT(ADCSRA, ADSC);
+ adc_start(ADCI_STUB, speed2x);
 }
 
 void adc_begin_measure_all(void)
@@ -195,6 +267,43 @@ void adc_begin_measure_all(void)
  adc_begin_measure(0); //<--normal speed
 }
 
+void adc_begin_measure_map(uint8_t new_cycle, uint8_t speed2x)
+{
+ //remember beginning of a new cycle even if this sample will be skipped
+ if (new_cycle)
+  adc.map_cyc_new = 1;
+
+ if (!adc_acquire(ADCP_MAP | (speed2x ? ADCP_MAP_2X : 0)))
+  return;
+
+ adc.map_only = 1;
+ adc_start(ADCI_MAP, speed2x);
+}
+
+uint8_t adc_get_map_cycle(uint16_t* p_mean, uint16_t* p_min)
+{
+ uint16_t sum; uint8_t cnt;
+ _BEGIN_ATOMIC_BLOCK();
+ sum = adc.map_cycle_sum;
+ cnt = adc.map_cycle_cnt;
+ *p_min = adc.map_cycle_min;
+ adc.map_cycle_cnt = 0;
+ _END_ATOMIC_BLOCK();
+ if (0==cnt)
+  return 0; //there are no new data
+ *p_mean = sum / cnt;
+ return 1;
+}
+
+void adc_reset_map_cycle(void)
+{
+ _BEGIN_ATOMIC_BLOCK();
+ adc.map_cyc_cnt = 0;
+ adc.map_cyc_new = 0;
+ adc.map_cycle_cnt = 0;
+ _END_ATOMIC_BLOCK();
+}
+
 uint8_t adc_is_measure_ready(void)
 {
  return adc.sensors_ready;
@@ -204,6 +313,9 @@ void adc_init(void)
 {
  adc.knock_value = 0;
  adc.measure_all = 0;
+ adc.map_only = 0;
+ adc.pending = 0;
+ adc_reset_map_cycle();
 
  // , : f = 125.000 kHz,
  //    - 2.56V,  
@@ -222,11 +334,43 @@ void adc_init(void)
  */
 ISR(ADC_vect)
 {
+ PRF_ENTER();
  _ENABLE_INTERRUPT();
 
+#ifdef TRACE_CAPTURE
+ trace_put_adc(ADMUX&0x07, ADC);
+#endif
+
  switch(ADMUX&0x07)
  {
   case ADCI_MAP: //   
+   if (adc.map_only)
+   { //crank-angle resolved sample, accumulate it and finish
+    uint16_t value = ADC;
+    adc.map_only = 0;
+    if (adc.map_cyc_new)
+    { //publish results of the previous cycle and begin new one
+     if (adc.map_cyc_cnt)
+     {
+      adc.map_cycle_sum = adc.map_cyc_sum;
+      adc.map_cycle_min = adc.map_cyc_min;
+      adc.map_cycle_cnt = adc.map_cyc_cnt;
+     }
+     adc.map_cyc_new = 0;
+     adc.map_cyc_cnt = 0;
+    }
+    if (adc.map_cyc_cnt >= ADC_MAP_CYCLE_MAX) //beginning of cycle was lost, prevent overflow
+     adc.map_cyc_cnt = 0;
+    if (0==adc.map_cyc_cnt)
+     adc.map_cyc_sum = 0, adc.map_cyc_min = value;
+    adc.map_cyc_sum+= value;
+    if (value < adc.map_cyc_min)
+     adc.map_cyc_min = value;
+    ++adc.map_cyc_cnt;
+    if (!adc_start_pending())
+     adc.sensors_ready = 1;
+    break;
+   }
    adc.map_value = ADC;
 #ifdef TPS_SENSOR     
    ADMUX = ADCI_TPS|ADC_VREF_TYPE;
@@ -259,7 +403,8 @@ ISR(ADC_vect)
    if (0==adc.measure_all)
    {
     ADMUX = ADCI_MAP|ADC_VREF_TYPE;
-    adc.sensors_ready = 1;
+    if (!adc_start_pending())
+     adc.sensors_ready = 1;
    }
    else
    {
@@ -288,7 +433,8 @@ ISR(ADC_vect)
    if (0==adc.measure_all)
    {
     ADMUX = ADCI_MAP|ADC_VREF_TYPE;
-    adc.sensors_ready = 1; //finished
+    if (!adc_start_pending())
+     adc.sensors_ready = 1; //finished
    }
    else
    { //continue (knock)
@@ -306,9 +452,11 @@ ISR(ADC_vect)
 
   case ADCI_KNOCK://      
    adc.knock_value = ADC;
-   adc.sensors_ready = 1;
+   if (!adc_start_pending())
+    adc.sensors_ready = 1;
    break;
  }
+ PRF_LEAVE(PRB_ADC);
 }
 
 int16_t adc_compensate(int16_t adcvalue, int16_t factor, int32_t correction)
@@ -363,7 +511,7 @@ int16_t temp_adc_to_c(int16_t adcvalue)
  return (adcvalue - ((int16_t)((TSENS_ZERO_POINT / ADC_DISCRETE)+0.5)) );
 }
 
-#ifdef SECU3T
+#if defined(SECU3T) || defined(TPS_SENSOR)
 uint8_t tps_adc_to_pc(int16_t adcvalue, int16_t offset, int16_t gradient)
 {
  int16_t t;
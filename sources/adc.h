@@ -42,6 +42,10 @@
 /**      */
 #define ADC_VREF_TYPE           0xC0
 
+/**Maximum number of crank-angle resolved MAP samples which can be accumulated during one
+ * engine cycle (sum of samples must fit in 16 bits) */
+#define ADC_MAP_CYCLE_MAX       64
+
 /**   -  */
 #define MAP_PHYSICAL_MAGNITUDE_MULTIPLAYER  64
 
@@ -50,7 +54,7 @@
 
 #ifdef TPS_SENSOR
 /**   -   */
-#define TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER (1.0/ADC_DISCRETE) //=400
+#define V_TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER (1.0/ADC_DISCRETE) //=400, the same as ADC discretes
 #endif
 
 /**   -  */
@@ -105,7 +109,8 @@ uint16_t adc_get_tps_value(void);
 #endif
 
 /**    ,    
- *  .
+ *  . If ADC is busy with crank-angle resolved MAP sample, then
+ * measurement is queued and started right after completion of sample.
  * \param speed2x Double ADC clock (0,1) (   )
  */
 void adc_begin_measure(uint8_t speed2x);
@@ -113,11 +118,36 @@ void adc_begin_measure(uint8_t speed2x);
 /**      .    
  *  INT/HOLD  0  INTOUT       
  * 20 (),       ,   
- *  .
+ *  . If ADC is busy with crank-angle resolved MAP sample, then
+ * measurement is queued and started right after completion of sample, so it is delayed by one
+ * conversion at most: 104us at 125kHz, 52us at 250kHz (integrator is in hold mode until the next
+ * knock window, so its output does not change). Simulator measures this delay
+ * (tools/hostsim.py mapcmp): 112us from INT/HOLD edge to sampling of knock channel without MAP
+ * samples, maximum 120us with 8 or 16 MAP samples per cycle.
  * \param speed2x Double ADC clock (0,1) (   )
  */
 void adc_begin_measure_knock(uint8_t speed2x);
 
+/**Starts measurement of MAP only (crank-angle resolved sample). If ADC is busy (sensors or
+ * knock are being measured), then sample is queued and taken right after completion of current
+ * measurement. Result is accumulated for calculation of mean and minimum values of MAP over
+ * engine cycle.
+ * \param new_cycle 1 - this sample begins new engine cycle, so results of the previous cycle
+ * will be published
+ * \param speed2x Double ADC clock (0,1) (   )
+ */
+void adc_begin_measure_map(uint8_t new_cycle, uint8_t speed2x);
+
+/**Get results of crank-angle resolved MAP sampling for the last completed engine cycle
+ * \param p_mean pointer to variable which will receive mean value of MAP (ADC discretes)
+ * \param p_min pointer to variable which will receive minimum value of MAP (ADC discretes)
+ * \return 1 - new data are available, 0 - there are no new data since last call
+ */
+uint8_t adc_get_map_cycle(uint16_t* p_mean, uint16_t* p_min);
+
+/**Resets state of crank-angle resolved MAP sampling (e.g. when synchronization has been lost) */
+void adc_reset_map_cycle(void);
+
 /**        .   
  *  ,    
  */
@@ -163,7 +193,7 @@ uint16_t ubat_adc_to_v(int16_t adcvalue);
 #ifdef TPS_SENSOR
 /**      -  
  * \param adcvalue    
- * \return   * TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER
+ * \return   * V_TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER
  */
 uint16_t tps_adc_to_v(int16_t adcvalue);
 #endif
@@ -174,7 +204,7 @@ uint16_t tps_adc_to_v(int16_t adcvalue);
  */
 int16_t temp_adc_to_c(int16_t adcvalue);
 
-#ifdef SECU3T
+#if defined(SECU3T) || defined(TPS_SENSOR)
 /**Converts ADC value of the Throttle Position Sensor to the percentage of throttle opening
  * \param adcvalue     (Value in ADC discretes)
  * \param offset    (Curve offset. Can be negative)
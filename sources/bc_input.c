@@ -136,7 +136,7 @@ void bc_indication_mode(struct ecudata_t *d)
   delay_hom(7);
 
   //read errors
-  eeprom_read(&errors, EEPROM_ECUERRORS_START, sizeof(uint16_t));
+  errors = ce_read_saved_errors();
 
   for(i = 0; i < 16; ++i)
   {  
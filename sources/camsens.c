@@ -32,6 +32,7 @@
 #include "camsens.h"
 #include "ioconfig.h"
 #include "tables.h"
+#include "trace.h"
 
 //Functionality added when either PHASE_SENSOR or SECU3T is defined
 #if defined(PHASE_SENSOR) || defined(SECU3T)
@@ -118,6 +119,9 @@ uint8_t cams_vr_is_event_r(void)
 ISR(INT0_vect)
 {
  camstate.vr_event = 1; //set event flag 
+#ifdef TRACE_CAPTURE
+ trace_put_event(TRC_HDR(TRC_CAM, TRC_CAM_REFS), TCNT1);
+#endif
 }
 
 void cams_vr_set_edge_type(uint8_t edge_type)
@@ -158,6 +162,9 @@ void cams_detect_edge(void)
    camstate.err_counter = 0;
    camstate.prev_level = level;
    camstate.event = 1;
+#ifdef TRACE_CAPTURE
+   trace_put_event(TRC_HDR(TRC_CAM, TRC_CAM_HALL), TCNT1);
+#endif
    return; //detected
   }
  }
@@ -207,6 +214,9 @@ ISR(INT1_vect)
  camstate.cam_ok = 1;
  camstate.err_counter = 0;
  camstate.event = 1; //set event flag
+#ifdef TRACE_CAPTURE
+ trace_put_event(TRC_HDR(TRC_CAM, TRC_CAM_HALL), TCNT1);
+#endif
 }
 #endif //SECU3T
 #endif //PHASE_SENSOR
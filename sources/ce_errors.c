@@ -25,6 +25,7 @@
  */
 
 #include "port/avrio.h"
+#include "port/pgmspace.h"
 #include "port/port.h"
 #include <string.h>
 #include "adc.h"
@@ -32,26 +33,60 @@
 #include "camsens.h"
 #include "ce_errors.h"
 #include "ckps.h"
+#include "crc16.h"
 #include "eeprom.h"
+#include "ejournal.h"
 #include "knock.h"
 #include "magnitude.h"
 #include "secu3.h"
 #include "suspendop.h"
 #include "vstimer.h"
 
+/**Record of journal which stores errors in the EEPROM (see ejournal.h) */
+typedef struct
+{
+ uint16_t seq;               //!< sequence number (filled by journal)
+ uint16_t errors;            //!< bits of errors
+ uint16_t crc;               //!< CRC of record (filled by journal)
+}ce_record_t;
+
 /**CE state variables structure */
 typedef struct
 {
  uint16_t ecuerrors;         //!< 16 error codes maximum ( 16  )
  uint16_t merged_errors;     //!< caching errors to preserve resource of the EEPROM (     EEPROM)
- uint16_t write_errors;      //!< . eeprom_start_wr_data() launches background process! (  !)
- uint16_t bv_tdc;            //!< board voltage debouncong counter for eliminating of false errors during normal transients
- uint8_t  bv_eds;            //!< board voltage error detecting state, used for state machine
- uint8_t  bv_dev;            //!< board voltage deviation flag, if 0, then voltage is below normal, if 1, then voltage is above normal
+ ce_record_t write_errors;   //!< . eeprom_start_wr_data() launches background process! (  !)
+ uint8_t  dbc[CE_ERRORS_NUMBER]; //!< debouncing counters of errors
+ uint16_t saved_errors;      //!< copy of errors saved in the EEPROM, so journal is scanned only once
+ uint8_t  saved_loaded;      //!< 1 - saved_errors contains valid copy
 }ce_state_t;
 
 /**State variables */
-ce_state_t ce_state = {0,0,0,0,0,0};
+ce_state_t ce_state = {0,0,{0,0,0},{0},0,0};
+
+/**Number of freeze frames in the RAM ring (must be power of 2) */
+#define CE_FRAMES_RING 4
+
+/**Compile time check: record of log is a slot of journal, so size of slot declared in eeprom.h must be
+ * equal to size of record (otherwise size of array is negative) */
+typedef char ce_frame_size_check_t[(sizeof(ce_frame_t) == EEPROM_CEFRAMES_SLOT_SIZE) ? 1 : -1];
+
+/**Freeze frames log state variables structure */
+typedef struct
+{
+ ce_frame_t ring[CE_FRAMES_RING]; //!< captured frames which are waiting for saving into EEPROM
+ uint8_t  tail;              //!< index of the oldest frame in the ring
+ uint8_t  count;             //!< number of frames in the ring (including frame which is being saved)
+ uint8_t  saving;            //!< 1 - the oldest frame is being written into EEPROM
+ uint8_t  lost;              //!< number of frames lost because ring was full (saturated)
+ uint16_t prev_errors;       //!< errors at the previous check, used to detect rising edges
+ ce_frame_t xfer;            //!< buffer for transferring of log via UART
+ uint8_t  xfer_index;        //!< index of record in the xfer buffer
+ uint8_t  xfer_valid;        //!< 1 - record in the xfer buffer is valid
+}ce_log_t;
+
+/**Freeze frames log state variables */
+ce_log_t ce_log;
 
 //operations under errors (  )
 /*#pragma inline*/
@@ -66,123 +101,140 @@ void ce_clear_error(uint8_t error)
  CLEARBIT(ce_state.ecuerrors, error);
 }
 
-/** Internal function. Contains checking logic */
+/**Thresholds of debouncing counters, in ticks of errors checking (see CE_CHECK_TIME_VALUE) */
+typedef struct
+{
+ uint8_t set;                //!< number of faulty samples required to set error
+ uint8_t clr;                //!< number of good samples required to clear error
+}ce_dbc_thrd_t;
+
+/**Thresholds of debouncing counters for each error (20ms ticks). Errors which are not checked
+ * periodically (set by other modules) do not use these values */
+PGM_DECLARE(ce_dbc_thrd_t ce_dbc_thrd[CE_ERRORS_NUMBER]) =
+{
+ {1, 50},                    //ECUERROR_CKPS_MALFUNCTION, already latched by CKPS module
+ {1, 1},                     //ECUERROR_EEPROM_PARAM_BROKEN
+ {1, 1},                     //ECUERROR_PROGRAM_CODE_BROKEN
+ {3, 50},                    //ECUERROR_KSP_CHIP_FAILED
+ {1, 1},                     //ECUERROR_KNOCK_DETECTED
+ {10, 25},                   //ECUERROR_MAP_SENSOR_FAIL
+ {25, 25},                   //ECUERROR_TEMP_SENSOR_FAIL
+ {50, 50},                   //ECUERROR_VOLT_SENSOR_FAIL, eliminates errors during normal transients (e.g. switching ignition off)
+ {1, 1},                     //ECUERROR_DWELL_CONTROL
+ {1, 50},                    //ECUERROR_CAMS_MALFUNCTION, already latched by CAMS module
+ {1, 1},                     //ECUERROR_TPS_SENSOR_FAIL
+ {1, 1},                     //ECUERROR_RAM_DATA_BROKEN
+ {1, 1},                     //ECUERROR_STACK_LOW
+ {1, 1},                     //ECUERROR_TABLES_OVERFLOW
+ {1, 1}, {1, 1}              //reserved
+};
+
+/** Passes sample of error's condition through the up/down debouncing counter. Error is set only
+ * when it is present during specified number of samples and cleared only when it is absent during
+ * specified number of samples (noise decrements counter).
+ * \param error code of error
+ * \param fault 1 - error's condition is present in this sample, 0 - absent
+ */
+static void sample_error(uint8_t error, uint8_t fault)
+{
+ uint8_t* p_cnt = &ce_state.dbc[error];
+ uint8_t active = CHECKBIT(ce_state.ecuerrors, error) > 0;
+
+ if ((fault > 0) != active)
+ { //sample differs from confirmed state
+  if (++(*p_cnt) >= (active ? PGM_GET_BYTE(&ce_dbc_thrd[error].clr) : PGM_GET_BYTE(&ce_dbc_thrd[error].set)))
+  {
+   if (fault)
+    ce_set_error(error);
+   else
+    ce_clear_error(error);
+   *p_cnt = 0;
+  }
+ }
+ else if (*p_cnt)
+  --(*p_cnt);
+}
+
+/** Internal function. Contains checking logic. Called on each tick of errors checking */
 void check(struct ecudata_t* d)
 {
  //If error of CKP sensor was, then set corresponding bit of error
  //        
- if (ckps_is_error())
- {
-  ce_set_error(ECUERROR_CKPS_MALFUNCTION);
-  ckps_reset_error();
- }
- else
- {
-  ce_clear_error(ECUERROR_CKPS_MALFUNCTION);
- }
+ sample_error(ECUERROR_CKPS_MALFUNCTION, ckps_is_error());
+ ckps_reset_error();
 
 #ifdef PHASE_SENSOR
- if (cams_is_error())
- {
-  ce_set_error(ECUERROR_CAMS_MALFUNCTION);
-  cams_reset_error();
- }
- else
- {
-  ce_clear_error(ECUERROR_CAMS_MALFUNCTION);
- }
+ sample_error(ECUERROR_CAMS_MALFUNCTION, cams_is_error());
+ cams_reset_error();
 #endif
 
  //if error of knock channel was
  //    
  if (d->param.knock_use_knock_channel)
  {
-  if (knock_is_error())
-  {
-   ce_set_error(ECUERROR_KSP_CHIP_FAILED);
-   knock_reset_error();
-  }
-  else
-   ce_clear_error(ECUERROR_KSP_CHIP_FAILED);
+  sample_error(ECUERROR_KSP_CHIP_FAILED, knock_is_error());
+  knock_reset_error();
  }
  else
-  ce_clear_error(ECUERROR_KSP_CHIP_FAILED);
+  sample_error(ECUERROR_KSP_CHIP_FAILED, 0);
 
  //checking MAP sensor. TODO: implement additional check
  // error if voltage < 0.1v //    ""   
- if (d->sens.map_raw < ROUND(0.1 / ADC_DISCRETE) && d->sens.carb)
-  ce_set_error(ECUERROR_MAP_SENSOR_FAIL);
- else
-  ce_clear_error(ECUERROR_MAP_SENSOR_FAIL);
+ sample_error(ECUERROR_MAP_SENSOR_FAIL, d->sens.map_raw < ROUND(0.1 / ADC_DISCRETE) && d->sens.carb);
 
  //checking coolant temperature sensor
  if (d->param.tmp_use)
  {
 #ifndef THERMISTOR_CS
   // error if (2.28v > voltage > 3.93v)
-  if (d->sens.temperat_raw < ROUND(2.28 / ADC_DISCRETE) || d->sens.temperat_raw > ROUND(3.93 / ADC_DISCRETE))
-   ce_set_error(ECUERROR_TEMP_SENSOR_FAIL);
-  else
-   ce_clear_error(ECUERROR_TEMP_SENSOR_FAIL);
+  sample_error(ECUERROR_TEMP_SENSOR_FAIL, d->sens.temperat_raw < ROUND(2.28 / ADC_DISCRETE) || d->sens.temperat_raw > ROUND(3.93 / ADC_DISCRETE));
 #else
   if (!d->param.cts_use_map) //use linear sensor
-  {
-   if (d->sens.temperat_raw < ROUND(2.28 / ADC_DISCRETE) || d->sens.temperat_raw > ROUND(3.93 / ADC_DISCRETE))
-    ce_set_error(ECUERROR_TEMP_SENSOR_FAIL);
-   else
-    ce_clear_error(ECUERROR_TEMP_SENSOR_FAIL);
-  }
-  else
-  {
-   // error if (0.2v > voltage > 4.7v) for thermistor
-   if (d->sens.temperat_raw < ROUND(0.2 / ADC_DISCRETE) || d->sens.temperat_raw > ROUND(4.7 / ADC_DISCRETE))
-    ce_set_error(ECUERROR_TEMP_SENSOR_FAIL);
-   else
-    ce_clear_error(ECUERROR_TEMP_SENSOR_FAIL);
-  }
+   sample_error(ECUERROR_TEMP_SENSOR_FAIL, d->sens.temperat_raw < ROUND(2.28 / ADC_DISCRETE) || d->sens.temperat_raw > ROUND(3.93 / ADC_DISCRETE));
+  else // error if (0.2v > voltage > 4.7v) for thermistor
+   sample_error(ECUERROR_TEMP_SENSOR_FAIL, d->sens.temperat_raw < ROUND(0.2 / ADC_DISCRETE) || d->sens.temperat_raw > ROUND(4.7 / ADC_DISCRETE));
 #endif
  }
  else
-  ce_clear_error(ECUERROR_TEMP_SENSOR_FAIL);
+  sample_error(ECUERROR_TEMP_SENSOR_FAIL, 0);
 
- //checking the voltage using simple state machine
- if (0==ce_state.bv_eds) //voltage is OK
- {
-  if (d->sens.voltage_raw < ROUND(12.0 / ADC_DISCRETE))
-  { //below normal
-   ce_state.bv_dev = 0, ce_state.bv_eds = 1;
-  }
-  else if (d->sens.voltage_raw > ROUND(16.0 / ADC_DISCRETE))
-  { //above normal
-   ce_state.bv_dev = 1, ce_state.bv_eds = 1;
-  }
-  else
-   ce_clear_error(ECUERROR_VOLT_SENSOR_FAIL);
+ //checking the voltage: error if voltage is out of normal range (12...16V) when RPM > 2500,
+ //U > 4 means that sensing is connected
+ sample_error(ECUERROR_VOLT_SENSOR_FAIL,
+  (d->sens.voltage_raw < ROUND(12.0 / ADC_DISCRETE) || d->sens.voltage_raw > ROUND(16.0 / ADC_DISCRETE)) &&
+  d->sens.voltage_raw > ROUND(4.0 / ADC_DISCRETE) && d->sens.inst_frq > 2500);
+}
 
-  ce_state.bv_tdc = 800; //init debouncing counter
- }
- else if (1==ce_state.bv_eds) //voltage is not OK
+/**Captures freeze frame into the RAM ring and starts lazy saving of it into EEPROM. Takes constant time.
+ * If ring is full (EEPROM is busy for a long time), then frame is lost.
+ * \param d pointer to ECU data structure
+ * \param errors bits of errors which appeared
+ */
+static void capture_frame(struct ecudata_t* d, uint16_t errors)
+{
+ ce_frame_t* p;
+ if (ce_log.count >= CE_FRAMES_RING)
  {
-  //use simple debouncing techique to eliminate errors during normal transients (e.g. switching ignition off) 
-  if (ce_state.bv_tdc)
-  {//state changed? If so, then rest state machine (start again)
-   if ((0==ce_state.bv_dev && d->sens.voltage_raw > ROUND(12.0 / ADC_DISCRETE)) ||
-       (1==ce_state.bv_dev && d->sens.voltage_raw < ROUND(16.0 / ADC_DISCRETE)))
-    ce_state.bv_eds = 0;
-
-   --ce_state.bv_tdc;
-  }
-  else
-  { //debouncing counter is expired
-   //error if U > 4 and RPM > 2500 
-   if (d->sens.voltage_raw > ROUND(4.0 / ADC_DISCRETE) && d->sens.inst_frq > 2500)
-    ce_set_error(ECUERROR_VOLT_SENSOR_FAIL);
-   else
-    ce_clear_error(ECUERROR_VOLT_SENSOR_FAIL);
-
-   ce_state.bv_eds = 0; //reset state machine
-  }
+  if (ce_log.lost < 255)
+   ++ce_log.lost;
+  return;
  }
+
+ p = &ce_log.ring[(ce_log.tail + ce_log.count) & (CE_FRAMES_RING - 1)];
+ p->errors = errors;
+ p->active = ce_state.ecuerrors;
+ p->time = s_timer_gtc();
+ p->rpm = d->sens.frequen;
+ p->map = d->sens.map;
+ p->voltage = d->sens.voltage;
+ p->temperat = d->sens.temperat;
+ p->angle = d->curr_angle;
+ p->mode = d->engine_mode;
+ p->flags = (d->sens.carb ? 1 : 0) | (d->sens.gas ? 2 : 0);
+ ++ce_log.count;
+
+ //frame will be written as soon as EEPROM will be released
+ sop_set_operation(SOP_SAVE_CE_FRAMES);
 }
 
 //If any error occurs, the CE is light up for a fixed time. If the problem persists (eg corrupted the program code),
@@ -194,7 +246,18 @@ void ce_check_engine(struct ecudata_t* d, volatile s_timer8_t* ce_control_time_c
 {
  uint16_t temp_errors;
 
- check(d);
+ //errors are checked and debounced on deterministic ticks
+ if (s_timer_is_action(ce_check_time_counter))
+ {
+  s_timer_set(ce_check_time_counter, CE_CHECK_TIME_VALUE);
+  check(d);
+ }
+
+ //capture freeze frame at the first rising edge of error bit(s)
+ temp_errors = ce_state.ecuerrors & ~ce_log.prev_errors;
+ ce_log.prev_errors = ce_state.ecuerrors;
+ if (temp_errors)
+  capture_frame(d, temp_errors);
 
  //If the timer counted the time, then turn off the CE
  //   ,   
@@ -234,28 +297,98 @@ void ce_check_engine(struct ecudata_t* d, volatile s_timer8_t* ce_control_time_c
  d->ecuerrors_for_transfer|= ce_state.ecuerrors;
 }
 
+uint16_t ce_read_saved_errors(void)
+{
+ ce_record_t rec;
+ if (!ce_state.saved_loaded)
+ {//scan journal only once, after that all writes go through the copy
+  if (ej_read(EJ_CE_ERRORS, &rec))
+   ce_state.saved_errors = rec.errors;
+  else
+  {//There are no valid records: EEPROM is empty or it was written by previous version of firmware, which
+   //stored errors after parameters (see eeprom.h). Take errors from there if parameters are valid and
+   //write them into the journal, so this is done only once
+   uint16_t crc;
+   ce_state.saved_errors = 0;
+   eeprom_read(&crc, EEPROM_PARAM_START + sizeof(params_t) - PAR_CRC_SIZE, sizeof(uint16_t));
+   if (crc16e(EEPROM_PARAM_START, sizeof(params_t) - PAR_CRC_SIZE) == crc)
+    eeprom_read(&ce_state.saved_errors, EEPROM_LEGACY_ECUERRORS_START, sizeof(uint16_t));
+   ce_state.write_errors.errors = ce_state.saved_errors;
+   ej_write_blocking(EJ_CE_ERRORS, &ce_state.write_errors);
+  }
+  ce_state.saved_loaded = 1;
+ }
+ return ce_state.saved_errors;
+}
+
 void ce_save_merged_errors(uint16_t* p_merged_errors)
 {
  uint16_t temp_errors;
 
  if (!p_merged_errors) //overwrite with parameter?
  {
-  eeprom_read(&temp_errors, EEPROM_ECUERRORS_START, sizeof(uint16_t));
-  ce_state.write_errors = temp_errors | ce_state.merged_errors;
-  if (ce_state.write_errors!=temp_errors)
-    eeprom_start_wr_data(0, EEPROM_ECUERRORS_START, &ce_state.write_errors, sizeof(uint16_t));
+  temp_errors = ce_read_saved_errors();
+  ce_state.write_errors.errors = temp_errors | ce_state.merged_errors;
+  if (ce_state.write_errors.errors!=temp_errors)
+   ej_write(EJ_CE_ERRORS, 0, &ce_state.write_errors);
  }
  else
  {
   ce_state.merged_errors = *p_merged_errors;
-  eeprom_start_wr_data(OPCODE_CE_SAVE_ERRORS, EEPROM_ECUERRORS_START, (uint8_t*)&ce_state.merged_errors, sizeof(uint16_t));
+  ce_state.write_errors.errors = *p_merged_errors;
+  ej_write(EJ_CE_ERRORS, OPCODE_CE_SAVE_ERRORS, &ce_state.write_errors);
  }
+ ce_state.saved_errors = ce_state.write_errors.errors;
+ ce_state.saved_loaded = 1;
 }
 
 void ce_clear_errors(void)
 {
  memset(&ce_state, 0, sizeof(ce_state_t));
- eeprom_write((uint8_t*)&ce_state.write_errors, EEPROM_ECUERRORS_START, sizeof(uint16_t));
+ ej_write_blocking(EJ_CE_ERRORS, &ce_state.write_errors);
+ ce_state.saved_loaded = 1; //saved_errors = 0
+}
+
+uint8_t ce_save_frames(void)
+{
+ if (ce_log.saving)
+ {//previous frame has been saved, release it
+  ce_log.tail = (ce_log.tail + 1) & (CE_FRAMES_RING - 1);
+  --ce_log.count;
+  ce_log.saving = 0;
+ }
+
+ if (!ce_log.count)
+  return 0; //all frames have been saved
+
+ ej_write(EJ_CE_FRAMES, 0, &ce_log.ring[ce_log.tail]);
+ ce_log.saving = 1;
+ return 1;
+}
+
+void ce_start_log_transfer(void)
+{
+ ce_log.xfer_index = 0;
+}
+
+void ce_read_log_frame(void)
+{
+ ce_log.xfer_valid = ej_read_slot(EJ_CE_FRAMES, ce_log.xfer_index, &ce_log.xfer);
+}
+
+uint8_t ce_next_log_frame(void)
+{
+ if (++ce_log.xfer_index < EEPROM_CEFRAMES_SLOTS)
+  return 1;
+ ce_log.xfer_index = 0;
+ return 0;
+}
+
+ce_frame_t* ce_get_log_frame(uint8_t* p_index, uint8_t* p_valid)
+{
+ *p_index = ce_log.xfer_index;
+ *p_valid = ce_log.xfer_valid;
+ return &ce_log.xfer;
 }
 
 void ce_init_ports(void)
@@ -43,9 +43,34 @@
 #define ECUERROR_DWELL_CONTROL          8  //!< Problems with dwell control (overcharge etc)
 #define ECUERROR_CAMS_MALFUNCTION       9  //!< CAM sensor malfunction
 #define ECUERROR_TPS_SENSOR_FAIL       10  //!< TPS sensor does not work
+#define ECUERROR_RAM_DATA_BROKEN       11  //!< Parameters or tables in RAM have been corrupted (reloaded from EEPROM/FLASH)
+#define ECUERROR_STACK_LOW             12  //!< Free memory of stack is less than allowed margin (see stackmon.h)
+#define ECUERROR_TABLES_OVERFLOW       13  //!< There is no free space in the pool of overlay of tables (see TABLES_OVERLAY)
+
+#define CE_ERRORS_NUMBER               16  //!< maximum number of errors (size of bit mask)
 
 struct ecudata_t;
 
+/**Freeze frame - snapshot of engine's state captured when error(s) appeared. Also it is a record
+ * of journal (see ejournal.h), so size of this structure must be equal to EEPROM_CEFRAMES_SLOT_SIZE
+ * (- -      ).
+ */
+typedef struct
+{
+ uint16_t seq;               //!< sequence number (filled by journal)
+ uint16_t errors;            //!< bits of errors which appeared (rising edges)
+ uint16_t active;            //!< bits of all errors which were active at that moment
+ uint32_t time;              //!< time stamp, runtime counter (10ms ticks since power-on)
+ uint16_t rpm;               //!< RPM ()
+ uint16_t map;               //!< MAP, load (   )
+ uint16_t voltage;           //!< board voltage (  )
+ int16_t  temperat;          //!< coolant temperature (  )
+ int16_t  angle;             //!< advance angle (  )
+ uint8_t  mode;              //!< engine mode (start, idle, work)
+ uint8_t  flags;             //!< bit 0 - carburetor's limit switch, bit 1 - gas valve
+ uint16_t crc;               //!< CRC of record (filled by journal)
+}ce_frame_t;
+
 /**checks for errors and manages the CE lamp
  * (       CE).
  * \param d pointer to ECU data structure
@@ -73,9 +98,42 @@ void ce_clear_error(uint8_t error);
  */
 void ce_save_merged_errors(uint16_t* p_merged_errors);
 
+/**Reads errors saved in the EEPROM (newest valid record of journal). Journal is scanned only at the
+ * first call, after that copy kept in RAM is returned. If journal is empty, then errors saved by previous
+ * versions of firmware are moved into it (see eeprom.h). Call only if EEPROM is ready!
+ * \return bits of saved errors, 0 if there are no valid records
+ */
+uint16_t ce_read_saved_errors(void);
+
 /**Clears errors saved in EEPROM (    EEPROM). */
 void ce_clear_errors(void);
 
+/**Saves freeze frames captured in RAM into the EEPROM log, one frame per call. Used by suspended operation,
+ * call only if EEPROM is ready!
+ * \return 1 - there are frames which are being saved or waiting for saving, 0 - all frames have been saved
+ */
+uint8_t ce_save_frames(void);
+
+/**Prepares transferring of freeze frames log, transferring will begin from the first record */
+void ce_start_log_transfer(void);
+
+/**Reads current record of freeze frames log from the EEPROM into buffer for transferring.
+ * Call only if EEPROM is ready!
+ */
+void ce_read_log_frame(void);
+
+/**Selects next record of freeze frames log for transferring
+ * \return 1 - next record selected, 0 - all records have been transferred
+ */
+uint8_t ce_next_log_frame(void);
+
+/**Used for transferring of freeze frames log via UART
+ * \param p_index receives index of record which is in the buffer
+ * \param p_valid receives 1 if record is valid, 0 - slot is empty or broken
+ * \return pointer to buffer containing record
+ */
+ce_frame_t* ce_get_log_frame(uint8_t* p_index, uint8_t* p_valid);
+
 /**Initialization of used I/O ports (   /). */
 void ce_init_ports(void);
 
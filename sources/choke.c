@@ -33,16 +33,44 @@
 #include "secu3.h"
 #include "smcontrol.h"
 #include "pwrrelay.h"
+#include "vstimer.h"
 
 /**Direction used to set choke to the initial position */
 #define INIT_POS_DIR SM_DIR_CW
 
+//Gains of the RPM regulator are chosen by closed-loop test on the host simulator (tools/hostsim.py choke,
+//scenario tools/hostsim/choke_load.txt): choke of the model changes idling RPM by ~0.8 min-1 per step,
+//RPM is averaged over 16 strokes (600ms at idling). With these gains RPM settles within 1.2...1.9s after
+//change of load without hunting of choke, also when authority of choke is 1.5 times higher or inertia
+//of engine is 2 times higher or lower. Doubled gains (KP = 32, KI = 8, RATE = 32) already give hunting.
+
+/**Period of the RPM regulator, 100ms (period of the regulator's calculations) */
+#define CHOKE_RPMREG_PERIOD  10
+
+/**Dead band of the RPM regulator, min-1 (   ) */
+#define CHOKE_RPMREG_DEADBAND 10
+
+/**Error of the RPM regulator is restricted to this value, min-1 */
+#define CHOKE_RPMREG_MAXERR  400
+
+/**Proportional gain of the RPM regulator, steps * 16 per 1 min-1 */
+#define CHOKE_RPMREG_KP      16
+
+/**Integral gain of the RPM regulator, steps * 16 per 1 min-1 per period */
+#define CHOKE_RPMREG_KI      4
+
+/**Maximum change of the RPM correction per period, steps (rate limit) */
+#define CHOKE_RPMREG_RATE    16
+
 /**Define state variables*/
 typedef struct
 {
  uint8_t   state;          //!< state machine state
  uint8_t   pwdn;           //!< powerdown flag (used if power management is enabled)
- uint16_t  smpos;          //!< current position of stepper motor in steps
+ int16_t   smpos;          //!< target position of stepper motor in steps (last issued)
+ int16_t   pos0;           //!< value of stepper's position counter at the initial position of choke
+ int16_t   rpm_int;        //!< integral term of the RPM regulator, steps * 16
+ int16_t   rpm_cor;        //!< RPM correction of choke position, steps
 }choke_st_t;
 
 /**Instance of state variables */
@@ -71,6 +99,46 @@ static void initial_pos(uint8_t dir, uint16_t steps)
  stpmot_run(steps + (steps >> 5));    //run using number of steps + 3%
 }
 
+/** PI regulator which corrects choke position using idling RPM error (fixed point).
+ * Target RPM is obtained from coolant temperature (idl_coolant_rpm_function()). Regulator
+ * works only when engine is running and choke is (partially) closed, otherwise its correction
+ * goes back to zero. Correction is restricted to +/- 25% of stepper's range and its rate of change
+ * is limited by CHOKE_RPMREG_RATE steps per period.
+ * \param d pointer to ECU data structure
+ * \param closing choke closing from lookup table (% * 2)
+ * \return correction in steps, positive value increases closing
+ */
+static int16_t calc_rpm_correction(struct ecudata_t* d, uint8_t closing)
+{
+ int16_t target = 0, limit = d->param.sm_steps >> 2;
+ if (limit > 2000)
+  limit = 2000;                                               //prevent overflow of the integral term
+
+ if (!s_timer_is_action(choke_regul_time_counter))
+  return chks.rpm_cor;
+ s_timer_set(choke_regul_time_counter, CHOKE_RPMREG_PERIOD);
+
+ if (d->st_block && closing && d->param.tmp_use)
+ {
+  int16_t error = (idl_coolant_rpm_function(d) / 16) - d->sens.frequen;
+  restrict_value_to(&error, -CHOKE_RPMREG_MAXERR, CHOKE_RPMREG_MAXERR);
+  if (abs(error) <= CHOKE_RPMREG_DEADBAND)
+   error = 0;                                                 //integral term holds its value
+
+  chks.rpm_int+= error * CHOKE_RPMREG_KI;
+  restrict_value_to(&chks.rpm_int, -limit * 16, limit * 16);  //anti-windup
+  target = (((int32_t)chks.rpm_int) + (error * CHOKE_RPMREG_KP)) / 16;
+  restrict_value_to(&target, -limit, limit);
+ }
+ else
+  chks.rpm_int = 0;
+
+ //limit rate of change
+ restrict_value_to(&target, chks.rpm_cor - CHOKE_RPMREG_RATE, chks.rpm_cor + CHOKE_RPMREG_RATE);
+ chks.rpm_cor = target;
+ return target;
+}
+
 void choke_control(struct ecudata_t* d)
 {
  switch(chks.state)
@@ -94,6 +162,9 @@ void choke_control(struct ecudata_t* d)
     else
      chks.state = 5;                                          //normal working
     chks.smpos = 0;
+    chks.pos0 = stpmot_get_pos();
+    chks.rpm_int = 0;
+    chks.rpm_cor = 0;
    }
    break;
 
@@ -113,16 +184,19 @@ void choke_control(struct ecudata_t* d)
    }
    else
    {
-    int16_t tmp_pos = (((int32_t)d->param.sm_steps) * choke_closing_lookup(d)) / 200;
-    int16_t rpm_cor = 0, diff;
+    uint8_t closing = choke_closing_lookup(d);
+    int16_t tmp_pos = (((int32_t)d->param.sm_steps) * closing) / 200;
+    int16_t rpm_cor = calc_rpm_correction(d, closing), diff;
     int16_t pos = tmp_pos + rpm_cor;
     restrict_value_to(&pos, 0, d->param.sm_steps);
-    diff = pos - chks.smpos;
-    if (!stpmot_is_busy() && diff != 0)
+    diff = pos - (stpmot_get_pos() - chks.pos0);              //use actual position of stepper
+    //Retarget stepper motor immediately if target has changed (even if it is moving now).
+    //Also, after reversal motor can stop beyond the target, so we check position when it is idle
+    if (diff != 0 && (pos != chks.smpos || !stpmot_is_busy()))
     {
      stpmot_dir(diff < 0 ? SM_DIR_CW : SM_DIR_CCW);
      stpmot_run(abs(diff));                                    //start stepper motor
-     chks.smpos += diff;
+     chks.smpos = pos;
     }
    }
    goto check_pwr;
@@ -35,9 +35,11 @@
 #include "ckps.h"
 #include "ioconfig.h"
 #include "magnitude.h"
+#include "profiler.h"
 
 #include "secu3.h"
 #include "knock.h"
+#include "trace.h"
 
 //PHASED_IGNITION can't be used without PHASE_SENSOR
 #if defined(PHASED_IGNITION) && !defined(PHASE_SENSOR)
@@ -150,6 +152,13 @@ typedef struct
 
  volatile uint8_t t1oc;               //!< Timer 1 overflow counter
  volatile uint8_t t1oc_s;             //!< Contains value of t1oc synchronized with stroke_period value
+
+ uint8_t  map_samp_num;               //!< Number of crank-angle resolved MAP samples per cycle (0 - sampling is off)
+ int8_t   map_samp_offset;            //!< Tooth of the first MAP sample relatively to TDC of the 1st cylinder (if > 0, then BTDC)
+ volatile uint8_t map_samp_idx;       //!< Index of the next MAP sample in the cycle
+ volatile uint16_t map_samp_base;     //!< Tooth number of the first MAP sample in the cycle
+ volatile uint16_t map_samp_step;     //!< Number of teeth between MAP samples (it is fractional number * 256)
+ volatile uint16_t map_samp_cog;      //!< Tooth number of the next MAP sample
 }ckpsstate_t;
  
 /**Precalculated data (reference points) and state data for a single channel plug
@@ -245,6 +254,11 @@ void ckps_init_state_variables(void)
   TIMSK|=_BV(TOIE1);                   //enable Timer 1 overflow interrupt. Used for correct calculation of very low RPM
   ckps.t1oc = 0;                       //reset overflow counter
   ckps.t1oc_s = 255;                   //RPM is very low
+
+ //MAP sampling will start from the first sample of a cycle
+ ckps.map_samp_idx = 0;
+ ckps.map_samp_cog = ckps.map_samp_base;
+ adc_reset_map_cycle();
  _END_ATOMIC_BLOCK();
 }
 
@@ -348,6 +362,29 @@ static uint16_t _normalize_tn(int16_t i_tn)
  return i_tn;
 }
 
+/**Calculates tooth number of the MAP sample with specified index in the cycle
+ * \param idx Index of sample (0...map_samp_num-1)
+ */
+static uint16_t _map_samp_tn(uint8_t idx)
+{
+ uint16_t tn = _normalize_tn(ckps.map_samp_base + ((((uint32_t)ckps.map_samp_step) * idx) >> 8));
+ return tn ? tn : ckps.wheel_cogs_num2; //numeration of teeth begins from 1
+}
+
+/**Recalculates tooth positions of crank-angle resolved MAP samples.
+ * Must be called when interrupts are disabled */
+static void _calc_map_samp(void)
+{
+ ckps.map_samp_step = 0;
+ if (ckps.map_samp_num > 1) //distribute samples uniformly over 720
+  ckps.map_samp_step = (((uint32_t)ckps.wheel_cogs_num2) << 8) / ckps.map_samp_num;
+ ckps.map_samp_base = _normalize_tn(((int16_t)ckps.cogs_btdc) - ckps.map_samp_offset);
+ if (0==ckps.map_samp_base)
+  ckps.map_samp_base = ckps.wheel_cogs_num2;
+ ckps.map_samp_idx = 0;
+ ckps.map_samp_cog = ckps.map_samp_base;
+}
+
 void ckps_set_cogs_btdc(uint8_t cogs_btdc)
 {
  uint8_t _t, i;
@@ -367,6 +404,20 @@ void ckps_set_cogs_btdc(uint8_t cogs_btdc)
 #endif
  }
  ckps.cogs_btdc = cogs_btdc;
+ _calc_map_samp(); //positions of MAP samples depend on ckps.cogs_btdc parameter
+ _RESTORE_INTERRUPT(_t);
+}
+
+void ckps_set_map_sampling(uint8_t i_num, int8_t i_offset)
+{
+ uint8_t _t;
+ if (i_num > CKPS_MAP_SAMP_MAX)
+  i_num = CKPS_MAP_SAMP_MAX;
+ _t=_SAVE_INTERRUPT();
+ _DISABLE_INTERRUPT();
+ ckps.map_samp_num = i_num;
+ ckps.map_samp_offset = i_offset;
+ _calc_map_samp();
  _RESTORE_INTERRUPT(_t);
 }
 
@@ -617,10 +668,7 @@ void turn_off_ignition_channel(uint8_t i_channel)
  */
 ISR(TIMER1_COMPA_vect)
 {
-#ifdef COOLINGFAN_PWM
- uint8_t timsk_sv, ucsrb_sv = UCSRB;
-#endif
-
+ PRF_ENTER();
 #ifdef DWELL_CONTROL
  ckps.tmrval_saved = TCNT1;
 #endif
@@ -632,7 +680,7 @@ ISR(TIMER1_COMPA_vect)
  //(    ,       -   
  //     ()).
  if (CKPS_CHANNEL_MODENA == ckps.channel_mode)
-  return; //none of channels selected (   )
+  PRF_RETURN(PRB_T1COMPA); //none of channels selected (   )
 
 #ifdef STROBOSCOPE
  if (1==ckps.strobe)
@@ -646,7 +694,7 @@ ISR(TIMER1_COMPA_vect)
  {
   IOCFG_SET(IOP_STROBE, 0); //end pulse
   ckps.strobe = 0;          //and reset flag
-  return;
+  PRF_RETURN(PRB_T1COMPA);
  }
 #endif
 
@@ -655,16 +703,6 @@ ISR(TIMER1_COMPA_vect)
  ((iocfg_pfn_set)chanstate[ckps.channel_mode].io_callback2)(IGN_OUTPUTS_ON_VAL);
 #endif
 
- //-----------------------------------------------------
-#ifdef COOLINGFAN_PWM
- timsk_sv = TIMSK;
- //ADCSRA&=~_BV(ADIE);            //??
- UCSRB&=~(_BV(RXCIE)|_BV(UDRIE)); //mask UART interrupts
- TIMSK&= _BV(OCIE2)|_BV(TOIE2);   //mask all timer interrupts except OCF2 and TOV2
- _ENABLE_INTERRUPT();
-#endif
- //-----------------------------------------------------
-
 #ifdef DWELL_CONTROL
  ckps.acc_delay = (((uint32_t)ckps.period_curr) * ckps.cogs_per_chan) >> 8;
  if (ckps.cr_acc_time > ckps.acc_delay-120)
@@ -688,14 +726,7 @@ ISR(TIMER1_COMPA_vect)
 #endif
 
  CLEARBIT(flags2, F_CALTIM); //we already output the spark, so calculation of time is finished
- //-----------------------------------------------------
-#ifdef COOLINGFAN_PWM
- _DISABLE_INTERRUPT();
- //ADCSRA|=_BV(ADIE);
- UCSRB = ucsrb_sv;
- TIMSK = timsk_sv;
-#endif
- //-----------------------------------------------------
+ PRF_LEAVE(PRB_T1COMPA);
 }
 
 #ifdef DWELL_CONTROL
@@ -704,10 +735,12 @@ ISR(TIMER1_COMPA_vect)
  */
 ISR(TIMER1_COMPB_vect)
 {
+ PRF_ENTER();
  TIMSK&= ~_BV(OCIE1B); // 
  //start accumulation
  turn_off_ignition_channel(ckps.channel_mode_b);
  ckps.channel_mode_b = CKPS_CHANNEL_MODENA;
+ PRF_LEAVE(PRB_T1COMPB);
 }
 #endif
 
@@ -781,20 +814,8 @@ static uint8_t sync_at_startup(void)
  */
 static void process_ckps_cogs(void)
 {
- uint8_t i, timsk_sv = TIMSK;
-
- //-----------------------------------------------------
- //Software PWM is very sensitive even to small delays. So, we need to allow OCF2 and TOV2
- //interrupts occur during processing of this handler.
-#ifdef COOLINGFAN_PWM
- //remember current state, mask all not urgent interrupts and enable interrupts
- uint8_t ucsrb_sv = UCSRB;
- //ADCSRA&=~_BV(ADIE);            //??
- UCSRB&=~(_BV(RXCIE)|_BV(UDRIE)); //mask UART interrupts
- TIMSK&= _BV(OCIE2)|_BV(TOIE2);   //mask all timer interrupts except OCF2 and TOV2
- _ENABLE_INTERRUPT();
-#endif
- //-----------------------------------------------------
+ uint8_t i;
+
  force_pending_spark();
 
 #ifdef DWELL_CONTROL
@@ -816,7 +837,7 @@ static void process_ckps_cogs(void)
   {
    OCR1B = GetICR() + ckps.acc_delay + ((int32_t)ckps.period_curr - ckps.period_saved);
    TIFR = _BV(OCF1B);
-   timsk_sv|= _BV(OCIE1B);
+   TIMSK|= _BV(OCIE1B);
    CLEARBIT(flags, F_NTSCHB); // To avoid entering into setup mode (       )
   }
   ckps.acc_delay-=ckps.period_curr;
@@ -891,6 +912,16 @@ static void process_ckps_cogs(void)
 #endif
  }
 
+ //crank-angle resolved sampling of MAP. Samples are distributed uniformly over 720, so the
+ //first sample of each cycle begins new cycle.
+ if (ckps.map_samp_num && ckps.cog == ckps.map_samp_cog)
+ {
+  adc_begin_measure_map(0==ckps.map_samp_idx, _AB(ckps.stroke_period, 1) < 4);
+  if (++ckps.map_samp_idx >= ckps.map_samp_num)
+   ckps.map_samp_idx = 0;
+  ckps.map_samp_cog = _map_samp_tn(ckps.map_samp_idx);
+ }
+
  force_pending_spark();
 
  //Preparing to start the ignition for the current channel (if the right moment became)
@@ -910,7 +941,7 @@ static void process_ckps_cogs(void)
    TIFR = _BV(OCF1A);
    CLEARBIT(flags, F_NTSCHA); // For avoiding to enter into setup mode (       )
    SETBIT(flags2, F_CALTIM);  // Set indication that we begin to calculate the time
-   timsk_sv|= _BV(OCIE1A);    // enable Compare A interrupt ( )
+   TIMSK|= _BV(OCIE1A);       // enable Compare A interrupt ( )
   }
  }
 
@@ -967,16 +998,6 @@ static void process_ckps_cogs(void)
  }
 #endif
 
- //-----------------------------------------------------
-#ifdef COOLINGFAN_PWM
- //disable interrupts and restore previous states of masked interrupts
- _DISABLE_INTERRUPT();
- //ADCSRA|=_BV(ADIE);
- UCSRB = ucsrb_sv;
-#endif
- TIMSK = timsk_sv;
- //-----------------------------------------------------
-
  force_pending_spark();
 }
 
@@ -985,8 +1006,13 @@ static void process_ckps_cogs(void)
  */
 ISR(TIMER1_CAPT_vect)
 {
+ PRF_ENTER();
  force_pending_spark();
 
+#ifdef TRACE_CAPTURE
+ trace_put_event(TRC_HDR(TRC_TOOTH, 0), GetICR());
+#endif
+
  ckps.period_curr = GetICR() - ckps.icr_prev;
 
  //At the start of engine, skipping a certain number of teeth for initializing
@@ -997,7 +1023,7 @@ ISR(TIMER1_CAPT_vect)
  {
   if (sync_at_startup())
    goto sync_enter;
-  return;
+  PRF_RETURN(PRB_T1CAPT);
  }
 
  //if missing teeth = 0, then reference will be identified by additional VR sensor (REF_S input),
@@ -1044,6 +1070,7 @@ sync_enter:
  ckps.period_prev = ckps.period_curr;
 
  force_pending_spark();
+ PRF_LEAVE(PRB_T1CAPT);
 }
 
 /**Purpose of this interrupt handler is to supplement timer up to 16 bits and call procedure
@@ -1052,6 +1079,7 @@ sync_enter:
  *      16-  ). */
 ISR(TIMER0_OVF_vect)
 {
+ PRF_ENTER();
  if (TCNT0_H!=0)  //Did high byte exhaust (   ) ?
  {
   TCNT0 = 0;
@@ -1073,6 +1101,7 @@ ISR(TIMER0_OVF_vect)
   process_ckps_cogs();
   ++ckps.cog360;
  }
+ PRF_LEAVE(PRB_T0OVF);
 }
 
 /** Timer 1 overflow interrupt.
@@ -35,6 +35,9 @@
  */
 #define ANGLE_MULTIPLAYER   32
 
+/**Maximum number of crank-angle resolved MAP samples per engine cycle */
+#define CKPS_MAP_SAMP_MAX   16
+
 /**Initialization of CKP module (hardware & variables)
  * (  /       )
  */
@@ -149,6 +152,13 @@ void ckps_set_merge_outs(uint8_t i_merge);
 void ckps_set_hall_pulse(int8_t i_offset, uint8_t i_duration);
 #endif
 
+/** Set parameters of crank-angle resolved MAP sampling. Samples are distributed uniformly over
+ * engine cycle (720), first sample of each cycle begins new cycle.
+ * \param i_num Number of MAP samples per engine cycle (0...CKPS_MAP_SAMP_MAX), 0 - sampling is off
+ * \param i_offset Tooth of the first sample relatively to TDC of the 1st cylinder (if > 0, then BTDC)
+ */
+void ckps_set_map_sampling(uint8_t i_num, int8_t i_offset);
+
 /** Set number of cranck wheel's teeth
  * \param norm_num Number of cranck wheel's teeth, including missing teeth (16...200)
  * \param miss_num Number of missing cranck wheel's teeth (0, 1, 2)
@@ -175,4 +175,29 @@
  #define COPT_SM_CONTROL 0
 #endif
 
+/** Capturing of input events (trace) */
+#ifdef TRACE_CAPTURE
+ #define COPT_TRACE_CAPTURE 1
+#else
+ #define COPT_TRACE_CAPTURE 0
+#endif
+
+/** Profiling of execution time */
+#ifdef PROFILING
+ #define COPT_PROFILING 1
+#else
+ #define COPT_PROFILING 0
+#endif
+
+/** Overlay (copy-on-write) mode of realtime tables */
+#ifdef TABLES_OVERLAY
+ #define COPT_TABLES_OVERLAY 1
+#else
+ #define COPT_TABLES_OVERLAY 0
+#endif
+
+/** Sets of tables have read only axes and source of load in the FLASH (fw_data_t::axes), FNNAME_DAT
+ *  consists of 4 parts. Always set, tells user interface about layout of firmware data */
+#define COPT_TABLES_AXES 1
+
 #endif //_COMPILOPT_H_
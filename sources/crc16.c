@@ -27,26 +27,39 @@
 
 #include "port/port.h"
 #include "crc16.h"
+#include "eeprom.h"
 
-#define      P_16   0xA001     //!< polynomial ()
+/**Table for calculation of CRC16 by nibbles (polynomial 0xA001). Much faster than bit by bit
+ * calculation and requires only 32 bytes of program memory
+ * (   CRC16  ) */
+PGM_DECLARE(uint16_t crc16_tab[16]) =
+{
+ 0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+ 0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+/**Updates CRC16 by one byte (low nibble first, then high nibble) */
+#define CRC16_UPDATE(crc, byte) \
+{ \
+ (crc) = ((crc) >> 4) ^ PGM_GET_WORD(&crc16_tab[((crc) ^ (byte)) & 0x0F]); \
+ (crc) = ((crc) >> 4) ^ PGM_GET_WORD(&crc16_tab[((crc) ^ ((byte) >> 4)) & 0x0F]); \
+}
 
 //variant for RAM (    RAM)
 uint16_t crc16( uint8_t *buf, uint16_t num )
 {
-uint16_t i;
-uint16_t crc = 0xffff;
+  return crc16_part(0xffff, buf, num);
+}
+
+//variant for RAM, continues calculation (    RAM,  )
+uint16_t crc16_part(uint16_t crc, uint8_t *buf, uint16_t num )
+{
+uint8_t byte;
 
   while ( num-- )
   {
-    crc ^= *buf++;
-    i = 8;
-    do
-    {
-      if ( crc & 1 )
-        crc = ( crc >> 1 ) ^ P_16;
-      else
-        crc >>= 1;
-    } while ( --i );
+    byte = *buf++;
+    CRC16_UPDATE(crc, byte);
   }
   return( crc );
 }
@@ -54,20 +67,33 @@ uint16_t crc = 0xffff;
 //variant for FLASH (    FLASH)
 uint16_t crc16f(uint8_t _PGM *buf, uint16_t num )
 {
-uint16_t i;
+  return crc16f_part(0xffff, buf, num);
+}
+
+//variant for FLASH, continues calculation (    FLASH,  )
+uint16_t crc16f_part(uint16_t crc, uint8_t _PGM *buf, uint16_t num )
+{
+uint8_t byte;
+
+  while ( num-- )
+  {
+    byte = PGM_GET_BYTE(buf++);
+    CRC16_UPDATE(crc, byte);
+  }
+
+  return( crc );
+}
+
+//variant for EEPROM (    EEPROM)
+uint16_t crc16e(uint16_t eeaddr, uint16_t num)
+{
 uint16_t crc = 0xffff;
+uint8_t byte;
 
   while ( num-- )
   {
-    crc ^= PGM_GET_BYTE(buf++);
-    i = 8;
-    do
-    {
-      if ( crc & 1 )
-        crc = ( crc >> 1 ) ^ P_16;
-      else
-        crc >>= 1;
-    } while ( --i );
+    eeprom_read(&byte, eeaddr++, 1);
+    CRC16_UPDATE(crc, byte);
   }
 
   return( crc );
@@ -39,6 +39,14 @@
  */
 uint16_t crc16(uint8_t *buf, uint16_t num);
 
+/** Continues calculation of CRC16 for given block of data in RAM (see crc16f_part())
+ * \param crc CRC16 of previous parts or 0xFFFF for the first part
+ * \param buf pointer to block of data (RAM) (   )
+ * \param num size of block to process (   )
+ * \return calculated CRC16 (  CRC16)
+ */
+uint16_t crc16_part(uint16_t crc, uint8_t *buf, uint16_t num);
+
 /** Calculates CRC16 for given block of data in ROM
  * (   CRC16     ).
  * \param buf pointer to block of data (ROM) (   )
@@ -47,4 +55,21 @@ uint16_t crc16(uint8_t *buf, uint16_t num);
  */
 uint16_t crc16f(uint8_t _PGM *buf, uint16_t num);
 
+/** Continues calculation of CRC16 for given block of data in ROM. Allows to calculate CRC16 of
+ * big block by parts (crc16f_part(crc16f_part(0xFFFF, a, n1), a + n1, n2) == crc16f(a, n1 + n2))
+ * \param crc CRC16 of previous parts or 0xFFFF for the first part
+ * \param buf pointer to block of data (ROM) (   )
+ * \param num size of block to process (   )
+ * \return calculated CRC16 (  CRC16)
+ */
+uint16_t crc16f_part(uint16_t crc, uint8_t _PGM *buf, uint16_t num);
+
+/** Calculates CRC16 for given block of data in EEPROM (call it only when EEPROM is idle!)
+ * (   CRC16     EEPROM).
+ * \param eeaddr address of block of data in the EEPROM
+ * \param num size of block to process (   )
+ * \return calculated CRC16 (  CRC16)
+ */
+uint16_t crc16e(uint16_t eeaddr, uint16_t num);
+
 #endif //_CRC16_H_
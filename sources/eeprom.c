@@ -31,6 +31,7 @@
 #include "port/port.h"
 #include "bitmask.h"
 #include "eeprom.h"
+#include "profiler.h"
 #include "wdt.h"
 
 /**Describes information is necessary for storing of data into EEPROM
@@ -44,14 +45,19 @@ typedef struct
  uint8_t eews;                 //!< State of writing process (  )
  uint8_t opcode;               //!< code of specific operation wich cased writing process
  uint8_t completed_opcode;     //!< will be equal to opcode after finish of process
+ uint16_t wr_count;            //!< number of bytes which were actually programmed during last process
 }eeprom_wr_desc_t;
 
 /**State variables */
-eeprom_wr_desc_t eewd = {0,0,0,0,0,0};
+eeprom_wr_desc_t eewd = {0,0,0,0,0,0,0};
 
 /** Initiates process of byte's writing (     EEPROM) */
 #define EE_START_WR_BYTE()  {EECR|= _BV(EEMWE);  EECR|= _BV(EEWE);}
 
+/**Maximum number of unchanged bytes which can be skipped during one interrupt. Interrupt from
+ * EEPROM is level-triggered, so remaining bytes will be checked in the next interrupt */
+#define EE_SKIP_MAX 8
+
 uint8_t eeprom_take_completed_opcode(void)
 {
  uint8_t result;
@@ -70,9 +76,19 @@ void eeprom_start_wr_data(uint8_t opcode, uint16_t eeaddr, void* sramaddr, uint1
  eewd.sram_addr = sramaddr;
  eewd.count = size;
  eewd.opcode = opcode;
+ eewd.wr_count = 0;
  SETBIT(EECR, EERIE);
 }
 
+uint16_t eeprom_get_written_count(void)
+{
+ uint16_t result;
+ _BEGIN_ATOMIC_BLOCK();
+ result = eewd.wr_count;
+ _END_ATOMIC_BLOCK();
+ return result;
+}
+
 //  0        
 uint8_t eeprom_is_idle(void)
 {
@@ -86,6 +102,8 @@ uint8_t eeprom_is_idle(void)
  */
 ISR(EE_RDY_vect)
 {
+ uint8_t skipped;
+ PRF_ENTER();
  CLEARBIT(EECR, EERIE); //   EEPROM
  _ENABLE_INTERRUPT();
  switch(eewd.eews)
@@ -94,18 +112,36 @@ ISR(EE_RDY_vect)
    break;
 
   case 1:   //   
-   _DISABLE_INTERRUPT();
-   EEAR = eewd.ee_addr;
-   EEDR = *eewd.sram_addr;
-   EE_START_WR_BYTE();
+   //Bytes are processed in ascending order of addresses, so the last byte of block (e.g. CRC)
+   //is always processed last. Only bytes which differ from current contents of EEPROM are
+   //programmed, bytes which already have required values are skipped (not more than EE_SKIP_MAX
+   //bytes per interrupt, so time spent in handler is bounded).
+   for(skipped = 0;;)
+   {
+    uint8_t differs;
+    _DISABLE_INTERRUPT();
+    EEAR = eewd.ee_addr;
+    SETBIT(EECR, EERE);     //read current value of the cell
+    differs = (EEDR != *eewd.sram_addr);
+    if (differs)
+    {
+     EEDR = *eewd.sram_addr;
+     EE_START_WR_BYTE();
+    }
+    _ENABLE_INTERRUPT();
+    ++eewd.sram_addr;
+    ++eewd.ee_addr;
+    if (--eewd.count==0)
+     eewd.eews = 2;   //     ( ).
+    if (differs)
+    {
+     ++eewd.wr_count;
+     break;           //wait for completion of byte's programming
+    }
+    if (2==eewd.eews || ++skipped >= EE_SKIP_MAX)
+     break;
+   }
    SETBIT(EECR, EERIE);
-   _ENABLE_INTERRUPT();
-   ++eewd.sram_addr;
-   ++eewd.ee_addr;
-   if (--eewd.count==0)
-    eewd.eews = 2;   //    .
-   else
-    eewd.eews = 1;
    break;
 
   case 2:   //  
@@ -114,6 +150,7 @@ ISR(EE_RDY_vect)
    eewd.completed_opcode = eewd.opcode;
    break;
  }//switch
+ PRF_LEAVE(PRB_EERDY);
 }
 
 void eeprom_read(void* sram_dest, uint16_t eeaddr, uint16_t size)
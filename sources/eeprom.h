@@ -31,19 +31,71 @@
 #include "port/pgmspace.h"
 #include <stdint.h>
 
-/**Address of parameters structure in EEPROM (    EEPROM) */
+/**Size of EEPROM in bytes, E2END defined in ioavr.h ( EEPROM  ) */
+#define EEPROM_SIZE            (((uint16_t)E2END) + 1)
+
+/**Address of the first slot of parameters in EEPROM. It is the place of record of parameters used by
+ * previous versions of firmware, so their EEPROM is read without conversion (see ejournal.h)
+ * (      EEPROM,       ) */
 #define EEPROM_PARAM_START     0x002
 
-/**Address of errors's array (Check Engine) in EEPROM (   (Check Engine)  EEPROM) */
-#define EEPROM_ECUERRORS_START (EEPROM_PARAM_START+(sizeof(params_t)))
+/**Size of slot of parameters: parameters (CRC is a part of params_t) followed by sequence number.
+ * Sequence number is not covered by params_t::crc (see ejournal.h) */
+#define EEPROM_PARAM_SLOT_SIZE (sizeof(params_t) + sizeof(uint16_t))
+
+/**Address of bits of errors saved by previous versions of firmware. Now this word is sequence number of
+ * the first slot of parameters, errors are moved into their own slots at the first start (see ce_errors.c)
+ * ( ,    ) */
+#define EEPROM_LEGACY_ECUERRORS_START (EEPROM_PARAM_START + sizeof(params_t))
+
+/**Address of tables which can be edited in real time (the same as in previous versions of firmware).
+ * Each set takes TABLES_EE_SIZE bytes (see tables.h) */
+#define EEPROM_REALTIME_TABLES_START (EEPROM_LEGACY_ECUERRORS_START + 16)
+
+/**Address of the beginning of journaled storage (see ejournal.h). Rest of the EEPROM is used by journal
+ * (   ,   EEPROM  ) */
+#define EEPROM_JOURNAL_START   (EEPROM_REALTIME_TABLES_START + (TABLES_EE_SIZE * TUNABLE_TABLES_NUMBER))
+
+/**Address of slots of errors (Check Engine) in EEPROM (   (Check Engine)  EEPROM) */
+#define EEPROM_ECUERRORS_START EEPROM_JOURNAL_START
+
+/**Size of slot of errors: sequence number, bits of errors, CRC */
+#define EEPROM_ECUERRORS_SLOT_SIZE (sizeof(uint16_t) * 3)
+
+/**Number of slots of errors */
+#define EEPROM_ECUERRORS_SLOTS 8
 
-/**Address of tables which can be edited in real time */
-#define EEPROM_REALTIME_TABLES_START (EEPROM_ECUERRORS_START + 16)
+/**Address of the second slot of parameters, following slots are placed one after another
+ * (      EEPROM) */
+#define EEPROM_PARAM_EXT_START (EEPROM_ECUERRORS_START + (EEPROM_ECUERRORS_SLOT_SIZE * EEPROM_ECUERRORS_SLOTS))
+
+/**Number of bytes of EEPROM which are left for slots of parameters and freeze frames. Evaluates to 0
+ * if start of slots is beyond the end of EEPROM (unsigned subtraction must not wrap) */
+#define EEPROM_FREE_SIZE       ((EEPROM_PARAM_EXT_START < EEPROM_SIZE) ? (EEPROM_SIZE - EEPROM_PARAM_EXT_START) : 0)
+
+/**Size of slot of freeze frame: sequence number, 7 words of data, time stamp, 2 bytes of data, CRC
+ * (must be equal to sizeof(ce_frame_t), see ce_errors.h) */
+#define EEPROM_CEFRAMES_SLOT_SIZE ((sizeof(uint16_t) * 9) + sizeof(uint32_t) + (sizeof(uint8_t) * 2))
+
+/**Number of slots of freeze frames (size of log in the EEPROM). Log is less important than parameters,
+ * so it takes only space which is left after the second slot of parameters (but not more than 4 slots) */
+#define EEPROM_CEFRAMES_SLOTS_FIT ((EEPROM_FREE_SIZE > EEPROM_PARAM_SLOT_SIZE) ? ((EEPROM_FREE_SIZE - EEPROM_PARAM_SLOT_SIZE) / EEPROM_CEFRAMES_SLOT_SIZE) : 0)
+#define EEPROM_CEFRAMES_SLOTS  ((EEPROM_CEFRAMES_SLOTS_FIT > 4) ? 4 : EEPROM_CEFRAMES_SLOTS_FIT)
+
+/**Number of slots of parameters: the first slot and all the rest of EEPROM (but not more than 16 slots) */
+#define EEPROM_PARAM_SLOTS_FIT (1 + ((EEPROM_FREE_SIZE - (EEPROM_CEFRAMES_SLOT_SIZE * EEPROM_CEFRAMES_SLOTS)) / EEPROM_PARAM_SLOT_SIZE))
+#define EEPROM_PARAM_SLOTS     ((EEPROM_PARAM_SLOTS_FIT > 16) ? 16 : EEPROM_PARAM_SLOTS_FIT)
+
+/**Address of slots of freeze frames of CE errors in EEPROM, log follows slots of parameters
+ * (  -  CE  EEPROM) */
+#define EEPROM_CEFRAMES_START  (EEPROM_PARAM_EXT_START + (EEPROM_PARAM_SLOT_SIZE * (EEPROM_PARAM_SLOTS - 1)))
 
 //Interface of module ( )
 
 /**Start writing process of EEPROM for selected block of data
- * (    EEPROM   )
+ * (    EEPROM   ).
+ * Only bytes which differ from current contents of EEPROM will be programmed. Bytes are processed
+ * in ascending order of addresses, so last bytes of block (e.g. CRC) are always written last.
  * \param opcode some code which will be remembered and can be retrieved when process finishes
  * \param eeaddr address in the EEPROM for write into
  * \param sramaddr address of block of data in RAM
@@ -57,6 +109,12 @@ void eeprom_start_wr_data(uint8_t opcode, uint16_t eeaddr, void* sramaddr, uint1
  */
 uint8_t eeprom_is_idle(void);
 
+/**Returns number of bytes which were actually programmed (differed from contents of EEPROM)
+ * during the last process started by eeprom_start_wr_data().
+ * \return number of programmed bytes
+ */
+uint16_t eeprom_get_written_count(void);
+
 /**Reads specified block of data from EEPROM to RAM (without using of interrupts)
  *      EEPROM (  )
  * \param sram_dest address of buffer in the RAM which will receive data
@@ -0,0 +1,215 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file ejournal.c
+ * Implementation of journaled storage of records in the EEPROM (wear leveling).
+ * (     EEPROM ( )).
+ */
+
+#include "port/avrio.h"
+#include "port/pgmspace.h"
+#include "port/port.h"
+#include "crc16.h"
+#include "eeprom.h"
+#include "ejournal.h"
+#include "tables.h"
+
+/**Value of sequence number of erased slot. This value is never used for records */
+#define EJ_SEQ_ERASED       0xFFFF
+
+/**Value returned by scan when stream has no valid records */
+#define EJ_SLOT_NA          EJ_SLOTS_MAX
+
+/**Describes location of stream in the EEPROM */
+typedef struct
+{
+ uint16_t start;              //!< address of the first slot
+ uint16_t next;               //!< address of the second slot, following slots are placed one after another
+ uint16_t size;               //!< size of slot (record) in bytes
+ uint16_t seq_ofs;            //!< offset of sequence number in the record: 0 - header, otherwise trailer (after CRC)
+ uint8_t  slots;              //!< number of slots
+}ejdesc_t;
+
+/**Locations of streams in the EEPROM (see eeprom.h) */
+PGM_DECLARE(ejdesc_t ej_desc[EJ_STREAMS]) =
+{
+ {EEPROM_PARAM_START, EEPROM_PARAM_EXT_START, EEPROM_PARAM_SLOT_SIZE, sizeof(params_t), EEPROM_PARAM_SLOTS}, //EJ_PARAMS (seq. number after params_t)
+ {EEPROM_ECUERRORS_START, EEPROM_ECUERRORS_START + EEPROM_ECUERRORS_SLOT_SIZE, EEPROM_ECUERRORS_SLOT_SIZE, 0, EEPROM_ECUERRORS_SLOTS}, //EJ_CE_ERRORS
+ {EEPROM_CEFRAMES_START, EEPROM_CEFRAMES_START + EEPROM_CEFRAMES_SLOT_SIZE, EEPROM_CEFRAMES_SLOT_SIZE, 0, EEPROM_CEFRAMES_SLOTS} //EJ_CE_FRAMES
+};
+
+/**Compile time check: the first slot of parameters must not overlap tables stored in the EEPROM
+ * (otherwise size of array is negative) */
+typedef char ej_param_first_slot_check_t[((EEPROM_PARAM_START + EEPROM_PARAM_SLOT_SIZE) <= EEPROM_REALTIME_TABLES_START) ? 1 : -1];
+
+/**Compile time check: at least two slots of parameters must fit into the EEPROM after tunable sets of
+ * tables and other streams, otherwise interrupted writing may destroy the only copy of parameters
+ * (otherwise size of array is negative) */
+typedef char ej_param_slot_check_t[(EEPROM_PARAM_SLOTS_FIT >= 2) ? 1 : -1];
+
+/**Compile time check: at least one slot of freeze frames must fit into the EEPROM after two slots of
+ * parameters (otherwise size of array is negative) */
+typedef char ej_ceframes_slot_check_t[(EEPROM_CEFRAMES_SLOTS >= 1) ? 1 : -1];
+
+/**Describes state of stream */
+typedef struct
+{
+ uint16_t seq;                //!< sequence number of the newest record
+ uint8_t  slot;               //!< index of slot which contains the newest record
+ uint8_t  ready;              //!< 1 - stream has been scanned and fields above are valid
+}ejstate_t;
+
+/**State variables of streams */
+ejstate_t ej_state[EJ_STREAMS] = {{0,0,0},{0,0,0},{0,0,0}};
+
+/**Calculates address of specified slot of stream
+ * \param stream Stream's index
+ * \param slot Slot's index
+ * \return address in the EEPROM
+ */
+static uint16_t ej_slot_addr(uint8_t stream, uint8_t slot)
+{
+ if (!slot)
+  return PGM_GET_WORD(&ej_desc[stream].start);
+ return PGM_GET_WORD(&ej_desc[stream].next) + (PGM_GET_WORD(&ej_desc[stream].size) * (slot - 1));
+}
+
+/**Calculates offset of CRC in the record of stream. CRC covers all bytes before it
+ * \param stream Stream's index
+ * \return offset of CRC in bytes
+ */
+static uint16_t ej_crc_ofs(uint8_t stream)
+{
+ uint16_t seq_ofs = PGM_GET_WORD(&ej_desc[stream].seq_ofs);
+ return (seq_ofs ? seq_ofs : PGM_GET_WORD(&ej_desc[stream].size)) - EJ_CRC_SIZE;
+}
+
+/**Scans slots of stream and finds the newest valid record. At first only sequence numbers are read,
+ * then CRC is checked for candidates beginning from the newest one.
+ * \param stream Stream's index
+ * \return index of slot or EJ_SLOT_NA if there are no valid records
+ */
+static uint8_t ej_scan(uint8_t stream)
+{
+ uint16_t seq[EJ_SLOTS_MAX];
+ uint16_t excluded = 0;       //bit mask of slots which do not contain valid records
+ uint16_t seq_ofs = PGM_GET_WORD(&ej_desc[stream].seq_ofs);
+ uint16_t crc_ofs = ej_crc_ofs(stream);
+ uint8_t  slots = PGM_GET_BYTE(&ej_desc[stream].slots), i, best;
+
+ for(i = 0; i < slots; ++i)
+ {
+  eeprom_read(&seq[i], ej_slot_addr(stream, i) + seq_ofs, EJ_SEQ_SIZE);
+  if (EJ_SEQ_ERASED == seq[i])
+   excluded|= (((uint16_t)1) << i);
+ }
+
+ for(;;)
+ {
+  uint16_t addr, crc;
+  best = EJ_SLOT_NA;
+  for(i = 0; i < slots; ++i)
+  {
+   if (excluded & (((uint16_t)1) << i))
+    continue;
+   //sequence numbers may wrap around, so compare them using difference
+   if (EJ_SLOT_NA == best || ((int16_t)(seq[i] - seq[best])) > 0)
+    best = i;
+  }
+  if (EJ_SLOT_NA == best)
+   break;                     //there are no valid records
+
+  addr = ej_slot_addr(stream, best);
+  eeprom_read(&crc, addr + crc_ofs, EJ_CRC_SIZE);
+  if (crc16e(addr, crc_ofs) == crc)
+   break;                     //found
+
+  excluded|= (((uint16_t)1) << best); //record is broken (e.g. writing was interrupted), try older one
+ }
+
+ //new records will be written after the newest one
+ ej_state[stream].ready = 1;
+ if (EJ_SLOT_NA == best)
+ {
+  ej_state[stream].slot = slots - 1;
+  ej_state[stream].seq = 0;
+ }
+ else
+ {
+  ej_state[stream].slot = best;
+  ej_state[stream].seq = seq[best];
+ }
+ return best;
+}
+
+/**Selects next slot of stream and fills sequence number and CRC of record
+ * \param stream Stream's index
+ * \param rec Buffer which contains record
+ * \return address of slot in the EEPROM
+ */
+static uint16_t ej_prepare(uint8_t stream, void* rec)
+{
+ uint16_t crc_ofs = ej_crc_ofs(stream);
+ ejstate_t* p_st = &ej_state[stream];
+
+ if (!p_st->ready)
+  ej_scan(stream);
+
+ if (++p_st->slot >= PGM_GET_BYTE(&ej_desc[stream].slots))
+  p_st->slot = 0;
+ if (EJ_SEQ_ERASED == ++p_st->seq)
+  p_st->seq = 0;
+
+ *((uint16_t*)(((uint8_t*)rec) + PGM_GET_WORD(&ej_desc[stream].seq_ofs))) = p_st->seq;
+ *((uint16_t*)(((uint8_t*)rec) + crc_ofs)) = crc16((uint8_t*)rec, crc_ofs);
+ return ej_slot_addr(stream, p_st->slot);
+}
+
+uint8_t ej_read(uint8_t stream, void* rec)
+{
+ uint8_t slot = ej_scan(stream);
+ if (EJ_SLOT_NA == slot)
+  return 0;
+ eeprom_read(rec, ej_slot_addr(stream, slot), PGM_GET_WORD(&ej_desc[stream].size));
+ return 1;
+}
+
+uint8_t ej_read_slot(uint8_t stream, uint8_t slot, void* rec)
+{
+ uint16_t crc_ofs = ej_crc_ofs(stream);
+ eeprom_read(rec, ej_slot_addr(stream, slot), PGM_GET_WORD(&ej_desc[stream].size));
+ if (EJ_SEQ_ERASED == *((uint16_t*)(((uint8_t*)rec) + PGM_GET_WORD(&ej_desc[stream].seq_ofs))))
+  return 0;
+ return (crc16((uint8_t*)rec, crc_ofs) == *((uint16_t*)(((uint8_t*)rec) + crc_ofs)));
+}
+
+void ej_write(uint8_t stream, uint8_t opcode, void* rec)
+{
+ uint16_t addr = ej_prepare(stream, rec);
+ eeprom_start_wr_data(opcode, addr, rec, PGM_GET_WORD(&ej_desc[stream].size));
+}
+
+void ej_write_blocking(uint8_t stream, void* rec)
+{
+ uint16_t addr = ej_prepare(stream, rec);
+ eeprom_write(rec, addr, PGM_GET_WORD(&ej_desc[stream].size));
+}
@@ -0,0 +1,94 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file ejournal.h
+ * Journaled storage of records in the EEPROM (wear leveling).
+ * Each kind of record (stream) occupies several slots in the EEPROM which are used in turn.
+ * Each slot contains sequence number, data and CRC16. Sequence number is stored either in the header
+ * of record (CRC is calculated over sequence number and data) or in the trailer of record, after CRC
+ * (CRC is calculated over data only). Trailer is used for parameters, so params_t::crc keeps its
+ * meaning for PC tools and boot loader: CRC16 of parameters excluding crc field.
+ * Newest valid record is found by comparing of sequence numbers of slots.
+ * The first slot of parameters is placed at the address of parameters used by previous versions of
+ * firmware (other slots follow tables), so their record is found as usual one. Its sequence number is
+ * the word of errors saved by these versions (see eeprom.h).
+ * (    EEPROM ( )).
+ */
+
+#ifndef _EJOURNAL_H_
+#define _EJOURNAL_H_
+
+#include <stdint.h>
+
+/**Size of record's sequence number in bytes */
+#define EJ_SEQ_SIZE         sizeof(uint16_t)
+
+/**Size of record's CRC in bytes. CRC is stored in the last bytes of record or just before
+ * sequence number if latter is stored in the trailer */
+#define EJ_CRC_SIZE         sizeof(uint16_t)
+
+/**Maximum number of slots per stream */
+#define EJ_SLOTS_MAX        16
+
+#define EJ_PARAMS           0    //!< stream of parameters (params_t)
+#define EJ_CE_ERRORS        1    //!< stream of saved CE errors
+#define EJ_CE_FRAMES        2    //!< stream of freeze frames of CE errors (log)
+#define EJ_STREAMS          3    //!< number of streams
+
+/**Finds newest valid record of specified stream and reads it into RAM.
+ * Only sequence numbers of slots are read during scan, CRC is checked only for candidate.
+ * Call this function only when EEPROM is idle!
+ * \param stream Stream's index (e.g. EJ_PARAMS)
+ * \param rec Buffer in RAM which will receive record (sequence number, data and CRC). Size of buffer
+ * must be equal to size of stream's slot
+ * \return 1 - record has been found and read, 0 - there are no valid records
+ */
+uint8_t ej_read(uint8_t stream, void* rec);
+
+/**Reads specified slot of stream into RAM and checks its CRC. Used when all records of stream are
+ * needed (e.g. log), newest record can be found by sequence numbers.
+ * Call this function only when EEPROM is idle!
+ * \param stream Stream's index (e.g. EJ_CE_FRAMES)
+ * \param slot Index of slot
+ * \param rec Buffer in RAM which will receive record. Size of buffer must be equal to size of stream's slot
+ * \return 1 - slot contains valid record, 0 - slot is erased or broken
+ */
+uint8_t ej_read_slot(uint8_t stream, uint8_t slot, void* rec);
+
+/**Starts writing of record into the next slot of specified stream (uses interrupt-driven EEPROM writer).
+ * Sequence number and CRC of record will be filled by this function.
+ * Call this function only when EEPROM is idle!
+ * \param stream Stream's index (e.g. EJ_PARAMS)
+ * \param opcode Code of operation which will be passed to eeprom_start_wr_data()
+ * \param rec Buffer in RAM which contains record. It must stay unchanged until writing finishes
+ */
+void ej_write(uint8_t stream, uint8_t opcode, void* rec);
+
+/**Writes record into the next slot of specified stream without using of interrupts.
+ * Sequence number and CRC of record will be filled by this function.
+ * Call this function only when EEPROM is idle!
+ * \param stream Stream's index (e.g. EJ_PARAMS)
+ * \param rec Buffer in RAM which contains record
+ */
+void ej_write_blocking(uint8_t stream, void* rec);
+
+#endif //_EJOURNAL_H_
@@ -28,6 +28,7 @@
 #include "port/port.h"
 #include "bitmask.h"
 #include "fuelecon.h"
+#include "funconv.h"    //baro_upper_pressure()
 #include "ioconfig.h"
 #include "secu3.h"
 
@@ -45,7 +46,8 @@ void fuelecon_control(struct ecudata_t* d)
 {
  int16_t discharge;
 
- discharge = (d->param.map_upper_pressure - d->sens.map);
+ //threshold is relative to upper pressure compensated by barometric pressure
+ discharge = (baro_upper_pressure(d) - d->sens.map);
  if (discharge < 0)
   discharge = 0;
  d->fe_valve = discharge < d->param.fe_on_threshold;
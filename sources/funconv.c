@@ -31,22 +31,105 @@
 #include "ckps.h"
 #include "funconv.h"
 #include "magnitude.h"
+#include "measure.h"
 #include "secu3.h"
 #include "vstimer.h"
-#include "idlregul.h"
 
 //For use with fn_dat pointer, because it can point either to FLASH or RAM
-#ifdef REALTIME_TABLES
+#if defined(TABLES_OVERLAY)
+ #define _GB(x) ovl_get_byte(d, (uint8_t _PGM*)(x))
+ #define _GW(x) ovl_get_word(d, (uint8_t _PGM*)(x))
+#elif defined(REALTIME_TABLES)
  #define _GB(x) *(x)
+ #define _GW(x) *(x)
 #else
  #define _GB(x) PGM_GET_BYTE(x)
+ #define _GW(x) PGM_GET_WORD(x)
 #endif
 
-//       ,      .
-/**Array which contains RPM axis's grid bounds */
-PGM_DECLARE(int16_t f_slots_ranges[16]) = {600,720,840,990,1170,1380,1650,1950,2310,2730,3210,3840,4530,5370,6360,7500};
-/**Array which contains RPM axis's grid sizes */
-PGM_DECLARE(int16_t f_slots_length[15]) = {120,120,150,180, 210, 270, 300, 360, 420, 480, 630, 690, 840, 990, 1140};
+#ifdef TABLES_OVERLAY
+/**Reads value from current set of tables (constant time). Value is taken from the pool of overlay if
+ * its row has been replaced, otherwise from the base set in the FLASH.
+ * \param d pointer to ECU data structure
+ * \param p address of value in the base set (relative to ecudata_t::fn_dat)
+ * \return value
+ */
+static int8_t ovl_get_byte(struct ecudata_t* d, uint8_t _PGM* p)
+{
+ uint16_t offset = p - (uint8_t _PGM*)d->fn_dat;
+ uint8_t slot = d->fn_ovl->slot[offset / TABLES_ROW_SIZE];
+ if (TABLES_OVL_BASE == slot)
+  return PGM_GET_BYTE(p);
+ return d->tables_ovl[slot][offset % TABLES_ROW_SIZE];
+}
+
+/**Reads 16-bit value from current set of tables (see ovl_get_byte()). Values are aligned, so
+ * both bytes always belong to the same row.
+ * \param d pointer to ECU data structure
+ * \param p address of value in the base set (relative to ecudata_t::fn_dat)
+ * \return value
+ */
+static uint16_t ovl_get_word(struct ecudata_t* d, uint8_t _PGM* p)
+{
+ uint16_t offset = p - (uint8_t _PGM*)d->fn_dat;
+ uint8_t slot = d->fn_ovl->slot[offset / TABLES_ROW_SIZE];
+ if (TABLES_OVL_BASE == slot)
+  return PGM_GET_WORD((uint16_t _PGM*)p);
+ offset%= TABLES_ROW_SIZE;
+ return d->tables_ovl[slot][offset] | (((uint16_t)d->tables_ovl[slot][offset + 1]) << 8);
+}
+#endif
+
+/**Calculates reciprocal of length of segment of axis (65536 / length) used for interpolation without
+ * division. Zero is returned for wrong (not increasing) axis. */
+#define AXIS_RCP(len) (((len) <= 0) ? 0 : (((len) == 1) ? 0xFFFF : (uint16_t)(65536UL / (len))))
+
+/**Reciprocals of lengths of segments of axes of current set of tables. Axes are constant (they are
+ * in the FLASH), so reciprocals are calculated only when other set of tables is selected */
+typedef struct
+{
+ f_axes_t _PGM *axes;                    //!< axes which reciprocals were calculated for
+ uint16_t rpm_rcp[F_WRK_POINTS_F - 1];   //!< reciprocals of lengths of segments of RPM axis
+ uint16_t load_rcp[F_WRK_POINTS_L - 1];  //!< reciprocals of lengths of segments of load axis
+}axes_rcp_t;
+
+/**Cache of reciprocals, see update_axes_rcp() */
+static axes_rcp_t arc = {0};
+
+/**Recalculates reciprocals of lengths of segments of axes if current set of tables has been changed
+ * \param d pointer to ECU data structure
+ */
+static void update_axes_rcp(struct ecudata_t* d)
+{
+ uint8_t i;
+ if (arc.axes == d->fn_axes)
+  return;
+ for(i = 0; i < F_WRK_POINTS_F - 1; ++i)
+  arc.rpm_rcp[i] = AXIS_RCP((int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[i + 1]) - (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[i]));
+ for(i = 0; i < F_WRK_POINTS_L - 1; ++i)
+  arc.load_rcp[i] = AXIS_RCP((int16_t)PGM_GET_BYTE(&d->fn_axes->load_grid_points[i + 1]) - (int16_t)PGM_GET_BYTE(&d->fn_axes->load_grid_points[i]));
+ arc.axes = d->fn_axes;
+}
+
+/**Calculates position of argument inside segment of axis without division
+ * \param dx distance of argument from the beginning of segment (must not be negative)
+ * \param rcp reciprocal of length of segment (see AXIS_RCP)
+ * \return position in 1/4096 of length of segment (greater than 4096 if argument is beyond the segment)
+ */
+static int32_t axis_position(uint16_t dx, uint16_t rcp)
+{
+ return ((uint32_t)dx * rcp) >> 4;
+}
+
+/**Linear interpolation by position calculated using axis_position()
+ * \param a1, a2 values of function at the beginning and at the end of segment
+ * \param pos position inside segment (1/4096)
+ * \return interpolated value of function * 16
+ */
+static int16_t position_interpolation(int16_t a1, int16_t a2, int32_t pos)
+{
+ return (a1 * 16) + ((((int32_t)(a2 - a1) * 16) * pos) >> 12);
+}
 
 //     ,  10 ,  -30
 int16_t idl_collant_rpm_t[16] = {1500,1400,1300,1200,1050, 1025, 1000, 970, 940, 820, 800, 800, 800, 800, 800, 800};
@@ -106,17 +189,19 @@ return simple_interpolation(t, idl_collant_rpm_t[i], idl_collant_rpm_t[i1],
 int16_t idling_function(struct ecudata_t* d)
 {
  int8_t i;
- int16_t rpm = d->sens.inst_frq;
+ int16_t rpm = d->sens.inst_frq, rpm_s;
 
+ update_axes_rcp(d);
  //  ,       
+ //(     , RPM axis is stored in the set of tables)
  for(i = 14; i >= 0; i--)
-  if (d->sens.inst_frq >= PGM_GET_WORD(&f_slots_ranges[i])) break;
+  if (rpm >= (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[i])) break;
 
- if (i < 0)  {i = 0; rpm = 600;}
+ if (i < 0)  {i = 0; rpm = (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[0]);}
+ rpm_s = (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[i]);
 
- return simple_interpolation(rpm,
-             _GB(&d->fn_dat->f_idl[i]), _GB(&d->fn_dat->f_idl[i+1]),
-             PGM_GET_WORD(&f_slots_ranges[i]), PGM_GET_WORD(&f_slots_length[i]));
+ return position_interpolation(_GB(&d->fn_dat->f_idl[i]), _GB(&d->fn_dat->f_idl[i+1]),
+             axis_position(rpm - rpm_s, arc.rpm_rcp[i]));
 }
 
 
@@ -137,27 +222,96 @@ int16_t start_function(struct ecudata_t* d)
 }
 
 
+/**Multiplier used for conversion of closing of throttle into load without division: (x * factor) >> 7 */
+#define TPS_LOAD_FACTOR ROUND((128.0 * 256) / TPS_MAGNITUDE(100))
+
+/**Calculates position on the load axis of work map from MAP. 256 units = range between upper and lower pressures
+ * (      )
+ * \param d pointer to ECU data structure
+ * \return load (0...256), 0 corresponds to full load
+ */
+static int16_t map_load(struct ecudata_t* d)
+{
+ int16_t range, discharge, upper = baro_upper_pressure(d);
+ int32_t load;
+
+ discharge = (upper - d->sens.map);
+ if (discharge < 0) discharge = 0;
+
+ //upper -    (with barometric compensation)
+ //map_lower_pressure -   
+ range = upper - d->param.map_lower_pressure;
+ if (range < 1)
+  range = 1;  //           
+
+ load = ((int32_t)discharge * 256) / range;
+ return (load > 256) ? 256 : load;
+}
+
+#ifdef TPS_AVAILABLE
+/**Calculates position on the load axis of work map from throttle position (Alpha-N). 256 units = range of
+ * throttle from fully open to closed (     )
+ * \param d pointer to ECU data structure
+ * \return load (0...256), 0 corresponds to fully opened throttle
+ */
+static int16_t tps_load(struct ecudata_t* d)
+{
+ uint8_t tps = d->sens.tps;
+ if (tps > TPS_MAGNITUDE(100))
+  tps = TPS_MAGNITUDE(100);
+ return ((uint16_t)(TPS_MAGNITUDE(100) - tps) * TPS_LOAD_FACTOR) >> 7;
+}
+#endif
+
 //     (-1)  ()    
 //        * 32, 2 * 16 = 32.
 int16_t work_function(struct ecudata_t* d, uint8_t i_update_airflow_only)
 {
- int16_t  gradient, discharge, rpm = d->sens.inst_frq, l;
- int8_t f, fp1, lp1;
+ int16_t  load, rpm = d->sens.inst_frq, a14, a23;
+ int32_t  pos_f, pos_l = 0;
+ int8_t f, fp1, l, lp1;
 
- discharge = (d->param.map_upper_pressure - d->sens.map);
- if (discharge < 0) discharge = 0;
+ update_axes_rcp(d);
 
- //map_upper_pressure -   
- //map_lower_pressure -   
- gradient = (d->param.map_upper_pressure - d->param.map_lower_pressure) / 16; //       
- if (gradient < 1)
-  gradient = 1;  //           
- l = (discharge / gradient);
+ //position on the load axis from selected source of load. Points of axis and source of load
+ //are stored in the set of tables (     )
+#ifdef TPS_AVAILABLE
+ switch(PGM_GET_BYTE(&d->fn_axes->load_src))
+ {
+  case LOAD_SRC_TPS:
+   load = tps_load(d);
+   break;
+  case LOAD_SRC_HYBRID: //MAP below switchover RPM, TPS above, blending within band
+  {
+   int16_t w = rpm - (int16_t)PGM_GET_WORD(&d->fn_axes->load_src_rpm);
+   if (w <= 0)
+    load = map_load(d);
+   else if (w >= LOAD_SRC_BLEND_BAND)
+    load = tps_load(d);
+   else //weighted sum, weights are w and (band - w), so division is replaced by shift
+    load = (((int32_t)map_load(d) * (LOAD_SRC_BLEND_BAND - w)) + ((int32_t)tps_load(d) * w)) >> LOAD_SRC_BLEND_SHIFT;
+   break;
+  }
+  default: //LOAD_SRC_MAP
+   load = map_load(d);
+   break;
+ }
+#else
+ load = map_load(d); //there is no throttle position sensor, source of load selected in the set is ignored
+#endif
+
+ for(l = F_WRK_POINTS_L - 1; l > 0; l--)
+  if (load >= (uint8_t)PGM_GET_BYTE(&d->fn_axes->load_grid_points[l])) break;
 
- if (l >= (F_WRK_POINTS_F - 1))
-  lp1 = l = F_WRK_POINTS_F - 1;
+ if (l >= (F_WRK_POINTS_L - 1))
+  lp1 = l = F_WRK_POINTS_L - 1;
  else
+ {
+  uint8_t load_s = (uint8_t)PGM_GET_BYTE(&d->fn_axes->load_grid_points[l]);
   lp1 = l + 1;
+  if (load > load_s)
+   pos_l = axis_position(load - load_s, arc.load_rcp[l]);
+ }
 
  //   
  d->airflow = 16 - l;
@@ -167,21 +321,49 @@ int16_t work_function(struct ecudata_t* d, uint8_t i_update_airflow_only)
 
  //  ,       
  for(f = 14; f >= 0; f--)
-  if (rpm >= PGM_GET_WORD(&f_slots_ranges[f])) break;
+  if (rpm >= (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[f])) break;
 
- //    600-   
- if (f < 0)  {f = 0; rpm = 600;}
+ //         
+ if (f < 0)  {f = 0; rpm = (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[0]);}
   fp1 = f + 1;
+ pos_f = axis_position(rpm - (int16_t)PGM_GET_WORD(&d->fn_axes->rpm_grid_points[f]), arc.rpm_rcp[f]);
 
- return bilinear_interpolation(rpm, discharge,
-        _GB(&d->fn_dat->f_wrk[l][f]),
-        _GB(&d->fn_dat->f_wrk[lp1][f]),
-        _GB(&d->fn_dat->f_wrk[lp1][fp1]),
-        _GB(&d->fn_dat->f_wrk[l][fp1]),
-        PGM_GET_WORD(&f_slots_ranges[f]),
-        (gradient * l),
-        PGM_GET_WORD(&f_slots_length[f]),
-        gradient);
+ //bilinear interpolation by positions inside segments of axes (without division)
+ a14 = position_interpolation(_GB(&d->fn_dat->f_wrk[l][f]), _GB(&d->fn_dat->f_wrk[l][fp1]), pos_f);
+ a23 = position_interpolation(_GB(&d->fn_dat->f_wrk[lp1][f]), _GB(&d->fn_dat->f_wrk[lp1][fp1]), pos_f);
+ return a14 + ((((int32_t)(a23 - a14)) * pos_l) >> 12);
+}
+
+int16_t baro_upper_pressure(struct ecudata_t* d)
+{
+ if (!d->param.baro_mode)
+  return d->param.map_upper_pressure;
+ //upper pressure follows deviation of ambient pressure from the nominal one, so full load is
+ //reached at wide open throttle at any altitude
+ return d->param.map_upper_pressure + ((int16_t)d->sens.baro - BARO_NOMINAL_PRESSURE);
+}
+
+//       ()
+//        * 32, 2 * 16 = 32.
+int16_t baro_function(struct ecudata_t* d)
+{
+ int16_t i, i1, p = d->sens.baro;
+
+ if (!d->param.baro_mode)
+  return 0;   //   (barometric compensation is turned off)
+
+ //60 -   
+ if (p < PRESSURE_MAGNITUDE(60))
+  p = PRESSURE_MAGNITUDE(60);
+
+ //10 -      
+ i = (p - PRESSURE_MAGNITUDE(60)) / PRESSURE_MAGNITUDE(10);
+
+ if (i >= BARO_CORR_LOOKUP_TABLE_SIZE-1) i = i1 = BARO_CORR_LOOKUP_TABLE_SIZE-1;
+ else i1 = i + 1;
+
+ return simple_interpolation(p, (int8_t)PGM_GET_BYTE(&fw_data.exdata.baro_corr[i]), (int8_t)PGM_GET_BYTE(&fw_data.exdata.baro_corr[i1]),
+ (i * PRESSURE_MAGNITUDE(10)) + PRESSURE_MAGNITUDE(60), PRESSURE_MAGNITUDE(10));
 }
 
 //     (. )  
@@ -211,111 +393,143 @@ int16_t coolant_function(struct ecudata_t* d)
  uint16_t user_var1;
  uint16_t user_var2;
  uint16_t user_var3;
+
+//Gains are given per time, not per period of regulator, so IDLE_PERIOD_TIME_VALUE can be changed
+//without retuning of ifac1/ifac2. Values are chosen by closed-loop test (tools/hostsim.py idle):
+//with default ifac1 = ifac2 = 4 integral time is 0.5s. Twice more integral gain (IDLREG_KI_DIV = 100)
+//already gives limit cycle if there is no D term.
+
+/**Derivative time of idling regulator, in ticks of 10ms (D = Kp * Td * dRPM/dt) */
+#define IDLREG_TD        10
+
+/**Feed-forward time of idling regulator, in ticks of 10ms (FF = Kp * Tff * dTarget/dt) */
+#define IDLREG_TFF       40
+
+/**Divider of integral gain: integral term grows by error * ifac2 / IDLREG_KI_DIV units of output
+ * (advance angle * 32) per tick of 10ms */
+#define IDLREG_KI_DIV    200
+
+/**Zone of capture of idling regulator, min-1 ( ""         ) */
+#define IDLREG_CAPTURE_RANGE 100
+
 /**Describes state data for idling regulator */
 typedef struct
 {
  //        ()
- int16_t output_state;   //!< regulator's memory
+ int16_t output_state;   //!< regulator's memory (advance angle * 32)
+ int32_t i_acc;          //!< accumulator of the integral term (advance angle * 32 * 16)
+ int16_t d_filt;         //!< filtered derivative of RPM (min-1 * 16 per period)
+ int16_t prev_rpm;       //!< RPM at the previous period
+ int16_t prev_target;    //!< target RPM * 16 at the previous period
+ uint8_t enable;         //!< regulator has captured RPM after return from working mode
+ uint8_t first;          //!< first period after enabling (no history for derivatives)
 }idlregul_state_t;
 
 /**Variable. State data for idling regulator */
 idlregul_state_t idl_prstate;
-idlregul_state_t idl_enable;
-idlregul_state_t idl_coolant_rpm;
 
 //  
 void idling_regulator_init(void)
 {
  idl_prstate.output_state = 0;
- idl_enable.output_state = 0;
+ idl_prstate.i_acc = 0;
+ idl_prstate.d_filt = 0;
+ idl_prstate.enable = 0;
+ idl_prstate.first = 1;
 }
 
-//        
+//         ( )
+//Fixed-point PID regulator: P on error, I with anti-windup bounded by idlreg_min_angle/idlreg_max_angle,
+//D on measured RPM with first order filter, feed-forward from slope of target RPM (idl_collant_rpm_t).
+//Calculations are performed on deterministic schedule given by io_timer, between periods last output is used.
+//In the dead band (MINEFR) error is taken as zero: P term is zero and integrator holds its value.
 //        * 32.
 int16_t idling_pregulator(struct ecudata_t* d, volatile s_timer8_t* io_timer)
 {
-int16_t error,factor,iState_error;
-// ""         
-uint16_t capture_range = 100;
+ int16_t error, target, target16, rpm = d->sens.frequen;
+ int32_t out, p_term, d_term, ff_term;
 
  // PXX         
  //          
- if (!d->param.idl_regul || (d->sens.frequen >(d->param.idling_rpm + capture_range))
+ if (!d->param.idl_regul || (rpm > (d->param.idling_rpm + IDLREG_CAPTURE_RANGE))
     || (d->sens.temperat < d->param.idlreg_turn_on_temp && d->param.tmp_use))
   return 0;
-//   ,    vs 
-idl_coolant_rpm.output_state = idl_coolant_rpm_function(d)/16;
-user_var1 = idl_coolant_rpm.output_state;
-
-//      ,    
-if (d->sens.frequen >(idl_coolant_rpm.output_state + capture_range)) 
-{
-idlregul_set_state(2,d);
-}
-// PXX         
-//       +10        ,      
-//          
-
-  if ((d->sens.frequen >(idl_coolant_rpm.output_state + 10)) && !idl_enable.output_state) 
-    return 0;
-  else 
-  {idl_enable.output_state = 1;
-   iState_error = 0;
-  
-  }
-  if (!d->param.idl_regul || (d->sens.frequen >(idl_coolant_rpm.output_state + capture_range)))
-    return 0;
-
-//  ,   ( ),  ,    
-//,    0 .
-
-error = idl_coolant_rpm.output_state - d->sens.frequen;
-
-restrict_value_to(&error, -200, 100);
-//     
-iState_error += error;
-user_var2 = iState_error;
-if (abs(error) <= d->param.MINEFR)
-{
-  //     ,     
-  iState_error = 0;
-  return 0;//idl_prstate.output_state;
-}
-//     
-if (abs(error)<= (d->param.MINEFR +20))
-   idlregul_set_state(3,d);
-else 
-    if (error >0)
-      idlregul_set_state(2,d);
-        else
-          idlregul_set_state(1,d);
 
+ //   ,    vs 
+ target16 = idl_coolant_rpm_function(d);
+ target = target16 / 16;
+ user_var1 = target;
 
 
+ //    ,        + 10
+ //    
+ if (!idl_prstate.enable)
+ {
+  if (rpm > (target + 10))
+   return 0;
+  idl_prstate.enable = 1;
+  idl_prstate.first = 1;
+ }
 
+ if (rpm > (target + IDLREG_CAPTURE_RANGE))
+  return 0;
 
+ //  ,  ,  ,     ,
+ //    (   , so output does not jump and
+ //there is no limit cycle around the edge of the dead band)
+ error = target - rpm;
+ restrict_value_to(&error, -200, 100);
+ if (abs(error) <= d->param.MINEFR)
+  error = 0;
 
+ //     
+ if (!s_timer_is_action(*io_timer))
+  return idl_prstate.output_state;
+ s_timer_set(*io_timer, IDLE_PERIOD_TIME_VALUE);
 
-//   ,     
-//if (error > 0)
-  factor = d->param.ifac1;
-//else
- // factor = d->param.ifac2;
+ if (idl_prstate.first)
+ {
+  idl_prstate.prev_rpm = rpm;
+  idl_prstate.prev_target = target16;
+  idl_prstate.d_filt = 0;
+  idl_prstate.first = 0;
+ }
 
-//      idle_period_time_counter
-//if (s_timer_is_action(*io_timer))
-{
-  //s_timer_set(*io_timer,IDLE_PERIOD_TIME_VALUE);
-   
-//       
-  idl_prstate.output_state = (error * factor) / 4 + (iState_error / 40)*d->param.ifac2;
-  //idl_prstate.output_state = (idl_prstate.output_state * ((d->param.idling_rpm + idl_coolant_rpm.output_state)/d->sens.frequen)* factor) / 4;
-//user_var3 = d->param.ifac1;
+ //D term uses measured RPM (no kick when target changes), filtered: d = d + (x - d) / 4
+ idl_prstate.d_filt+= ((idl_prstate.prev_rpm - rpm) * 16 - idl_prstate.d_filt) / 4;
+ idl_prstate.prev_rpm = rpm;
+
+ p_term = (((int32_t)error) * d->param.ifac1) / 4;
+ d_term = (((int32_t)idl_prstate.d_filt) * d->param.ifac1 * IDLREG_TD) / (4 * 16 * IDLE_PERIOD_TIME_VALUE);
+ ff_term = (((int32_t)(target16 - idl_prstate.prev_target)) * d->param.ifac1 * IDLREG_TFF) / (4 * 16 * IDLE_PERIOD_TIME_VALUE);
+ idl_prstate.prev_target = target16;
+
+ //integration with anti-windup: integral term is bounded by limits of the regulator and
+ //it is not integrated in the direction of saturation
+ out = p_term + d_term + ff_term + (idl_prstate.i_acc / 16);
+ if (!((out >= d->param.idlreg_max_angle && error > 0) || (out <= d->param.idlreg_min_angle && error < 0)))
+  idl_prstate.i_acc+= (((int32_t)error) * d->param.ifac2 * 16 * IDLE_PERIOD_TIME_VALUE) / IDLREG_KI_DIV;
+ if (idl_prstate.i_acc > ((int32_t)d->param.idlreg_max_angle) * 16)
+  idl_prstate.i_acc = ((int32_t)d->param.idlreg_max_angle) * 16;
+ if (idl_prstate.i_acc < ((int32_t)d->param.idlreg_min_angle) * 16)
+  idl_prstate.i_acc = ((int32_t)d->param.idlreg_min_angle) * 16;
+ user_var2 = idl_prstate.i_acc / 16;
+
+ out = p_term + d_term + ff_term + (idl_prstate.i_acc / 16);
+
+ //      
+ if (out > d->param.idlreg_max_angle)
+  out = d->param.idlreg_max_angle;
+ if (out < d->param.idlreg_min_angle)
+  out = d->param.idlreg_min_angle;
+ idl_prstate.output_state = out;
+
+ return idl_prstate.output_state;
 }
-//      
-restrict_value_to(&idl_prstate.output_state, d->param.idlreg_min_angle, d->param.idlreg_max_angle);
 
-return idl_prstate.output_state;
+int16_t idling_pregulator_output(void)
+{
+ return idl_prstate.output_state;
 }
 
 
@@ -443,7 +657,7 @@ uint8_t choke_closing_lookup(struct ecudata_t* d)
  if (i >= 15) i = i1 = 15;
  else i1 = i + 1;
 
- return simple_interpolation(t, _GB(&fw_data.exdata.choke_closing[i]), _GB(&fw_data.exdata.choke_closing[i1]),
+ return simple_interpolation(t, PGM_GET_BYTE(&fw_data.exdata.choke_closing[i]), PGM_GET_BYTE(&fw_data.exdata.choke_closing[i1]),
  (i * TEMPERATURE_MAGNITUDE(5)) + TEMPERATURE_MAGNITUDE(-5), TEMPERATURE_MAGNITUDE(5)) >> 4;
 }
 #endif
@@ -82,6 +82,19 @@ int16_t work_function(struct ecudata_t* d, uint8_t i_update_airflow_only);
  */
 int16_t coolant_function(struct ecudata_t* d);
 
+/** Calculates anvance angle correction using barometric pressure (see param.baro_mode)
+ * \param d pointer to ECU data structure
+ * \return value of advance angle * 32
+ */
+int16_t baro_function(struct ecudata_t* d);
+
+/** Calculates upper pressure of the load axis (map_upper_pressure) compensated by barometric pressure
+ * (     )
+ * \param d pointer to ECU data structure
+ * \return pressure (kPa * MAP_PHYSICAL_MAGNITUDE_MULTIPLAYER)
+ */
+int16_t baro_upper_pressure(struct ecudata_t* d);
+
 /**
  * \param d pointer to ECU data structure
  * \return
@@ -95,6 +108,12 @@ extern uint16_t user_var3;
 /**Initialization of idling regulator's data structures */
 void idling_regulator_init(void);
 
+/**Obtains target idling RPM from coolant temperature using idl_collant_rpm_t lookup table
+ * \param d pointer to ECU data structure
+ * \return target RPM * 16
+ */
+int16_t idl_coolant_rpm_function(struct ecudata_t* d);
+
 /**
  * \param d pointer to ECU data structure
  * \param io_timer
@@ -102,6 +121,11 @@ void idling_regulator_init(void);
  */
 int16_t idling_pregulator(struct ecudata_t* d, volatile s_timer8_t* io_timer);
 
+/**Used by idle air valve driver for coordination with idling regulator
+ * \return last output of idling regulator, value of advance angle * 32
+ */
+int16_t idling_pregulator_output(void);
+
 /**
  * \param new_advance_angle
  * \param ip_prev_state
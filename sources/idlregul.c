@@ -29,21 +29,46 @@
 #include "port/avrio.h"
 #include "port/port.h"
 #include "bitmask.h"
+#include "funconv.h"
 #include "idlregul.h"
+#include "ignlogic.h"
 #include "secu3.h"
 #include "vstimer.h"
 #include "adc.h"
 #include "magnitude.h"
 #include <stdint.h>
+#include <stdlib.h>
 
 /** Turn on/turn off PIN IDL_REGUL */
 #define OUT_IDL_REGUL1(s) {PORTC_Bit0 = s;}
 #define OUT_IDL_REGUL2(s) {PORTC_Bit1 = s;}
 
-//      
-uint8_t idl_start_en;
-//     
-uint16_t tps_v_buf;
+/** Drive states of valve (  ) */
+#define IDL_EXTEND  1   //!< 
+#define IDL_RETRACT 2   //!< 
+#define IDL_STOP    3   //!< 
+
+/** Number of 2ms ticks which correspond to the time of valve movement for 0.1V of TPS */
+#define IDL_TICKS_PER_01V   ((uint8_t)((IDL_TIME_MIN / 2.048) + 0.5))
+
+/** Dashpot addition decrement per window, TPS units (so dashpot decays during IDL_DASHPOT_TIME) */
+#define IDL_DASHPOT_DEC     (V_TPS_MAGNITUDE((IDL_DASHPOT_V * IDL_PWM_WINDOW * 0.002048) / IDL_DASHPOT_TIME) + 1)
+
+/**Define state variables of the idle air valve driver */
+typedef struct
+{
+ uint16_t target;       //!< target position of valve (TPS voltage * 400)
+ uint16_t dashpot;      //!< dashpot addition to the target position (TPS voltage * 400)
+ uint8_t  tick;         //!< current tick in the time-proportioning window
+ uint8_t  on_ticks;     //!< number of ticks valve will be driven in the current window
+ uint8_t  dir;          //!< direction of drive in the current window
+ uint8_t  open_ticks;   //!< remaining ticks of open-loop extension (dashpot setting in working mode)
+ uint8_t  trim_cnt;     //!< counts windows between trim steps
+ uint8_t  mode;         //!< engine mode at the previous tick
+}idlregul_st_t;
+
+/**Instance of state variables */
+idlregul_st_t idls;
 
 //   
 void idlregul_init_ports(void)
@@ -51,7 +76,13 @@ void idlregul_init_ports(void)
 
    PORTC|= _BV(PC1)|_BV(PC0);
    DDRC|= _BV(DDC1)|_BV(DDC0);
-   idl_start_en = 1;
+   idls.target = V_TPS_MAGNITUDE(TPS_V_START);
+   idls.dashpot = 0;
+   idls.tick = 0;
+   idls.on_ticks = 0;
+   idls.open_ticks = 0;
+   idls.trim_cnt = 0;
+   idls.mode = EM_START;
 }
 
 //      1 -  , 2  , 3 
@@ -81,30 +112,111 @@ void idlregul_set_state(uint8_t i_state, struct ecudata_t* d)
   }  
 }
 
-//          1800 
-void idlregul_control(struct ecudata_t* d)
+#ifdef TPS_SENSOR
+/** Coordination with idling regulator (advance angle). Valve takes slow part of regulation: if
+ * advance correction stays near one of its limits, target position of valve is moved slowly, so
+ * advance correction returns back to the middle of its range and two regulators don't fight.
+ * \param d pointer to ECU data structure
+ */
+static void idlregul_trim(struct ecudata_t* d)
 {
-  //    ,         
- //      
-#ifdef TPS_SENSOR 
-  if (d->sens.v_tps < V_TPS_MAGNITUDE(TPS_V_START))
- 
-   idlregul_set_state(1,d); 
- 
+ int16_t corr = idling_pregulator_output();
+
+ if (++idls.trim_cnt < IDL_TRIM_WINDOWS)
+  return;
+ idls.trim_cnt = 0;
+
+ if (corr > (d->param.idlreg_max_angle / 2) && idls.target < V_TPS_MAGNITUDE(TPS_V_MAX - 0.1))
+  idls.target+= V_TPS_MAGNITUDE(IDL_TRIM_STEP_V);   //RPM is too low - more air
+ else if (corr < (d->param.idlreg_min_angle / 2) && idls.target > V_TPS_MAGNITUDE(TPS_V_MIN + 0.1))
+  idls.target-= V_TPS_MAGNITUDE(IDL_TRIM_STEP_V);   //RPM is too high - less air
+}
+
+/** Calculates drive for new time-proportioning window: drive time is proportional to the position error
+ * \param d pointer to ECU data structure
+ */
+static void idlregul_new_window(struct ecudata_t* d)
+{
+ int16_t error = (int16_t)(idls.target + idls.dashpot) - (int16_t)d->sens.v_tps;
+ uint16_t on;
+
+ idls.dir = (error > 0) ? IDL_EXTEND : IDL_RETRACT;
+ error = abs(error);
+ if (error <= V_TPS_MAGNITUDE(IDL_POS_DEADBAND_V))
+  on = 0;
  else
  {
-   idlregul_set_state(3,d);
-   idl_start_en = 0;
-   
+  on = (((uint32_t)error) * IDL_TICKS_PER_01V) / V_TPS_MAGNITUDE(0.1);
+  if (on < 1)
+   on = 1;
+  if (on > IDL_PWM_WINDOW - 1)
+   on = IDL_PWM_WINDOW - 1;                 //leave time for valve to settle down before next measurement
  }
-#endif  
+ idls.on_ticks = on;
+}
+#endif
+
+// .    ,    idl_regul_time_counter (2)
+void idlregul_control(struct ecudata_t* d)
+{
+ if (!s_timer_is_action(idl_regul_time_counter))
+  return;
+ s_timer_set(idl_regul_time_counter, 1);
+
+#ifdef TPS_SENSOR
+ if (d->engine_mode == EM_WORK)
+ {
+  //Throttle is opened, so TPS doesn't show position of valve. Set dashpot in open-loop
+  if (idls.mode != EM_WORK)
+   idls.open_ticks = idlregul_dempfer(d);
+  if (idls.open_ticks)
+  {
+   --idls.open_ticks;
+   idlregul_set_state(IDL_EXTEND, d);
+  }
+  else
+   idlregul_set_state(IDL_STOP, d);
+  idls.tick = 0;
+  idls.mode = d->engine_mode;
+  return;
+ }
+
+ if (d->engine_mode == EM_START)
+ {//start position, corresponds to 1800 min-1
+  idls.target = V_TPS_MAGNITUDE(TPS_V_START);
+  idls.dashpot = 0;
+ }
+ idls.mode = d->engine_mode;
+
+ if (0==idls.tick)
+ {
+  if (d->engine_mode == EM_IDLE)
+  {
+   idlregul_trim(d);
+   //dashpot decays, so RPM goes down to idling smoothly
+   idls.dashpot = (idls.dashpot > IDL_DASHPOT_DEC) ? (idls.dashpot - IDL_DASHPOT_DEC) : 0;
+  }
+  idlregul_new_window(d);
+ }
+
+ idlregul_set_state((idls.tick < idls.on_ticks) ? idls.dir : IDL_STOP, d);
+
+ if (++idls.tick >= IDL_PWM_WINDOW)
+  idls.tick = 0;
+#else
+ idlregul_set_state(IDL_STOP, d);
+#endif
 }
 
 //    
-void idlregul_dempfer(struct ecudata_t* d, volatile s_timer8_t* io_timer)
+uint8_t idlregul_dempfer(struct ecudata_t* d)
 {
- 
-  
+ uint16_t ticks;
+ //valve will be extended for additional distance while throttle is opened, so closing throttle
+ //will be stopped by valve and RPM will drop smoothly
+ idls.dashpot = V_TPS_MAGNITUDE(IDL_DASHPOT_V);
+ ticks = (((uint32_t)idls.dashpot) * IDL_TICKS_PER_01V) / V_TPS_MAGNITUDE(0.1);
+ return (ticks > 255) ? 255 : ticks;
 }
 
 #endif //IDL_REGUL
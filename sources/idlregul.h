@@ -43,8 +43,23 @@
 //      0.1  , ms
 #define IDL_TIME_MIN          40.0
 
-extern uint8_t idl_start_en;
-extern uint16_t tps_v_buf;
+//   (    ),   2
+#define IDL_PWM_WINDOW        20
+
+//     ,  
+#define IDL_POS_DEADBAND_V    0.02
+
+//       ,  
+#define IDL_DASHPOT_V         0.3
+
+//    , 
+#define IDL_DASHPOT_TIME      2.0
+
+//         ,  
+#define IDL_TRIM_STEP_V       0.01
+
+//    ,   
+#define IDL_TRIM_WINDOWS      5
 
 struct ecudata_t;
 
@@ -54,11 +69,20 @@ void idlregul_init_ports(void);
 //      1 -  , 2  , 3 
 void idlregul_set_state(uint8_t i_state, struct ecudata_t* d);
 
-//          1800 
+/** Idle air valve driver ( ). Must be called from the main loop, works on 2ms ticks of
+ * idl_regul_time_counter. Valve is driven to the target position (measured by TPS) using time-proportioned
+ * drive: in each window of IDL_PWM_WINDOW ticks valve is driven for time proportional to the position error.
+ * At startup target corresponds to 1800 min-1, at idling target is trimmed by advance angle idling regulator.
+ * \param d pointer to ECU data structure
+ */
 void idlregul_control(struct ecudata_t* d);
 
-//    
-void idlregul_dempfer(struct ecudata_t* d, volatile s_timer8_t* io_timer);
+/** Dashpot (). Called when throttle opens, sets dashpot addition to the valve's target
+ * position, which decays after throttle closes.
+ * \param d pointer to ECU data structure
+ * \return number of 2ms ticks valve must be extended in open-loop to reach dashpot position
+ */
+uint8_t idlregul_dempfer(struct ecudata_t* d);
 
 #endif //IDL_REGUL
 #endif //_IDLREGUL_H_
@@ -63,6 +63,7 @@ int16_t advance_angle_state_machine(struct ecudata_t* d)
    }
    angle=work_function(d, 0);              //  -   
    angle+=coolant_function(d);             //    
+   angle+=baro_function(d);                //    
    //      
    angle-=d->knock_retard;
    break;
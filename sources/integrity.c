@@ -0,0 +1,223 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file integrity.c
+ * Implementation of background checking of integrity of firmware, parameters and tables in RAM.
+ * (    ,     ).
+ *
+ * Reference CRC of parameters in RAM is params_t::crc, it is calculated in the same way as CRC of
+ * parameters stored in the EEPROM and is updated each time parameters are changed legally (see
+ * intg_invalidate_params()). Reference CRCs of tables in RAM are not stored anywhere, they are calculated
+ * during the first pass of checking after new set of tables has been committed or loaded (see
+ * ecudata_t::tables_gen).
+ */
+
+#include "port/avrio.h"
+#include "port/pgmspace.h"
+#include "port/port.h"
+#include <stdint.h>
+#include "ce_errors.h"
+#include "crc16.h"
+#include "integrity.h"
+#include "params.h"
+#include "procuart.h"
+#include "secu3.h"
+#include "tables.h"
+
+//Regions of memory being checked
+#define INTG_CODE      0       //!< firmware
+#define INTG_PARAMS    1       //!< parameters in RAM
+#define INTG_TABLES    2       //!< active set of tables in RAM for gasoline (+1 for gas)
+#ifdef REALTIME_TABLES
+ #define INTG_REGIONS  4       //!< number of regions
+#else
+ #define INTG_REGIONS  2       //!< number of regions
+#endif
+
+//Bits used in intg_state_t::reload (and intg_state_t::ref for tables)
+#define INTG_RF_PARAMS 0x01    //!< parameters
+#define INTG_RF_TABLES 0x02    //!< set of tables for gasoline (shifted left by 1 for gas)
+
+/**Define internal state variables */
+typedef struct
+{
+ uint8_t  region;              //!< region being checked (see INTG_xxx)
+ uint16_t offset;              //!< offset of next block in the region
+ uint16_t crc;                 //!< CRC16 of already checked part of region
+ uint8_t  ref;                 //!< bits, indicate that reference CRCs are valid (see INTG_RF_xxx)
+ uint8_t  reload;              //!< bits, indicate data waiting for reloading (see INTG_RF_xxx)
+ uint8_t  code_done;           //!< flag, the first check of firmware is completed
+#ifdef REALTIME_TABLES
+ uint8_t  gen;                 //!< generation of set of tables at the beginning of its checking
+ uint8_t  tables_gen[2];       //!< generations of sets of tables for which reference CRCs were calculated
+ uint16_t tables_crc[2];       //!< reference CRCs of active sets of tables
+#endif
+}intg_state_t;
+
+/**State variables */
+intg_state_t intg;
+
+/**Begins checking of specified region
+ * \param d pointer to ECU data structure
+ * \param region region to be checked
+ */
+static void begin_region(struct ecudata_t* d, uint8_t region)
+{
+ intg.region = region;
+ intg.offset = 0;
+ intg.crc = 0xFFFF;
+#ifdef REALTIME_TABLES
+ if (region >= INTG_TABLES)
+  intg.gen = d->tables_gen[region - INTG_TABLES];
+#endif
+}
+
+/**Compares CRC of completely checked region with reference one
+ * \param d pointer to ECU data structure
+ */
+static void finish_region(struct ecudata_t* d)
+{
+ if (INTG_CODE == intg.region)
+ {
+  //    -  
+  if (intg.crc != PGM_GET_WORD(&fw_data.code_crc))
+   ce_set_error(ECUERROR_PROGRAM_CODE_BROKEN);
+  intg.code_done = 1;
+ }
+ else if (INTG_PARAMS == intg.region)
+ {
+  if (intg.crc != d->param.crc)
+  { //parameters (or their CRC) are broken
+   ce_set_error(ECUERROR_RAM_DATA_BROKEN);
+   intg.reload|= INTG_RF_PARAMS;
+  }
+ }
+#ifdef REALTIME_TABLES
+ else
+ {
+  uint8_t f = intg.region - INTG_TABLES, bit = INTG_RF_TABLES << f;
+  if (d->tables_gen[f] != intg.gen)
+   return; //set of tables has been changed during checking, result is useless
+  if (!(intg.ref & bit) || intg.tables_gen[f] != intg.gen)
+  { //new set of tables, remember new reference
+   intg.tables_crc[f] = intg.crc;
+   intg.tables_gen[f] = intg.gen;
+   intg.ref|= bit;
+  }
+  else if (intg.crc != intg.tables_crc[f])
+  {
+   ce_set_error(ECUERROR_RAM_DATA_BROKEN);
+   intg.reload|= bit;
+   intg.ref&= ~bit;
+  }
+ }
+#endif
+}
+
+/**Reloads corrupted data, if any
+ * \param d pointer to ECU data structure
+ */
+static void reload_data(struct ecudata_t* d)
+{
+ if ((intg.reload & INTG_RF_PARAMS) && reload_eeprom_params(d))
+ {
+  intg.reload&= ~INTG_RF_PARAMS;
+  intg_invalidate_params(d);
+  //reloaded parameters are applied to other modules in the same way as received via UART
+  apply_params(d);
+ }
+#ifdef REALTIME_TABLES
+ if ((intg.reload & INTG_RF_TABLES) && reload_active_tables(d, 0))
+  intg.reload&= ~INTG_RF_TABLES;
+ if ((intg.reload & (INTG_RF_TABLES << 1)) && reload_active_tables(d, 1))
+  intg.reload&= ~(INTG_RF_TABLES << 1);
+#endif
+}
+
+void intg_init(void)
+{
+ intg.ref = 0;
+ intg.reload = 0;
+ intg.code_done = 0;
+ begin_region(0, INTG_CODE);
+}
+
+void intg_process(struct ecudata_t* d)
+{
+ uint16_t t0 = TCNT1, total, size;
+
+ if (intg.reload)
+  reload_data(d);
+
+ do
+ {
+  if (INTG_CODE == intg.region)
+   total = CODE_SIZE;
+  else if (INTG_PARAMS == intg.region)
+   total = sizeof(params_t) - PAR_CRC_SIZE;
+  else
+   total = sizeof(f_data_t);
+
+  size = total - intg.offset;
+  if (size > INTG_BLOCK)
+   size = INTG_BLOCK;
+
+  if (INTG_CODE == intg.region)
+   intg.crc = crc16f_part(intg.crc, (uint8_t _PGM*)intg.offset, size);
+  else if (INTG_PARAMS == intg.region)
+   intg.crc = crc16_part(intg.crc, ((uint8_t*)&d->param) + intg.offset, size);
+#if defined(TABLES_OVERLAY)
+  else
+  { //rows of set of tables are scattered between FLASH and RAM, so it is checked row by row
+   uint8_t row[TABLES_ROW_SIZE];
+   size = TABLES_ROW_SIZE;
+   read_tables_row(d, intg.region - INTG_TABLES, 0, intg.offset / TABLES_ROW_SIZE, row);
+   intg.crc = crc16_part(intg.crc, row, size);
+  }
+#elif defined(REALTIME_TABLES)
+  else
+   intg.crc = crc16_part(intg.crc, ((uint8_t*)d->tables_ram[intg.region - INTG_TABLES]) + intg.offset, size);
+#endif
+  intg.offset+= size;
+
+  if (intg.offset >= total)
+  { //region has been checked completely, go to the next one
+   finish_region(d);
+   begin_region(d, (intg.region + 1) < INTG_REGIONS ? intg.region + 1 : INTG_CODE);
+  }
+ }while((uint16_t)(TCNT1 - t0) < INTG_BUDGET);
+}
+
+void intg_invalidate_params(struct ecudata_t* d)
+{
+ update_params_crc(d);
+ if (INTG_PARAMS == intg.region)
+ { //check of parameters is in progress, begin it again
+  intg.offset = 0;
+  intg.crc = 0xFFFF;
+ }
+}
+
+uint8_t intg_is_code_checked(void)
+{
+ return intg.code_done;
+}
@@ -0,0 +1,66 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file integrity.h
+ * Background checking of integrity of firmware, parameters and tables in RAM, performed in small
+ * time-bounded portions from main loop.
+ * (   ,     ,   
+ *      ).
+ */
+
+#ifndef _INTEGRITY_H_
+#define _INTEGRITY_H_
+
+#include <stdint.h>
+
+/**Time budget of one call of intg_process() in ticks of timer 1 (4us). Can be overridden in the
+ * preprocessor's options of compiler. At least one block (INTG_BLOCK) is checked per call */
+#ifndef INTG_BUDGET
+ #define INTG_BUDGET 25
+#endif
+
+/**Number of bytes checked at once (takes approximately 40us at 16MHz) */
+#define INTG_BLOCK  16
+
+struct ecudata_t;
+
+/**Initialization of module. Must be called before main loop */
+void intg_init(void);
+
+/**Performs next portion of checking. Must be called from main loop (after CKP sensor's module has been
+ * initialized, because timer 1 is used for measuring of time). Firmware, parameters and active sets of tables
+ * are checked one by one, in cycle. If firmware is broken, ECUERROR_PROGRAM_CODE_BROKEN is set. If parameters
+ * or tables in RAM are broken, ECUERROR_RAM_DATA_BROKEN is set and they are reloaded from EEPROM (or FLASH).
+ * \param d pointer to ECU data structure
+ */
+void intg_process(struct ecudata_t* d);
+
+/**Must be called when parameters have been changed legally (e.g. received via UART). Reference CRC of
+ * parameters (params_t::crc) is recalculated and checking of parameters (if it is in progress) begins again
+ * \param d pointer to ECU data structure
+ */
+void intg_invalidate_params(struct ecudata_t* d);
+
+/**\return 1 - the first check of firmware is completed, 0 - check is in progress */
+uint8_t intg_is_code_checked(void);
+
+#endif //_INTEGRITY_H_
@@ -73,7 +73,11 @@ typedef uint8_t (*iocfg_pfn_get)(void);
 #define IOP_RESERVED14   31     //!< reserved plug   ()
 
 //Wrap macro from port/pgmspace.h.
-#define _IOREM_GPTR(ptr) PGM_GET_WORD(ptr)
+#ifdef SECU3_HOST
+ #define _IOREM_GPTR(ptr) (*(ptr))   //pointers are wider than 16 bits on the host
+#else
+ #define _IOREM_GPTR(ptr) PGM_GET_WORD(ptr)
+#endif
 
 /**Init specified I/O
  * io_id - ID of I/O to be initialized
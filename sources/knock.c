@@ -31,6 +31,7 @@
 #include "port/port.h"
 #include "bitmask.h"
 #include "knock.h"
+#include "profiler.h"
 
 //HIP9011 - Knock Signal Processor.
 
@@ -230,6 +231,7 @@ void knock_reset_error(void)
 ISR(SPI_STC_vect)
 {
  uint8_t t = SPDR;
+ PRF_ENTER();
  //signal processor requires transition of CS into high level after each sent
  //byte, at least for 200ns
  SET_KSP_CS(1);
@@ -283,6 +285,7 @@ ISR(SPI_STC_vect)
    break;
 #endif
  }
+ PRF_LEAVE(PRB_SPI);
 }
 
 void knock_init_ports(void)
@@ -52,7 +52,7 @@
 
 #ifdef TPS_SENSOR
 /** Transforms floating point value of voltage tps to fixed point value */
-#define V_TPS_MAGNITUDE(t) ROUND ((t) * TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER)
+#define V_TPS_MAGNITUDE(t) ROUND ((t) * V_TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER)
 #endif
 
 /** Transforms floating point value of pressure(MAP) to fixed point value */
@@ -35,6 +35,7 @@
 #include "magnitude.h"
 #include "measure.h"
 #include "secu3.h"
+#include "vstimer.h"
 
 /**Reads state of gas valve (   ) */
 #define GET_GAS_VALVE_STATE(s) (CHECKBIT(PINC, PINC6) > 0)
@@ -69,9 +70,19 @@
 #define AI2_AVERAGING           4                 //!< Number of values for averaging of ADD_IO2
 #endif
 
+//  (barometric pressure)
+#define BARO_MIN_PRESSURE       PRESSURE_MAGNITUDE(50.0)  //!< Minimum plausible barometric pressure
+#define BARO_MAX_PRESSURE       PRESSURE_MAGNITUDE(110.0) //!< Maximum plausible barometric pressure
+#define BARO_WOT_TPS            TPS_MAGNITUDE(95.0)       //!< Throttle position above which throttle is considered as wide open
+#define BARO_WOT_RPM            2000                      //!< Maximum RPM at which MAP at WOT is close to barometric pressure
+#define BARO_WOT_HOLD           100                       //!< WOT must be held during this time before refreshing (in 10ms ticks)
+#define BARO_WOT_PERIOD         10                        //!< Period of refreshing of barometric pressure at WOT (in 10ms ticks)
+
 uint16_t freq_circular_buffer[FRQ_AVERAGING];     //!< Ring buffer for RPM averaging for tachometer (      )
 uint16_t freq4_circular_buffer[FRQ4_AVERAGING];   //!< Ring buffer for RPM averaging for starter blocking (       )
 uint16_t map_circular_buffer[MAP_AVERAGING];      //!< Ring buffer for averaring of MAP sensor (   )
+uint16_t map_cycle_value;                         //!< MAP value (mean or minimum) obtained from crank-angle resolved samples of the last cycle
+uint8_t  map_cycle_valid = 0;                     //!< Indicates that map_cycle_value contains valid value
 uint16_t ubat_circular_buffer[BAT_AVERAGING];     //!< Ring buffer for averaring of voltage (    )
 uint16_t temp_circular_buffer[TMP_AVERAGING];     //!< Ring buffer for averaring of coolant temperature (    )
 #ifdef TPS_SENSOR
@@ -108,11 +119,26 @@ void meas_update_values_buffers(struct ecudata_t* d, uint8_t rpm_only)
  (frq4_ai==0) ? (frq4_ai = FRQ4_AVERAGING - 1): frq4_ai--;
 
  if (rpm_only)
+ {
+  map_cycle_valid = 0; //engine is stopped, so cycle MAP is not valid anymore
   return;
+ }
 
  map_circular_buffer[map_ai] = adc_get_map_value();
  (map_ai==0) ? (map_ai = MAP_AVERAGING - 1): map_ai--;
 
+ if (d->param.map_samp_mode)
+ {
+  uint16_t mean, min;
+  if (adc_get_map_cycle(&mean, &min))
+  {
+   map_cycle_value = (2==d->param.map_samp_mode) ? min : mean;
+   map_cycle_valid = 1;
+  }
+ }
+ else
+  map_cycle_valid = 0;
+
  ubat_circular_buffer[bat_ai] = adc_get_ubat_value();
  (bat_ai==0) ? (bat_ai = BAT_AVERAGING - 1): bat_ai--;
 
@@ -137,15 +163,45 @@ void meas_update_values_buffers(struct ecudata_t* d, uint8_t rpm_only)
  d->sens.knock_k = adc_get_knock_value() * 2;
 }
 
+#ifdef TPS_AVAILABLE
+/**Refreshes barometric pressure while throttle is wide open at low RPM, because MAP is close
+ * to the ambient pressure in this case. Slow filter is used to suppress pulsations of MAP.
+ * \param d pointer to ECU data structure
+ */
+static void update_baro_at_wot(struct ecudata_t* d)
+{
+ static uint16_t wot_time = 0, upd_time = 0;
+ uint16_t now = (uint16_t)s_timer_gtc();
+
+ if (2!=d->param.baro_mode || d->sens.tps < BARO_WOT_TPS || d->sens.frequen > BARO_WOT_RPM ||
+     d->sens.map < BARO_MIN_PRESSURE || d->sens.map > BARO_MAX_PRESSURE)
+ {
+  wot_time = now; //WOT is not detected, start counting of hold time again
+  return;
+ }
+
+ if ((uint16_t)(now - wot_time) < BARO_WOT_HOLD || (uint16_t)(now - upd_time) < BARO_WOT_PERIOD)
+  return;
+
+ upd_time = now;
+ d->sens.baro+= ((int16_t)(d->sens.map - d->sens.baro)) / 8;
+}
+#endif
+
 //        , 
 // ,      .
 void meas_average_measured_values(struct ecudata_t* d)
 {
  uint8_t i;  uint32_t sum;
 
- for (sum=0,i = 0; i < MAP_AVERAGING; i++)  //     
-  sum+=map_circular_buffer[i];
- d->sens.map_raw = adc_compensate((sum/MAP_AVERAGING)*2,d->param.map_adc_factor,d->param.map_adc_correction);
+ if (map_cycle_valid) //use MAP obtained over the whole engine cycle, it doesn't need averaging
+  d->sens.map_raw = adc_compensate(map_cycle_value*2,d->param.map_adc_factor,d->param.map_adc_correction);
+ else
+ {
+  for (sum=0,i = 0; i < MAP_AVERAGING; i++)  //     
+   sum+=map_circular_buffer[i];
+  d->sens.map_raw = adc_compensate((sum/MAP_AVERAGING)*2,d->param.map_adc_factor,d->param.map_adc_correction);
+ }
  d->sens.map = map_adc_to_kpa(d->sens.map_raw, d->param.map_curve_offset, d->param.map_curve_gradient);
 
  for (sum=0,i = 0; i < BAT_AVERAGING; i++)   //   
@@ -159,6 +215,14 @@ void meas_average_measured_values(struct ecudata_t* d)
  d->sens.v_tps_raw = adc_compensate((5*(sum/TPS_AVERAGING))/3,d->param.ubat_adc_factor,d->param.ubat_adc_correction);
  d->sens.v_tps = tps_adc_to_v(d->sens.v_tps_raw);
  user_var3 = d->sens.v_tps;
+#ifndef SECU3T //throttle position in percents is used as source of load (see funconv.c)
+ //Voltage of sensor in ADC discretes, compensated by TPS factors - the same scale as on SECU-3T,
+ //so tps_curve_offset and tps_curve_gradient have the same meaning on both boards
+ d->sens.tps_raw = adc_compensate((5*(sum/TPS_AVERAGING))/3,d->param.tps_adc_factor,d->param.tps_adc_correction);
+ d->sens.tps = tps_adc_to_pc(d->sens.tps_raw, d->param.tps_curve_offset, d->param.tps_curve_gradient);
+ if (d->sens.tps > TPS_MAGNITUDE(100))
+  d->sens.tps = TPS_MAGNITUDE(100);
+#endif
 #endif
  
  if (d->param.tmp_use)
@@ -204,6 +268,10 @@ void meas_average_measured_values(struct ecudata_t* d)
  d->sens.add_i2_raw = adc_compensate((sum/AI2_AVERAGING)*2,d->param.ai2_adc_factor,d->param.ai2_adc_correction);
  d->sens.add_i2 = d->sens.add_i2_raw;
 #endif
+
+#ifdef TPS_AVAILABLE
+ update_baro_at_wot(d);
+#endif
 }
 
 //      .   
@@ -221,7 +289,13 @@ void meas_initial_measure(struct ecudata_t* d)
   meas_update_values_buffers(d, 0); //<-- all
  }while(--i);
  _RESTORE_INTERRUPT(_t);
+ d->sens.baro = BARO_NOMINAL_PRESSURE;
  meas_average_measured_values(d);
+
+ //engine is not running yet, so MAP sensor measures barometric pressure. Implausible value
+ //(e.g. restart with running engine or faulty sensor) is replaced by nominal pressure
+ if (d->sens.map >= BARO_MIN_PRESSURE && d->sens.map <= BARO_MAX_PRESSURE)
+  d->sens.baro = d->sens.map;
 }
 
 void meas_take_discrete_inputs(struct ecudata_t *d)
@@ -298,11 +372,20 @@ else
   else             // 
    d->fn_dat = mapsel0 ? &fw_data.tables[0] : &fw_data.tables[d->param.fn_gasoline];
  }
+ d->fn_axes = &fw_data.axes[d->fn_dat - &fw_data.tables[0]]; //axes of selected set
+#elif defined(TABLES_OVERLAY) //use tables from FLASH with rows replaced from RAM
+ if (d->sens.gas)
+  d->fn_ovl = d->tables_ram[1]; //using gas( )
+ else
+  d->fn_ovl = d->tables_ram[0]; //using petrol( )
+ d->fn_dat = d->fn_ovl->base;
+ d->fn_axes = d->tables_axes[d->sens.gas ? 1 : 0];
 #else //use tables from RAM
  if (d->sens.gas)
-  d->fn_dat = &d->tables_ram[1]; //using gas( )
+  d->fn_dat = d->tables_ram[1]; //using gas( )
  else
-  d->fn_dat = &d->tables_ram[0]; //using petrol( )
+  d->fn_dat = d->tables_ram[0]; //using petrol( )
+ d->fn_axes = d->tables_axes[d->sens.gas ? 1 : 0];
 #endif
 }
 
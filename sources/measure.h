@@ -31,6 +31,10 @@
 
 struct ecudata_t;
 
+/**Nominal (sea level) barometric pressure, barometric compensation is made relatively to this value.
+ * Requires magnitude.h (  ) */
+#define BARO_NOMINAL_PRESSURE  PRESSURE_MAGNITUDE(101.3)
+
 /**Update ring buffers with new data given from sensors and ADC
  * \param d pointer to ECU data structure
  * \param rpm_only if != 0, then only RPM related buffers will be updated
@@ -42,7 +46,8 @@ void meas_update_values_buffers(struct ecudata_t* d, uint8_t rpm_only);
  */
 void meas_average_measured_values(struct ecudata_t* d);
 
-/**Initialization of ring buffers. Performs initial measurements. Used before start of engine
+/**Initialization of ring buffers. Performs initial measurements. Used before start of engine.
+ * Barometric pressure is taken from MAP sensor here, because engine is not running yet
  * \param d pointer to ECU data structure
  */
 void meas_initial_measure(struct ecudata_t* d);
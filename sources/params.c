@@ -24,20 +24,24 @@
  * (      (//)).
  */
 
+#include "port/interrupt.h"
 #include "port/pgmspace.h"
 #include "port/port.h"
 
+#include <stddef.h>
 #include <string.h>
 #include "ce_errors.h"
 #include "crc16.h"
 #include "eeprom.h"
+#include "ejournal.h"
 #include "jumper.h"
 #include "params.h"
 #include "secu3.h"
 #include "suspendop.h"
 #include "vstimer.h"
 
-uint8_t eeprom_parameters_cache[sizeof(params_t) + 1];
+/**Cache of parameters. It is a record of journal: parameters followed by sequence number */
+uint8_t eeprom_parameters_cache[sizeof(params_t) + EJ_SEQ_SIZE + 1];
 
 void save_param_if_need(struct ecudata_t* d)
 {
@@ -45,22 +49,45 @@ void save_param_if_need(struct ecudata_t* d)
  if (s_timer16_is_action(save_param_timeout_counter))
  {
   //    ?
-  if (memcmp(eeprom_parameters_cache, &d->param, sizeof(params_t)-PAR_CRC_SIZE))
+  if (memcmp(d->eeprom_parameters_cache, &d->param, sizeof(params_t)-PAR_CRC_SIZE))
    sop_set_operation(SOP_SAVE_PARAMETERS);
   s_timer16_set(save_param_timeout_counter, SAVE_PARAM_TIMEOUT_VALUE);
  }
 }
 
+/**Reads record of parameters from the first slot of journal ignoring its sequence number. Previous versions
+ * of firmware stored parameters at this place and errors in place of sequence number, so record is
+ * excluded by scan of journal if errors were equal to erased sequence number. Found record is written
+ * back with valid sequence number (bytes of parameters and CRC are not changed).
+ * \return 1 - valid record has been found and loaded into cache, 0 - not found
+ */
+static uint8_t load_legacy_params(void)
+{
+ eeprom_read(eeprom_parameters_cache, EEPROM_PARAM_START, sizeof(params_t));
+ if (crc16(eeprom_parameters_cache, sizeof(params_t) - PAR_CRC_SIZE) != ((params_t*)eeprom_parameters_cache)->crc)
+  return 0;
+ ej_write_blocking(EJ_PARAMS, eeprom_parameters_cache);
+ return 1;
+}
+
 void load_eeprom_params(struct ecudata_t* d)
 {
+#ifdef REALTIME_TABLES
+ uint8_t i;
+#endif
  if (jumper_get_defeeprom_state())
  {
-  //   EEPROM,    .
-  //         
-  //     -     FLASH
-  eeprom_read(&d->param,EEPROM_PARAM_START,sizeof(params_t));
+  //Errors must be read before the first slot of parameters is rewritten: if EEPROM was written by
+  //previous version of firmware, they are moved from there into their own slots (see ce_errors.c)
+  ce_read_saved_errors();
 
-  if (crc16((uint8_t*)&d->param, (sizeof(params_t)-PAR_CRC_SIZE))!=d->param.crc)
+  //          .
+  //    -     FLASH
+  //Find the newest record of parameters with correct CRC in the journal. If there is no
+  //such record, then load reserve parameters from the FLASH
+  if (ej_read(EJ_PARAMS, eeprom_parameters_cache) || load_legacy_params())
+   memcpy(&d->param, &eeprom_parameters_cache[0], sizeof(params_t));
+  else
   {
    memcpy_P(&d->param, &fw_data.def_param, sizeof(params_t));
    ce_set_error(ECUERROR_EEPROM_PARAM_BROKEN);
@@ -68,7 +95,7 @@ void load_eeprom_params(struct ecudata_t* d)
 
   //  ,      
   // .
-  memcpy(eeprom_parameters_cache, &d->param, sizeof(params_t));
+  memcpy(&eeprom_parameters_cache[0], &d->param, sizeof(params_t));
  }
  else
  {//  -   ,    ,  
@@ -76,40 +103,446 @@ void load_eeprom_params(struct ecudata_t* d)
   memcpy_P(&d->param, &fw_data.def_param, sizeof(params_t));
   ce_clear_errors(); //  
 #ifdef REALTIME_TABLES
-  eeprom_write_P(&tt_def_data[0], EEPROM_REALTIME_TABLES_START, sizeof(f_data_t) * TUNABLE_TABLES_NUMBER);
+  for(i = 0; i < TUNABLE_TABLES_NUMBER; ++i)
+   eeprom_write_P(&tt_def_data[i], EEPROM_REALTIME_TABLES_START + (TABLES_EE_SIZE * i), TABLES_EE_SIZE);
 #endif  
  }
+ //parameters from the FLASH contain size of data instead of CRC
+ update_params_crc(d);
+}
+
+uint8_t reload_eeprom_params(struct ecudata_t* d)
+{
+ if (!eeprom_is_idle())
+  return 0;
+
+ if (ej_read(EJ_PARAMS, eeprom_parameters_cache))
+  memcpy(&d->param, &eeprom_parameters_cache[0], sizeof(params_t));
+ else
+ {
+  memcpy_P(&d->param, &fw_data.def_param, sizeof(params_t));
+  memcpy(&eeprom_parameters_cache[0], &d->param, sizeof(params_t));
+  ce_set_error(ECUERROR_EEPROM_PARAM_BROKEN);
+ }
+ update_params_crc(d);
+ return 1;
+}
+
+void update_params_crc(struct ecudata_t* d)
+{
+ d->param.crc = crc16((uint8_t*)&d->param, sizeof(params_t) - PAR_CRC_SIZE);
 }
 
 #ifdef REALTIME_TABLES
-void load_selected_tables_into_ram(struct ecudata_t* d)
+/**Number of bytes read from EEPROM into shadow set of tables per one pass of main loop (one row) */
+#define TABLES_LOAD_CHUNK_SIZE  TABLES_ROW_SIZE
+
+
+/**Describes state of background loading of set of tables from EEPROM */
+typedef struct
+{
+ uint16_t eeaddr;                        //!< address in EEPROM of the set being loaded
+ uint16_t offset;                        //!< number of bytes already read into shadow set of tables
+ uint8_t fuel_type;                      //!< type of fuel for which tables are being loaded
+ uint8_t index;                          //!< index of set of tables being loaded
+ uint8_t busy;                           //!< flag, indicates that loading is in progress
+}tables_load_state_t;
+
+/**Describes state of editing of sets of tables for each type of fuel */
+typedef struct
+{
+ uint32_t edited[2];                     //!< bit mask of rows edited in shadow set, but not committed yet
+ uint32_t dirty[2];                      //!< bit mask of rows of active set which differ from set stored in EEPROM
+ uint8_t src_index[2];                   //!< index of set of tables which active set was loaded from (or saved to)
+}tables_edit_state_t;
+
+#ifdef TABLES_OVERLAY
+/**Describes state of background saving of set of tables into EEPROM. Rows of set are scattered
+ * between FLASH and RAM, so they are written one by one through the buffer */
+typedef struct
+{
+ uint32_t rows;                          //!< bit mask of rows which are still to be written
+ uint16_t eeaddr;                        //!< address in EEPROM of the set being saved
+ uint8_t fuel_type;                      //!< type of fuel of active set being saved
+ uint8_t row;                            //!< index of row being written
+ uint8_t buf[TABLES_ROW_SIZE];           //!< copy of row being written
+}tables_save_state_t;
+
+/**State variables of background saving of tables */
+static tables_save_state_t tsv;
+#endif
+
+/**State variables of background loading of tables */
+static tables_load_state_t tld = {0, 0, 0, 0, 0};
+
+/**State variables of editing of tables */
+static tables_edit_state_t ted;
+
+#ifdef TABLES_OVERLAY
+/**Shadow set of tables of specified type of fuel (each type of fuel has its own shadow overlay) */
+#define SHADOW_TABLES(d, fuel_type) ((d)->tables_shd[fuel_type])
+#else
+/**Shadow set of tables. One shadow set is shared by both types of fuel to save RAM (see bind_shadow_tables()) */
+#define SHADOW_TABLES(d, fuel_type) ((d)->tables_shd)
+
+/**Binds shared shadow set of tables to specified type of fuel, shadow set receives copy of active
+ * set of this type of fuel. Binding is impossible while shadow set contains not committed edits of
+ * another type of fuel or is being loaded.
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \return 1 - shadow set belongs to specified type of fuel, 0 - shadow set is busy
+ */
+static uint8_t bind_shadow_tables(struct ecudata_t* d, uint8_t fuel_type)
+{
+ if (d->tables_shd_fuel == fuel_type)
+  return 1;
+ if (ted.edited[d->tables_shd_fuel] || tld.busy)
+  return 0;
+ memcpy(d->tables_shd, d->tables_ram[fuel_type], sizeof(f_data_t));
+ d->tables_shd_fuel = fuel_type;
+ return 1;
+}
+#endif
+
+/**Makes shadow set of tables active for specified type of fuel. Previously active set becomes
+ * shadow one and receives copy of the new active set. Swapping of pointers is atomic, so active
+ * set of tables is always consistent.
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ */
+static void swap_shadow_tables(struct ecudata_t* d, uint8_t fuel_type)
+{
+#ifdef TABLES_OVERLAY
+ tables_ovl_t* p_old = d->tables_ram[fuel_type];
+#else
+ f_data_t* p_old = d->tables_ram[fuel_type];
+#endif
+ _BEGIN_ATOMIC_BLOCK();
+ d->tables_ram[fuel_type] = SHADOW_TABLES(d, fuel_type);
+#ifdef TABLES_OVERLAY
+ if (d->fn_ovl == p_old)
+ {
+  d->fn_ovl = SHADOW_TABLES(d, fuel_type);
+  d->fn_dat = d->fn_ovl->base;
+  d->fn_axes = d->tables_axes[fuel_type];
+ }
+#else
+ if (d->fn_dat == p_old)
+ {
+  d->fn_dat = SHADOW_TABLES(d, fuel_type);
+  d->fn_axes = d->tables_axes[fuel_type];
+ }
+#endif
+ SHADOW_TABLES(d, fuel_type) = p_old;
+ _END_ATOMIC_BLOCK();
+
+ //shadow set must contain the same data as active one, further editing will be continued from it.
+ //In the overlay mode only indexes of slots are copied, so rows are shared until they are edited.
+ memcpy(SHADOW_TABLES(d, fuel_type), d->tables_ram[fuel_type], sizeof(*p_old));
+ ++d->tables_gen[fuel_type];
+}
+
+/**Marks rows of shadow set of tables as edited. Must be called after changing of shadow set.
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \param offset offset of changed data in f_data_t
+ * \param size size of changed data in bytes
+ */
+static void mark_edited_tables(uint8_t fuel_type, uint16_t offset, uint8_t size)
+{
+ uint16_t row = offset / TABLES_ROW_SIZE, last = (offset + size - 1) / TABLES_ROW_SIZE;
+ if (!size || row >= TABLES_ROWS_NUMBER)
+  return;
+ if (last >= TABLES_ROWS_NUMBER)
+  last = TABLES_ROWS_NUMBER - 1;
+ for(; row <= last; ++row)
+  ted.edited[fuel_type]|= (1UL << row);
+}
+
+#ifdef TABLES_OVERLAY
+/**Finds free slot in the pool of overlay. Slot is free if it is not used by any set of tables.
+ * \param d pointer to ECU data structure
+ * \return index of free slot or TABLES_OVL_BASE if pool is exhausted
+ */
+static uint8_t alloc_ovl_slot(struct ecudata_t* d)
+{
+ uint32_t used = 0;
+ uint8_t i = 0, r;
+ for(; i < 4; ++i)
+  for(r = 0; r < TABLES_ROWS_NUMBER; ++r)
+   if (d->tables_pool[i].slot[r] != TABLES_OVL_BASE)
+    used|= (1UL << d->tables_pool[i].slot[r]);
+
+ for(i = 0; i < TABLES_OVL_ROWS; ++i)
+  if (!(used & (1UL << i)))
+   return i;
+ return TABLES_OVL_BASE;
+}
+
+/**Puts row into shadow set of tables. Row which is equal to the row of base set does not take
+ * slot in the pool of overlay. Slot which is shared with active set is not changed, new slot is
+ * taken instead (copy-on-write).
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \param row index of row
+ * \param buf data of row
+ * \return 1 - row has been put, 0 - pool of overlay is exhausted
+ */
+static uint8_t put_shadow_row(struct ecudata_t* d, uint8_t fuel_type, uint8_t row, const uint8_t* buf)
+{
+ tables_ovl_t* p_shd = SHADOW_TABLES(d, fuel_type);
+ uint8_t slot = p_shd->slot[row];
+ uint8_t base[TABLES_ROW_SIZE];
+
+ memcpy_P(base, ((uint8_t _PGM*)p_shd->base) + (row * TABLES_ROW_SIZE), TABLES_ROW_SIZE);
+ if (!memcmp(base, buf, TABLES_ROW_SIZE))
+ { //row is the same as in base set, its slot (if any) becomes free
+  p_shd->slot[row] = TABLES_OVL_BASE;
+  return 1;
+ }
+
+ if (TABLES_OVL_BASE == slot || slot == d->tables_ram[fuel_type]->slot[row])
+ {
+  slot = alloc_ovl_slot(d);
+  if (TABLES_OVL_BASE == slot)
+  {
+   ce_set_error(ECUERROR_TABLES_OVERFLOW);
+   return 0;
+  }
+ }
+
+ memcpy(d->tables_ovl[slot], buf, TABLES_ROW_SIZE);
+ p_shd->slot[row] = slot;
+ return 1;
+}
+
+/**Writes next dirty row of active set of tables into EEPROM (only if EEPROM is idle)
+ * \param d pointer to ECU data structure
+ */
+static void save_next_tables_row(struct ecudata_t* d)
+{
+ if (!eeprom_is_idle())
+  return;
+
+ while(!(tsv.rows & (1UL << tsv.row)))
+  ++tsv.row;
+ tsv.rows&= ~(1UL << tsv.row);
+
+ read_tables_row(d, tsv.fuel_type, 0, tsv.row, tsv.buf);
+ //notification will be sent when the last row is written
+ eeprom_start_wr_data(tsv.rows ? 0 : OPCODE_SAVE_TABLSET, tsv.eeaddr + (tsv.row * TABLES_ROW_SIZE), tsv.buf, TABLES_ROW_SIZE);
+}
+#endif
+
+/**Completes loading of set of tables: loaded shadow set becomes active
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \param index index of loaded set of tables
+ */
+static void finish_tables_loading(struct ecudata_t* d, uint8_t fuel_type, uint8_t index)
+{
+ //axes are not loaded, they are always taken from the FLASH
+ d->tables_axes[fuel_type] = (index < TABLES_NUMBER) ? &fw_data.axes[index] : &tt_def_axes[index - TABLES_NUMBER];
+ swap_shadow_tables(d, fuel_type);
+ ted.edited[fuel_type] = 0;
+ ted.dirty[fuel_type] = 0;
+ ted.src_index[fuel_type] = index;
+
+ //    ,     
+ //notification will be sent about that new set of tables has been loaded
+ sop_set_operation(SOP_SEND_NC_TABLSET_LOADED);
+}
+
+uint8_t load_selected_tables_into_ram(struct ecudata_t* d)
 {
  if (d->fn_gasoline_prev != d->param.fn_gasoline)
  {
   //load gasoline tables
-  load_specified_tables_into_ram(d, 0, d->param.fn_gasoline);
+  if (!load_specified_tables_into_ram(d, 0, d->param.fn_gasoline))
+   return 0; //loader is busy, try later
   d->fn_gasoline_prev = d->param.fn_gasoline;
  }
 
  if (d->fn_gas_prev != d->param.fn_gas)
  {
   //load gas tables
-  load_specified_tables_into_ram(d, 1, d->param.fn_gas);
+  if (!load_specified_tables_into_ram(d, 1, d->param.fn_gas))
+   return 0; //loader is busy, try later
   d->fn_gas_prev = d->param.fn_gas;
  }
+
+ return 1;
 }
 
-void load_specified_tables_into_ram(struct ecudata_t* d, uint8_t fuel_type, uint8_t index)
+uint8_t load_specified_tables_into_ram(struct ecudata_t* d, uint8_t fuel_type, uint8_t index)
 {
- //load tables depending on type of fuel
+ //Active set which is replaced may be being saved into EEPROM directly from RAM, so loading waits
+ //until writing of EEPROM is finished
+ if (!tables_loading_is_idle() || !eeprom_is_idle())
+  return 0; //shadow set of tables is in use (or active set is being saved)
+
+#ifdef TABLES_OVERLAY
+ //Shadow set becomes empty overlay of base set. Default data of tunable set is used as its base,
+ //so only rows which were changed by user take slots in the pool of overlay.
+ SHADOW_TABLES(d, fuel_type)->base = (index < TABLES_NUMBER) ? &fw_data.tables[index] : &tt_def_data[index - TABLES_NUMBER];
+ memset(SHADOW_TABLES(d, fuel_type)->slot, TABLES_OVL_BASE, TABLES_ROWS_NUMBER);
+#else
+ //shared shadow set can not be taken while it contains not committed edits of another type of fuel
+ if (d->tables_shd_fuel != fuel_type && ted.edited[d->tables_shd_fuel])
+  return 0;
+ d->tables_shd_fuel = fuel_type;
+#endif
+
+ //load tables depending on type of fuel. Not committed changes in shadow set are lost
  if (index < TABLES_NUMBER)
-  memcpy_P(&d->tables_ram[fuel_type], &fw_data.tables[index], sizeof(f_data_t));
+ { //tables from FLASH are copied at once
+#ifndef TABLES_OVERLAY
+  memcpy_P(SHADOW_TABLES(d, fuel_type), &fw_data.tables[index], sizeof(f_data_t));
+#endif
+  finish_tables_loading(d, fuel_type, index);
+ }
  else
-  eeprom_read(&d->tables_ram[fuel_type], EEPROM_REALTIME_TABLES_START+(sizeof(f_data_t)*(index-TABLES_NUMBER)), sizeof(f_data_t));
+ { //tables from EEPROM are read in background, see process_tables_loading()
+  tld.eeaddr = EEPROM_REALTIME_TABLES_START + (TABLES_EE_SIZE * (index - TABLES_NUMBER));
+  tld.offset = 0;
+  tld.fuel_type = fuel_type;
+  tld.index = index;
+  tld.busy = 1;
+ }
+ return 1;
+}
 
- //    ,     
- //notification will be sent about that new set of tables has been loaded
- sop_set_operation(SOP_SEND_NC_TABLSET_LOADED);
+void process_tables_loading(struct ecudata_t* d)
+{
+ uint16_t size;
+#ifdef TABLES_OVERLAY
+ uint8_t row[TABLES_LOAD_CHUNK_SIZE];
+ if (tsv.rows)
+  save_next_tables_row(d);
+#endif
+ if (!tld.busy || !eeprom_is_idle())
+  return;
+
+ size = TABLES_EE_SIZE - tld.offset;
+ if (size > TABLES_LOAD_CHUNK_SIZE)
+  size = TABLES_LOAD_CHUNK_SIZE;
+
+#ifdef TABLES_OVERLAY
+ eeprom_read(row, tld.eeaddr + tld.offset, size);
+ if (!put_shadow_row(d, tld.fuel_type, tld.offset / TABLES_ROW_SIZE, row))
+ { //there is no room for the set, loading is aborted and active set is kept
+  tld.busy = 0;
+  memcpy(SHADOW_TABLES(d, tld.fuel_type), d->tables_ram[tld.fuel_type], sizeof(tables_ovl_t));
+  sop_set_operation(SOP_SEND_NC_TABLSET_LOADED);
+  return;
+ }
+#else
+ eeprom_read(((uint8_t*)SHADOW_TABLES(d, tld.fuel_type)) + tld.offset, tld.eeaddr + tld.offset, size);
+#endif
+ tld.offset+= size;
+
+ if (tld.offset >= TABLES_EE_SIZE)
+ { //whole image of set of tables has been read, now it can be used
+  tld.busy = 0;
+  finish_tables_loading(d, tld.fuel_type, tld.index);
+ }
+}
+
+uint8_t tables_loading_is_idle(void)
+{
+#ifdef TABLES_OVERLAY
+ return !tld.busy && !tsv.rows;
+#else
+ return !tld.busy;
+#endif
+}
+
+void read_tables_row(struct ecudata_t* d, uint8_t fuel_type, uint8_t shadow, uint8_t row, uint8_t* buf)
+{
+#ifdef TABLES_OVERLAY
+ tables_ovl_t* p_set = shadow ? SHADOW_TABLES(d, fuel_type) : d->tables_ram[fuel_type];
+ uint8_t slot = p_set->slot[row];
+ if (TABLES_OVL_BASE == slot)
+  memcpy_P(buf, ((uint8_t _PGM*)p_set->base) + (row * TABLES_ROW_SIZE), TABLES_ROW_SIZE);
+ else
+  memcpy(buf, d->tables_ovl[slot], TABLES_ROW_SIZE);
+#else
+ //shadow set which belongs to another type of fuel has no edits of this one, so active set is read
+ f_data_t* p_set = (shadow && d->tables_shd_fuel == fuel_type) ? d->tables_shd : d->tables_ram[fuel_type];
+ memcpy(buf, ((uint8_t*)p_set) + (row * TABLES_ROW_SIZE), TABLES_ROW_SIZE);
+#endif
+}
+
+uint8_t write_shadow_tables_row(struct ecudata_t* d, uint8_t fuel_type, uint8_t row, const uint8_t* buf)
+{
+#ifdef TABLES_OVERLAY
+ if (!put_shadow_row(d, fuel_type, row, buf))
+  return 0;
+#else
+ if (!bind_shadow_tables(d, fuel_type))
+  return 0;
+ memcpy(((uint8_t*)SHADOW_TABLES(d, fuel_type)) + (row * TABLES_ROW_SIZE), buf, TABLES_ROW_SIZE);
+#endif
+ mark_edited_tables(fuel_type, row * TABLES_ROW_SIZE, TABLES_ROW_SIZE);
+ return 1;
+}
+
+
+void commit_edited_tables(struct ecudata_t* d, uint8_t fuel_type)
+{
+#ifndef TABLES_OVERLAY
+ if (!bind_shadow_tables(d, fuel_type))
+  return; //shadow set contains edits of another type of fuel, so there is nothing to commit
+#endif
+ swap_shadow_tables(d, fuel_type);
+ ted.dirty[fuel_type]|= ted.edited[fuel_type];
+ ted.edited[fuel_type] = 0;
+}
+
+void save_dirty_tables(struct ecudata_t* d, uint8_t fuel_type, uint8_t index)
+{
+ uint32_t dirty = ted.dirty[fuel_type];
+#ifndef TABLES_OVERLAY
+ uint8_t first = 0, last = TABLES_ROWS_NUMBER - 1;
+#endif
+ uint16_t eeaddr = EEPROM_REALTIME_TABLES_START + (TABLES_EE_SIZE * (index - TABLES_NUMBER));
+
+ //active set was taken from another place - all rows must be saved
+ if (ted.src_index[fuel_type] != index)
+  dirty = ~0UL;
+
+ ted.dirty[fuel_type] = 0;
+ ted.src_index[fuel_type] = index;
+
+ dirty&= (~0UL >> (32 - TABLES_ROWS_NUMBER));
+
+ if (0==dirty)
+ { //nothing to save, notify at once
+  sop_set_operation(SOP_SEND_NC_TABLSET_SAVED);
+  return;
+ }
+
+#ifdef TABLES_OVERLAY
+ //dirty rows will be written one by one, see process_tables_loading()
+ tsv.rows = dirty;
+ tsv.eeaddr = eeaddr;
+ tsv.fuel_type = fuel_type;
+ tsv.row = 0;
+#else
+ //Find range of dirty rows. Clean rows inside this range will not be programmed, because EEPROM
+ //writer skips bytes which are equal to stored ones.
+ while(!(dirty & (1UL << first)))
+  ++first;
+ while(!(dirty & (1UL << last)))
+  --last;
+
+ eeprom_start_wr_data(OPCODE_SAVE_TABLSET, eeaddr + (first * TABLES_ROW_SIZE),
+   ((uint8_t*)d->tables_ram[fuel_type]) + (first * TABLES_ROW_SIZE), (last - first + 1) * TABLES_ROW_SIZE);
+#endif
+}
+
+uint8_t reload_active_tables(struct ecudata_t* d, uint8_t fuel_type)
+{
+ return load_specified_tables_into_ram(d, fuel_type, ted.src_index[fuel_type]);
 }
 
 #endif
@@ -43,7 +43,8 @@ struct ecudata_t;
 void save_param_if_need(struct ecudata_t* d);
 
 /**Loads the parameters from the EEPROM, and verifies the integrity of the data if they spoiled
- * it takes a backup instance from the FLASH.
+ * it takes a backup instance from the FLASH. The newest valid record of parameters is taken
+ * from the journal (see ejournal.h).
  * Call this function only when EEPROM is idle!
  *    EEPROM,        
  *     FLASH.
@@ -51,23 +52,102 @@ void save_param_if_need(struct ecudata_t* d);
  */
 void load_eeprom_params(struct ecudata_t* d);
 
+/**Reloads parameters from the EEPROM at runtime (used when parameters in RAM are found to be corrupted).
+ * Newest valid record of journal is taken, if there is no such record, then parameters are taken from the FLASH.
+ * Jumper of default parameters is not taken into account.
+ * \param d pointer to ECU data structure
+ * \return 1 - parameters have been reloaded, 0 - EEPROM is busy, call this function again later
+ */
+uint8_t reload_eeprom_params(struct ecudata_t* d);
+
+/**Calculates CRC of parameters in RAM and stores it in params_t::crc (the same way as it is stored
+ * in the EEPROM). Must be called each time parameters have been changed legally, CRC is used as
+ * reference by background check of RAM (see integrity.h).
+ * \param d pointer to ECU data structure
+ */
+void update_params_crc(struct ecudata_t* d);
+
 #ifdef REALTIME_TABLES
 /** Loads tables into RAM depending on current fuel type and index of selected table (selected in parameters).
- *  Call this function only when EEPROM is idle!
+ *  Sets of tables from EEPROM are loaded in background, see process_tables_loading().
  * \param d pointer to ECU data structure
+ * \return 1 - loading of all changed sets of tables has been started, 0 - loader is busy, call this function again later
  */
-void load_selected_tables_into_ram(struct ecudata_t* d);
+uint8_t load_selected_tables_into_ram(struct ecudata_t* d);
 
-/** Loads tables into RAM depending on specified fuel type and index
- *  Call this function only when EEPROM is idle!
+/** Loads tables into RAM depending on specified fuel type and index. Tables are loaded into staging
+ *  set, which becomes active (atomically) only when loading is completed. Tables from FLASH are loaded
+ *  at once, tables from EEPROM are read by chunks in background (see process_tables_loading()).
  * \param d pointer to ECU data structure
  * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
  * \param index index of tables set to load into RAM
+ * \return 1 - loading has been started (or completed), 0 - loader or EEPROM is busy, call this function again later
+ * Set of tables is loaded into shadow set (not committed changes are lost) and then committed.
+ * Without TABLES_OVERLAY one shadow set is shared by both types of fuel, so loading is postponed
+ * (0 is returned) while shadow set contains not committed changes of another type of fuel.
+ */
+uint8_t load_specified_tables_into_ram(struct ecudata_t* d, uint8_t fuel_type, uint8_t index);
+
+/** Continues background loading of set of tables from EEPROM. Reads next small chunk of data into
+ *  shadow set of tables (only if EEPROM is idle). Call this function from the main loop.
+ *  In the TABLES_OVERLAY mode it also continues saving of set of tables (row by row).
+ * \param d pointer to ECU data structure
+ */
+void process_tables_loading(struct ecudata_t* d);
+
+/** Checks whether background loading (or saving in the TABLES_OVERLAY mode) of tables is in progress
+ * \return 1 - idle, 0 - loading is in progress
+ */
+uint8_t tables_loading_is_idle(void);
+
+/** Reads one row of active or shadow set of tables
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \param shadow 0 - active set, 1 - shadow set
+ * \param row index of row (0...TABLES_ROWS_NUMBER-1)
+ * \param buf buffer which will receive TABLES_ROW_SIZE bytes of row
+ */
+void read_tables_row(struct ecudata_t* d, uint8_t fuel_type, uint8_t shadow, uint8_t row, uint8_t* buf);
+
+/** Writes one row of shadow set of tables and marks it as edited
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \param row index of row (0...TABLES_ROWS_NUMBER-1)
+ * \param buf buffer which contains TABLES_ROW_SIZE bytes of row
+ * \return 1 - row has been written, 0 - there is no free space in the pool of overlay (TABLES_OVERLAY mode)
+ * or shared shadow set contains not committed changes of another type of fuel (otherwise)
+ */
+uint8_t write_shadow_tables_row(struct ecudata_t* d, uint8_t fuel_type, uint8_t row, const uint8_t* buf);
+
+
+/** Commits changes made in shadow set of tables: shadow set atomically becomes active one and
+ *  generation counter of tables (ecudata_t::tables_gen) is incremented. Edited rows become dirty.
+ *  Do not call this function while loading of tables or writing of EEPROM is in progress!
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ */
+void commit_edited_tables(struct ecudata_t* d, uint8_t fuel_type);
+
+/** Starts writing of dirty rows of active set of tables into EEPROM (all rows are written if
+ *  active set was loaded from another place). Notification will be sent upon completion.
+ *  Call this function only when EEPROM is idle!
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \param index index of tables set to save to, begins from FLASH's indexes (must be >= TABLES_NUMBER)
+ */
+void save_dirty_tables(struct ecudata_t* d, uint8_t fuel_type, uint8_t index);
+
+/** Reloads active set of tables from the place it was loaded from or saved to (used when set of tables
+ *  in RAM is found to be corrupted). Not saved changes are lost.
+ * \param d pointer to ECU data structure
+ * \param fuel_type type of fuel (0 - gasoline, 1 - gas)
+ * \return 1 - loading has been started (or completed), 0 - loader is busy, call this function again later
  */
-void load_specified_tables_into_ram(struct ecudata_t* d, uint8_t fuel_type, uint8_t index);
+uint8_t reload_active_tables(struct ecudata_t* d, uint8_t fuel_type);
 #endif
 
-/** Cache for buffering parameters used during suspended EEPROM operations */
+/** Cache for buffering parameters used during suspended EEPROM operations. It is a record of
+ * journal (see ejournal.h), parameters are followed by sequence number */
 extern uint8_t eeprom_parameters_cache[];
 
 #endif //_PARAMS_H_
@@ -36,6 +36,20 @@
 
  #define CALL_ADDRESS(addr) ((void (*)())((addr)/2))()
 
+#elif defined(SECU3_HOST) //host build of firmware (see tools/hostsim)
+ #include <avr/eeprom.h>       //__EEGET(), __EEPUT(), functions of model
+
+ //abstracting intrinsics
+ #define _ENABLE_INTERRUPT() sei()
+ #define _DISABLE_INTERRUPT() cli()
+ #define _SAVE_INTERRUPT() SREG
+ #define _RESTORE_INTERRUPT(s) SREG = (s)
+ #define _NO_OPERATION()
+ #define _DELAY_CYCLES(cycles) host_delay_cycles(cycles)
+ #define _WATCHDOG_RESET() host_wdr()
+
+ #define CALL_ADDRESS(addr) host_call_address(addr)
+
 #else //AVR GCC
  #include <avr/eeprom.h>       //__EEGET(), __EEPUT() etc
 
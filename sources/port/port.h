@@ -39,8 +39,13 @@
  #define INLINE _Pragma("inline")
 
 #elif defined(__GNUC__) // GNU Compiler
+#ifdef SECU3_HOST
+ //host build of firmware (see tools/hostsim), main() is called by simulator
+ #define MAIN() void secu3_main(void)
+#else
  //main() can be void if -ffreestanding compiler option specified.
  #define MAIN() __attribute__ ((OS_main)) void main(void)
+#endif
 
  //convert compiler-specific symbols to common symbols
  #if defined (__AVR_ATmega16__)
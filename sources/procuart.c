@@ -33,20 +33,80 @@
 #include "ce_errors.h"
 #include "ckps.h"
 #include "diagnost.h"
+#include "integrity.h"
 #include "knock.h"
 #include "procuart.h"
 #include "secu3.h"
 #include "suspendop.h"
+#include "trace.h"
 #include "uart.h"
 #include "ufcodes.h"
 #include "vstimer.h"
 
+/**Applies parameters of CKP sensor to the running engine
+ * \param d pointer to ECU data structure
+ */
+static void apply_ckps_params(struct ecudata_t* d)
+{
+ ckps_set_cyl_number(d->param.ckps_engine_cyl);  //<--   !
+ ckps_set_cogs_num(d->param.ckps_cogs_num, d->param.ckps_miss_num);
+ ckps_set_edge_type(d->param.ckps_edge_type);
+#ifdef SECU3T
+ cams_vr_set_edge_type(d->param.ref_s_edge_type); //REF_S ()
+#endif
+ ckps_set_cogs_btdc(d->param.ckps_cogs_btdc);
+ ckps_set_merge_outs(d->param.merge_ign_outs);
+ ckps_set_map_sampling(d->param.map_samp_mode ? d->param.map_samp_num : 0, d->param.map_samp_offset);
+
+#ifndef DWELL_CONTROL
+ ckps_set_ignition_cogs(d->param.ckps_ignit_cogs);
+#endif
+}
+
+/**Applies parameters of knock detection, must be called after apply_ckps_params()
+ * \param d pointer to ECU data structure
+ */
+static void apply_knock_params(struct ecudata_t* d)
+{
+ //        ,      .
+ if (!d->use_knock_channel_prev && d->param.knock_use_knock_channel)
+  if (!knock_module_initialize())
+  {//     -  
+   ce_set_error(ECUERROR_KSP_CHIP_FAILED);
+  }
+
+ knock_set_band_pass(d->param.knock_bpf_frequency);
+ //gain     
+ knock_set_int_time_constant(d->param.knock_int_time_const);
+ ckps_set_knock_window(d->param.knock_k_wnd_begin_angle, d->param.knock_k_wnd_end_angle);
+ ckps_use_knock_channel(d->param.knock_use_knock_channel);
+
+ //           
+ //   .
+ d->use_knock_channel_prev = d->param.knock_use_knock_channel;
+}
+
+void apply_params(struct ecudata_t* d)
+{
+ apply_ckps_params(d);
+ apply_knock_params(d);
+#ifdef HALL_OUTPUT
+ ckps_set_hall_pulse(d->param.hop_start_cogs, d->param.hop_durat_cogs);
+#endif
+#ifdef REALTIME_TABLES
+ sop_set_operation(SOP_SELECT_TABLSET);
+#endif
+}
+
 void process_uart_interface(struct ecudata_t* d)
 {
  uint8_t descriptor;
 
  if (uart_is_packet_received())//   ?
  {
+#ifdef TRACE_CAPTURE
+  trace_put_uart(); //capture frame before it is interpreted
+#endif
   descriptor = uart_recept_packet(d);
   switch(descriptor)
   {
@@ -57,6 +117,7 @@ void process_uart_interface(struct ecudata_t* d)
    case STARTR_PAR:
    case ADCCOR_PAR:
    case CHOKE_PAR:
+    intg_invalidate_params(d);
     //       
     s_timer16_set(save_param_timeout_counter, SAVE_PARAM_TIMEOUT_VALUE);
     break;
@@ -65,6 +126,7 @@ void process_uart_interface(struct ecudata_t* d)
 #ifdef HALL_OUTPUT
     ckps_set_hall_pulse(d->param.hop_start_cogs, d->param.hop_durat_cogs);
 #endif
+    intg_invalidate_params(d);
     s_timer16_set(save_param_timeout_counter, SAVE_PARAM_TIMEOUT_VALUE);
     break;
 
@@ -72,6 +134,7 @@ void process_uart_interface(struct ecudata_t* d)
 #ifdef REALTIME_TABLES
     sop_set_operation(SOP_SELECT_TABLSET);
 #endif
+    intg_invalidate_params(d);
     //       
     s_timer16_set(save_param_timeout_counter, SAVE_PARAM_TIMEOUT_VALUE);
     break;
@@ -87,6 +150,12 @@ void process_uart_interface(struct ecudata_t* d)
      sop_set_operation(SOP_READ_CE_ERRORS);
      _AB(d->op_actn_code, 0) = 0; //
     }
+    if (_AB(d->op_actn_code, 0) == OPCODE_CE_READ_LOG) //"read freeze frames log of CE errors" command has been received
+    {
+     ce_start_log_transfer();
+     sop_set_operation(SOP_READ_CE_LOG);
+     _AB(d->op_actn_code, 0) = 0; //
+    }
     if (_AB(d->op_actn_code, 0) == OPCODE_READ_FW_SIG_INFO) //       
     {
      sop_set_operation(SOP_SEND_FW_SIG_INFO);
@@ -103,6 +172,20 @@ void process_uart_interface(struct ecudata_t* d)
      sop_set_operation(SOP_SAVE_TABLSET);
      _AB(d->op_actn_code, 0) = 0; //
     }
+    if (_AB(d->op_actn_code, 0) == OPCODE_COMMIT_TABLSET) //"commit changes in shadow set of tables for specified fuel" command has been received
+    {
+     sop_set_operation(SOP_COMMIT_TABLSET);
+     _AB(d->op_actn_code, 0) = 0; //
+    }
+    if (_AB(d->op_actn_code, 0) == OPCODE_BULK_TABLSET) //"send set(s) of tables by bulk transfer" command has been received
+    {
+     uart_bulk_start(_AB(d->op_actn_code, 1));
+     if (uart_bulk_is_active())
+      sop_set_operation(SOP_SEND_TABLSET_BULK);
+     else //wrong set, just acknowledge
+      sop_set_operation(SOP_SEND_NC_TABLSET_BULK);
+     _AB(d->op_actn_code, 0) = 0; //
+    }
 #endif
 #ifdef DIAGNOSTICS
     if (_AB(d->op_actn_code, 0) == OPCODE_DIAGNOST_ENTER) //"enter diagnostic mode" command has been received
@@ -117,6 +200,13 @@ void process_uart_interface(struct ecudata_t* d)
      diagnost_stop();
      _AB(d->op_actn_code, 0) = 0; //
     }
+#endif
+#ifdef TRACE_CAPTURE
+    if (_AB(d->op_actn_code, 0) == OPCODE_TRACE_CAPTURE) //"start/stop capturing of trace" command has been received
+    {
+     trace_start(_AB(d->op_actn_code, 1));
+     _AB(d->op_actn_code, 0) = 0; //
+    }
 #endif
     break;
 
@@ -124,42 +214,25 @@ void process_uart_interface(struct ecudata_t* d)
     sop_set_operation(SOP_SAVE_CE_ERRORS);
     break;
 
+#ifdef REALTIME_TABLES
+   case EDITAB_BLK:
+    //set of tables has been received by bulk transfer, send single acknowledgement
+    if (uart_bulk_take_completed())
+     sop_set_operation(SOP_SEND_NC_TABLSET_BULK);
+    break;
+#endif
+
    case CKPS_PAR:
     //    ,           
-    ckps_set_cyl_number(d->param.ckps_engine_cyl);  //<--   !
-    ckps_set_cogs_num(d->param.ckps_cogs_num, d->param.ckps_miss_num);
-    ckps_set_edge_type(d->param.ckps_edge_type);
-#ifdef SECU3T
-    cams_vr_set_edge_type(d->param.ref_s_edge_type); //REF_S ()
-#endif
-    ckps_set_cogs_btdc(d->param.ckps_cogs_btdc);
-    ckps_set_merge_outs(d->param.merge_ign_outs);
-
-#ifndef DWELL_CONTROL
-    ckps_set_ignition_cogs(d->param.ckps_ignit_cogs);
-#endif
+    apply_ckps_params(d);
+    intg_invalidate_params(d);
     s_timer16_set(save_param_timeout_counter, SAVE_PARAM_TIMEOUT_VALUE);
     break;
 
    case KNOCK_PAR:
     //   ,   CKPS_PAR!
-    //        ,      .
-    if (!d->use_knock_channel_prev && d->param.knock_use_knock_channel)
-     if (!knock_module_initialize())
-     {//     -  
-      ce_set_error(ECUERROR_KSP_CHIP_FAILED);
-     }
-
-    knock_set_band_pass(d->param.knock_bpf_frequency);
-    //gain     
-    knock_set_int_time_constant(d->param.knock_int_time_const);
-    ckps_set_knock_window(d->param.knock_k_wnd_begin_angle, d->param.knock_k_wnd_end_angle);
-    ckps_use_knock_channel(d->param.knock_use_knock_channel);
-
-    //           
-    //   .
-    d->use_knock_channel_prev = d->param.knock_use_knock_channel;
-
+    apply_knock_params(d);
+    intg_invalidate_params(d);
     //       
     s_timer16_set(save_param_timeout_counter, SAVE_PARAM_TIMEOUT_VALUE);
     break;
@@ -169,10 +242,20 @@ void process_uart_interface(struct ecudata_t* d)
   uart_notify_processed();
  }
 
+#ifdef TRACE_CAPTURE
+ //while capture is active, trace is sent as soon as transmitter becomes free and periodic packets are not sent
+ if (trace_is_on())
+ {
+  if (!uart_is_sender_busy() && trace_is_pending())
+   uart_send_packet(d, TRACE_DAT);
+  return;
+ }
+#endif
+
  //    
  if (s_timer_is_action(send_packet_interval_counter))
  {
-  if (!uart_is_sender_busy())
+  if (!uart_is_sender_busy() && uart_is_stream_on())
   {
    uint8_t desc = uart_get_send_mode();
    uart_send_packet(d, 0);                  //    
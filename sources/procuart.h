@@ -35,4 +35,11 @@ struct ecudata_t;
  */
 void process_uart_interface(struct ecudata_t* d);
 
+/** Applies all parameters which are used by other modules (CKP sensor, knock chip, selection of tables)
+ * in the same way as when they are received via UART. Used after parameters have been reloaded.
+ * Should be called from main loop!
+ * \param d pointer to ECU data structure
+ */
+void apply_params(struct ecudata_t* d);
+
 #endif //_PROCUART_H_
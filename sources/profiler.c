@@ -0,0 +1,156 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file profiler.c
+ * Implementation of measuring of execution time of interrupt handlers and stages of main loop.
+ * (         ).
+ *
+ * Main loop never waits, so CPU load is estimated as following. Background work (PRB_ML_INTG stage:
+ * integrity checking with fixed time budget, scanning of stack) is performed in each pass and only
+ * fills free time, so it is subtracted from duration of pass. The shortest remainder is considered as
+ * idle pass (no pending work), then load = sum of (remainder - idle pass) / total time of passes.
+ * It is calculated over window of PRF_LOAD_WINDOW ticks.
+ */
+
+#ifdef PROFILING
+
+#include "port/avrio.h"
+#include "port/interrupt.h"
+#include "port/intrinsic.h"
+#include "port/port.h"
+#include <string.h>
+#include "profiler.h"
+
+/**Window used for calculation of CPU load, in ticks of timer 1 (1s) */
+#define PRF_LOAD_WINDOW 250000UL
+
+/**Define internal state variables */
+typedef struct
+{
+ prf_probe_t probes[PRB_NUMBER];  //!< statistics of probes
+ uint8_t  next;                   //!< next probe to be taken by prf_take_next()
+ uint16_t loop_min;               //!< the shortest pass of main loop without background work (idle), never reset
+ uint16_t bg_ticks;               //!< time of background work in current pass of main loop
+ uint16_t win_cnt;                //!< number of passes of main loop in current window
+ uint32_t win_sum;                //!< total time of passes of main loop in current window
+ uint32_t win_work;               //!< total time of passes without background work in current window
+ uint8_t  load;                   //!< CPU load in percents, calculated in the last window
+}prf_state_t;
+
+/**State variables */
+prf_state_t prf;
+
+/**Resets statistics of specified probe
+ * \param p pointer to probe
+ */
+static void reset_probe(prf_probe_t* p)
+{
+ memset(p, 0, sizeof(prf_probe_t));
+ p->min = 0xFFFF;
+}
+
+void prf_init(void)
+{
+ uint8_t i = 0;
+ for(; i < PRB_NUMBER; ++i)
+  reset_probe(&prf.probes[i]);
+ prf.next = 0;
+ prf.loop_min = 0xFFFF;
+ prf.bg_ticks = 0;
+ prf.win_cnt = 0;
+ prf.win_sum = 0;
+ prf.win_work = 0;
+ prf.load = 0;
+}
+
+/**Calculates bin of histogram for specified duration
+ * \param ticks duration in ticks of timer 1
+ * \return number of bin
+ */
+static uint8_t get_bin(uint16_t ticks)
+{
+ uint8_t bin = 0;
+ ticks>>= 1;
+ while(ticks && bin < (PRF_BINS - 1))
+ {
+  ticks>>= 1;
+  ++bin;
+ }
+ return bin;
+}
+
+void prf_put(uint8_t probe, uint16_t ticks)
+{
+ prf_probe_t* p = &prf.probes[probe];
+ uint8_t bin = get_bin(ticks);
+ _BEGIN_ATOMIC_BLOCK();
+ if (p->cnt < 65535)
+ {
+  ++p->cnt;
+  p->sum+= ticks;
+  if (ticks < p->min)
+   p->min = ticks;
+  if (ticks > p->max)
+   p->max = ticks;
+  if (p->hist[bin] < 255)
+   ++p->hist[bin];
+ }
+ _END_ATOMIC_BLOCK();
+
+ if (PRB_ML_INTG == probe)
+  prf.bg_ticks+= ticks;      //background work of current pass
+ else if (PRB_ML_LOOP == probe)
+ { //main loop only, calculate CPU load
+  uint16_t work = (ticks > prf.bg_ticks) ? ticks - prf.bg_ticks : 0;
+  prf.bg_ticks = 0;
+  if (work < prf.loop_min)
+   prf.loop_min = work;
+  prf.win_sum+= ticks;
+  prf.win_work+= work;
+  ++prf.win_cnt;
+  if (prf.win_sum >= PRF_LOAD_WINDOW || prf.win_cnt == 65535)
+  {
+   prf.load = (uint8_t)(((prf.win_work - (((uint32_t)prf.win_cnt) * prf.loop_min)) * 100) / prf.win_sum);
+   prf.win_cnt = 0;
+   prf.win_sum = 0;
+   prf.win_work = 0;
+  }
+ }
+}
+
+uint8_t prf_take_next(prf_probe_t* p_probe)
+{
+ uint8_t probe = prf.next;
+ _BEGIN_ATOMIC_BLOCK();
+ memcpy(p_probe, &prf.probes[probe], sizeof(prf_probe_t));
+ reset_probe(&prf.probes[probe]);
+ _END_ATOMIC_BLOCK();
+ prf.next = (probe + 1) < PRB_NUMBER ? probe + 1 : 0;
+ return probe;
+}
+
+uint8_t prf_get_load(void)
+{
+ return prf.load;
+}
+
+#endif //PROFILING
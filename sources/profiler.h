@@ -0,0 +1,117 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file profiler.h
+ * Measuring of execution time of interrupt handlers and stages of main loop (profiling build only).
+ * (         (   )).
+ *
+ * Time is measured using timer 1 (4us tick). Durations of interrupt handlers include time spent in nested
+ * interrupts and do not include prologue and epilogue generated by compiler. Statistics takes about 18 bytes
+ * of RAM per probe, so profiling build is intended for ATMega32/64.
+ */
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#ifdef PROFILING
+
+#include "port/avrio.h"
+#include <stdint.h>
+
+//Probes of interrupt handlers
+#define PRB_T1CAPT       0    //!< TIMER1_CAPT_vect
+#define PRB_T1COMPA      1    //!< TIMER1_COMPA_vect
+#define PRB_T1COMPB      2    //!< TIMER1_COMPB_vect
+#define PRB_T0OVF        3    //!< TIMER0_OVF_vect
+#define PRB_T2OVF        4    //!< TIMER2_OVF_vect
+#define PRB_T2COMP       5    //!< TIMER2_COMP_vect
+#define PRB_ADC          6    //!< ADC_vect
+#define PRB_RXC          7    //!< USART_RXC_vect
+#define PRB_UDRE         8    //!< USART_UDRE_vect
+#define PRB_SPI          9    //!< SPI_STC_vect
+#define PRB_EERDY       10    //!< EE_RDY_vect
+//Probes of stages of main loop
+#define PRB_ML_SOP      11    //!< suspended operations, loading of tables, CE
+#define PRB_ML_UART     12    //!< processing of UART, saving of parameters
+#define PRB_ML_MEAS     13    //!< averaging of measured values, discrete inputs
+#define PRB_ML_UNITS    14    //!< control of engine units
+#define PRB_ML_ADVANG   15    //!< calculation of advance angle, dwell, cutoff
+#define PRB_ML_INTG     16    //!< diagnostics, integrity checking, stack scanning (background work, not counted in CPU load)
+#define PRB_ML_STROKE   17    //!< operations performed for each stroke
+#define PRB_ML_LOOP     18    //!< whole pass of main loop (used for calculation of CPU load)
+#define PRB_NUMBER      19    //!< number of probes
+
+#define PRF_BINS         8    //!< number of bins of histogram (log2 of duration, bin 0: < 8us, bin 7: >= 512us)
+
+/**Statistics of single probe */
+typedef struct
+{
+ uint16_t cnt;                //!< number of samples (saturated, statistics is frozen when reached 65535)
+ uint16_t min;                //!< minimum duration in ticks of timer 1
+ uint16_t max;                //!< maximum duration in ticks of timer 1
+ uint32_t sum;                //!< sum of durations, used for calculation of mean value
+ uint8_t  hist[PRF_BINS];     //!< histogram of durations (saturated counters)
+}prf_probe_t;
+
+/**Starts measuring in the interrupt handler (place after local declarations) */
+#define PRF_ENTER() uint16_t prf_t0 = TCNT1
+
+/**Finishes measuring in the interrupt handler */
+#define PRF_LEAVE(probe) prf_put((probe), TCNT1 - prf_t0)
+
+/**Finishes measuring and leaves interrupt handler */
+#define PRF_RETURN(probe) {prf_put((probe), TCNT1 - prf_t0); return;}
+
+/**Finishes measuring of stage of main loop and starts measuring of the next one
+ * \param probe probe of finished stage
+ * \param t variable which holds time of beginning of stage
+ */
+#define PRF_STAGE(probe, t) {uint16_t _t1 = TCNT1; prf_put((probe), _t1 - (t)); (t) = _t1;}
+
+/**Initialization of module */
+void prf_init(void);
+
+/**Accumulates sample of duration. Can be called from interrupts
+ * \param probe number of probe
+ * \param ticks duration in ticks of timer 1
+ */
+void prf_put(uint8_t probe, uint16_t ticks);
+
+/**Takes statistics of next probe (round robin) and resets it. Must be called from main loop
+ * \param p_probe pointer to structure which will receive statistics
+ * \return number of probe
+ */
+uint8_t prf_take_next(prf_probe_t* p_probe);
+
+/**\return CPU load in percents (share of time when main loop was not idle) */
+uint8_t prf_get_load(void);
+
+#else //PROFILING
+
+#define PRF_ENTER()
+#define PRF_LEAVE(probe)
+#define PRF_RETURN(probe) return
+#define PRF_STAGE(probe, t)
+
+#endif //PROFILING
+
+#endif //_PROFILER_H_
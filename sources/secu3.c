@@ -36,7 +36,6 @@
 #include "ce_errors.h"
 #include "choke.h"
 #include "ckps.h"
-#include "crc16.h"
 #include "diagnost.h"
 #include "eeprom.h"
 #include "fuelecon.h"
@@ -46,14 +45,17 @@
 #include "jumper.h"
 #include "idlecon.h"
 #include "ignlogic.h"
+#include "integrity.h"
 #include "knklogic.h"
 #include "knock.h"
 #include "magnitude.h"
 #include "measure.h"
 #include "params.h"
 #include "procuart.h"
+#include "profiler.h"
 #include "pwrrelay.h"
 #include "secu3.h"
+#include "stackmon.h"
 #include "starter.h"
 #include "suspendop.h"
 #include "tables.h"
@@ -87,7 +89,8 @@ void control_engine_units(struct ecudata_t *d)
  fuelpump_control(d);
 #endif
 #ifdef IDL_REGUL
- if (idl_start_en) idlregul_control(d);
+ //idle air valve driver ( )
+ idlregul_control(d);
 #endif 
 
  //power management
@@ -104,19 +107,44 @@ void control_engine_units(struct ecudata_t *d)
  */
 void init_ecu_data(struct ecudata_t* d)
 {
+#ifdef TABLES_OVERLAY
+ uint8_t i, r;
+#endif
  edat.op_comp_code = 0;
  edat.op_actn_code = 0;
  edat.sens.inst_frq = 0;
  edat.curr_angle = 0;
  edat.knock_retard = 0;
  edat.ecuerrors_for_transfer = 0;
- edat.eeprom_parameters_cache = &eeprom_parameters_cache[0];
+ edat.eeprom_parameters_cache = &eeprom_parameters_cache[0]; //parameters begin journal's record
  edat.engine_mode = EM_START;
  edat.ce_state = 0;
 #ifdef REALTIME_TABLES
  edat.fn_gasoline_prev = 255;
  edat.fn_gas_prev = 255;
+ edat.tables_ram[0] = &edat.tables_pool[0];
+ edat.tables_ram[1] = &edat.tables_pool[1];
+ edat.tables_gen[0] = edat.tables_gen[1] = 0;
+ edat.tables_axes[0] = edat.tables_axes[1] = &fw_data.axes[0];
+#ifdef TABLES_OVERLAY
+ edat.tables_shd[0] = &edat.tables_pool[2];
+ edat.tables_shd[1] = &edat.tables_pool[3];
+ //all sets are empty overlays of the first set of tables from FLASH until selected sets are loaded
+ for(i = 0; i < 4; ++i)
+ {
+  edat.tables_pool[i].base = &fw_data.tables[0];
+  for(r = 0; r < TABLES_ROWS_NUMBER; ++r)
+   edat.tables_pool[i].slot[r] = TABLES_OVL_BASE;
+ }
+ edat.fn_ovl = edat.tables_ram[0];
+ edat.fn_dat = edat.fn_ovl->base;
+#else
+ edat.tables_shd = &edat.tables_pool[2];
+ edat.tables_shd_fuel = 0;
+ edat.fn_dat = edat.tables_ram[0];
+#endif
 #endif
+ edat.fn_axes = &fw_data.axes[0];
  edat.cool_fan = 0;
  edat.st_block = 0; //  
  edat.sens.tps = edat.sens.tps_raw = 0;
@@ -132,10 +160,25 @@ MAIN()
  uint8_t turnout_low_priority_errors_counter = 255;
  int16_t advance_angle_inhibitor_state = 0;
  retard_state_t retard_state;
+#ifdef PROFILING
+ uint16_t prf_t, prf_l;                //time of beginning of stage and of pass of main loop
+#endif
+#ifdef DEBUG_VARIABLES
+ uint8_t strt_tooth = 0, strt_codechk = 0;
+
+ //timer 1 is used for measuring of startup timings (clk/1024, 64us), it will be reconfigured by ckps_init_state()
+ TCCR1B = _BV(CS12)|_BV(CS10);
+#endif
+
+ //fill free memory of stack by pattern, it will be used for detecting of stack's usage
+ stkm_paint();
 
  //     
  init_ecu_data(&edat);
  knklogic_init(&retard_state);
+#ifdef PROFILING
+ prf_init();
+#endif
 
  //  /
  ckps_init_ports();
@@ -156,10 +199,12 @@ MAIN()
 #ifdef SM_CONTROL
  choke_init_ports();
 #endif
+#ifdef DEBUG_VARIABLES
+ edat.strt_times[STRT_PORTS] = TCNT1;
+#endif
 
- //    -  
- if (crc16f(0, CODE_SIZE)!=PGM_GET_WORD(&fw_data.code_crc))
-  ce_set_error(ECUERROR_PROGRAM_CODE_BROKEN);
+ //code of firmware will be checked in background, when engine is already running
+ intg_init();
 
  wdt_start_timer();
 
@@ -167,8 +212,12 @@ MAIN()
  load_eeprom_params(&edat);
 
 #ifdef REALTIME_TABLES
- //load currently selected tables into RAM
- load_selected_tables_into_ram(&edat);
+ //load currently selected tables into RAM (wait until all sets are loaded)
+ while(!load_selected_tables_into_ram(&edat) || !tables_loading_is_idle())
+  process_tables_loading(&edat);
+#endif
+#ifdef DEBUG_VARIABLES
+ edat.strt_times[STRT_PARAMS] = TCNT1;
 #endif
 
  //     
@@ -187,6 +236,9 @@ MAIN()
 
  //       
  meas_initial_measure(&edat);
+#ifdef DEBUG_VARIABLES
+ edat.strt_times[STRT_MEASURE] = TCNT1;
+#endif
 
  //  
  starter_set_blocking_state(0);
@@ -211,6 +263,10 @@ MAIN()
  choke_init();
 #endif
 
+#ifdef DEBUG_VARIABLES
+ edat.strt_times[STRT_LOOP] = TCNT1; //remaining initialization takes negligible time
+#endif
+
  //  
  ckps_init_state();
  ckps_set_cyl_number(edat.param.ckps_engine_cyl);
@@ -227,6 +283,7 @@ MAIN()
  ckps_use_knock_channel(edat.param.knock_use_knock_channel);
  ckps_set_cogs_btdc(edat.param.ckps_cogs_btdc); //<--now valid initialization
  ckps_set_merge_outs(edat.param.merge_ign_outs);
+ ckps_set_map_sampling(edat.param.map_samp_mode ? edat.param.map_samp_num : 0, edat.param.map_samp_offset);
 #ifdef HALL_OUTPUT
  ckps_set_hall_pulse(edat.param.hop_start_cogs, edat.param.hop_durat_cogs);
 #endif
@@ -241,11 +298,26 @@ MAIN()
  _ENABLE_INTERRUPT();
 
  sop_init_operations();
+#ifdef PROFILING
+ prf_t = prf_l = TCNT1;
+#endif
  //------------------------------------------------------------------------
  while(1)
  {
+  PRF_STAGE(PRB_ML_LOOP, prf_l);
+
   if (ckps_is_cog_changed())
+  {
    s_timer_set(engine_rotation_timeout_counter, ENGINE_ROTATION_TIMEOUT_VALUE);
+#ifdef DEBUG_VARIABLES
+   if (!strt_tooth)
+   { //first tooth has been accepted, all important startup timings are known now
+    edat.strt_times[STRT_TOOTH] = (uint16_t)s_timer_gtc();
+    sop_set_operation(SOP_SEND_STRTIM);
+    strt_tooth = 1;
+   }
+#endif
+  }
 
   if (s_timer_is_action(engine_rotation_timeout_counter))
   { //  (   )
@@ -299,20 +371,28 @@ MAIN()
   //---------- -----------------------------------------
   //  
   sop_execute_operations(&edat);
+#ifdef REALTIME_TABLES
+  //background loading of set of tables from EEPROM (     EEPROM)
+  process_tables_loading(&edat);
+#endif
   //     
   ce_check_engine(&edat, &ce_control_time_counter);
+  PRF_STAGE(PRB_ML_SOP, prf_t);
   // /   
   process_uart_interface(&edat);
   //  
   save_param_if_need(&edat);
+  PRF_STAGE(PRB_ML_UART, prf_t);
   //    
   edat.sens.inst_frq = ckps_calculate_instant_freq();
   //      
   meas_average_measured_values(&edat);
   //c       
   meas_take_discrete_inputs(&edat);
+  PRF_STAGE(PRB_ML_MEAS, prf_t);
   // 
   control_engine_units(&edat);
+  PRF_STAGE(PRB_ML_UNITS, prf_t);
   //   (  -   )
   calc_adv_ang = advance_angle_state_machine(&edat);
   //   -
@@ -332,10 +412,23 @@ MAIN()
    ckps_enable_ignition(edat.sens.inst_frq < edat.param.ign_cutoff_thrd);
   else
    ckps_enable_ignition(1);
+  PRF_STAGE(PRB_ML_ADVANG, prf_t);
 
 #ifdef DIAGNOSTICS
   diagnost_process(&edat);
 #endif
+  //background checking of integrity of firmware, parameters and tables
+  intg_process(&edat);
+  //checking of stack's usage
+  stkm_scan();
+#ifdef DEBUG_VARIABLES
+  if (!strt_codechk && intg_is_code_checked())
+  {
+   edat.strt_times[STRT_CODECHK] = (uint16_t)s_timer_gtc();
+   strt_codechk = 1;
+  }
+#endif
+  PRF_STAGE(PRB_ML_INTG, prf_t);
   //------------------------------------------------------------------------
 
   //         .
@@ -380,6 +473,7 @@ MAIN()
   }
 
   wdt_reset_timer();
+  PRF_STAGE(PRB_ML_STROKE, prf_t);
  }//main loop
  //------------------------------------------------------------------------
 }
@@ -33,8 +33,21 @@
 #define SAVE_PARAM_TIMEOUT_VALUE      3000  //!< timeout value used to count time before automatic saving of parameters
 #define FORCE_MEASURE_TIMEOUT_VALUE   20    //!< timeout value used to perform measurements when engine is stopped
 #define CE_CONTROL_STATE_TIME_VALUE   50    //!< used for CE (flashing)
+#define CE_CHECK_TIME_VALUE           2     //!< period of checking and debouncing of errors (20ms)
 #define ENGINE_ROTATION_TIMEOUT_VALUE 20    //!< timeout value used to determine that engine is stopped (this value must not exceed 25)
-#define IDLE_PERIOD_TIME_VALUE        50    //!< used by idling regulator
+#define IDLE_PERIOD_TIME_VALUE        10    //!< period of idling regulator (100ms), several steps per averaging window of RPM (16 strokes, 600ms at idling)
+
+#ifdef DEBUG_VARIABLES
+//Indexes of startup timings (see ecudata_t::strt_times). First four values are counted from entering main() in
+//ticks of 64us, the rest are counted from entering main loop in ticks of 10ms.
+#define STRT_PORTS                    0     //!< I/O ports have been configured
+#define STRT_PARAMS                   1     //!< parameters and tables have been loaded
+#define STRT_MEASURE                  2     //!< initial measurements have been completed
+#define STRT_LOOP                     3     //!< main loop is about to be entered (CKP sensor's module is being initialized)
+#define STRT_TOOTH                    4     //!< first tooth of CKP sensor has been accepted
+#define STRT_CODECHK                  5     //!< background check of firmware has been completed
+#define STRT_NUMBER                   6     //!< number of startup timings
+#endif
 
 #ifdef DIAGNOSTICS
 /**Describes diagnostics inputs data */
@@ -58,6 +71,7 @@ typedef struct diagnost_inp_t
 typedef struct sensors_t
 {
  uint16_t map;                           //!< Input Manifold Pressure (    ())
+ uint16_t baro;                          //!< Barometric pressure, measured at key-on and refreshed at WOT ( )
  uint16_t voltage;                       //!< Board voltage (   ())
  int16_t  temperat;                      //!< Coolant temperature (   ())
  uint16_t frequen;                       //!< Averaged RPM (   ())
@@ -106,12 +120,29 @@ typedef struct ecudata_t
 
 #ifndef REALTIME_TABLES
  f_data_t _PGM *fn_dat;                  //!< Pointer to the set of tables (   )
+#elif defined(TABLES_OVERLAY)
+ tables_ovl_t tables_pool[4];            //!< pool of sets of tables (overlays): active and shadow sets for each type of fuel
+ tables_ovl_t* tables_ram[2];            //!< pointers to active sets of tables (from pool) used for petrol(0) and gas(1)
+ tables_ovl_t* tables_shd[2];            //!< pointers to shadow sets of tables (from pool), receive edits and loaded data
+ uint8_t  tables_ovl[TABLES_OVL_ROWS][TABLES_ROW_SIZE]; //!< pool of rows which replace rows of base sets of tables
+ uint8_t  tables_gen[2];                 //!< generation counters of active sets of tables, incremented on each commit (used to invalidate caches)
+ f_axes_t _PGM *tables_axes[2];          //!< pointers to axes (in the FLASH) of active sets of tables used for petrol(0) and gas(1)
+ f_data_t _PGM *fn_dat;                  //!< pointer to base set of current set of tables (in the FLASH)
+ tables_ovl_t* fn_ovl;                   //!< pointer to current set of tables
+ uint8_t  fn_gas_prev;                   //!< previous index of tables set used for gas
+ uint8_t  fn_gasoline_prev;              //!< previous index of tables set used for petrol
 #else
- f_data_t tables_ram[2];                 //!< set of tables in RAM for petrol(0) and gas(1)
+ f_data_t tables_pool[3];                //!< pool of sets of tables in RAM: active set for each type of fuel and one shared shadow set
+ f_data_t* tables_ram[2];                //!< pointers to active sets of tables in RAM (from pool) used for petrol(0) and gas(1)
+ f_data_t* tables_shd;                   //!< pointer to shadow set of tables in RAM (from pool), receives edits and loaded data
+ uint8_t  tables_shd_fuel;               //!< type of fuel which shadow set of tables currently belongs to
+ uint8_t  tables_gen[2];                 //!< generation counters of active sets of tables, incremented on each commit (used to invalidate caches)
+ f_axes_t _PGM *tables_axes[2];          //!< pointers to axes (in the FLASH) of active sets of tables used for petrol(0) and gas(1)
  f_data_t* fn_dat;                       //!< pointer to current set of tables in RAM
  uint8_t  fn_gas_prev;                   //!< previous index of tables set used for gas
  uint8_t  fn_gasoline_prev;              //!< previous index of tables set used for petrol
 #endif
+ f_axes_t _PGM *fn_axes;                 //!< pointer to axes of current set of tables (always in the FLASH)
 
  uint16_t op_comp_code;                  //!< Contains code of operation for packet being sent - OP_COMP_NC (     UART ( OP_COMP_NC))
  uint16_t op_actn_code;                  //!< Contains code of operation for packet being received - OP_COMP_NC (     UART ( OP_COMP_NC))
@@ -130,6 +161,10 @@ typedef struct ecudata_t
 #endif
 
  uint8_t choke_testing;                  //!< Use to indcated that choke testing if on/off (so it is applicable only if SM_CONTROL compile option is used)
+
+#ifdef DEBUG_VARIABLES
+ uint16_t strt_times[STRT_NUMBER];       //!< startup timings, used to tune startup (see STRT_xxx)
+#endif
 }ecudata_t;
 
 extern struct ecudata_t edat;
@@ -26,18 +26,76 @@
 
 #ifdef SM_CONTROL
 
+#include "port/avrio.h"
 #include "port/interrupt.h"
 #include "port/intrinsic.h"
 #include "port/port.h"
 #include "ioconfig.h"
+#include "profiler.h"
 #include "smcontrol.h"
 #include "tables.h"
 
+#ifdef SM_HWSTEP
+
+/**Frequency of timer 1 clock (4us tick) */
+#define SM_TIMER_FREQ   250000UL
+
+/**Width of the step pulse in timer's ticks (20us) */
+#define SM_PULSE_TICKS  5
+
+/**Minimum distance in timer's ticks between current time and next compare event. Used when
+ * calculated time of the next step is already passed */
+#define SM_MIN_TICKS    8
+
+/**Limit for the index of ramp's step, so 4*n+1 always fits into 16 bits */
+#define SM_RAMP_N_MAX   16000
+
+/**Describes parameters of the velocity profile, prepared for use in the interrupt */
+typedef struct
+{
+ uint16_t c0;             //!< step interval corresponding to the start rate, timer's ticks
+ uint16_t cmin;           //!< step interval corresponding to the maximum rate, timer's ticks
+ uint16_t n0;             //!< index of the ramp's step corresponding to the start rate
+}sm_prof_t;
+
+/**Describes state of the step generator */
+typedef struct
+{
+ uint16_t steps;          //!< number of steps remaining in the current motion
+ uint16_t n;              //!< index of current step on the acceleration ramp
+ uint16_t c;              //!< current step interval, timer's ticks
+ uint16_t rest;           //!< remainder of the ramp's division, keeps acceleration precise
+ uint16_t t_step;         //!< time (TCNT1) of the beginning of current step
+ uint8_t dir;             //!< direction of the current motion
+ uint8_t pulse;           //!< 1 - step pulse is active at the moment
+ volatile uint8_t run;    //!< 1 - generator is running (compare interrupt is enabled)
+}sm_gen_t;
+
+/**Profile parameters used by the step generator */
+sm_prof_t sm_prof;
+
+/**State variables of the step generator */
+sm_gen_t sm_gen = {0};
+
+/**Requested number of steps, taken by generator at the beginning of next step */
+volatile uint16_t sm_steps = 0;
+/**Set to 1 when new request is pending */
+volatile uint8_t sm_latch = 0;
+
+#else //legacy generator clocked from the system timer (see vstimer.c)
+
 volatile uint16_t sm_steps = 0;
 volatile uint8_t sm_latch = 0;
 uint16_t sm_steps_b = 0;
 uint8_t sm_pulse_state = 0;
 
+#endif
+
+/**Requested direction (applied when motor is stopped if SM_HWSTEP is used) */
+volatile uint8_t sm_dir = SM_DIR_CW;
+/**Current position: counts steps, CCW steps increment it and CW steps decrement it */
+volatile int16_t sm_pos = 0;
+
 void stpmot_init_ports(void)
 {
  IOCFG_INIT(IOP_SM_DIR, SM_DIR_CW);
@@ -46,14 +104,54 @@ void stpmot_init_ports(void)
 
 void stpmot_init(void)
 {
- //todo
+ stpmot_set_profile(SM_START_RATE, SM_ACCELERATION, SM_MAX_RATE);
+}
+
+void stpmot_set_profile(uint16_t start_rate, uint16_t accel, uint16_t max_rate)
+{
+#ifdef SM_HWSTEP
+ sm_prof_t prof;
+ uint16_t accel_min;
+
+ if (start_rate < SM_RATE_MIN)
+  start_rate = SM_RATE_MIN;
+ if (start_rate > SM_RATE_MAX)
+  start_rate = SM_RATE_MAX;
+ if (max_rate > SM_RATE_MAX)
+  max_rate = SM_RATE_MAX;
+ if (max_rate < start_rate)
+  max_rate = start_rate;
+
+ //acceleration must be high enough to reach maximum rate within SM_RAMP_N_MAX steps
+ accel_min = (((uint32_t)max_rate) * max_rate) / (2 * SM_RAMP_N_MAX) + 1;
+ if (accel < accel_min)
+  accel = accel_min;
+
+ prof.c0 = SM_TIMER_FREQ / start_rate;
+ prof.cmin = SM_TIMER_FREQ / max_rate;
+ //number of steps required to accelerate from zero to the start rate: n0 = v0^2 / (2 * a)
+ prof.n0 = (((uint32_t)start_rate) * start_rate) / (((uint32_t)accel) * 2);
+
+ _BEGIN_ATOMIC_BLOCK();
+ sm_prof = prof;
+ _END_ATOMIC_BLOCK();
+#else
+ (void)start_rate; (void)accel; (void)max_rate; //constant rate, see vstimer.c
+#endif
 }
 
 void stpmot_dir(uint8_t dir)
 {
+#ifdef SM_HWSTEP
+ //Direction is applied by the step generator when motor is stopped. If motor is moving in opposite
+ //direction, then generator will decelerate it first (see stpmot_run())
+ sm_dir = dir;
+#else
  //Speaking about L297, CW/~CCW input synchronized internally therefore
  //direction can be changed at any time
  IOCFG_SET(IOP_SM_DIR, dir);
+ sm_dir = dir;
+#endif
 }
 
 void stpmot_run(uint16_t steps)
@@ -61,11 +159,26 @@ void stpmot_run(uint16_t steps)
  _DISABLE_INTERRUPT();
   sm_steps = steps;
   sm_latch = 1;
+#ifdef SM_HWSTEP
+  if (!sm_gen.run)
+  {//start generator, first step will begin shortly
+   sm_gen.run = 1;
+   sm_gen.pulse = 0;
+   sm_gen.steps = 0;
+   sm_gen.t_step = TCNT1 + SM_MIN_TICKS;
+   OCR1B = sm_gen.t_step;
+   TIFR = _BV(OCF1B);
+   TIMSK|= _BV(OCIE1B);
+  }
+#endif
  _ENABLE_INTERRUPT();
 }
 
 uint8_t stpmot_is_busy(void)
 {
+#ifdef SM_HWSTEP
+ return sm_gen.run; //busy?
+#else
  uint16_t current;
  uint8_t latching;
  _DISABLE_INTERRUPT();
@@ -73,6 +186,138 @@ uint8_t stpmot_is_busy(void)
  latching = sm_latch;
  _ENABLE_INTERRUPT();
  return (current > 0 || latching); //busy?
+#endif
+}
+
+int16_t stpmot_get_pos(void)
+{
+ int16_t pos;
+ _BEGIN_ATOMIC_BLOCK();
+ pos = sm_pos;
+ _END_ATOMIC_BLOCK();
+ return pos;
+}
+
+#ifdef SM_HWSTEP
+/**Calculates interval of the next step. Uses incremental approximation of the constant acceleration
+ * profile (c[n] = c[n-1] - 2*c[n-1]/(4*n+1)), so only one division is required per step.
+ * Deceleration begins when number of remaining steps becomes equal to number of steps done
+ * on the acceleration ramp.
+ */
+static void sm_next_interval(void)
+{
+ uint32_t q;
+ uint16_t den;
+
+ if (sm_gen.steps <= (sm_gen.n - sm_prof.n0))
+ {//deceleration: c[n-1] = c[n] + 2*c[n]/(4*n-1)
+  if (sm_gen.n > sm_prof.n0)
+  {
+   den = (sm_gen.n << 2) - 1;
+   sm_gen.c+= (((uint32_t)sm_gen.c) << 1) / den;
+   --sm_gen.n;
+  }
+  sm_gen.rest = 0;
+ }
+ else if (sm_gen.c > sm_prof.cmin && sm_gen.n < SM_RAMP_N_MAX)
+ {//acceleration
+  ++sm_gen.n;
+  den = (sm_gen.n << 2) + 1;
+  q = (((uint32_t)sm_gen.c) << 1) + sm_gen.rest;
+  sm_gen.c-= q / den;
+  sm_gen.rest = q % den;
+  if (sm_gen.c < sm_prof.cmin)
+   sm_gen.c = sm_prof.cmin;
+ }
+ //otherwise motor runs at maximum rate
 }
 
+/**Interrupt handler for Compare/Match channel B of timer T1. Used as step generator.
+ * Each step takes two interrupts: the first one begins step pulse and the second one ends it
+ * (the step occurs on the rising edge of ~CLOCK signal) and schedules the next step.
+ */
+ISR(TIMER1_COMPB_vect)
+{
+ uint16_t t;
+ PRF_ENTER();
+
+ if (sm_gen.pulse)
+ {//end of the step pulse
+  IOCFG_SET(IOP_SM_STP, 0); //rising edge
+  sm_gen.pulse = 0;
+  --sm_gen.steps;
+  sm_pos+= (sm_gen.dir == SM_DIR_CCW) ? 1 : -1;
+
+  //Calculation involves division, so we allow other interrupts (ignition timing is more important)
+  TIMSK&= ~_BV(OCIE1B);
+  _ENABLE_INTERRUPT();
+  sm_next_interval();
+  _DISABLE_INTERRUPT();
+
+  t = sm_gen.t_step + sm_gen.c;
+  if ((int16_t)(t - TCNT1) < SM_MIN_TICKS)
+   t = TCNT1 + SM_MIN_TICKS;  //we are late
+  sm_gen.t_step = t;
+  OCR1B = t;
+  TIFR = _BV(OCF1B);
+  TIMSK|= _BV(OCIE1B);
+  PRF_RETURN(PRB_T1COMPB);
+ }
+
+ //beginning of the next step, process new request if any
+ if (sm_latch)
+ {
+  if (sm_gen.steps && sm_gen.dir != sm_dir)
+  {//reversal: decelerate to the start rate, request will be taken when motor stops
+   uint16_t dec = sm_gen.n - sm_prof.n0;
+   if (sm_gen.steps > dec)
+    sm_gen.steps = dec;
+  }
+
+  if (!sm_gen.steps)
+  {//motor is stopped, start new motion from the start rate
+   sm_gen.dir = sm_dir;
+   IOCFG_SET(IOP_SM_DIR, sm_gen.dir);
+   sm_gen.n = sm_prof.n0;
+   sm_gen.c = sm_prof.c0;
+   sm_gen.rest = 0;
+   sm_gen.steps = sm_steps;
+   sm_latch = 0;
+  }
+  else if (sm_gen.dir == sm_dir)
+  {//retarget in the same direction, profile continues from current rate
+   uint16_t dec = sm_gen.n - sm_prof.n0;
+   if (sm_steps >= dec)
+   {
+    sm_gen.steps = sm_steps;
+    sm_latch = 0;
+   }
+   else
+   {//target is nearer than deceleration distance: decelerate past it, then run back (request stays pending)
+    sm_gen.steps = dec;
+    sm_steps = dec - sm_steps;
+    sm_dir = (sm_dir == SM_DIR_CW) ? SM_DIR_CCW : SM_DIR_CW;
+   }
+  }
+ }
+
+ if (!sm_gen.steps)
+ {//motion is finished, stop generator
+  TIMSK&= ~_BV(OCIE1B);
+  sm_gen.run = 0;
+  PRF_RETURN(PRB_T1COMPB);
+ }
+
+ IOCFG_SET(IOP_SM_STP, 1); //falling edge
+ sm_gen.pulse = 1;
+ //Entry of this interrupt may be delayed by other interrupts for longer than the pulse, then compare
+ //would be missed and the motor would stall for the whole period of timer (262ms)
+ t = sm_gen.t_step + SM_PULSE_TICKS;
+ if ((int16_t)(t - TCNT1) < SM_MIN_TICKS)
+  t = TCNT1 + SM_MIN_TICKS;
+ OCR1B = t;
+ PRF_LEAVE(PRB_T1COMPB);
+}
+#endif
+
 #endif
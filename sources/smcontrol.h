@@ -31,24 +31,58 @@
 
 #include <stdint.h>
 
+#ifndef DWELL_CONTROL
+/** Step pulses are generated by compare channel B of timer 1 using trapezoidal velocity profile.
+ * This channel is used for dwell control, so in this case motor is clocked from system timer
+ * at the constant rate (see vstimer.c) */
+#define SM_HWSTEP
+#endif
+
+/** Default start rate, steps per second ( ,   ) */
+#define SM_START_RATE   250
+
+/** Default acceleration, steps per second^2 (,   ^2) */
+#define SM_ACCELERATION 2500
+
+/** Default maximum rate, steps per second ( ,   ) */
+#define SM_MAX_RATE     1000
+
+/** Minimum allowed rate, steps per second */
+#define SM_RATE_MIN     16
+
+/** Maximum allowed rate, steps per second */
+#define SM_RATE_MAX     2000
+
 /** Initialization of used I/O ports (  ) */
 void stpmot_init_ports(void);
 
 /** Initialization of the module */
 void stpmot_init(void);
 
+/** Set parameters of the velocity profile. Motor starts at the start rate, accelerates up to the
+ * maximum rate and decelerates back to the start rate before the end of motion. Values are
+ * restricted to SM_RATE_MIN...SM_RATE_MAX range.
+ * \param start_rate Start rate, steps per second
+ * \param accel Acceleration, steps per second^2
+ * \param max_rate Maximum rate, steps per second
+ */
+void stpmot_set_profile(uint16_t start_rate, uint16_t accel, uint16_t max_rate);
+
 /** ID of the clockwise direction (   ) */
 #define SM_DIR_CW   0
 
 /** ID of the counterclockwise direction (   ) */
 #define SM_DIR_CCW  1
 
-/** Set stepper motor direction
+/** Set stepper motor direction. Takes effect with the next call of stpmot_run()
  * \param dir Direction (0 - backward, 1 - forward)
  */
 void stpmot_dir(uint8_t dir);
 
-/** Run stepper motor using specified number of steps
+/** Run stepper motor using specified number of steps. May be called while motor is running:
+ * in the same direction remaining number of steps is replaced by specified one (if it is less than
+ * deceleration distance, then motor decelerates past the target and runs back), in the opposite
+ * direction motor decelerates, stops and then runs back. So steps are never lost.
  * \param steps Number of steps to run. Use 0 if you want to stop
  * the stepper motor.
  */
@@ -59,6 +93,12 @@ void stpmot_run(uint16_t steps);
  */
 uint8_t stpmot_is_busy(void);
 
+/**Get current position of stepper motor. Position is counted by step generator: steps in CCW
+ * direction increment it and steps in CW direction decrement it. Valid while motor is moving.
+ * \return current position in steps (relative to position at the moment of power-on)
+ */
+int16_t stpmot_get_pos(void);
+
 #endif
 
 #endif //_SMCONTROL_H_
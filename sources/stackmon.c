@@ -0,0 +1,138 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file stackmon.c
+ * Implementation of monitoring of stack usage.
+ * (   ).
+ */
+
+#include "port/avrio.h"
+#include "port/port.h"
+#include <stdint.h>
+#include "ce_errors.h"
+#include "stackmon.h"
+
+/**Pattern used for painting of free memory of stack */
+#define STKM_PATTERN      0xC5
+
+/**Number of bytes below current stack pointer which are not painted (used by stkm_paint() itself) */
+#define STKM_GUARD        16
+
+/**Number of bytes checked per one call of stkm_scan() */
+#define STKM_SCAN_CHUNK   16
+
+#ifdef __ICCAVR__
+ #pragma segment="CSTACK"
+ #pragma segment="RSTACK"
+#elif defined(SECU3_HOST)
+ static uint8_t host_stack[64]; //!< host build (see tools/hostsim) has no stack of AVR, dummy region is monitored
+#else
+ extern uint8_t __heap_start;  //!< end of static data, defined by linker (avr-libc)
+#endif
+
+/**Describes state of one stack */
+typedef struct
+{
+ uint8_t* bottom;            //!< the lowest address of stack's memory
+ uint8_t* top;               //!< address after the highest address of stack's memory
+ uint8_t* lowest;            //!< the lowest address which has been used (high-water mark)
+ uint8_t* scan;              //!< address of the next byte to be checked
+}stkm_region_t;
+
+/**State variables */
+static stkm_region_t stkm[STKM_REGIONS];
+
+/**\return current value of hardware stack pointer */
+#define STKM_GET_SP() ((uint8_t*)((((uint16_t)SPH) << 8) | SPL))
+
+/**Paints memory of stack from its bottom to the specified address (not inclusive)
+ * \param p_rg pointer to stack's description
+ * \param p_cur current stack pointer of this stack
+ */
+static void paint_region(stkm_region_t* p_rg, uint8_t* p_cur)
+{
+ uint8_t* p = p_rg->bottom;
+ p_cur-= STKM_GUARD;
+ while(p < p_cur)
+  *p++ = STKM_PATTERN;
+ p_rg->lowest = p;
+ p_rg->scan = p_rg->bottom;
+}
+
+void stkm_paint(void)
+{
+ uint8_t marker = 0; //local variable, its address is near to the current pointer of data stack
+#ifdef __ICCAVR__
+ stkm[0].bottom = (uint8_t*)__segment_begin("CSTACK");
+ stkm[0].top = (uint8_t*)__segment_end("CSTACK");
+ paint_region(&stkm[0], &marker);
+ stkm[1].bottom = (uint8_t*)__segment_begin("RSTACK");
+ stkm[1].top = (uint8_t*)__segment_end("RSTACK");
+ paint_region(&stkm[1], STKM_GET_SP());
+#elif defined(SECU3_HOST)
+ stkm[0].bottom = host_stack;
+ stkm[0].top = host_stack + sizeof(host_stack);
+ paint_region(&stkm[0], stkm[0].top);
+ (void)marker;
+#else
+ stkm[0].bottom = &__heap_start;
+ stkm[0].top = (uint8_t*)(RAMEND + 1);
+ paint_region(&stkm[0], STKM_GET_SP());
+ (void)marker;
+#endif
+}
+
+void stkm_scan(void)
+{
+ uint8_t i = 0, n;
+ for(; i < STKM_REGIONS; ++i)
+ {
+  stkm_region_t* p_rg = &stkm[i];
+  //Search for the lowest byte which has been changed. Scanning goes from the bottom, so
+  //unused holes inside stack frames (e.g. not written arrays) do not hide deeper usage.
+  for(n = STKM_SCAN_CHUNK; n && p_rg->scan < p_rg->lowest; --n, ++p_rg->scan)
+  {
+   if (*p_rg->scan != STKM_PATTERN)
+   {
+    p_rg->lowest = p_rg->scan;
+    break;
+   }
+  }
+
+  if (p_rg->scan >= p_rg->lowest)
+  { //whole painted memory has been checked, begin again
+   p_rg->scan = p_rg->bottom;
+   if ((uint16_t)(p_rg->lowest - p_rg->bottom) < STKM_MIN_FREE)
+    ce_set_error(ECUERROR_STACK_LOW);
+  }
+ }
+}
+
+uint16_t stkm_get_free(uint8_t region)
+{
+ return stkm[region].lowest - stkm[region].bottom;
+}
+
+uint16_t stkm_get_depth(uint8_t region)
+{
+ return stkm[region].top - stkm[region].lowest;
+}
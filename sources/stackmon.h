@@ -0,0 +1,60 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file stackmon.h
+ * Monitoring of stack usage. Free memory of stack is painted by pattern at startup and then it is
+ * scanned in background to find the lowest address which has been used (high-water mark of stack).
+ * Static RAM used by each module is reported at build time by tools/ramreport.py.
+ * (  .         
+ *         ).
+ */
+
+#ifndef _STACKMON_H_
+#define _STACKMON_H_
+
+#include <stdint.h>
+
+#ifdef __ICCAVR__
+ #define STKM_REGIONS     2   //!< number of stacks: data stack (CSTACK) and return stack (RSTACK)
+#else
+ #define STKM_REGIONS     1   //!< number of stacks: single stack growing down from the end of RAM
+#endif
+
+/**CE error (ECUERROR_STACK_LOW) is set when free memory of any stack becomes less than this number of bytes */
+#define STKM_MIN_FREE     32
+
+/**Paints free memory of stack(s). Must be called at the very beginning of main(), when interrupts are disabled */
+void stkm_paint(void);
+
+/**Checks next small portion of painted memory (takes a few microseconds). Must be called from main loop */
+void stkm_scan(void);
+
+/**\param region index of stack (0...STKM_REGIONS-1)
+ * \return number of bytes of stack which have never been used (worst case) */
+uint16_t stkm_get_free(uint8_t region);
+
+/**\param region index of stack (0...STKM_REGIONS-1)
+ * \return the worst observed depth of stack in bytes. For single stack (AVR GCC) it includes space
+ * between static data and the end of RAM which is used by main() itself */
+uint16_t stkm_get_depth(uint8_t region);
+
+#endif //_STACKMON_H_
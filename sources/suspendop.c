@@ -28,8 +28,8 @@
 #include <string.h>
 #include "bitmask.h"
 #include "ce_errors.h"
-#include "crc16.h"
 #include "eeprom.h"
+#include "ejournal.h"
 #include "params.h"
 #include "secu3.h"
 #include "suspendop.h"
@@ -38,11 +38,19 @@
 #include "wdt.h"
 
 /**Maximum allowed number of suspended operations */
-#define SUSPENDED_OPERATIONS_SIZE 16
+#define SUSPENDED_OPERATIONS_SIZE 24
 
 /**Contains queue of suspended operations. Each operation can appear one time */
 uint8_t suspended_opcodes[SUSPENDED_OPERATIONS_SIZE];
 
+/**Number of bytes actually programmed during the last saving of parameters (saturated to 255) */
+uint8_t param_save_wr_count = 0;
+
+#ifdef REALTIME_TABLES
+/**Type of fuel for which changes in shadow set of tables have been committed last time */
+uint8_t tablset_commit_fuel = 0;
+#endif
+
 /*#pragma inline*/
 void sop_set_operation(uint8_t opcode)
 {
@@ -70,9 +78,10 @@ void sop_execute_operations(struct ecudata_t* d)
   if (eeprom_is_idle())
   {
    //               EEPROM.
+   //     ,   (params_t::crc)    .
+   //Record will be written into the next slot of journal, CRC (params_t::crc) will be calculated there too.
    memcpy(d->eeprom_parameters_cache,&d->param,sizeof(params_t));
-   ((params_t*)d->eeprom_parameters_cache)->crc=crc16(d->eeprom_parameters_cache,sizeof(params_t)-PAR_CRC_SIZE); //  
-   eeprom_start_wr_data(OPCODE_EEPROM_PARAM_SAVE, EEPROM_PARAM_START, d->eeprom_parameters_cache, sizeof(params_t));
+   ej_write(EJ_PARAMS, OPCODE_EEPROM_PARAM_SAVE, d->eeprom_parameters_cache);
 
    //   ,         EEPROM 
    //      
@@ -103,6 +112,7 @@ void sop_execute_operations(struct ecudata_t* d)
   if (!uart_is_sender_busy())
   {
    _AB(d->op_comp_code, 0) = OPCODE_EEPROM_PARAM_SAVE;
+   _AB(d->op_comp_code, 1) = param_save_wr_count; //number of bytes written into EEPROM
    uart_send_packet(d, OP_COMP_NC);    //    
 
    //""         .
@@ -121,12 +131,46 @@ void sop_execute_operations(struct ecudata_t* d)
   }
  }
 
+ if (sop_is_operation_active(SOP_SAVE_CE_FRAMES))
+ {
+  //Freeze frames are saved lazily, one frame each time when EEPROM becomes idle
+  if (eeprom_is_idle())
+  {
+   if (!ce_save_frames())
+    suspended_opcodes[SOP_SAVE_CE_FRAMES] = SOP_NA; //all frames have been saved
+  }
+ }
+
+ if (sop_is_operation_active(SOP_READ_CE_LOG))
+ {
+  //wait until captured frames will be saved, so transferred log will be complete
+  if (eeprom_is_idle() && !sop_is_operation_active(SOP_SAVE_CE_FRAMES))
+  {
+   ce_read_log_frame();
+   sop_set_operation(SOP_TRANSMIT_CE_LOG);
+   suspended_opcodes[SOP_READ_CE_LOG] = SOP_NA;
+  }
+ }
+
+ if (sop_is_operation_active(SOP_TRANSMIT_CE_LOG))
+ {
+  // ?
+  if (!uart_is_sender_busy())
+  {
+   uart_send_packet(d, CE_LOG_DAT);    //    
+   suspended_opcodes[SOP_TRANSMIT_CE_LOG] = SOP_NA;
+   if (ce_next_log_frame())
+    sop_set_operation(SOP_READ_CE_LOG); //read next record
+  }
+ }
+
  if (sop_is_operation_active(SOP_SEND_NC_CE_ERRORS_SAVED))
  {
   // ?
   if (!uart_is_sender_busy())
   {
    _AB(d->op_comp_code, 0) = OPCODE_CE_SAVE_ERRORS;
+   _AB(d->op_comp_code, 1) = 0; //not used
    uart_send_packet(d, OP_COMP_NC);    //    
 
    //""         .
@@ -138,7 +182,7 @@ void sop_execute_operations(struct ecudata_t* d)
  {
   if (eeprom_is_idle())
   {
-   eeprom_read(&d->ecuerrors_saved_transfer, EEPROM_ECUERRORS_START, sizeof(uint16_t));
+   d->ecuerrors_saved_transfer = ce_read_saved_errors();
    sop_set_operation(SOP_TRANSMIT_CE_ERRORS);
    //""         .
    suspended_opcodes[SOP_READ_CE_ERRORS] = SOP_NA;
@@ -187,12 +231,10 @@ void sop_execute_operations(struct ecudata_t* d)
 
  if (sop_is_operation_active(SOP_SELECT_TABLSET))
  {
-  if (eeprom_is_idle())
-  {
-   load_selected_tables_into_ram(d);
-   //""         .
+  //""           .
+  //"delete" this operation from list only when loading of all sets of tables has been started
+  if (load_selected_tables_into_ram(d))
    suspended_opcodes[SOP_SELECT_TABLSET] = SOP_NA;
-  }
  }
 
  if (sop_is_operation_active(SOP_LOAD_TABLSET))
@@ -205,9 +247,9 @@ void sop_execute_operations(struct ecudata_t* d)
    // bbbb - index of tables set to save to, begins from FLASH's indexes
    uint8_t index = (_AB(d->op_actn_code, 1) & 0xF);
    uint8_t fuel_type = (_AB(d->op_actn_code, 1) >> 4);
-   load_specified_tables_into_ram(d, fuel_type, index);
-   //""         .
-   suspended_opcodes[SOP_LOAD_TABLSET] = SOP_NA;
+   //""         (  ).
+   if (load_specified_tables_into_ram(d, fuel_type, index))
+    suspended_opcodes[SOP_LOAD_TABLSET] = SOP_NA;
   }
  }
 
@@ -228,20 +270,80 @@ void sop_execute_operations(struct ecudata_t* d)
  if (sop_is_operation_active(SOP_SAVE_TABLSET))
  {
   //TODO: d->op_actn_code may become overwritten while we are waiting here...
-  if (eeprom_is_idle())
+  //active set of tables must not be changed by loading while it is being written
+  if (eeprom_is_idle() && tables_loading_is_idle())
   {
    //bits: aaaabbbb
    // aaaa - fuel type (0, 1)
    // bbbb - index of tables set to save to, begins from FLASH's indexes
-   uint8_t index = (_AB(d->op_actn_code, 1) & 0xF) - TABLES_NUMBER;
+   uint8_t index = (_AB(d->op_actn_code, 1) & 0xF);
    uint8_t fuel_type = (_AB(d->op_actn_code, 1) >> 4);
-   eeprom_start_wr_data(OPCODE_SAVE_TABLSET, EEPROM_REALTIME_TABLES_START + sizeof(f_data_t) * index, &d->tables_ram[fuel_type], sizeof(f_data_t));
+   //only dirty rows of active set will be written
+   save_dirty_tables(d, fuel_type, index);
 
    //""         .
    suspended_opcodes[SOP_SAVE_TABLSET] = SOP_NA;
   }
  }
 
+ if (sop_is_operation_active(SOP_COMMIT_TABLSET))
+ {
+  //active set of tables must not be changed while it is being written into EEPROM, also
+  //shadow set must not be committed while it is being loaded
+  if (eeprom_is_idle() && tables_loading_is_idle())
+  {
+   tablset_commit_fuel = _AB(d->op_actn_code, 1) & 0x1;
+   commit_edited_tables(d, tablset_commit_fuel);
+   sop_set_operation(SOP_SEND_NC_TABLSET_COMMITTED);
+
+   //"delete" this operation from list because it has already completed
+   suspended_opcodes[SOP_COMMIT_TABLSET] = SOP_NA;
+  }
+ }
+
+ if (sop_is_operation_active(SOP_SEND_NC_TABLSET_COMMITTED))
+ {
+  //Is sender busy ( )?
+  if (!uart_is_sender_busy())
+  {
+   _AB(d->op_comp_code, 0) = OPCODE_COMMIT_TABLSET;
+   _AB(d->op_comp_code, 1) = tablset_commit_fuel; //type of fuel
+   uart_send_packet(d, OP_COMP_NC);    //    
+
+   //"delete" this operation from list because it has already completed
+   suspended_opcodes[SOP_SEND_NC_TABLSET_COMMITTED] = SOP_NA;
+  }
+ }
+
+ if (sop_is_operation_active(SOP_SEND_TABLSET_BULK))
+ {
+  //rows are sent back-to-back, as soon as transmitter becomes free (EEPROM may be read)
+  if (!uart_is_sender_busy() && eeprom_is_idle())
+  {
+   uart_send_packet(d, EDITAB_BLK);    //    
+   if (!uart_bulk_is_active())
+   { //all rows have been sent, single acknowledgement will be sent after them
+    sop_set_operation(SOP_SEND_NC_TABLSET_BULK);
+    //"delete" this operation from list because it has already completed
+    suspended_opcodes[SOP_SEND_TABLSET_BULK] = SOP_NA;
+   }
+  }
+ }
+
+ if (sop_is_operation_active(SOP_SEND_NC_TABLSET_BULK))
+ {
+  //Is sender busy ( )?
+  if (!uart_is_sender_busy())
+  {
+   _AB(d->op_comp_code, 0) = OPCODE_BULK_TABLSET;
+   _AB(d->op_comp_code, 1) = uart_bulk_get_status(); //number of bad rows (0 - success)
+   uart_send_packet(d, OP_COMP_NC);    //    
+
+   //"delete" this operation from list because it has already completed
+   suspended_opcodes[SOP_SEND_NC_TABLSET_BULK] = SOP_NA;
+  }
+ }
+
 #endif
 
 #ifdef DEBUG_VARIABLES
@@ -255,6 +357,17 @@ void sop_execute_operations(struct ecudata_t* d)
    suspended_opcodes[SOP_DBGVAR_SENDING] = SOP_NA;
   }
  }
+
+ if (sop_is_operation_active(SOP_SEND_STRTIM))
+ {
+  //Is sender busy ( )?
+  if (!uart_is_sender_busy())
+  {
+   uart_send_packet(d, STRTIM_DAT);    //send packet with startup timings
+   //"delete" this operation from list because it has already completed
+   suspended_opcodes[SOP_SEND_STRTIM] = SOP_NA;
+  }
+ }
 #endif
 
 #ifdef DIAGNOSTICS
@@ -264,6 +377,7 @@ void sop_execute_operations(struct ecudata_t* d)
   if (!uart_is_sender_busy())
   {
    _AB(d->op_comp_code, 0) = OPCODE_DIAGNOST_ENTER;
+   _AB(d->op_comp_code, 1) = 0; //not used
    uart_send_packet(d, OP_COMP_NC);    //    
    //"delete" this operation from list because it has already completed
    suspended_opcodes[SOP_SEND_NC_ENTER_DIAG] = SOP_NA;
@@ -275,6 +389,7 @@ void sop_execute_operations(struct ecudata_t* d)
   if (!uart_is_sender_busy())
   {
    _AB(d->op_comp_code, 0) = OPCODE_DIAGNOST_LEAVE;
+   _AB(d->op_comp_code, 1) = 0; //not used
    uart_send_packet(d, OP_COMP_NC);    //    
    _DELAY_CYCLES(64000); //wait 20ms
    _DELAY_CYCLES(64000);
@@ -290,8 +405,12 @@ void sop_execute_operations(struct ecudata_t* d)
  switch(eeprom_take_completed_opcode()) //TODO: review assembler code -take!
  {
   case OPCODE_EEPROM_PARAM_SAVE:
+  {
+   uint16_t count = eeprom_get_written_count();
+   param_save_wr_count = (count > 255) ? 255 : count;
    sop_set_operation(SOP_SEND_NC_PARAMETERS_SAVED);
    break;
+  }
 
   case OPCODE_CE_SAVE_ERRORS:
    sop_set_operation(SOP_SEND_NC_CE_ERRORS_SAVED);
@@ -52,6 +52,18 @@
 #define SOP_SEND_NC_ENTER_DIAG      14    //!< notify that device has entered diagnostic mode
 #define SOP_SEND_NC_LEAVE_DIAG      15    //!< notify that device has left diagnostic mode
 #endif
+#ifdef REALTIME_TABLES
+#define SOP_COMMIT_TABLSET          16    //!< commit changes made in shadow set of tables
+#define SOP_SEND_NC_TABLSET_COMMITTED 17  //!< notify that changes in shadow set of tables have been committed
+#define SOP_SEND_TABLSET_BULK       18    //!< send set(s) of tables by bulk transfer
+#define SOP_SEND_NC_TABLSET_BULK    19    //!< notify that bulk transfer of set(s) of tables has been completed
+#endif
+#define SOP_SAVE_CE_FRAMES          20    //!< save captured freeze frames of CE errors into EEPROM log
+#define SOP_READ_CE_LOG             21    //!< read record of freeze frames log from EEPROM
+#define SOP_TRANSMIT_CE_LOG         22    //!< transmit record of freeze frames log
+#ifdef DEBUG_VARIABLES
+#define SOP_SEND_STRTIM             23    //!< send startup timings
+#endif
 
 //      0
 #define OPCODE_EEPROM_PARAM_SAVE     1    //!< save EEPROM parameters
@@ -65,6 +77,14 @@
 #define OPCODE_DIAGNOST_ENTER        6    //!< enter diagnostic mode
 #define OPCODE_DIAGNOST_LEAVE        7    //!< leave diagnostic mode
 #endif
+#ifdef REALTIME_TABLES
+#define OPCODE_COMMIT_TABLSET        8    //!< commit changes made in shadow set of tables for selected fuel or notify that it has been committed
+#define OPCODE_BULK_TABLSET          9    //!< start bulk sending of set(s) of tables or notify that bulk transfer has been completed
+#endif
+#define OPCODE_CE_READ_LOG          10    //!< read and transmit freeze frames log of CE errors
+#ifdef TRACE_CAPTURE
+#define OPCODE_TRACE_CAPTURE        11    //!< start (second byte = 1) or stop (second byte = 0) capturing of trace
+#endif
 struct ecudata_t;
 
 /**Set specified operation to execution queue (      )
@@ -61,6 +61,7 @@
 #define _TABLES_H_
 
 #include "port/pgmspace.h"
+#include <stddef.h>
 #include <stdint.h>
 #include "bootldr.h"   //to know value of SECU3BOOTSTART, and only
 
@@ -80,6 +81,24 @@
 #define COIL_ON_TIME_LOOKUP_TABLE_SIZE  32          //!< number of points in lookup table used for dwell control
 #define THERMISTOR_LOOKUP_TABLE_SIZE    16          //!< Size of lookup table for coolant temperature sensor
 #define CHOKE_CLOSING_LOOKUP_TABLE_SIZE 16          //!< Size of lookup table defining choke closing versus coolant temperature
+#define BARO_CORR_LOOKUP_TABLE_SIZE     6           //!< Size of lookup table defining advance angle correction versus barometric pressure
+
+
+//Sources of load for the work map (    )
+#define LOAD_SRC_MAP           0                    //!< load is derived from MAP (   )
+#define LOAD_SRC_TPS           1                    //!< load is derived from throttle position (Alpha-N)
+#define LOAD_SRC_HYBRID        2                    //!< MAP below load_src_rpm, TPS above, blended within LOAD_SRC_BLEND_BAND
+
+/**Width of RPM band (min-1) in which MAP load is blended with TPS load in the LOAD_SRC_HYBRID mode,
+ * band is a power of 2 (1 << LOAD_SRC_BLEND_SHIFT), so blending is done by shift */
+#define LOAD_SRC_BLEND_SHIFT   8
+#define LOAD_SRC_BLEND_BAND    (1 << LOAD_SRC_BLEND_SHIFT)
+
+/**Throttle position (sensors_t::tps) is measured only by SECU-3T or if TPS_SENSOR is used. Otherwise
+ * LOAD_SRC_TPS and LOAD_SRC_HYBRID are not available and MAP is always used as source of load */
+#if defined(SECU3T) || defined(TPS_SENSOR)
+ #define TPS_AVAILABLE
+#endif
 
 /**      
  * Number of sets of tables stored in the firmware */
@@ -97,6 +116,19 @@ typedef struct f_data_t
   uint8_t name[F_NAME_SIZE];                        //!<   ( ) (assosiated name, displayed in user interface)
 }f_data_t;
 
+/**Describes axes of maps and source of load of one set of tables. Axes are stored only in the FLASH
+ * (firmware data and default data of tunable sets) and can not be edited in real time, so they do not
+ * take RAM and EEPROM. Reciprocals of lengths of segments are calculated by funconv.c
+ * (      ,    FLASH)
+ */
+typedef struct f_axes_t
+{
+  int16_t rpm_grid_points[F_WRK_POINTS_F];          //!< points of RPM axis of idle and work maps (min-1), must increase ( )
+  uint8_t load_grid_points[F_WRK_POINTS_L];         //!< points of load axis of work map, must increase. Measured from map_upper_pressure downwards, 256 units = range between map_upper_pressure and map_lower_pressure or range of throttle from fully open to closed ( )
+  uint8_t load_src;                                 //!< source of load for the work map, see LOAD_SRC_xxx ( )
+  int16_t load_src_rpm;                             //!< switchover RPM (min-1) from MAP to TPS in the LOAD_SRC_HYBRID mode
+}f_axes_t;
+
 
 /**Describes additional data stored in the firmware
  *      
@@ -131,13 +163,10 @@ typedef struct fw_ex_data_t
   /*Choke closing versus coolant temperature */
   uint8_t choke_closing[CHOKE_CLOSING_LOOKUP_TABLE_SIZE];
 
-  /**       
-   *       .    
-   *  ,    .
-   * Following reserved bytes required for keeping binary compatibility between
-   * different versions of firmware. Useful when you add/remove members to/from
-   * this structure. */
-  uint8_t reserved[6];
+  /**Advance angle correction versus barometric pressure, descrete = 0.5 degr. (60...110 kPa, step 10 kPa)
+   * (    ). Takes place of the last reserved bytes,
+   * so size of this structure is the same as before */
+  int8_t baro_corr[BARO_CORR_LOOKUP_TABLE_SIZE];
 }fw_ex_data_t;
 
 /**  
@@ -243,13 +272,11 @@ typedef struct params_t
 
   int16_t  idlreg_turn_on_temp;          //!< Idling regulator turn on temperature
 
-  /**       
-   *       .    
-   *  ,    .
-   * Following reserved bytes required for keeping binary compatibility between
-   * different versions of firmware. Useful when you add/remove members to/from
-   * this structure. */
-  uint8_t  reserved[4];
+  uint8_t  map_samp_mode;                //!< MAP sampling mode: 0 - once per stroke, 1 - mean of crank-angle resolved samples over cycle, 2 - minimum over cycle
+  uint8_t  map_samp_num;                 //!< Number of MAP samples per engine cycle (720), used when map_samp_mode != 0
+  int8_t   map_samp_offset;              //!< Tooth of the first MAP sample relatively to TDC of the 1st cylinder (if > 0, then BTDC)
+
+  uint8_t  baro_mode;                    //!< Barometric compensation: 0 - off, 1 - barometric pressure is measured at key-on, 2 - also refreshed at wide open throttle (needs TPS, see TPS_AVAILABLE)
 
   /**     (       EEPROM)
    *             ,   
@@ -260,7 +287,11 @@ typedef struct params_t
 }params_t;
 
 //Define data structures are related to code area data and IO remapping data
+#ifdef SECU3_HOST
+typedef uintptr_t fnptr_t;               //!< Special type for function pointers (host build, see tools/hostsim)
+#else
 typedef uint16_t fnptr_t;                //!< Special type for function pointers
+#endif
 #define IOREM_SLOTS 16                   //!< Number of slots used for I/O remapping
 #define IOREM_PLUGS 32                   //!< Number of plugs used in I/O remapping
 
@@ -305,6 +336,7 @@ typedef struct fw_data_t
  fw_ex_data_t exdata;                    //!<   Additional data in the firmware
  params_t def_param;                     //!<   Reserve parameters (loaded when instance in EEPROM is broken)
  f_data_t tables[TABLES_NUMBER];         //!<   Array of tables of advance angle
+ f_axes_t axes[TABLES_NUMBER];           //!< Axes of maps of sets of tables (placed after tables, so offsets of tables are kept)
  uint16_t code_crc;                      //!< Check sum of the whole firmware (except this check sum and boot loader)
 }fw_data_t;
 
@@ -327,12 +359,57 @@ typedef struct fw_data_t
 /**        
  *     EEPROM.
  * Number of sets of tables allowed to be tuned in the real time */
-#ifdef REALTIME_TABLES
+#if defined(REALTIME_TABLES) && defined(TABLES_OVERLAY) && defined(_PLATFORM_M64_)
+ #define TUNABLE_TABLES_NUMBER 4 //RAM does not depend on number of sets in overlay mode, 2K of EEPROM is enough for 4 sets
+#elif defined(REALTIME_TABLES)
  #define TUNABLE_TABLES_NUMBER 2
 #else
  #define TUNABLE_TABLES_NUMBER 0
 #endif
 
+//Image of one tunable set (320 bytes) placed at the old address (158) leaves only 34 bytes of 512 for
+//slots of errors (48 bytes) and parameters, so even overlay mode (which takes little RAM) can not be used
+#if defined(REALTIME_TABLES) && defined(_PLATFORM_M16_)
+ #error "REALTIME_TABLES is not supported on ATmega16 (tunable sets of tables do not fit into EEPROM), use ATmega32 or ATmega64!"
+#endif
+
+/**Size of image of tunable set of tables in the EEPROM. Axes and source of load are not stored,
+ * they are always taken from default data (tt_def_axes) */
+#define TABLES_EE_SIZE          sizeof(f_data_t)
+
+#ifdef REALTIME_TABLES
+/**Size of row of set of tables in bytes. All maps in f_data_t consist of such rows */
+#define TABLES_ROW_SIZE         16
+
+/**Number of rows in set of tables (must not exceed 32) */
+#define TABLES_ROWS_NUMBER      (sizeof(f_data_t) / TABLES_ROW_SIZE)
+
+#endif
+
+#ifdef TABLES_OVERLAY
+#ifndef REALTIME_TABLES
+ #error "TABLES_OVERLAY can be used only together with REALTIME_TABLES!"
+#endif
+
+/**Number of rows in the pool of overlay (must not exceed 32). Each row takes TABLES_ROW_SIZE bytes of RAM */
+#ifndef TABLES_OVL_ROWS
+ #define TABLES_OVL_ROWS        24
+#endif
+
+/**Value of index of slot which means that row is not replaced and it is taken from the base set */
+#define TABLES_OVL_BASE         0xFF
+
+/**Describes set of tables in overlay mode (copy-on-write): set of tables in the FLASH is used as base,
+ * rows which differ from the base set are stored in the overlay pool in RAM (ecudata_t::tables_ovl).
+ * (    :     FLASH,   -  )
+ */
+typedef struct tables_ovl_t
+{
+ f_data_t _PGM *base;                    //!< base set of tables in the FLASH
+ uint8_t slot[TABLES_ROWS_NUMBER];       //!< indexes of slots of overlay pool for each row or TABLES_OVL_BASE
+}tables_ovl_t;
+#endif
+
 /**    
  * Address of data in the firmware */
 #define FIRMWARE_DATA_START (SECU3BOOTSTART-sizeof(fw_data_section_t))
@@ -345,6 +422,9 @@ PGM_FIXED_ADDR_OBJ(extern fw_data_t fw_data, ".firmware_data");
 #ifdef REALTIME_TABLES
 /**Default data for tunable tables stored in the EEPROM */
 PGM_DECLARE(extern f_data_t tt_def_data[]);
+
+/**Axes of maps of tunable sets of tables */
+PGM_DECLARE(extern f_axes_t tt_def_axes[]);
 #endif
 
 #endif //_TABLES_H_
@@ -0,0 +1,202 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file trace.c
+ * Implementation of capture of input events (trace) for deterministic replay on the host.
+ * (    ()     PC).
+ */
+
+#ifdef TRACE_CAPTURE
+
+#include "port/avrio.h"
+#include "port/interrupt.h"
+#include "port/intrinsic.h"
+#include "port/port.h"
+#include <stdint.h>
+#include "bitmask.h"
+#include "trace.h"
+#include "uart.h"
+
+/**Size of record's header: [type|aux][ts lo][ts hi] */
+#define TRC_HEAD_SIZE    3
+
+/**Size of TRC_LOST record */
+#define TRC_LOST_SIZE    (TRC_HEAD_SIZE + 1)
+
+/**Define internal state variables */
+typedef struct
+{
+ uint8_t buf[256];           //!< ring buffer of records, 8-bit indexes wrap around automatically
+ volatile uint8_t head;      //!< index of the oldest byte which is not sent yet (changed by main loop)
+ volatile uint8_t tail;      //!< index for writing of next record (changed by interrupts and main loop)
+ uint8_t lost;               //!< number of records dropped since last TRC_LOST record
+ uint8_t rd_rem;             //!< number of bytes of partially sent record which are not sent yet
+ uint8_t seq;                //!< sequence number of portion of stream
+ volatile uint8_t on;        //!< flag, capture is active
+}trace_t;
+
+/**State variables */
+trace_t trace;
+
+/**Reserves space for record in the buffer and writes its header. If there are dropped records, then
+ * TRC_LOST record is written first. Must be called with interrupts disabled
+ * \param hdr header of record
+ * \param ts timestamp
+ * \param size size of payload
+ * \param p_idx returns index of payload in the buffer
+ * \return 1 - space reserved, 0 - there is no space (record is dropped)
+ */
+static uint8_t reserve(uint8_t hdr, uint16_t ts, uint8_t size, uint8_t* p_idx)
+{
+ uint8_t room = trace.head - trace.tail - 1;
+ uint16_t need = TRC_HEAD_SIZE + size + (trace.lost ? TRC_LOST_SIZE : 0);
+
+ if (room < need)
+ {
+  if (trace.lost < 255)
+   ++trace.lost;
+  return 0;
+ }
+
+ if (trace.lost)
+ { //make gap visible for replay
+  trace.buf[trace.tail++] = TRC_HDR(TRC_LOST, 0);
+  trace.buf[trace.tail++] = _AB(ts, 0);
+  trace.buf[trace.tail++] = _AB(ts, 1);
+  trace.buf[trace.tail++] = trace.lost;
+  trace.lost = 0;
+ }
+
+ trace.buf[trace.tail++] = hdr;
+ trace.buf[trace.tail++] = _AB(ts, 0);
+ trace.buf[trace.tail++] = _AB(ts, 1);
+ *p_idx = trace.tail;
+ trace.tail+= size;
+ return 1;
+}
+
+/**Calculates size of record
+ * \param i index of record's header in the buffer
+ * \return size of record in bytes
+ */
+static uint8_t rec_size(uint8_t i)
+{
+ switch(trace.buf[i] >> 4)
+ {
+  case TRC_ADC:
+   return TRC_HEAD_SIZE + 2;
+  case TRC_UART:
+   return TRC_HEAD_SIZE + 1 + trace.buf[(uint8_t)(i + TRC_HEAD_SIZE)];
+  case TRC_LOST:
+   return TRC_LOST_SIZE;
+  default: //TRC_TOOTH, TRC_CAM
+   return TRC_HEAD_SIZE;
+ }
+}
+
+void trace_start(uint8_t on)
+{
+ _BEGIN_ATOMIC_BLOCK();
+ trace.head = trace.tail = 0;
+ trace.lost = 0;
+ trace.rd_rem = 0;
+ trace.seq = 0;
+ trace.on = on;
+ _END_ATOMIC_BLOCK();
+}
+
+uint8_t trace_is_on(void)
+{
+ return trace.on;
+}
+
+uint8_t trace_is_pending(void)
+{
+ return trace.head != trace.tail;
+}
+
+void trace_put_event(uint8_t hdr, uint16_t ts)
+{
+ uint8_t i;
+ if (trace.on)
+ {
+  _BEGIN_ATOMIC_BLOCK();
+  reserve(hdr, ts, 0, &i);
+  _END_ATOMIC_BLOCK();
+ }
+}
+
+void trace_put_adc(uint8_t channel, uint16_t value)
+{
+ uint8_t i;
+ if (trace.on)
+ {
+  _BEGIN_ATOMIC_BLOCK();
+  if (reserve(TRC_HDR(TRC_ADC, channel), TCNT1, 2, &i))
+  {
+   trace.buf[i] = _AB(value, 0);
+   trace.buf[(uint8_t)(i + 1)] = _AB(value, 1);
+  }
+  _END_ATOMIC_BLOCK();
+ }
+}
+
+void trace_put_uart(void)
+{
+ uint8_t i, n, ok, size;
+ if (trace.on)
+ {
+  _BEGIN_ATOMIC_BLOCK();
+  size = uart_peek_recv(0) + 1; //[size][descriptor][data...]
+  ok = reserve(TRC_HDR(TRC_UART, 0), TCNT1, size, &i);
+  _END_ATOMIC_BLOCK();
+
+  //Space is reserved, so frame can be copied with interrupts enabled. Reading of
+  //the buffer (trace_get()) is also performed from main loop and can not interfere.
+  if (ok)
+   for(n = 0; n < size; ++n)
+    trace.buf[i++] = uart_peek_recv(n);
+ }
+}
+
+uint8_t trace_get(uint8_t* buf, uint8_t* p_first, uint8_t* p_seq)
+{
+ uint8_t i, n = trace.tail - trace.head;
+ uint8_t pos = trace.rd_rem;
+ if (n > TRACE_PACKET_SIZE)
+  n = TRACE_PACKET_SIZE;
+
+ *p_first = (pos < n) ? pos : TRACE_NO_RECORD;
+ *p_seq = trace.seq++;
+
+ //walk through records which begin in this portion, remember remainder of the last one
+ while(pos < n)
+  pos+= rec_size((uint8_t)(trace.head + pos));
+ trace.rd_rem = pos - n;
+
+ for(i = 0; i < n; ++i)
+  buf[i] = trace.buf[(uint8_t)(trace.head + i)];
+ trace.head+= n;
+ return n;
+}
+
+#endif //TRACE_CAPTURE
@@ -0,0 +1,104 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+
+/** \file trace.h
+ * Capture of input events (trace) for deterministic replay on the host.
+ * (   ()     PC).
+ *
+ * Trace is a stream of records. Each record begins with header byte (type in high nibble, auxiliary
+ * value in low nibble) followed by 16-bit timestamp (value of timer 1, tick = 4us, little endian).
+ * Payload depends on type of record:
+ * - TRC_TOOTH: none, timestamp is value of ICR1 (input capture of CKP sensor's tooth)
+ * - TRC_CAM:   none, aux: 0 - cam sensor (Hall), 1 - REF_S input (VR)
+ * - TRC_ADC:   16-bit result of conversion (little endian), aux - number of ADC channel
+ * - TRC_UART:  [size][descriptor][data...] - received frame, as it is stored in the receiver's buffer
+ * - TRC_LOST:  [count] - number of records dropped because buffer was full (saturated at 255)
+ *
+ * Captured trace is replayed by host simulator (tools/hostsim/replay.c).
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#ifdef TRACE_CAPTURE
+
+#include <stdint.h>
+
+#define TRC_TOOTH        1    //!< tooth of CKP sensor
+#define TRC_CAM          2    //!< event from cam sensor or from REF_S input
+#define TRC_ADC          3    //!< result of ADC conversion
+#define TRC_UART         4    //!< frame received via UART
+#define TRC_LOST         0x0F //!< records have been dropped
+
+#define TRC_CAM_HALL     0    //!< aux value of TRC_CAM record: cam sensor (Hall)
+#define TRC_CAM_REFS     1    //!< aux value of TRC_CAM record: REF_S input
+
+/**Builds header byte of record from type and auxiliary value */
+#define TRC_HDR(type, aux) (((type) << 4) | (aux))
+
+/**Maximum number of bytes of trace in one TRACE_DAT packet */
+#define TRACE_PACKET_SIZE 36
+
+/**Value of "first record" field of packet if packet does not contain beginning of any record */
+#define TRACE_NO_RECORD  0xFF
+
+/**Starts or stops capture. Buffer is emptied in both cases
+ * \param on 1 - start, 0 - stop
+ */
+void trace_start(uint8_t on);
+
+/**\return 1 - capture is active, 0 - not active */
+uint8_t trace_is_on(void);
+
+/**\return 1 - there are captured bytes which are not sent yet */
+uint8_t trace_is_pending(void);
+
+/**Puts record without payload (TRC_TOOTH, TRC_CAM). Can be called from interrupts
+ * \param hdr header of record (see TRC_HDR)
+ * \param ts timestamp (value of timer 1)
+ */
+void trace_put_event(uint8_t hdr, uint16_t ts);
+
+/**Puts record with result of ADC conversion. Can be called from interrupts
+ * \param channel number of ADC channel
+ * \param value result of conversion
+ */
+void trace_put_adc(uint8_t channel, uint16_t value);
+
+/**Puts record with the frame which is currently the oldest one in the receiver's buffer.
+ * Must be called from main loop before frame is processed
+ */
+void trace_put_uart(void);
+
+/**Takes next portion of captured stream for sending. Records may be split between
+ * packets, so offset of the first record which begins in this portion is also returned.
+ * Must be called from main loop
+ * \param buf buffer for bytes, at least TRACE_PACKET_SIZE bytes
+ * \param p_first returns offset of the first record in buf or TRACE_NO_RECORD
+ * \param p_seq returns sequence number of portion, used to detect lost packets
+ * \return number of bytes placed into buf
+ */
+uint8_t trace_get(uint8_t* buf, uint8_t* p_first, uint8_t* p_seq);
+
+#endif //TRACE_CAPTURE
+
+#endif //_TRACE_H_
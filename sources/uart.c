@@ -29,14 +29,21 @@
 #include "port/intrinsic.h"
 #include "port/pgmspace.h"
 #include "port/port.h"
+#include <stddef.h>
 #include <string.h>
 #include "bitmask.h"
+#include "ce_errors.h"
+#include "crc16.h"
 #include "eeprom.h"
+#include "params.h"
+#include "profiler.h"
 #include "secu3.h"
+#include "stackmon.h"
 #include "uart.h"
 #include "ufcodes.h"
 #include "funconv.h"
 #include "adc.h"
+#include "trace.h"
 
 //Mega64 compatibility
 #ifdef _PLATFORM_M64_
@@ -81,22 +88,73 @@
 #define ETTS_GASOLINE_SET 0 //!< tables's set: gasoline id
 #define ETTS_GAS_SET      1 //!< tables's set: gas id
 
+//Idenfifiers of fields used in SUBSCR_PAR/SUBSCR_DAT (bit numbers in mask of fields)
+#define SBSF_RPM          0 //!< averaged RPM (16 bit)
+#define SBSF_MAP          1 //!< MAP pressure (16 bit)
+#define SBSF_VOLTAGE      2 //!< board voltage (16 bit)
+#define SBSF_TEMPERAT     3 //!< coolant temperature (16 bit)
+#define SBSF_ANGLE        4 //!< current advance angle (16 bit)
+#define SBSF_KNOCK_K      5 //!< knock value (16 bit)
+#define SBSF_KNOCK_RET    6 //!< knock retard (16 bit)
+#define SBSF_AIRFLOW      7 //!< air flow (8 bit)
+#define SBSF_FLAGS        8 //!< boolean values, the same as in SENSOR_DAT (8 bit)
+#define SBSF_TPS          9 //!< TPS (8 bit)
+#define SBSF_ADD_I1      10 //!< ADD_I1 voltage (16 bit)
+#define SBSF_ADD_I2      11 //!< ADD_I2 voltage (16 bit)
+#define SBSF_CE_ERRORS   12 //!< CE errors (16 bit)
+#define SBSF_INST_RPM    13 //!< instant RPM (16 bit)
+#define SBSF_BARO        14 //!< barometric pressure (16 bit)
+#define SBSF_RECV_ERRS   15 //!< counters of dropped received frames: overflows of ring buffer (MSB), wrong frames (LSB) (16 bit)
+#define SBSF_NUMBER      16 //!< number of fields available for subscription
+
+//Idenfifiers of sets used in EDITAB_BLK
+#define ETTS_BLK_EEPROM_SET  2    //!< first tunable set of tables in EEPROM (0 and 1 - sets in RAM, see ETTS_GASOLINE_SET)
+#define ETTS_BLK_ALL_EEPROM  0x0F //!< all tunable sets of tables in EEPROM
+
 #define ETMT_STRT_MAP 0     //!< start map id
 #define ETMT_IDLE_MAP 1     //!< idle map id
 #define ETMT_WORK_MAP 2     //!< work map id
 #define ETMT_TEMP_MAP 3     //!< temp.corr. map id
 #define ETMT_NAME_STR 4     //!< name of tables's set id
+#define ETMT_RPM_GRID 5     //!< points of RPM axis id (8 points per packet), read only
+#define ETMT_LOAD_GRID 6    //!< points of load axis id, read only
+#define ETMT_LOAD_SRC  7    //!< source of load and switchover RPM id, read only
+
+//Identifiers of parts of FNNAME_DAT
+#define FNNP_NAME      0    //!< name of set of tables
+#define FNNP_RPM_GRID  1    //!< points of RPM axis
+#define FNNP_LOAD_GRID 2    //!< points of load axis
+#define FNNP_LOAD_SRC  3    //!< source of load and switchover RPM
 
 /**Define internal state variables */
 typedef struct
 {
  uint8_t send_mode;                     //!< current descriptor of packets beeing send
- uint8_t recv_buf[UART_RECV_BUFF_SIZE]; //!< receiver's buffer
+ uint8_t recv_buf[UART_RECV_BUFF_SIZE]; //!< receiver's ring buffer, each frame is stored as: [size][descriptor][data...]
  uint8_t send_buf[UART_SEND_BUFF_SIZE]; //!< transmitter's buffer
  volatile uint8_t send_size;            //!< size of data to be send
  uint8_t send_index;                    //!< index in transmitter's buffer
- volatile uint8_t recv_size;            //!< size of received data
- uint8_t recv_index;                    //!< index in receiver's buffer
+ volatile uint8_t recv_head;            //!< index of the oldest received frame in the ring buffer (read by main loop)
+ volatile uint8_t recv_tail;            //!< index after the last completely received frame (written by interrupt)
+ uint8_t recv_wr;                       //!< index for writing of frame being received (used by interrupt)
+ uint8_t recv_frame;                    //!< size of current frame which is being parsed
+ uint8_t recv_size;                     //!< number of bytes of current frame which are not parsed yet
+ uint8_t recv_index;                    //!< index in current frame
+ uint8_t recv_overflows;                //!< number of frames dropped because ring buffer was full
+ uint8_t recv_errors;                   //!< number of frames dropped because of wrong size or garbage
+ uint8_t stream_on;                     //!< flag, enables periodic (unsolicited) sending of packets
+ uint16_t subscr_mask;                  //!< mask of subscribed fields of telemetry (see SBSF_xxx)
+ uint8_t subscr_decim[SBSF_NUMBER];     //!< decimation factors of subscribed fields (field is sent in each N-th frame)
+ uint8_t subscr_tick;                   //!< counter of periodic frames, used for decimation
+#ifdef REALTIME_TABLES
+ uint8_t blk_set;                       //!< bulk transfer: set of tables being sent
+ uint8_t blk_last;                      //!< bulk transfer: last set of tables to be sent
+ uint8_t blk_row;                       //!< bulk transfer: row of set of tables being sent
+ uint8_t blk_active;                    //!< bulk transfer: flag, indicates that sending is in progress
+ uint8_t blk_done;                      //!< bulk transfer: flag, indicates that receiving of set of tables has been completed
+ uint8_t blk_status;                    //!< bulk transfer: number of rows which were not received or had wrong CRC
+ uint32_t blk_rows;                     //!< bulk transfer: bit mask of rows which were received with correct CRC
+#endif
 }uartstate_t;
 
 /**State variables */
@@ -108,6 +166,14 @@ PGM_DECLARE(uint8_t hdig[]) = "0123456789ABCDEF";
 /**Decodes from HEX to BIN */
 #define HTOD(h) (((h)<0x3A) ? ((h)-'0') : ((h)-'A'+10))
 
+/**Access to byte of current frame in the receiver's ring buffer
+ * \param i index of byte in the frame (0 - descriptor)
+ */
+#define recv_byte(i) uart.recv_buf[(uint8_t)(uart.recv_head + 1 + (i)) & (UART_RECV_BUFF_SIZE - 1)]
+
+/**Increments counter with saturation */
+#define inc_sat(c) {if ((c) < 255) ++(c);}
+
 //--------    -------------
 
 /**Appends sender's buffer by sequence of bytes from program memory 
@@ -172,6 +238,41 @@ static void build_rb(const uint8_t* ramBuffer, uint8_t size)
  while(size--) build_i8h(*ramBuffer++);
 }
 
+/**Appends sender's buffer by value of specified field of telemetry (used for subscription)
+ * \param d pointer to ECU data structure
+ * \param field identifier of field (see SBSF_xxx)
+ */
+static void build_subscr_field(struct ecudata_t* d, uint8_t field)
+{
+ switch(field)
+ {
+  case SBSF_RPM:       build_i16h(d->sens.frequen); break;
+  case SBSF_MAP:       build_i16h(d->sens.map); break;
+  case SBSF_VOLTAGE:   build_i16h(d->sens.voltage); break;
+  case SBSF_TEMPERAT:  build_i16h(d->sens.temperat); break;
+  case SBSF_ANGLE:     build_i16h(d->curr_angle); break;
+  case SBSF_KNOCK_K:   build_i16h(d->sens.knock_k); break;
+  case SBSF_KNOCK_RET: build_i16h(d->knock_retard); break;
+  case SBSF_AIRFLOW:   build_i8h(d->airflow); break;
+  case SBSF_FLAGS:
+   build_i8h((d->ie_valve   << 0) |       // IE flag
+             (d->sens.carb  << 1) |       // carb. limit switch flag
+             (d->sens.gas   << 2) |       // gas valve flag
+             (d->fe_valve   << 3) |       // power valve flag
+             (d->ce_state   << 4) |       // CE flag
+             (d->cool_fan   << 5) |       // cooling fan flag
+             (d->st_block   << 6));       // starter blocking flag
+   break;
+  case SBSF_TPS:       build_i8h(d->sens.tps); break;
+  case SBSF_ADD_I1:    build_i16h(d->sens.add_i1); break;
+  case SBSF_ADD_I2:    build_i16h(d->sens.add_i2); break;
+  case SBSF_CE_ERRORS: build_i16h(d->ecuerrors_for_transfer); break;
+  case SBSF_INST_RPM:  build_i16h(d->sens.inst_frq); break;
+  case SBSF_BARO:      build_i16h(d->sens.baro); break;
+  case SBSF_RECV_ERRS: build_i16h((((uint16_t)uart.recv_overflows) << 8) | uart.recv_errors); break;
+ }
+}
+
 //----------    ---------
 /**Recepts sequence of bytes from receiver's buffer and places it into the RAM buffer
  * can NOT be used for binary data */
@@ -179,11 +280,11 @@ static void recept_rs(uint8_t* ramBuffer, uint8_t size)
 { 
  if (size > uart.recv_size)
   size = uart.recv_size;
- while(size--) *ramBuffer++ = uart.recv_buf[uart.recv_index++];
+ while(size--) *ramBuffer++ = recv_byte(uart.recv_index++);
 }
 
 /**Retrieves from receiver's buffer 4-bit value */
-#define recept_i4h() (uart.recv_buf[uart.recv_index++] - 0x30)
+#define recept_i4h() (recv_byte(uart.recv_index++) - 0x30)
 
 /**Retrieves from receiver's buffer 8-bit value
  * \return retrieved value
@@ -191,9 +292,9 @@ static void recept_rs(uint8_t* ramBuffer, uint8_t size)
 static uint8_t recept_i8h(void)
 {
  uint8_t i8;
- i8 = HTOD(uart.recv_buf[uart.recv_index])<<4;
+ i8 = HTOD(recv_byte(uart.recv_index))<<4;
  ++uart.recv_index;
- i8|= HTOD(uart.recv_buf[uart.recv_index]);
+ i8|= HTOD(recv_byte(uart.recv_index));
  ++uart.recv_index;
  return i8;
 }
@@ -204,13 +305,13 @@ static uint8_t recept_i8h(void)
 static uint16_t recept_i16h(void)
 {
  uint16_t i16;
- _AB(i16,1) = (HTOD(uart.recv_buf[uart.recv_index]))<<4;
+ _AB(i16,1) = (HTOD(recv_byte(uart.recv_index)))<<4;
  ++uart.recv_index;
- _AB(i16,1)|= (HTOD(uart.recv_buf[uart.recv_index]));
+ _AB(i16,1)|= (HTOD(recv_byte(uart.recv_index)));
  ++uart.recv_index;
- _AB(i16,0) = (HTOD(uart.recv_buf[uart.recv_index]))<<4;
+ _AB(i16,0) = (HTOD(recv_byte(uart.recv_index)))<<4;
  ++uart.recv_index;
- _AB(i16,0)|= (HTOD(uart.recv_buf[uart.recv_index]));
+ _AB(i16,0)|= (HTOD(recv_byte(uart.recv_index)));
  ++uart.recv_index;
  return i16;
 }
@@ -236,6 +337,79 @@ static void recept_rb(uint8_t* ramBuffer, uint8_t size)
   size = rcvsize;
  while(size--) *ramBuffer++ = recept_i8h();
 }
+
+/**Checks symbols of data in received frame. Numbers are transferred as hexadecimal digits, 4-bit
+ * values are transferred as '0' + value, so valid symbols are '0'...'?' and 'A'...'F'.
+ * \param begin index of the first symbol to check (descriptor has index 0)
+ * \param end index following the last symbol to check
+ * \return 1 - all symbols are valid, 0 - frame contains garbage
+ */
+static uint8_t check_recv_hex(uint8_t begin, uint8_t end)
+{
+ for(; begin < end; ++begin)
+ {
+  uint8_t chr = recv_byte(begin);
+  if ((chr < '0' || chr > '?') && (chr < 'A' || chr > 'F'))
+   return 0;
+ }
+ return 1;
+}
+
+/**Checks size and symbols of data in received frame. Frames with wrong size or garbage must not be
+ * parsed, otherwise parameters may be corrupted.
+ * \param descriptor descriptor of frame
+ * \param size size of data in frame (without descriptor)
+ * \return 1 - frame is valid, 0 - size is wrong, frame contains garbage or descriptor is unknown
+ */
+static uint8_t check_recv_size(uint8_t descriptor, uint8_t size)
+{
+ uint8_t valid, hex = size; //number of symbols of data which must be hexadecimal digits
+ switch(descriptor)
+ {
+  case CHANGEMODE:   valid = 1; hex = 0; break; //descriptor of packets
+  case BOOTLOADER:   return 1;
+  case TEMPER_PAR:   valid = 11; break;
+  case CARBUR_PAR:   valid = 25; break;
+  case IDLREG_PAR:   valid = 29; break;
+  case ANGLES_PAR:   valid = 21; break;
+  case FUNSET_PAR:   valid = 29; break;
+  case STARTR_PAR:   valid = 8; break;
+  case ADCCOR_PAR:   valid = 72; break;
+  case CKPS_PAR:     valid = 18; break;
+  case OP_COMP_NC:   valid = 4; break;
+  case KNOCK_PAR:    valid = 31; break;
+  case CE_SAVED_ERR: valid = 4; break;
+  case MISCEL_PAR:   valid = 15; break;
+  case CHOKE_PAR:    valid = 5; break;
+  case SUBSCR_PAR:   valid = 1 + 4 + SBSF_NUMBER; break;
+#ifdef REALTIME_TABLES
+  case EDITAB_PAR:   //[x][x][xx] + data, size of data depends on type of data
+   if (size < 4)
+    return 0;
+   switch(recv_byte(2) - 0x30)
+   {
+    case ETMT_STRT_MAP:
+    case ETMT_IDLE_MAP:
+    case ETMT_WORK_MAP:
+    case ETMT_TEMP_MAP:  //1...16 points of 8 bits
+     valid = (size > 4 && size <= (4 + (TABLES_ROW_SIZE * 2)) && !(size & 1)) ? size : 0;
+     break;
+    case ETMT_NAME_STR:  //1...F_NAME_SIZE symbols, name is not hexadecimal
+     valid = (size > 4 && size <= (4 + F_NAME_SIZE)) ? size : 0;
+     hex = 4;
+     break;
+    default: return 0;   //axes and source of load can not be edited (they are in the FLASH)
+   }
+   break;
+  case EDITAB_BLK:   valid = 39; break;  //[x][xx] + 16 bytes + CRC
+#endif
+#ifdef DIAGNOSTICS
+  case DIAGOUT_DAT:  valid = 4; break;
+#endif
+  default: return 0;
+ }
+ return (size == valid) && check_recv_hex(1, 1 + hex);
+}
 //--------------------------------------------------------------------
 
 /**Makes sender to start sending */
@@ -247,6 +421,37 @@ static void uart_begin_send(void)
  _ENABLE_INTERRUPT();
 }
 
+/**Reads data of set of tables stored in FLASH or in EEPROM (EEPROM must be idle)
+ * \param buf buffer which will receive data
+ * \param set index of set of tables, tunable sets in EEPROM follow sets in FLASH
+ * \param offset offset of data in f_data_t
+ * \param size size of data in bytes
+ */
+static void read_set_data(uint8_t* buf, uint8_t set, uint16_t offset, uint8_t size)
+{
+#ifdef REALTIME_TABLES
+ if (set >= TABLES_NUMBER)
+ {
+  eeprom_read(buf, EEPROM_REALTIME_TABLES_START + (TABLES_EE_SIZE * (set - TABLES_NUMBER)) + offset, size);
+  return;
+ }
+#endif
+ memcpy_P(buf, ((uint8_t _PGM*)&fw_data.tables[set]) + offset, size);
+}
+
+/**Returns axes of set of tables (axes are always in the FLASH)
+ * \param set index of set of tables, tunable sets follow sets in FLASH
+ * \return pointer to axes
+ */
+static f_axes_t _PGM* get_set_axes(uint8_t set)
+{
+#ifdef REALTIME_TABLES
+ if (set >= TABLES_NUMBER)
+  return &tt_def_axes[set - TABLES_NUMBER];
+#endif
+ return &fw_data.axes[set];
+}
+
 void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
 {
  static uint8_t index = 0;
@@ -311,6 +516,7 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    build_i16h(d->param.map_curve_gradient);
    build_i16h(d->param.tps_curve_offset);
    build_i16h(d->param.tps_curve_gradient);
+   build_i4h(d->param.baro_mode);
    break;
 
   case STARTR_PAR:
@@ -318,36 +524,48 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    build_i16h(d->param.smap_abandon);
    break;
 
+  //Name and axes of each set of tables are sent by separate packets (parts)
   case FNNAME_DAT:
-   build_i8h(TABLES_NUMBER + TUNABLE_TABLES_NUMBER);
+  {
+   static uint8_t part = 0;
+   uint8_t set = index, i;
+   uint8_t buf[F_NAME_SIZE];
+   f_axes_t _PGM* p_axes;
 #ifdef REALTIME_TABLES
-   if (index < TABLES_NUMBER) //from FLASH
+   if (set >= TABLES_NUMBER && !eeprom_is_idle())
+    set = TABLES_NUMBER - 1; //skip this item - will be transferred next time
+#endif
+   build_i8h(TABLES_NUMBER + TUNABLE_TABLES_NUMBER);
+   build_i8h(set);
+   build_i4h(part);
+   p_axes = get_set_axes(set);
+   switch(part)
    {
-    build_i8h(index);
-    build_fs(fw_data.tables[index].name, F_NAME_SIZE);
+    case FNNP_NAME:
+     read_set_data(buf, set, offsetof(f_data_t, name), F_NAME_SIZE);
+     build_rs(buf, F_NAME_SIZE);
+     break;
+    case FNNP_RPM_GRID:
+     for(i = 0; i < F_WRK_POINTS_F; ++i)
+      build_i16h(PGM_GET_WORD(&p_axes->rpm_grid_points[i]));
+     break;
+    case FNNP_LOAD_GRID:
+     for(i = 0; i < F_WRK_POINTS_L; ++i)
+      build_i8h(PGM_GET_BYTE(&p_axes->load_grid_points[i]));
+     break;
+    case FNNP_LOAD_SRC:
+     build_i4h(PGM_GET_BYTE(&p_axes->load_src));
+     build_i16h(PGM_GET_WORD(&p_axes->load_src_rpm));
+     break;
    }
-   else //from EEPROM
-   {
-    if (eeprom_is_idle())
-    {
-     build_i8h(index);
-     eeprom_read(&uart.send_buf[uart.send_size], (uint16_t)((f_data_t*)(EEPROM_REALTIME_TABLES_START))[index - TABLES_NUMBER].name, F_NAME_SIZE);
-     uart.send_size+=F_NAME_SIZE;
-    }
-    else //skip this item - will be transferred next time
-    {
-     index = TABLES_NUMBER - 1;
-     build_i8h(index);
-     build_fs(fw_data.tables[index].name, F_NAME_SIZE);
-    }
+   if (set == index && ++part > FNNP_LOAD_SRC)
+   { //all parts of item have been sent, go to the next one
+    part = FNNP_NAME;
+    ++index;
+    if (index>=(TABLES_NUMBER + TUNABLE_TABLES_NUMBER)) index = 0;
    }
-#else
-   build_i8h(index);
-   build_fs(fw_data.tables[index].name, F_NAME_SIZE);
-#endif
-   ++index;
-   if (index>=(TABLES_NUMBER + TUNABLE_TABLES_NUMBER)) index = 0;
-    break;
+   break;
+  }
 
   case SENSOR_DAT:
    build_i16h(d->sens.frequen);           // averaged RPM
@@ -370,7 +588,29 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    build_i16h(d->sens.add_i1);            // ADD_I1 voltage
    build_i16h(d->sens.add_i2);            // ADD_I2 voltage
    build_i16h(d->ecuerrors_for_transfer); // CE errors
+   build_i16h(d->sens.baro);              // barometric pressure
+   break;
+
+  //only subscribed fields are sent, each field with its own decimation factor
+  case SUBSCR_DAT:
+  {
+   uint8_t i;
+   uint16_t mask = 0;
+   for(i = 0; i < SBSF_NUMBER; ++i)
+    if ((uart.subscr_mask & (1U << i)) && 0==(uart.subscr_tick % uart.subscr_decim[i]))
+     mask|= (1U << i);
+   ++uart.subscr_tick;
+   if (!mask)
+   { //nothing to send in this frame
+    uart.send_size = 0;
+    return;
+   }
+   build_i16h(mask);
+   for(i = 0; i < SBSF_NUMBER; ++i)
+    if (mask & (1U << i))
+     build_subscr_field(d, i);
    break;
+  }
 
   case ADCCOR_PAR:
    build_i16h(d->param.map_adc_factor);
@@ -407,6 +647,9 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    build_i4h(d->param.merge_ign_outs);
    build_i8h(d->param.ckps_cogs_num);
    build_i8h(d->param.ckps_miss_num);
+   build_i4h(d->param.map_samp_mode);
+   build_i8h(d->param.map_samp_num);
+   build_i8h(d->param.map_samp_offset);
    break;
 
   case OP_COMP_NC:
@@ -435,6 +678,69 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    build_i16h(d->ecuerrors_saved_transfer);
    break;
 
+  case CE_LOG_DAT:
+  {
+   uint8_t index, valid;
+   ce_frame_t* p_frame = ce_get_log_frame(&index, &valid);
+   build_i4h(index);                 //index of record
+   build_i4h(EEPROM_CEFRAMES_SLOTS); //number of records in the log
+   build_i4h(valid);                 //0 - slot is empty or broken
+   build_i16h(p_frame->seq);         //sequence number, used to order records
+   build_i16h(p_frame->errors);
+   build_i16h(p_frame->active);
+   build_i32h(p_frame->time);
+   build_i16h(p_frame->rpm);
+   build_i16h(p_frame->map);
+   build_i16h(p_frame->voltage);
+   build_i16h(p_frame->temperat);
+   build_i16h(p_frame->angle);
+   build_i4h(p_frame->mode);
+   build_i4h(p_frame->flags);
+   break;
+  }
+
+#ifdef TRACE_CAPTURE
+  case TRACE_DAT:
+  {
+   uint8_t buf[TRACE_PACKET_SIZE], first, seq;
+   uint8_t size = trace_get(buf, &first, &seq);
+#if ((UART_SEND_BUFF_SIZE - 3) < (TRACE_PACKET_SIZE*2)+4)
+ #error "Out of buffer!"
+#endif
+   build_i8h(seq);                   //sequence number, used to detect lost packets
+   build_i8h(first);                 //offset of the first record which begins in this packet
+   build_rb(buf, size);
+   break;
+  }
+#endif
+
+  case STACK_DAT:
+  {
+   uint8_t i = 0;
+   build_i4h(STKM_REGIONS);          //number of stacks
+   for(; i < STKM_REGIONS; ++i)
+   {
+    build_i16h(stkm_get_free(i));    //never used bytes
+    build_i16h(stkm_get_depth(i));   //the worst observed depth
+   }
+   break;
+  }
+
+#ifdef PROFILING
+  case PROFIL_DAT:
+  {
+   prf_probe_t p;
+   build_i8h(prf_take_next(&p));     //number of probe
+   build_i8h(prf_get_load());        //CPU load, %
+   build_i16h(p.cnt);
+   build_i16h(p.cnt ? p.min : 0);
+   build_i16h(p.max);
+   build_i16h(p.cnt ? (uint16_t)(p.sum / p.cnt) : 0); //mean value
+   build_rb(p.hist, PRF_BINS);
+   break;
+  }
+#endif
+
   case FWINFO_DAT:
    //  ,       . 3  -    .
 #if ((UART_SEND_BUFF_SIZE - 3) < FW_SIGNATURE_INFO_SIZE+8)
@@ -463,23 +769,27 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
   case EDITAB_PAR:
   {
    static uint8_t fuel = 0, state = 0, wrk_index = 0;
+   uint8_t row[TABLES_ROW_SIZE], i; //all maps consist of rows of 16 points
    build_i4h(fuel);
    build_i4h(state);
    switch(state)
    {
     case ETMT_STRT_MAP: //start map
      build_i8h(0); //<--not used
-     build_rb((uint8_t*)&d->tables_ram[fuel].f_str, F_STR_POINTS);
+     read_tables_row(d, fuel, 1, offsetof(f_data_t, f_str) / TABLES_ROW_SIZE, row);
+     build_rb(row, F_STR_POINTS);
      state = ETMT_IDLE_MAP;
      break;
     case ETMT_IDLE_MAP: //idle map
      build_i8h(0); //<--not used
-     build_rb((uint8_t*)&d->tables_ram[fuel].f_idl, F_IDL_POINTS);
+     read_tables_row(d, fuel, 1, offsetof(f_data_t, f_idl) / TABLES_ROW_SIZE, row);
+     build_rb(row, F_IDL_POINTS);
      state = ETMT_WORK_MAP, wrk_index = 0;
      break;
     case ETMT_WORK_MAP: //work map
      build_i8h(wrk_index*F_WRK_POINTS_L);
-     build_rb((uint8_t*)&d->tables_ram[fuel].f_wrk[wrk_index][0], F_WRK_POINTS_F);
+     read_tables_row(d, fuel, 1, (offsetof(f_data_t, f_wrk) / TABLES_ROW_SIZE) + wrk_index, row);
+     build_rb(row, F_WRK_POINTS_F);
      if (wrk_index >= F_WRK_POINTS_L-1 )
      {
       wrk_index = 0;
@@ -490,12 +800,36 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
      break;
     case ETMT_TEMP_MAP: //temper. correction.
      build_i8h(0); //<--not used
-     build_rb((uint8_t*)&d->tables_ram[fuel].f_tmp, F_TMP_POINTS);
+     read_tables_row(d, fuel, 1, offsetof(f_data_t, f_tmp) / TABLES_ROW_SIZE, row);
+     build_rb(row, F_TMP_POINTS);
      state = ETMT_NAME_STR;
      break;
     case ETMT_NAME_STR:
      build_i8h(0); //<--not used
-     build_rs(d->tables_ram[fuel].name, F_NAME_SIZE);
+     read_tables_row(d, fuel, 1, offsetof(f_data_t, name) / TABLES_ROW_SIZE, row);
+     build_rs(row, F_NAME_SIZE);
+     state = ETMT_RPM_GRID, wrk_index = 0;
+     break;
+    case ETMT_RPM_GRID: //RPM axis of active set (read only), 8 points per packet
+     build_i8h(wrk_index * (TABLES_ROW_SIZE / 2));
+     for(i = 0; i < TABLES_ROW_SIZE / 2; ++i)
+      build_i16h(PGM_GET_WORD(&d->tables_axes[fuel]->rpm_grid_points[(wrk_index * (TABLES_ROW_SIZE / 2)) + i]));
+     if (++wrk_index >= (F_WRK_POINTS_F * 2) / TABLES_ROW_SIZE)
+     {
+      wrk_index = 0;
+      state = ETMT_LOAD_GRID;
+     }
+     break;
+    case ETMT_LOAD_GRID: //load axis of active set (read only)
+     build_i8h(0); //<--not used
+     memcpy_P(row, d->tables_axes[fuel]->load_grid_points, F_WRK_POINTS_L);
+     build_rb(row, F_WRK_POINTS_L);
+     state = ETMT_LOAD_SRC;
+     break;
+    case ETMT_LOAD_SRC: //source of load, switchover RPM of active set (read only)
+     build_i8h(0); //<--not used
+     build_i4h(PGM_GET_BYTE(&d->tables_axes[fuel]->load_src));
+     build_i16h(PGM_GET_WORD(&d->tables_axes[fuel]->load_src_rpm));
      if (fuel >= ETTS_GAS_SET)  //last
       fuel = ETTS_GASOLINE_SET; //first
      else
@@ -505,6 +839,32 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    }
    break;
   }
+
+//Bulk transfer: one row of set of tables per frame, frames are sent back-to-back (see uart_bulk_start())
+  case EDITAB_BLK:
+  {
+   uint8_t row[TABLES_ROW_SIZE + 2]; //set, index of row, data of row
+   row[0] = uart.blk_set;
+   row[1] = uart.blk_row;
+   if (uart.blk_set < ETTS_BLK_EEPROM_SET) //shadow set of tables in RAM
+    read_tables_row(d, uart.blk_set, 1, uart.blk_row, &row[2]);
+   else //tunable set of tables in EEPROM
+    eeprom_read(&row[2], EEPROM_REALTIME_TABLES_START + (TABLES_EE_SIZE * (uart.blk_set - ETTS_BLK_EEPROM_SET)) + (uart.blk_row * TABLES_ROW_SIZE), TABLES_ROW_SIZE);
+   build_i4h(row[0]);
+   build_i8h(row[1]);
+   build_rb(&row[2], TABLES_ROW_SIZE);
+   build_i16h(crc16(row, sizeof(row)));
+
+   if (++uart.blk_row >= TABLES_ROWS_NUMBER)
+   {
+    uart.blk_row = 0;
+    if (uart.blk_set >= uart.blk_last)
+     uart.blk_active = 0; //all rows of all requested sets have been sent
+    else
+     ++uart.blk_set;
+   }
+   break;
+  }
 #endif
 
   case ATTTAB_PAR:
@@ -530,6 +890,14 @@ void uart_send_packet(struct ecudata_t* d, uint8_t send_mode)
    build_i16h(user_var3);
    build_i16h(/*Your variable here*/0);
    break;
+
+  case STRTIM_DAT:
+  {
+   uint8_t i = 0;
+   for(; i < STRT_NUMBER; ++i)
+    build_i16h(d->strt_times[i]);
+   break;
+  }
 #endif
 #ifdef DIAGNOSTICS
   case DIAGINP_DAT:
@@ -563,20 +931,43 @@ uint8_t uart_recept_packet(struct ecudata_t* d)
  uint8_t temp;
  uint8_t descriptor;
 
+ //current frame is the oldest one in the ring buffer
+ uart.recv_frame = uart.recv_size = uart.recv_buf[uart.recv_head];
  uart.recv_index = 0;
 
- descriptor = uart.recv_buf[uart.recv_index++];
+ descriptor = recv_byte(uart.recv_index++);
 
-// TODO:   uart_recv_size    .
-//        
+ //frames with wrong size or garbage are dropped
+ if (!check_recv_size(descriptor, uart.recv_size - 1))
+ {
+  inc_sat(uart.recv_errors);
+  return 0;
+ }
 
  //       
  switch(descriptor)
  {
   case CHANGEMODE:
-   uart_set_send_mode(uart.recv_buf[uart.recv_index++]);
+   uart_set_send_mode(recv_byte(uart.recv_index++));
+   uart.stream_on = 1; //any CHANGEMODE packet turns on flow of outgoing data packets
    break;
 
+  case SUBSCR_PAR:
+  {
+   uint8_t i;
+   uart.stream_on = recept_i4h();     //0 - turn off flow of outgoing data packets
+   uart.subscr_mask = recept_i16h();
+   for(i = 0; i < SBSF_NUMBER; ++i)
+   {
+    uint8_t decim = recept_i4h();
+    uart.subscr_decim[i] = decim ? decim : 1;
+   }
+   uart.subscr_tick = 0;
+   if (uart.subscr_mask)
+    uart_set_send_mode(SUBSCR_DAT);
+   break;
+  }
+
   case BOOTLOADER:
    //TODO: in the future use callback and move following code out
    // .         
@@ -642,6 +1033,11 @@ uint8_t uart_recept_packet(struct ecudata_t* d)
    d->param.map_curve_gradient = recept_i16h();
    d->param.tps_curve_offset = recept_i16h();
    d->param.tps_curve_gradient = recept_i16h();
+   d->param.baro_mode = recept_i4h();
+#ifndef TPS_AVAILABLE
+   if (d->param.baro_mode > 1)
+    d->param.baro_mode = 1; //WOT can not be detected without throttle position sensor
+#endif
    break;
 
   case STARTR_PAR:
@@ -674,6 +1070,9 @@ uint8_t uart_recept_packet(struct ecudata_t* d)
    d->param.merge_ign_outs = recept_i4h();
    d->param.ckps_cogs_num = recept_i8h();
    d->param.ckps_miss_num = recept_i8h();
+   d->param.map_samp_mode = recept_i4h();
+   d->param.map_samp_num = recept_i8h();
+   d->param.map_samp_offset = recept_i8h();
    break;
 
   case OP_COMP_NC:
@@ -718,25 +1117,64 @@ uint8_t uart_recept_packet(struct ecudata_t* d)
    uint8_t fuel = recept_i4h();
    uint8_t state = recept_i4h();
    uint8_t addr = recept_i8h();
+   uint16_t offset = sizeof(f_data_t);
+   uint8_t row[TABLES_ROW_SIZE];
    uart.recv_size-=5; //[d][x][x][xx]
+   //changes are made in shadow set of tables and become active after commit (see OPCODE_COMMIT_TABLSET)
    switch(state)
    {
     case ETMT_STRT_MAP: //start map
-     recept_rb(((uint8_t*)&d->tables_ram[fuel].f_str) + addr, F_STR_POINTS); /*F_STR_POINTS max*/
+     offset = offsetof(f_data_t, f_str) + addr;
      break;
     case ETMT_IDLE_MAP: //idle map
-     recept_rb(((uint8_t*)&d->tables_ram[fuel].f_idl) + addr, F_IDL_POINTS); /*F_IDL_POINTS max*/
+     offset = offsetof(f_data_t, f_idl) + addr;
      break;
     case ETMT_WORK_MAP: //work map
-     recept_rb(((uint8_t*)&d->tables_ram[fuel].f_wrk[0][0]) + addr, F_WRK_POINTS_F); /*F_WRK_POINTS_F max*/
+     offset = offsetof(f_data_t, f_wrk) + addr;
      break;
     case ETMT_TEMP_MAP: //temper. correction map
-     recept_rb(((uint8_t*)&d->tables_ram[fuel].f_tmp) + addr, F_TMP_POINTS); /*F_TMP_POINTS max*/
+     offset = offsetof(f_data_t, f_tmp) + addr;
      break;
     case ETMT_NAME_STR: //name
-     recept_rs((d->tables_ram[fuel].name) + addr, F_NAME_SIZE); /*F_NAME_SIZE max*/
+     offset = offsetof(f_data_t, name) + addr;
      break;
    }
+   //frames with wrong type of fuel are rejected (fuel is used as index of arrays)
+   if (fuel <= ETTS_GAS_SET && offset < sizeof(f_data_t)) //all maps have rows of 16 points, each packet contains one row
+   {
+    read_tables_row(d, fuel, 1, offset / TABLES_ROW_SIZE, row);
+    if (ETMT_NAME_STR == state)
+     recept_rs(row, F_NAME_SIZE); /*F_NAME_SIZE max*/
+    else
+     recept_rb(row, TABLES_ROW_SIZE); /*16 points max*/
+    write_shadow_tables_row(d, fuel, offset / TABLES_ROW_SIZE, row);
+   }
+  }
+  break;
+
+  case EDITAB_BLK:
+  {
+   uint8_t row[TABLES_ROW_SIZE + 2]; //set, index of row, data of row
+   row[0] = recept_i4h();
+   row[1] = recept_i8h();
+   uart.recv_size-=4; //[d][x][xx]
+   recept_rb(&row[2], TABLES_ROW_SIZE);
+   //only shadow sets of tables in RAM can be written, changes become active after commit (see OPCODE_COMMIT_TABLSET)
+   //row which does not fit into the pool of overlay (TABLES_OVERLAY) is reported as not received
+   if (row[0] < ETTS_BLK_EEPROM_SET && row[1] < TABLES_ROWS_NUMBER && recept_i16h() == crc16(row, sizeof(row))
+       && write_shadow_tables_row(d, row[0], row[1], &row[2]))
+    uart.blk_rows|= (1UL << row[1]);
+
+   if (row[1] == TABLES_ROWS_NUMBER - 1)
+   { //last row - count rows which were not received or had wrong CRC, one acknowledgement will be sent
+    uint8_t i;
+    uart.blk_status = 0;
+    for(i = 0; i < TABLES_ROWS_NUMBER; ++i)
+     if (!(uart.blk_rows & (1UL << i)))
+      ++uart.blk_status;
+    uart.blk_rows = 0;
+    uart.blk_done = 1;
+   }
   }
   break;
 #endif
@@ -753,24 +1191,83 @@ uint8_t uart_recept_packet(struct ecudata_t* d)
 
 void uart_notify_processed(void)
 {
+ //free space occupied by current frame in the ring buffer
+ uart.recv_head = (uart.recv_head + 1 + uart.recv_frame) & (UART_RECV_BUFF_SIZE - 1);
  uart.recv_size = 0;
 }
 
 uint8_t uart_is_sender_busy(void)
 {
- return (uart.send_size > 0);
+ //UDRE interrupt is disabled when transmitter has taken the last byte. Until that moment the
+ //interrupt still uses send_index, so the buffer can not be filled with the next packet.
+ return (uart.send_size > 0) || (UCSRB & _BV(UDRIE));
 }
 
 uint8_t uart_is_packet_received(void)
 {
- return (uart.recv_size > 0);
+ return (uart.recv_head != uart.recv_tail);
+}
+
+uint8_t uart_get_recv_overflows(void)
+{
+ return uart.recv_overflows;
+}
+
+uint8_t uart_get_recv_errors(void)
+{
+ return uart.recv_errors;
+}
+
+#ifdef TRACE_CAPTURE
+uint8_t uart_peek_recv(uint8_t i)
+{
+ return uart.recv_buf[(uint8_t)(uart.recv_head + i) & (UART_RECV_BUFF_SIZE - 1)];
 }
+#endif
+
+#ifdef REALTIME_TABLES
+void uart_bulk_start(uint8_t set)
+{
+ if (ETTS_BLK_ALL_EEPROM == set)
+ {
+  uart.blk_set = ETTS_BLK_EEPROM_SET;
+  uart.blk_last = ETTS_BLK_EEPROM_SET + TUNABLE_TABLES_NUMBER - 1;
+ }
+ else
+  uart.blk_set = uart.blk_last = set;
+ uart.blk_row = 0;
+ uart.blk_active = (uart.blk_set < ETTS_BLK_EEPROM_SET + TUNABLE_TABLES_NUMBER);
+ uart.blk_status = uart.blk_active ? 0 : 0xFF; //0xFF - wrong set
+}
+
+uint8_t uart_bulk_is_active(void)
+{
+ return uart.blk_active;
+}
+
+uint8_t uart_bulk_take_completed(void)
+{
+ uint8_t done = uart.blk_done;
+ uart.blk_done = 0;
+ return done;
+}
+
+uint8_t uart_bulk_get_status(void)
+{
+ return uart.blk_status;
+}
+#endif
 
 uint8_t uart_get_send_mode(void)
 {
  return uart.send_mode;
 }
 
+uint8_t uart_is_stream_on(void)
+{
+ return uart.stream_on;
+}
+
 uint8_t uart_set_send_mode(uint8_t descriptor)
 {
  return uart.send_mode = descriptor;
@@ -791,7 +1288,15 @@ void uart_init(uint16_t baud)
 
  uart.send_size = 0;                                         //    
  uart.recv_size = 0;                                         //  
+ uart.recv_head = uart.recv_tail = 0;
+ uart.recv_overflows = uart.recv_errors = 0;
+#ifdef REALTIME_TABLES
+ uart.blk_active = uart.blk_done = 0;
+ uart.blk_rows = 0;
+#endif
  uart.send_mode = SENSOR_DAT;
+ uart.stream_on = 1;
+ uart.subscr_mask = 0;
 }
 
 
@@ -800,6 +1305,7 @@ void uart_init(uint16_t baud)
  */
 ISR(USART_UDRE_vect)
 {
+ PRF_ENTER();
  if (uart.send_size > 0)
  {
   UDR = uart.send_buf[uart.send_index];
@@ -810,25 +1316,27 @@ ISR(USART_UDRE_vect)
  {//  
   UCSRB &= ~_BV(UDRIE); // disable UDRE interrupt
  }
+ PRF_LEAVE(PRB_UDRE);
 }
 
 /**Interrupt handler for receive data through the UART */
 ISR(USART_RXC_vect)
 {
  static uint8_t state=0;
+ static uint8_t size=0;
  uint8_t chr = UDR;
+ PRF_ENTER();
 
  _ENABLE_INTERRUPT();
  switch(state)
  {
   case 0:            // (   )
-   if (uart.recv_size!=0) //     ,     .
-    break;
-
    if (chr=='!')   // ?
    {
     state = 1;
-    uart.recv_index = 0;
+    //first byte of frame's place in the ring buffer will contain size of frame
+    uart.recv_wr = (uart.recv_tail + 1) & (UART_RECV_BUFF_SIZE - 1);
+    size = 0;
    }
    break;
 
@@ -836,18 +1344,34 @@ ISR(USART_RXC_vect)
    if (chr=='\r')
    {
     state = 0;       //   
-    uart.recv_size = uart.recv_index; // ,   
+    if (size)
+    { // ,    (frame becomes visible for main loop)
+     uart.recv_buf[uart.recv_tail] = size;
+     uart.recv_tail = uart.recv_wr;
+    }
    }
    else
    {
-    if (uart.recv_index >= UART_RECV_BUFF_SIZE)
+    if (size >= UART_RECV_FRAME_SIZE)
     {
      //: ! -    ,    !
+     inc_sat(uart.recv_errors);
+     state = 0;
+    }
+    else if (uart.recv_wr == uart.recv_head || ((uart.recv_wr + 1) & (UART_RECV_BUFF_SIZE - 1)) == uart.recv_head)
+    {
+     //ring buffer is full (place for size of the next frame is always kept free), frame is dropped
+     inc_sat(uart.recv_overflows);
      state = 0;
     }
     else
-     uart.recv_buf[uart.recv_index++] = chr;
+    {
+     uart.recv_buf[uart.recv_wr] = chr;
+     uart.recv_wr = (uart.recv_wr + 1) & (UART_RECV_BUFF_SIZE - 1);
+     ++size;
+    }
    }
    break;
  }
+ PRF_LEAVE(PRB_RXC);
 }
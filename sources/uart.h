@@ -28,6 +28,7 @@
 #define  _UART_H_
 
 #include <stdint.h>
+#include "port/port.h"
 
 //Here are some values for UBRR for 16.000 mHz crystal
 //
@@ -50,7 +51,14 @@
 #define  CBR_38400               0x0033 //!< 38400 baud
 #define  CBR_57600               0x0022 //!< 57600 baud
 
-#define  UART_RECV_BUFF_SIZE     82 //!< Size of receiver's buffer
+/**Size of receiver's ring buffer, must be power of 2 and must not exceed 256 (indexes are 8-bit). Buffer
+ * holds 3 frames of the maximum size (one on ATmega16, which has only 1K of RAM) */
+#ifdef _PLATFORM_M16_
+#define  UART_RECV_BUFF_SIZE     128
+#else
+#define  UART_RECV_BUFF_SIZE     256
+#endif
+#define  UART_RECV_FRAME_SIZE    73 //!< Maximum size of received frame (descriptor and data), the longest one is ADCCOR_PAR
 #define  UART_SEND_BUFF_SIZE     82 //!< Size of transmitter's buffer
 
 // Interface of the module ( )
@@ -85,9 +93,51 @@
  */
  uint8_t uart_is_packet_received(void);
 
+/**\return number of received frames which were dropped because receiver's ring buffer was full (saturated to 255) */
+ uint8_t uart_get_recv_overflows(void);
+
+/**\return number of received frames which were dropped because they were too long, had wrong size or
+ * contained garbage (saturated to 255) */
+ uint8_t uart_get_recv_errors(void);
+
+#ifdef TRACE_CAPTURE
+/**Reads byte of the frame which is currently the oldest one in the receiver's buffer (raw access, used for capturing)
+ * \param i index of byte: 0 - size of frame, 1 - descriptor, 2... - data
+ * \return value of byte
+ */
+ uint8_t uart_peek_recv(uint8_t i);
+#endif
+
+#ifdef REALTIME_TABLES
+/**Prepares bulk sending of set(s) of tables. Each call of uart_send_packet() with EDITAB_BLK descriptor
+ * will send one row of set with its CRC, until all rows are sent.
+ * \param set set of tables to send: 0, 1 - shadow sets in RAM (gasoline, gas), 2... - tunable sets
+ * in EEPROM, 0x0F - all tunable sets in EEPROM
+ */
+ void uart_bulk_start(uint8_t set);
+
+/**\return 1 if bulk sending is in progress (not all rows have been sent yet), otherwise - 0 */
+ uint8_t uart_bulk_is_active(void);
+
+/**Checks if last row of set of tables has been received by bulk transfer (flag is reset by this call)
+ * \return 1 - receiving of set has been completed, 0 - not completed
+ */
+ uint8_t uart_bulk_take_completed(void);
+
+/**\return number of rows which were not received or had wrong CRC during the last bulk transfer (0 - success,
+ * 0xFF - wrong set was requested) */
+ uint8_t uart_bulk_get_status(void);
+#endif
+
 /** \return code of current descriptor (type of frame) */
  uint8_t uart_get_send_mode(void);
 
+/**Flow of outgoing (unsolicited) data packets can be turned off by SUBSCR_PAR packet and turned on
+ * again by SUBSCR_PAR or any CHANGEMODE packet.
+ * \return 1 if periodic sending of data packets is enabled, otherwise - 0
+ */
+ uint8_t uart_is_stream_on(void);
+
 /**Sets current type of frame
  * \param descriptor code of descriptor of packet
  * \return code of passed(set) descriptor
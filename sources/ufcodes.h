@@ -37,7 +37,7 @@
 #define   FUNSET_PAR   'n'   //!< parametersrelated to set of functions (lookup tables)
 #define   STARTR_PAR   'o'   //!< engine start parameters
 
-#define   FNNAME_DAT   'p'   //!< used for transfering of names of set of functions (lookup tables)
+#define   FNNAME_DAT   'p'   //!< used for transfering of names, axes and sources of load of set of functions (lookup tables)
 #define   SENSOR_DAT   'q'   //!< used for transfering of sensors data
 
 #define   ADCCOR_PAR   'r'   //!< parameters related to ADC corrections
@@ -56,10 +56,23 @@
 #define   EDITAB_PAR   '{'   //!< used for transferring of data for realtime tables editing
 #define   ATTTAB_PAR   '}'   //!< used for transferring of attenuator map (knock detection related)
 #define   DBGVAR_DAT   ':'   //!< for watching of firmware variables (used for debug purposes)
+#define   STRTIM_DAT   '#'   //!< used for transferring of startup timings (used for debug purposes)
 
 #define   DIAGINP_DAT  '='   //!< diagnostics: send input values (analog & digital values)
 #define   DIAGOUT_DAT  '^'   //!< diagnostics: receive output states (bits)
 
 #define   CHOKE_PAR    '%'   //!< parameters  related to choke control
 
+#define   EDITAB_BLK   '|'   //!< used for bulk transferring of sets of tables (row of set and its CRC in each frame)
+
+#define   SUBSCR_PAR   '<'   //!< subscription for telemetry: mask of fields and their decimation factors
+#define   SUBSCR_DAT   '>'   //!< used for transferring of subscribed fields of telemetry
+
+#define   CE_LOG_DAT   '&'   //!< used for transferring of freeze frames log of CE errors (one record per packet)
+
+#define   TRACE_DAT    '*'   //!< used for transferring of captured trace of input events (see trace.h)
+
+#define   PROFIL_DAT   '$'   //!< used for transferring of execution time statistics (one probe per packet, see profiler.h)
+#define   STACK_DAT    '~'   //!< used for transferring of free memory and the worst depth of stack(s)
+
 #endif //_UFCODES_H_
@@ -30,8 +30,10 @@
 #include "port/port.h"
 #include "bitmask.h"
 #include "ioconfig.h"
+#include "profiler.h"
 #include "secu3.h"
 #include "ventilator.h"
+#include "vstimer.h"
 
 /**Turns on/off cooling fan
  * This is redundant definitions (see ioconfig.c), but it is opportunity to
@@ -54,17 +56,49 @@
 #endif
 #endif //COOLINGFAN_PWM
 
-/**Warning must be the same as another definition in vstimer.h!*/
-#define TIMER2_RELOAD_VALUE  6
-
-/**will be added to TIMER2_RELOAD_VALUE at the initialization */
-#define COMPADD 5
+#ifdef COOLINGFAN_PWM
+#if defined(SECU3T) && !defined(_PLATFORM_M64_)
+/**Output of cooling fan is OC2 pin (PD7), so PWM is generated by hardware of timer 2 (fast PWM mode)*/
+ #define COOLINGFAN_HWPWM
+#ifdef REV9_BOARD
+ #define COOLINGFAN_COM2 (_BV(COM21)|_BV(COM20)) //!< inverting mode (fan is turned on by low level)
+#else
+ #define COOLINGFAN_COM2 (_BV(COM21))            //!< non-inverting mode (fan is turned on by high level)
+#endif
+#endif
 
-/**number of PWM discretes */
+/**number of PWM discretes (used for software PWM) */
 #define PWM_STEPS 25
 
+/**Maximum value of duty (100%) */
+#define VENT_DUTY_MAX 255
+
+/**Step of changing of duty per 10ms (ramping), full range is passed in 0.64 sec */
+#define VENT_RAMP_STEP 4
+
+/**Time of settling after the change of duty (todo.txt item 10), in 10ms units */
+#define VENT_SETTLE_TIME 500
+
+/**Duration of kick-start pulse (100% duty) on turn on, in 10ms units */
+#define VENT_KICK_TIME 50
+
+/**Describes state of cooling fan's PWM control */
+typedef struct
+{
+ uint8_t duty;           //!< current value of duty (0...VENT_DUTY_MAX)
+ uint8_t target;         //!< target value of duty, current duty is ramping to it
+ uint8_t kick;           //!< counter of kick-start pulse
+ uint16_t settle;        //!< counter of settling time, target can not be changed until it reaches 0
+}vent_state_t;
+
+/**State variables */
+vent_state_t vent;
+
+#ifndef COOLINGFAN_HWPWM
 volatile uint8_t pwm_state; //!< For state machine. 0 - passive, 1 - active
-volatile uint8_t pwm_duty;  //!< current duty value
+volatile uint8_t pwm_duty;  //!< current duty value (0...PWM_STEPS)
+#endif
+#endif //COOLINGFAN_PWM
 
 void vent_init_ports(void)
 {
@@ -77,46 +111,64 @@ void vent_init_ports(void)
 
 void vent_init_state(void)
 {
+#ifdef COOLINGFAN_PWM
+ vent.duty = vent.target = 0; // 0%
+ vent.kick = 0;
+ vent.settle = 0;
+#ifdef COOLINGFAN_HWPWM
+ TCCR2|= _BV(WGM21)|_BV(WGM20); //fast PWM mode, period is the same as in normal mode (256 ticks)
+ OCR2 = 0;
+#else
  pwm_state = 0;  //begin from active level
  pwm_duty = 0;   // 0%
- OCR2 = TIMER2_RELOAD_VALUE + COMPADD;
+#endif
+#endif
 }
 
 #ifdef COOLINGFAN_PWM
 /**Sets duty value
- * \param duty value to be set
+ * \param duty value to be set (0...VENT_DUTY_MAX)
  */
-void vent_set_duty(uint8_t duty)
+static void vent_set_duty(uint8_t duty)
 {
- //TODO: Maybe we need double buffering?
- pwm_duty = duty;
-
- //We don't need interrupts if duty is 0 or 100%
- if (duty == 0)
- {
-  _DISABLE_INTERRUPT();
-  TIMSK&=~_BV(OCIE2);
-  _ENABLE_INTERRUPT();
-  COOLINGFAN_TURNOFF();
- }
- else if (duty == PWM_STEPS)
+ //We don't need PWM if duty is 0 or 100%
+ if (duty == 0 || duty == VENT_DUTY_MAX)
  {
+#ifdef COOLINGFAN_HWPWM
+  TCCR2&= ~(_BV(COM21)|_BV(COM20)); //disconnect OC2, pin is controlled by PORT
+#else
   _DISABLE_INTERRUPT();
   TIMSK&=~_BV(OCIE2);
   _ENABLE_INTERRUPT();
-  COOLINGFAN_TURNON();
+#endif
+  if (duty)
+   COOLINGFAN_TURNON();
+  else
+   COOLINGFAN_TURNOFF();
  }
  else
  {
+#ifdef COOLINGFAN_HWPWM
+  OCR2 = duty;                      //double buffered, updated at the bottom of timer
+  TCCR2|= COOLINGFAN_COM2;          //connect OC2
+#else
+  uint8_t sw_duty = (((uint16_t)duty) * PWM_STEPS) >> 8;
+  if (sw_duty == 0)
+   sw_duty = 1;
+  pwm_duty = sw_duty;
   _DISABLE_INTERRUPT();
   TIMSK|=_BV(OCIE2);
   _ENABLE_INTERRUPT();
+#endif
  }
 }
 
-/**T/C 2 Compare interrupt for generating of PWM (cooling fan control)*/
+#ifndef COOLINGFAN_HWPWM
+/**T/C 2 Compare interrupt for generating of PWM (cooling fan control). Timer 2 is free running,
+ * so OCR2 wraps around naturally. It is not critical if interrupt is delayed by other ones.*/
 ISR(TIMER2_COMP_vect)
 {
+ PRF_ENTER();
  if (0 == pwm_state)
  { //start active part
   COOLINGFAN_TURNON();
@@ -129,6 +181,57 @@ ISR(TIMER2_COMP_vect)
   OCR2+= (PWM_STEPS - pwm_duty);
   --pwm_state;
  }
+ PRF_LEAVE(PRB_T2COMP);
+}
+#endif
+
+/**Stops PWM and resets state of PWM control (used when PWM is disabled)*/
+static void vent_stop_pwm(void)
+{
+#ifdef COOLINGFAN_HWPWM
+ TCCR2&= ~(_BV(COM21)|_BV(COM20));
+#else
+ _DISABLE_INTERRUPT();
+ TIMSK&=~_BV(OCIE2);
+ _ENABLE_INTERRUPT();
+#endif
+ vent.duty = vent.target = vent.kick = 0;
+}
+
+/**Updates duty of PWM, called each 10ms. Applies settle rule, kick-start and ramping
+ * \param target desired value of duty (0...VENT_DUTY_MAX)
+ */
+static void vent_update_duty(uint8_t target)
+{
+ //After changing of target, it is necessary to sustain a pause, until the next possible change
+ if (vent.settle)
+  --vent.settle;
+ else if (target != vent.target)
+ {
+  //kick-start on turn on: apply full power for a short time to spin up the motor
+  if (0==vent.target && 0==vent.duty)
+   vent.kick = VENT_KICK_TIME;
+  vent.target = target;
+  vent.settle = VENT_SETTLE_TIME;
+ }
+
+ if (vent.kick)
+ {
+  if (--vent.kick)
+  {
+   vent_set_duty(VENT_DUTY_MAX);
+   return;
+  }
+  vent.duty = vent.target; //kick-start finished, continue from target
+ }
+
+ //smooth ramping of duty to target
+ if (vent.duty < vent.target)
+  vent.duty = (vent.target - vent.duty > VENT_RAMP_STEP) ? vent.duty + VENT_RAMP_STEP : vent.target;
+ else if (vent.duty > vent.target)
+  vent.duty = (vent.duty - vent.target > VENT_RAMP_STEP) ? vent.duty - VENT_RAMP_STEP : vent.target;
+
+ vent_set_duty(vent.duty);
 }
 #endif
 
@@ -149,10 +252,8 @@ void vent_control(struct ecudata_t *d)
 #else //control cooling fan either by using relay or PWM
  if (!d->param.vent_pwm)
  { //relay
-  //We don't need interrupts for relay control
-  _DISABLE_INTERRUPT();
-  TIMSK&=~_BV(OCIE2);
-  _ENABLE_INTERRUPT();
+  //We don't need PWM for relay control
+  vent_stop_pwm();
 
   if (d->sens.temperat >= d->param.vent_on)
    IOCFG_SET(IOP_ECF, 1), d->cool_fan = 1; //turn on
@@ -166,15 +267,15 @@ void vent_control(struct ecudata_t *d)
   if (dd < 2)
    dd = 0;         //restrict to max.
   if (dd > (PWM_STEPS-2))
-  {
    dd = PWM_STEPS; //restrict to min.
-   d->cool_fan = 0; //turned off
-  }
-  else
-   d->cool_fan = 1; //turned on
 
-  //TODO: implement kick on turn on
-  vent_set_duty(PWM_STEPS - dd);
+  //duty is updated each 10ms
+  if (s_timer_is_action(vent_pwm_time_counter))
+  {
+   s_timer_set(vent_pwm_time_counter, 1);
+   vent_update_duty((((uint16_t)(PWM_STEPS - dd)) * VENT_DUTY_MAX) / PWM_STEPS);
+  }
+  d->cool_fan = (vent.duty > 0 || vent.kick > 0); //turned on/off
  }
 #endif
 }
@@ -187,6 +288,9 @@ void vent_turnoff(struct ecudata_t *d)
  if (!d->param.vent_pwm)
   IOCFG_SET(IOP_ECF, 0);
  else
+ {
+  vent_stop_pwm();
   COOLINGFAN_TURNOFF();
+ }
 #endif
 }
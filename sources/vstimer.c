@@ -30,23 +30,24 @@
 #include "port/port.h"
 #include "bitmask.h"
 #include "ioconfig.h" //for SM_CONTROL
+#include "profiler.h"
 #include "secu3.h"
+#include "smcontrol.h"
 #include "vstimer.h"
 
-/**Reload value for timer 2 */
-#define TIMER2_RELOAD_VALUE  6               //for 2 ms
+/**Number of timer 2 ticks (8us) between overflows. Timer is free running, so it can be used for
+ * generation of hardware PWM (see ventilator.c) */
+#define TICKS_PER_OVF  256                   //2.048 ms
 
-/**Addition value for compare register */
-#define COMPADD 5
-
-/**Reload count for system timer's divider, to obtain 10 ms from 2 ms */
-#define DIVIDER_RELOAD 4
+/**Number of timer 2 ticks (8us) in the system tick */
+#define TICKS_PER_10MS 1250                  //10 ms
 
 //TODO: Do refactoring of timers! Implement callback mechanism.
 
 volatile s_timer8_t  send_packet_interval_counter = 0;    //!< used for sending of packets
 volatile s_timer8_t  force_measure_timeout_counter = 0;   //!< used by measuring process when engine is stopped
 volatile s_timer8_t  ce_control_time_counter = CE_CONTROL_STATE_TIME_VALUE; //!< used for counting of time intervals for CE
+volatile s_timer8_t  ce_check_time_counter = 0;           //!< used for checking and debouncing of CE errors
 volatile s_timer8_t  engine_rotation_timeout_counter = 0; //!< used to determine that engine was stopped
 volatile s_timer8_t  epxx_delay_time_counter = 0;         //!< used by idle economizer's controlling algorithm
 volatile s_timer8_t  idle_period_time_counter = 0;        //!< used by idling regulator's controlling algorithm
@@ -58,38 +59,42 @@ volatile s_timer16_t fuel_pump_time_counter = 0;          //!< used for fuel pum
 volatile s_timer8_t idl_regul_time_counter = 0;           //!< used for idl regulator
 #endif
 volatile s_timer16_t powerdown_timeout_counter = 0;       //!< used for power-down timeout 
+#ifdef COOLINGFAN_PWM
+volatile s_timer8_t vent_pwm_time_counter = 0;            //!< used for ramping of cooling fan's PWM duty
+#endif
+#ifdef SM_CONTROL
+volatile s_timer8_t choke_regul_time_counter = 0;         //!< used by choke's RPM regulator
+#endif
 
-/**for division, to achieve 10ms, because timer overflovs each 2 ms */
-uint8_t divider = DIVIDER_RELOAD;
+/**Accumulates timer's ticks to obtain 10ms, because timer overflows each 2.048 ms */
+uint16_t tick_acc = 0;
 
-#ifdef SM_CONTROL
+/**Counts system ticks (10ms) since power-on, used as runtime counter (see s_timer_gtc()) */
+volatile uint32_t sys_counter = 0;
+
+#if defined(SM_CONTROL) && !defined(SM_HWSTEP)
 //See smcontrol.c
 extern volatile uint16_t sm_steps;
 extern volatile uint8_t sm_latch;
 extern uint16_t sm_steps_b;
 extern uint8_t sm_pulse_state;
+extern volatile uint8_t sm_dir;
+extern volatile int16_t sm_pos;
 #endif
 
 /**Interrupt routine which called when T/C 2 overflovs - used for counting time intervals in system
- *(for generic usage). Called each 2ms. System tick is 10ms, and so we divide frequency by 5
+ *(for generic usage). Called each 2.048ms. System tick is 10ms, it is obtained by accumulation of
+ * timer's ticks (1250 ticks per 10ms), so the average period of system tick is exact.
  */
 ISR(TIMER2_OVF_vect)
 {
- TCNT2 = TIMER2_RELOAD_VALUE;
-
-#ifdef COOLINGFAN_PWM
- //for PWM's generation (for cooling fan). We need to reinitialize OCR2 because it looses correct value
- //(I guess) after TCNT2 write. Compare interrupt shifted in time from overflow interrupt by COMPADD
- //value
- OCR2 = TIMER2_RELOAD_VALUE + COMPADD;
-#endif
-
+ PRF_ENTER();
  _ENABLE_INTERRUPT();
 
 #ifdef IDL_REGUL
   s_timer_update(idl_regul_time_counter);           //!< used for idl regulator 2ms update
 #endif
-#ifdef SM_CONTROL
+#if defined(SM_CONTROL) && !defined(SM_HWSTEP)
  if (!sm_pulse_state && sm_latch) {
   sm_steps_b = sm_steps;
   sm_latch = 0;
@@ -105,19 +110,21 @@ ISR(TIMER2_OVF_vect)
    IOCFG_SET(IOP_SM_STP, 0); //rising edge
    sm_pulse_state = 0;
    --sm_steps_b;
+   sm_pos+= (sm_dir == SM_DIR_CCW) ? 1 : -1;
   }
  }
 #endif
 
- if (divider > 0)
-  --divider;
- else
+ tick_acc+= TICKS_PER_OVF;
+ if (tick_acc >= TICKS_PER_10MS)
  {//each 10 ms
-  divider = DIVIDER_RELOAD;
+  tick_acc-= TICKS_PER_10MS;
+  ++sys_counter;
   s_timer_update(force_measure_timeout_counter);
   s_timer_update(save_param_timeout_counter);
   s_timer_update(send_packet_interval_counter);
   s_timer_update(ce_control_time_counter);
+  s_timer_update(ce_check_time_counter);
   s_timer_update(engine_rotation_timeout_counter);
   s_timer_update(epxx_delay_time_counter);
   s_timer_update(idle_period_time_counter);
@@ -125,7 +132,14 @@ ISR(TIMER2_OVF_vect)
   s_timer_update(fuel_pump_time_counter);
 #endif
   s_timer_update(powerdown_timeout_counter);
+#ifdef COOLINGFAN_PWM
+  s_timer_update(vent_pwm_time_counter);
+#endif
+#ifdef SM_CONTROL
+  s_timer_update(choke_regul_time_counter);
+#endif
  }
+ PRF_LEAVE(PRB_T2OVF);
 }
 
 void s_timer_init(void)
@@ -134,3 +148,12 @@ void s_timer_init(void)
  TCNT2 = 0;
  TIMSK|= _BV(TOIE2);           //enable T/C 2 overflow interrupt
 }
+
+uint32_t s_timer_gtc(void)
+{
+ uint32_t value;
+ _BEGIN_ATOMIC_BLOCK();
+ value = sys_counter;
+ _END_ATOMIC_BLOCK();
+ return value;
+}
@@ -74,10 +74,16 @@ uint8_t s_timer16_is_action(s_timer16_t i_timer)
 /**Initialization of system timers */
 void s_timer_init(void);
 
+/**Get tick count (runtime counter)
+ * \return number of system ticks (10ms) since power-on
+ */
+uint32_t s_timer_gtc(void);
+
 //////////////////////////////////////////////////////////////////
 extern volatile s_timer8_t  send_packet_interval_counter;
 extern volatile s_timer8_t  force_measure_timeout_counter;
 extern volatile s_timer8_t  ce_control_time_counter;
+extern volatile s_timer8_t  ce_check_time_counter;
 extern volatile s_timer8_t  engine_rotation_timeout_counter;
 extern volatile s_timer8_t  epxx_delay_time_counter;
 extern volatile s_timer8_t  idle_period_time_counter;
@@ -90,6 +96,12 @@ extern volatile s_timer8_t idl_regul_time_counter;           //!< used for idl r
 #endif
 
 extern volatile s_timer16_t powerdown_timeout_counter;
+#ifdef COOLINGFAN_PWM
+extern volatile s_timer8_t vent_pwm_time_counter;            //!< used for ramping of cooling fan's PWM duty
+#endif
+#ifdef SM_CONTROL
+extern volatile s_timer8_t choke_regul_time_counter;         //!< used by choke's RPM regulator
+#endif
 //////////////////////////////////////////////////////////////////
 
 #endif //_VSTIMER_H_
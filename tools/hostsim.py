@@ -0,0 +1,486 @@
+#!/usr/bin/env python3
+#
+# SECU-3  - An open source, free engine control unit
+# Host simulator: firmware is compiled for the host and runs against model of engine in closed loop
+# (see tools/hostsim/hostsim.c for format of scenario and log, engine.c for settings of model).
+#
+#   hostsim.py build [--out DIR] [--opts="-DDWELL_CONTROL ..."]
+#       Builds DIR/hostsim by host gcc. Firmware is compiled for ATmega32/SECU-3T with packed structures
+#       and coverage instrumentation (each basic block advances time of simulated CPU), I/O registers
+#       are modelled by tools/hostsim/hostcpu.c.
+#   hostsim.py run SCENARIO [--out DIR] [key=value ...]
+#       Runs scenario, log goes to stdout.
+#   hostsim.py sweep [--out DIR] [--rpm 600:7000:200] [--map 60] [--time 1.5] [--tol 0.5]
+#       Runs engine at each RPM of the range (steady state) and compares measured advance angle of each
+#       spark with commanded one (ignoring first second). Exit code is 1 if any deviation exceeds --tol
+#       degrees or if firmware stops (e.g. watchdog reset), so the sweep can be used as a check in CI.
+#   hostsim.py capture SCENARIO TRACE [--out DIR]
+#       Runs scenario by simulator built with --opts=-DTRACE_CAPTURE and writes trace streamed by
+#       firmware via UART into TRACE (see tracecap.py). Scenario must start capture itself, e.g.
+#       "at 0.4 uart !u010B\r" (see hostsim/golden/*_capture.txt).
+#   hostsim.py check [--out DIR] [--update]
+#       Replays each golden trace hostsim/golden/NAME.trc (scenario NAME.txt) and compares sparks (lines
+#       "R", see hostsim/replay.c) with NAME.log. Exit code is 1 if any of them differs, --update
+#       rewrites logs. Golden logs are produced by the default build (no --opts).
+#   hostsim.py mapcmp [--out DIR] [--rpm 1000:6000:1000] [--map 60] [--puls 10] [--num 8]
+#       Compares modes of sampling of MAP (map_samp_mode): once per stroke and mean/minimum of --num
+#       crank-angle resolved samples over cycle. MAP of model pulsates with amplitude --puls kPa at
+#       frequency of strokes. Reports mean and deviation of MAP seen by firmware and delay of measurement
+#       of knock signal (samples of MAP share ADC with knock channel).
+#   hostsim.py idle [--out DIR] [--scenario hostsim/idle_load.txt] [--target 800] [key=value ...]
+#       Closed-loop test of idling regulator: runs scenario with dynamic model of engine and evaluates
+#       each phase between changes of load: RPM error, peak-to-peak RPM and advance angle in the last
+#       3 s of phase (limit cycle) and time of recovery after change of load. Exit code is 1 if any
+#       phase is out of limits (see IDLE_LIMITS).
+#   hostsim.py choke [--out DIR] [--scenario hostsim/choke_load.txt] [--target 970] [key=value ...]
+#       The same test for RPM regulator of choke (see CHOKE_LIMITS), position of choke is evaluated
+#       instead of advance angle. Simulator must be built with --opts=-DSM_CONTROL.
+#   hostsim.py fuzz [--out DIR] [--frames 2000] [--fuzz 200] [--seed N] [--divisor 0x22] [--rpm 3000]
+#       The same test of UART receiver as uartfuzz.py, but against simulated unit (engine is running):
+#       back-to-back valid frames at full baud, then invalid frames, parameters are read back before and
+#       after. Exit code is 1 if any valid frame is dropped, any invalid frame is not counted as error,
+#       parameters are changed or firmware stops.
+
+import argparse
+import difflib
+import glob
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+import tracecap
+import uartfuzz
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCES = os.path.join(HERE, '..', 'sources')
+SIMDIR = os.path.join(HERE, 'hostsim')
+GOLDEN = os.path.join(SIMDIR, 'golden')
+
+FW_FLAGS = ['-std=gnu99', '-O1', '-g', '-D__AVR_ATmega32__', '-DSECU3_HOST', '-DSECU3T', '-DLITTLE_ENDIAN_DATA_FORMAT',
+            '-fpack-struct=1', '-Wno-attributes', '-Wno-address-of-packed-member',
+            '-Wno-char-subscripts', '-Wno-int-to-pointer-cast', '-I' + SIMDIR]
+SIM_FLAGS = ['-std=gnu99', '-O2', '-g', '-Wall', '-I' + SIMDIR]
+SIM_FILES = ['hostcpu.c', 'engine.c', 'replay.c', 'hostsim.c']
+
+
+def compile_c(cc, flags, src, obj):
+    subprocess.run([cc] + flags + ['-c', src, '-o', obj], check=True)
+
+
+def build(args):
+    os.makedirs(args.out, exist_ok=True)
+    fw = FW_FLAGS + args.opts.split()
+    objs = []
+    for src in sorted(glob.glob(os.path.join(SOURCES, '*.c'))):
+        obj = os.path.join(args.out, os.path.basename(src)[:-2] + '.o')
+        compile_c(args.cc, fw + ['-fsanitize-coverage=trace-pc'], src, obj)
+        objs.append(obj)
+    # access to data of firmware needs the same layout of structures, but must not consume time of CPU
+    obj = os.path.join(args.out, 'fwglue.o')
+    compile_c(args.cc, fw + ['-I' + SOURCES], os.path.join(SIMDIR, 'fwglue.c'), obj)
+    objs.append(obj)
+    for name in SIM_FILES:
+        obj = os.path.join(args.out, name[:-2] + '.o')
+        compile_c(args.cc, SIM_FLAGS, os.path.join(SIMDIR, name), obj)
+        objs.append(obj)
+    exe = os.path.join(args.out, 'hostsim')
+    subprocess.run([args.cc, '-o', exe] + objs + ['-Wl,--wrap=load_eeprom_params', '-lm'], check=True)
+    print(exe)
+    return 0
+
+
+def simulator(args):
+    exe = os.path.join(args.out, 'hostsim')
+    if not os.path.exists(exe):
+        sys.exit('%s does not exist, run "hostsim.py build" first' % exe)
+    return exe
+
+
+def run(args):
+    return subprocess.run([simulator(args), args.scenario] + args.settings).returncode
+
+
+def parse_range(text):
+    start, stop, step = (int(v) for v in text.split(':'))
+    return range(start, stop + 1, step)
+
+
+def sweep(args):
+    exe = simulator(args)
+    failed = 0
+    with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as f:
+        f.write('set map %s\nset temp 90\nrun %s\n' % (args.map, args.time))
+        scenario = f.name
+    try:
+        print('   rpm  sparks  mean_err  max_err  adv_cmd  isr_load')
+        for rpm in parse_range(args.rpm):
+            p = subprocess.run([exe, scenario, 'rpm=%d' % rpm], stdout=subprocess.PIPE,
+                               stderr=subprocess.DEVNULL, universal_newlines=True)
+            errs, adv, end = [], 0.0, None
+            for line in p.stdout.splitlines():
+                v = line.split()
+                if v[0] == 'S' and float(v[1]) >= 1e6:
+                    errs.append(float(v[4]) - float(v[5]))
+                    adv = float(v[5])
+                elif v[0] == 'E':
+                    end = v
+            bad = p.returncode != 0 or not errs or max(abs(e) for e in errs) > args.tol
+            failed+= bad
+            if errs:
+                print('%6d  %6d  %8.3f  %7.3f  %7.2f  %7s%%%s' % (rpm, len(errs), sum(errs) / len(errs),
+                      max(errs, key=abs), adv, end[6] if end else '?', '  FAIL' if bad else ''))
+            else:
+                print('%6d  no sparks (%s)  FAIL' % (rpm, end[2] if end else 'crash'))
+    finally:
+        os.unlink(scenario)
+    print('%s: %d of %d points failed' % ('FAIL' if failed else 'OK', failed, len(parse_range(args.rpm))))
+    return 1 if failed else 0
+
+
+def mapcmp(args):
+    exe = simulator(args)
+    modes = (('stroke', 0, args.map), ('mean', 1, args.map), ('min', 2, args.map - args.puls))
+    with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as f:
+        f.write('param knock_use_knock_channel 1\nparam map_samp_num %d\nset temp 90\nset map %s\n'
+                'set map_puls %s\nlog spark 0\nlog period 0.01\nrun %s\n' % (args.num, args.map, args.puls, args.time))
+        scenario = f.name
+    try:
+        print('   rpm  mode     map_err  map_sd  knock_delay  knock_max  knock_lost')
+        for rpm in parse_range(args.rpm):
+            for name, mode, expected in modes:
+                with open(scenario, 'a') as f:
+                    f.write('param map_samp_mode %d\n' % mode)
+                p = subprocess.run([exe, scenario, 'rpm=%d' % rpm], stdout=subprocess.PIPE,
+                                   stderr=subprocess.DEVNULL, universal_newlines=True)
+                maps, end = [], None
+                for line in p.stdout.splitlines():
+                    v = line.split()
+                    if v[0] == 'T' and float(v[1]) >= 1e6:
+                        maps.append(float(v[5]))
+                    elif v[0] == 'E':
+                        end = v
+                if p.returncode or not maps or not end:
+                    print('%6d  %-6s  firmware stopped (%s)' % (rpm, name, end[2] if end else 'crash'))
+                    return 1
+                mean = sum(maps) / len(maps)
+                sd = (sum((m - mean) ** 2 for m in maps) / len(maps)) ** 0.5
+                print('%6d  %-6s  %7.2f  %6.2f  %9sus  %7sus  %10s' % (rpm, name, mean - expected, sd,
+                      end[11], end[12], end[10]))
+    finally:
+        os.unlink(scenario)
+    return 0
+
+
+# limits of idle test: |mean error|, p-p RPM (min-1), p-p advance (deg), recovery time (s)
+IDLE_LIMITS = (15, 20, 1.0, 3.0)
+IDLE_BAND = 25                   # band of recovery, min-1
+# limits of choke test: the same, but p-p position of choke (%)
+CHOKE_LIMITS = (15, 20, 2.0, 3.0)
+
+
+def closed_loop(args, limits, column, name):
+    """Runs scenario of closed-loop test and evaluates each phase between changes of load, column is index
+    of position of actuator in telemetry line (see hostsim.c)"""
+    exe = simulator(args)
+    p = subprocess.run([exe, args.scenario] + args.settings, stdout=subprocess.PIPE,
+                       stderr=subprocess.DEVNULL, universal_newlines=True)
+    tele = [(float(v[1]) / 1e6, int(v[2]), float(v[3]), float(v[column])) for v in
+            (line.split() for line in p.stdout.splitlines()) if v[0] == 'T']
+    end = [line.split() for line in p.stdout.splitlines() if line.startswith('E ')]
+    if p.returncode or not end or not tele:
+        print('FAIL: firmware stopped (%s)' % (end[0][2] if end else 'crash'))
+        return 1
+    if len(set(act for t, mode, rpm, act in tele)) < 2:
+        print('FAIL: regulator has not moved %s (e.g. firmware is built without it)' % name[:-3])
+        return 1
+    # phases begin when engine enters idling mode and at each change of load
+    changes = [float(line.split()[1]) for line in open(args.scenario)
+               if line.startswith('at ') and ' set load ' in line]
+    start = next((t for t, mode, rpm, act in tele if mode == 1), None)
+    if start is None:
+        print('FAIL: engine has not entered idling mode')
+        return 1
+    bounds = [start] + sorted(changes) + [tele[-1][0] + 1e-6]
+    failed = 0
+    print('  phase      mean_err  rpm_pp  %s  recovery' % name)
+    for t0, t1 in zip(bounds, bounds[1:]):
+        phase = [(t, rpm, act) for t, mode, rpm, act in tele if t0 <= t < t1]
+        tail = [(rpm, act) for t, rpm, act in phase if t >= t1 - 3]
+        out = [t for t, rpm, act in phase if abs(rpm - args.target) > IDLE_BAND]
+        recovery = (out[-1] - t0) if out else 0.0
+        err = sum(rpm for rpm, act in tail) / len(tail) - args.target
+        rpm_pp = max(rpm for rpm, act in tail) - min(rpm for rpm, act in tail)
+        act_pp = max(act for rpm, act in tail) - min(act for rpm, act in tail)
+        bad = abs(err) > limits[0] or rpm_pp > limits[1] or act_pp > limits[2] or \
+            (t0 != start and recovery > limits[3])
+        failed += bad
+        print('%5.1f-%-5.1f  %8.1f  %6.0f  %*.2f  %7.2fs%s' % (t0, t1, err, rpm_pp, len(name), act_pp,
+              recovery, '  FAIL' if bad else ''))
+    print('%s: %d of %d phases failed' % ('FAIL' if failed else 'OK', failed, len(bounds) - 1))
+    return 1 if failed else 0
+
+
+def idle(args):
+    return closed_loop(args, IDLE_LIMITS, 9, 'adv_pp')
+
+
+def choke(args):
+    return closed_loop(args, CHOKE_LIMITS, 13, 'choke_pp')
+
+
+def capture(args):
+    exe = simulator(args)
+    with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as f:
+        f.write(open(args.scenario).read() + '\nlog uart 1\nlog spark 0\n')
+        scenario = f.name
+    try:
+        p = subprocess.run([exe, scenario], stdout=subprocess.PIPE, universal_newlines=True)
+    finally:
+        os.unlink(scenario)
+    with open(args.trace, 'wb') as out:
+        ra, frame = tracecap.Reassembler(out), b''
+        for line in p.stdout.splitlines():
+            v = line.split()
+            if v[0] != 'U':
+                continue
+            byte = bytes([int(v[2], 16)])
+            if byte == b'\r':
+                ra.feed(frame)
+                frame = b''
+            else:
+                frame += byte
+    print('%d packets, %d lost' % (ra.packets, ra.lost))
+    if not ra.packets:
+        print('no trace, is simulator built with --opts=-DTRACE_CAPTURE?')
+    return 1 if p.returncode or not ra.packets else 0
+
+
+def check(args):
+    exe = os.path.abspath(simulator(args))
+    failed, names = 0, sorted(glob.glob(os.path.join(GOLDEN, '*.trc')))
+    for trace in names:
+        name = trace[:-4]
+        p = subprocess.run([exe, name + '.txt'], cwd=GOLDEN, stdout=subprocess.PIPE,
+                           stderr=subprocess.DEVNULL, universal_newlines=True)
+        got = [line + '\n' for line in p.stdout.splitlines() if line.startswith('R ')]
+        if args.update:
+            with open(name + '.log', 'w') as f:
+                f.writelines(got)
+            print('%s: %d lines written' % (os.path.basename(name), len(got)))
+            continue
+        expected = open(name + '.log').readlines() if os.path.exists(name + '.log') else []
+        diff = list(difflib.unified_diff(expected, got, name + '.log', 'replay'))
+        bad = p.returncode != 0 or bool(diff)
+        failed += bad
+        print('%s: %s' % (os.path.basename(name), 'FAIL' if bad else 'OK'))
+        sys.stdout.writelines(diff[:40])
+    if not args.update:
+        print('%s: %d of %d traces failed' % ('FAIL' if failed else 'OK', failed, len(names)))
+    return 1 if failed else 0
+
+
+def uart_packets(lines):
+    """Reassembles packets transmitted by firmware (lines "U" of log), returns list of
+    (time_s, descriptor, data), time is the time of the last byte"""
+    packets, frame = [], b''
+    for line in lines:
+        v = line.split()
+        if v[0] != 'U':
+            continue
+        byte = int(v[2], 16)
+        if byte != 0x0D:
+            frame += bytes([byte])
+            continue
+        at = frame.rfind(b'@')
+        if at >= 0 and len(frame) > at + 1:
+            text = frame[at + 1:].decode('latin-1')
+            packets.append((float(v[1]) / 1e6, text[0], text[1:]))
+        frame = b''
+    return packets
+
+
+class FuzzScenario:
+    """Scenario of hostsim.py fuzz: frames sent to firmware and windows of time where answers are expected"""
+    ANSWER_TIME = 0.25               # time given to firmware to answer request (s)
+    HEX_PER_LINE = 256               # bytes per command "uart_hex", fits into line of scenario
+
+    def __init__(self, head):
+        self.lines = list(head)
+        self.windows = []            # (start, end, descriptor, key)
+        self.t = 0.5
+
+    def send(self, t, data):
+        data = data.encode('latin-1')
+        for i in range(0, len(data), self.HEX_PER_LINE):
+            part = data[i:i + self.HEX_PER_LINE]
+            self.lines.append('at %.6f uart_hex %s' % (t, ' '.join('%02X' % b for b in part)))
+
+    def request(self, descriptor, data, answer, key):
+        """Sends frame, answer is the last packet with given descriptor received before the next request"""
+        self.send(self.t, '!' + descriptor + data + '\r')
+        self.windows.append((self.t, self.t + self.ANSWER_TIME, answer, key))
+        self.t += self.ANSWER_TIME
+
+    def read_params(self, key):
+        for desc in sorted(uartfuzz.PARAM_SIZES):
+            if desc not in 'ux':
+                self.request(uartfuzz.CHANGEMODE, desc, desc, (key, desc))
+
+    def read_counters(self, key):
+        decim = '1' * uartfuzz.SBSF_NUMBER
+        self.request(uartfuzz.SUBSCR_PAR, '1' + '%04X' % (1 << uartfuzz.SBSF_RECV_ERRS) + decim,
+                     uartfuzz.SUBSCR_DAT, key)
+
+    def answers(self, packets):
+        """Returns dictionary key -> data of answer (None if there is no answer)"""
+        result = {}
+        for start, end, desc, key in self.windows:
+            result[key] = None
+            for t, d, data in packets:
+                if start <= t < end and d == desc:
+                    result[key] = data
+        return result
+
+
+def counters(data):
+    """Decodes SUBSCR_DAT packet with SBSF_RECV_ERRS field, returns (overflows, errors)"""
+    if data is None or len(data) < 8:
+        return None
+    value = int(data[4:8], 16)
+    return value >> 8, value & 0xFF
+
+
+def fuzz(args):
+    exe = simulator(args)
+    rnd = random.Random(args.seed)
+    byte_time = 10 * 8 * (args.divisor + 1) / 16e6    # U2X is used, 10 bits per byte
+    sc = FuzzScenario(['set temp 90', 'set map 60', 'set rpm %d' % args.rpm, 'log spark 0',
+                       'log uart 1', 'param uart_divisor %d' % args.divisor])
+    sc.read_params('ref')
+    sc.read_counters('c0')
+
+    # throughput: valid frames back to back, firmware switches between two kinds of packets
+    burst = ''.join('!' + uartfuzz.CHANGEMODE + (uartfuzz.SENSOR_DAT if i & 1 else uartfuzz.SUBSCR_DAT) + '\r'
+                    for i in range(args.frames))
+    sc.send(sc.t, burst)
+    duration = len(burst) * byte_time
+    sc.t += duration + sc.ANSWER_TIME
+    sc.read_counters('c1')
+
+    # fuzz: frames are sent in small groups, so ring buffer never overflows
+    count = min(args.fuzz, 250)
+    for i in range(count):
+        desc, data = uartfuzz.bad_frame(rnd)
+        sc.send(sc.t, '!' + desc + data + '\r')
+        if i % 4 == 3:
+            sc.t += 0.05
+    sc.t += sc.ANSWER_TIME
+    sc.read_counters('c2')
+    sc.read_params('end')
+    sc.lines.append('run %.3f' % sc.t)
+
+    with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as f:
+        f.write('\n'.join(sc.lines) + '\n')
+        scenario = f.name
+    try:
+        p = subprocess.run([exe, scenario], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                           universal_newlines=True)
+    finally:
+        os.unlink(scenario)
+    lines = p.stdout.splitlines()
+    end = [line.split() for line in lines if line.startswith('E ')]
+    if p.returncode or not end:
+        print('FAIL: firmware stopped (%s)' % (end[0][2] if end else 'crash'))
+        return 1
+    got = sc.answers(uart_packets(lines))
+
+    failed = False
+    c0, c1, c2 = counters(got['c0']), counters(got['c1']), counters(got['c2'])
+    if None in (c0, c1, c2):
+        print('FAIL: no SUBSCR_DAT packets')
+        return 1
+    ref = {k[1]: v for k, v in got.items() if k[0] == 'ref'}
+    params = {k[1]: v for k, v in got.items() if k[0] == 'end'}
+    for p in (ref, params):
+        if None in p.values():
+            print('FAIL: no answer for %s' % ''.join(k for k, v in sorted(p.items()) if v is None))
+            return 1
+    print('counters at start: overflows %d, errors %d' % c0)
+    print('throughput: %d frames in %.3f s (%.0f frames/s), dropped by overflow: %d, errors: %d'
+          % (args.frames, duration, args.frames / duration, c1[0] - c0[0], c1[1] - c0[1]))
+    if c1 != c0:
+        print('FAIL: valid frames were dropped (firmware does not keep up with baud rate) or counted as errors')
+        failed = True
+    print('fuzz: %d invalid frames, counted as errors: %d, overflows: %d' % (count, c2[1] - c1[1], c2[0] - c1[0]))
+    if c2[1] - c1[1] != count or c2[0] != c1[0]:
+        print('FAIL: some invalid frames were not dropped (or ring buffer overflowed)')
+        failed = True
+    if params != ref:
+        print('FAIL: parameters were changed by invalid frames')
+        failed = True
+    if int(end[0][8]):
+        print('FAIL: %s bytes were lost by hardware overrun of receiver' % end[0][8])
+        failed = True
+    print('FAILED' if failed else 'PASSED')
+    return 1 if failed else 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Host simulator of SECU-3 firmware')
+    sub = ap.add_subparsers(dest='cmd')
+    sub.required = True
+    p = sub.add_parser('build', help='build simulator')
+    p.add_argument('--opts', default='', help='compile options of firmware (e.g. --opts="-DDWELL_CONTROL")')
+    p.add_argument('--cc', default='gcc')
+    p.set_defaults(func=build)
+    p = sub.add_parser('run', help='run scenario')
+    p.add_argument('scenario')
+    p.add_argument('settings', nargs='*', help='settings of model of engine (key=value)')
+    p.set_defaults(func=run)
+    p = sub.add_parser('sweep', help='check accuracy of ignition timing over range of RPM')
+    p.add_argument('--rpm', default='600:7000:200', help='start:stop:step')
+    p.add_argument('--map', default='60', help='MAP (kPa)')
+    p.add_argument('--time', default='1.5', help='duration of each point (s)')
+    p.add_argument('--tol', type=float, default=0.5, help='allowed deviation (deg)')
+    p.set_defaults(func=sweep)
+    p = sub.add_parser('mapcmp', help='compare modes of sampling of MAP')
+    p.add_argument('--rpm', default='1000:6000:1000', help='start:stop:step')
+    p.add_argument('--map', type=float, default=60, help='mean MAP (kPa)')
+    p.add_argument('--puls', type=float, default=10, help='amplitude of pulsation of MAP (kPa)')
+    p.add_argument('--num', type=int, default=8, help='number of samples per cycle (map_samp_num)')
+    p.add_argument('--time', default='2', help='duration of each point (s)')
+    p.set_defaults(func=mapcmp)
+    p = sub.add_parser('capture', help='capture trace of input events by simulator')
+    p.add_argument('scenario')
+    p.add_argument('trace')
+    p.set_defaults(func=capture)
+    p = sub.add_parser('check', help='replay golden traces and compare sparks with golden logs')
+    p.add_argument('--update', action='store_true', help='rewrite golden logs')
+    p.set_defaults(func=check)
+    p = sub.add_parser('idle', help='closed-loop test of idling regulator')
+    p.add_argument('--scenario', default=os.path.join(SIMDIR, 'idle_load.txt'))
+    p.add_argument('--target', type=float, default=800, help='target RPM of idling at temperature of scenario')
+    p.add_argument('settings', nargs='*', help='settings of model of engine (key=value)')
+    p.set_defaults(func=idle)
+    p = sub.add_parser('choke', help='closed-loop test of RPM regulator of choke')
+    p.add_argument('--scenario', default=os.path.join(SIMDIR, 'choke_load.txt'))
+    p.add_argument('--target', type=float, default=970, help='target RPM of idling at temperature of scenario')
+    p.add_argument('settings', nargs='*', help='settings of model of engine (key=value)')
+    p.set_defaults(func=choke)
+    p = sub.add_parser('fuzz', help='fuzz and throughput test of UART receiver')
+    p.add_argument('--frames', type=int, default=2000, help='number of frames in throughput test')
+    p.add_argument('--fuzz', type=int, default=200, help='number of invalid frames (<= 250)')
+    p.add_argument('--seed', type=int, default=1)
+    p.add_argument('--divisor', type=lambda v: int(v, 0), default=0x22, help='UBRR, default is 57600 baud')
+    p.add_argument('--rpm', type=int, default=3000, help='RPM of engine during test')
+    p.set_defaults(func=fuzz)
+    for p in sub.choices.values():
+        p.add_argument('--out', default='hostsim_build', help='directory of build')
+    args = ap.parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
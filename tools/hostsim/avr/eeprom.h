@@ -0,0 +1,47 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file eeprom.h
+ * Replacement of avr-libc's <avr/eeprom.h> for host build of firmware. Access goes through
+ * registers of EEPROM, so timing of programming is the same as for the interrupt-driven writer.
+ */
+
+#ifndef _HOSTSIM_AVR_EEPROM_H_
+#define _HOSTSIM_AVR_EEPROM_H_
+
+#include <avr/io.h>
+
+#define __EEGET(var, addr) do { \
+ while(EECR & _BV(EEWE)); \
+ EEAR = (addr); \
+ EECR|= _BV(EERE); \
+ (var) = (uint8_t)EEDR; \
+ } while(0)
+
+#define __EEPUT(addr, val) do { \
+ while(EECR & _BV(EEWE)); \
+ EEAR = (addr); \
+ EEDR = (val); \
+ EECR|= _BV(EEMWE); \
+ EECR|= _BV(EEWE); \
+ } while(0)
+
+#endif //_HOSTSIM_AVR_EEPROM_H_
@@ -0,0 +1,38 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file interrupt.h
+ * Replacement of avr-libc's <avr/interrupt.h> for host build of firmware. Interrupt handlers are
+ * ordinary functions, they are called by the model of microcontroller when corresponding flag is
+ * set, interrupt is enabled and I bit of SREG is set.
+ */
+
+#ifndef _HOSTSIM_AVR_INTERRUPT_H_
+#define _HOSTSIM_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define sei() (SREG|= _BV(SREG_I))
+#define cli() (SREG&= ~_BV(SREG_I))
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+
+#endif //_HOSTSIM_AVR_INTERRUPT_H_
@@ -0,0 +1,419 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file io.h
+ * Replacement of avr-libc's <avr/io.h> for host build of firmware (ATmega32 only).
+ * Registers are mapped to the model of microcontroller, bits have the same values as in the
+ * datasheet.
+ */
+
+#ifndef _HOSTSIM_AVR_IO_H_
+#define _HOSTSIM_AVR_IO_H_
+
+#include <stdint.h>
+#include "hostcpu.h"
+
+#ifndef __AVR_ATmega32__
+ #error "Host simulator supports ATmega32 only!"
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+#define _HR(id) (*host_reg(id))
+
+#define ACSR    _HR(HR_ACSR)
+#define ADC     _HR(HR_ADC)
+#define ADCW    _HR(HR_ADC)
+#define ADCSRA  _HR(HR_ADCSRA)
+#define ADMUX   _HR(HR_ADMUX)
+#define ASSR    _HR(HR_ASSR)
+#define DDRA    _HR(HR_DDRA)
+#define DDRB    _HR(HR_DDRB)
+#define DDRC    _HR(HR_DDRC)
+#define DDRD    _HR(HR_DDRD)
+#define EEAR    _HR(HR_EEAR)
+#define EECR    _HR(HR_EECR)
+#define EEDR    _HR(HR_EEDR)
+#define GICR    _HR(HR_GICR)
+#define GIFR    _HR(HR_GIFR)
+#define ICR1    _HR(HR_ICR1)
+#define MCUCR   _HR(HR_MCUCR)
+#define MCUCSR  _HR(HR_MCUCSR)
+#define OCR0    _HR(HR_OCR0)
+#define OCR1A   _HR(HR_OCR1A)
+#define OCR1B   _HR(HR_OCR1B)
+#define OCR2    _HR(HR_OCR2)
+#define OSCCAL  _HR(HR_OSCCAL)
+#define PINA    _HR(HR_PINA)
+#define PINB    _HR(HR_PINB)
+#define PINC    _HR(HR_PINC)
+#define PIND    _HR(HR_PIND)
+#define PORTA   _HR(HR_PORTA)
+#define PORTB   _HR(HR_PORTB)
+#define PORTC   _HR(HR_PORTC)
+#define PORTD   _HR(HR_PORTD)
+#define SFIOR   _HR(HR_SFIOR)
+#define SPCR    _HR(HR_SPCR)
+#define SPDR    _HR(HR_SPDR)
+#define SPH     _HR(HR_SPH)
+#define SPL     _HR(HR_SPL)
+#define SPSR    _HR(HR_SPSR)
+#define SREG    _HR(HR_SREG)
+#define TCCR0   _HR(HR_TCCR0)
+#define TCCR1A  _HR(HR_TCCR1A)
+#define TCCR1B  _HR(HR_TCCR1B)
+#define TCCR2   _HR(HR_TCCR2)
+#define TCNT0   _HR(HR_TCNT0)
+#define TCNT1   _HR(HR_TCNT1)
+#define TCNT2   _HR(HR_TCNT2)
+#define TIFR    _HR(HR_TIFR)
+#define TIMSK   _HR(HR_TIMSK)
+#define TWAR    _HR(HR_TWAR)
+#define TWBR    _HR(HR_TWBR)
+#define TWCR    _HR(HR_TWCR)
+#define TWDR    _HR(HR_TWDR)
+#define TWSR    _HR(HR_TWSR)
+#define UBRRH   _HR(HR_UBRRH)
+#define UBRRL   _HR(HR_UBRRL)
+#define UCSRA   _HR(HR_UCSRA)
+#define UCSRB   _HR(HR_UCSRB)
+#define UCSRC   _HR(HR_UCSRC)
+#define UDR     _HR(HR_UDR)
+#define WDTCR   _HR(HR_WDTCR)
+
+/* SREG */
+#define SREG_I  7
+
+/* TIMSK */
+#define OCIE2   7
+#define TOIE2   6
+#define TICIE1  5
+#define OCIE1A  4
+#define OCIE1B  3
+#define TOIE1   2
+#define OCIE0   1
+#define TOIE0   0
+
+/* TIFR */
+#define OCF2    7
+#define TOV2    6
+#define ICF1    5
+#define OCF1A   4
+#define OCF1B   3
+#define TOV1    2
+#define OCF0    1
+#define TOV0    0
+
+/* GICR */
+#define INT1    7
+#define INT0    6
+#define INT2    5
+#define IVSEL   1
+#define IVCE    0
+
+/* GIFR */
+#define INTF1   7
+#define INTF0   6
+#define INTF2   5
+
+/* MCUCR */
+#define SE      7
+#define SM2     6
+#define SM1     5
+#define SM0     4
+#define ISC11   3
+#define ISC10   2
+#define ISC01   1
+#define ISC00   0
+
+/* MCUCSR */
+#define JTD     7
+#define ISC2    6
+#define JTRF    4
+#define WDRF    3
+#define BORF    2
+#define EXTRF   1
+#define PORF    0
+
+/* TCCR0 */
+#define FOC0    7
+#define WGM00   6
+#define COM01   5
+#define COM00   4
+#define WGM01   3
+#define CS02    2
+#define CS01    1
+#define CS00    0
+
+/* TCCR1A */
+#define COM1A1  7
+#define COM1A0  6
+#define COM1B1  5
+#define COM1B0  4
+#define FOC1A   3
+#define FOC1B   2
+#define WGM11   1
+#define WGM10   0
+
+/* TCCR1B */
+#define ICNC1   7
+#define ICES1   6
+#define WGM13   4
+#define WGM12   3
+#define CS12    2
+#define CS11    1
+#define CS10    0
+
+/* TCCR2 */
+#define FOC2    7
+#define WGM20   6
+#define COM21   5
+#define COM20   4
+#define WGM21   3
+#define CS22    2
+#define CS21    1
+#define CS20    0
+
+/* ASSR */
+#define AS2     3
+
+/* SFIOR */
+#define PUD     2
+#define PSR2    1
+#define PSR10   0
+
+/* ADMUX */
+#define REFS1   7
+#define REFS0   6
+#define ADLAR   5
+#define MUX4    4
+#define MUX3    3
+#define MUX2    2
+#define MUX1    1
+#define MUX0    0
+
+/* ADCSRA */
+#define ADEN    7
+#define ADSC    6
+#define ADATE   5
+#define ADIF    4
+#define ADIE    3
+#define ADPS2   2
+#define ADPS1   1
+#define ADPS0   0
+
+/* ACSR */
+#define ACD     7
+#define ACBG    6
+#define ACO     5
+#define ACI     4
+#define ACIE    3
+#define ACIC    2
+#define ACIS1   1
+#define ACIS0   0
+
+/* SPCR */
+#define SPIE    7
+#define SPE     6
+#define DORD    5
+#define MSTR    4
+#define CPOL    3
+#define CPHA    2
+#define SPR1    1
+#define SPR0    0
+
+/* SPSR */
+#define SPIF    7
+#define WCOL    6
+#define SPI2X   0
+
+/* UCSRA */
+#define RXC     7
+#define TXC     6
+#define UDRE    5
+#define FE      4
+#define DOR     3
+#define PE      2
+#define U2X     1
+#define MPCM    0
+
+/* UCSRB */
+#define RXCIE   7
+#define TXCIE   6
+#define UDRIE   5
+#define RXEN    4
+#define TXEN    3
+#define UCSZ2   2
+#define RXB8    1
+#define TXB8    0
+
+/* UCSRC */
+#define URSEL   7
+#define UMSEL   6
+#define UPM1    5
+#define UPM0    4
+#define USBS    3
+#define UCSZ1   2
+#define UCSZ0   1
+#define UCPOL   0
+
+/* EECR */
+#define EERIE   3
+#define EEMWE   2
+#define EEWE    1
+#define EERE    0
+
+/* WDTCR */
+#define WDTOE   4
+#define WDE     3
+#define WDP2    2
+#define WDP1    1
+#define WDP0    0
+
+/* Bits of ports */
+#define PA7 7
+#define PA6 6
+#define PA5 5
+#define PA4 4
+#define PA3 3
+#define PA2 2
+#define PA1 1
+#define PA0 0
+#define PB7 7
+#define PB6 6
+#define PB5 5
+#define PB4 4
+#define PB3 3
+#define PB2 2
+#define PB1 1
+#define PB0 0
+#define PC7 7
+#define PC6 6
+#define PC5 5
+#define PC4 4
+#define PC3 3
+#define PC2 2
+#define PC1 1
+#define PC0 0
+#define PD7 7
+#define PD6 6
+#define PD5 5
+#define PD4 4
+#define PD3 3
+#define PD2 2
+#define PD1 1
+#define PD0 0
+
+#define DDA7 7
+#define DDA6 6
+#define DDA5 5
+#define DDA4 4
+#define DDA3 3
+#define DDA2 2
+#define DDA1 1
+#define DDA0 0
+#define DDB7 7
+#define DDB6 6
+#define DDB5 5
+#define DDB4 4
+#define DDB3 3
+#define DDB2 2
+#define DDB1 1
+#define DDB0 0
+#define DDC7 7
+#define DDC6 6
+#define DDC5 5
+#define DDC4 4
+#define DDC3 3
+#define DDC2 2
+#define DDC1 1
+#define DDC0 0
+#define DDD7 7
+#define DDD6 6
+#define DDD5 5
+#define DDD4 4
+#define DDD3 3
+#define DDD2 2
+#define DDD1 1
+#define DDD0 0
+
+#define PINA7 7
+#define PINA6 6
+#define PINA5 5
+#define PINA4 4
+#define PINA3 3
+#define PINA2 2
+#define PINA1 1
+#define PINA0 0
+#define PINB7 7
+#define PINB6 6
+#define PINB5 5
+#define PINB4 4
+#define PINB3 3
+#define PINB2 2
+#define PINB1 1
+#define PINB0 0
+#define PINC7 7
+#define PINC6 6
+#define PINC5 5
+#define PINC4 4
+#define PINC3 3
+#define PINC2 2
+#define PINC1 1
+#define PINC0 0
+#define PIND7 7
+#define PIND6 6
+#define PIND5 5
+#define PIND4 4
+#define PIND3 3
+#define PIND2 2
+#define PIND1 1
+#define PIND0 0
+
+/* Interrupt vectors. Handlers are called by the model (see hostcpu.c) */
+#define INT0_vect          host_vect_int0
+#define INT1_vect          host_vect_int1
+#define INT2_vect          host_vect_int2
+#define TIMER2_COMP_vect   host_vect_timer2_comp
+#define TIMER2_OVF_vect    host_vect_timer2_ovf
+#define TIMER1_CAPT_vect   host_vect_timer1_capt
+#define TIMER1_COMPA_vect  host_vect_timer1_compa
+#define TIMER1_COMPB_vect  host_vect_timer1_compb
+#define TIMER1_OVF_vect    host_vect_timer1_ovf
+#define TIMER0_COMP_vect   host_vect_timer0_comp
+#define TIMER0_OVF_vect    host_vect_timer0_ovf
+#define SPI_STC_vect       host_vect_spi_stc
+#define USART_RXC_vect     host_vect_usart_rxc
+#define USART_UDRE_vect    host_vect_usart_udre
+#define USART_TXC_vect     host_vect_usart_txc
+#define ADC_vect           host_vect_adc
+#define EE_RDY_vect        host_vect_ee_rdy
+#define ANA_COMP_vect      host_vect_ana_comp
+#define TWI_vect           host_vect_twi
+#define SPM_RDY_vect       host_vect_spm_rdy
+
+#define RAMEND     0x85F
+#define XRAMEND    0x85F
+#define E2END      0x3FF
+#define FLASHEND   0x7FFF
+#define SPM_PAGESIZE 128
+
+#endif //_HOSTSIM_AVR_IO_H_
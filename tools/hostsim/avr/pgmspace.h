@@ -0,0 +1,46 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file pgmspace.h
+ * Replacement of avr-libc's <avr/pgmspace.h> for host build of firmware. Constant objects are
+ * ordinary constants of the host, code of firmware is represented by image of FLASH.
+ */
+
+#ifndef _HOSTSIM_AVR_PGMSPACE_H_
+#define _HOSTSIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "hostcpu.h"
+
+#define __progmem__ __unused__
+#define PROGMEM
+
+typedef uint8_t prog_uint8_t;
+typedef uint16_t prog_uint16_t;
+typedef uint32_t prog_uint32_t;
+
+#define pgm_read_byte(addr) host_pgm_read_byte((const void*)(addr))
+#define pgm_read_word(addr) host_pgm_read_word((const void*)(addr))
+#define pgm_read_dword(addr) host_pgm_read_dword((const void*)(addr))
+#define memcpy_P(dest, src, size) host_memcpy_P((dest), (const void*)(src), (size))
+
+#endif //_HOSTSIM_AVR_PGMSPACE_H_
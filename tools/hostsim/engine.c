@@ -0,0 +1,489 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file engine.c
+ * Model of engine and sensors for host simulator.
+ *
+ * Crankshaft: angle runs over 0...720 degrees of engine cycle, angular speed is assumed to be
+ * constant between two consecutive events of the model (edges of trigger wheel's teeth are
+ * half of tooth apart, so it is less than 3 degrees for 60-2 wheel). Active edge of tooth k is
+ * at k*pitch (+360 for the second revolution), teeth k >= N-M are missing, so tooth 0 is the
+ * first tooth after the gap (tooth 1 for firmware). TDC of the 1st cylinder is at the active
+ * edge of tooth (ckps_cogs_btdc-1).
+ *
+ * Speed is either scripted (steps and linear ramps of RPM) or calculated (mode "dyn") from mean
+ * value model: indicated torque depends on MAP and on deviation of measured advance angle from
+ * MBT, MAP follows flow of air through throttle and idle air bypass with lag, friction torque
+ * depends linearly on RPM.
+ *
+ * Choke (firmware built with SM_CONTROL): position of choke follows steps of firmware's stepper motor
+ * and is restricted by stops (0 - open, sm_steps - closed), initial position is unknown to firmware.
+ * Linkage of choke opens throttle (fast idle), so closing adds air: choke_air at full closing.
+ *
+ * Spark is the rising edge of ignition output, falling edge is the beginning of dwell. Measured
+ * advance angle is the distance from spark to the nearest TDC (TDCs are 720/cyl degrees apart).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+
+#define MAX_EVENTS   1024          //!< maximum number of edges per engine cycle
+#define ADC_VREF     2.56          //!< reference voltage of ADC
+#define ADC_CHANNELS 8
+#define IGN_CHANNELS 4
+
+//Channels of ADC (see adc.c)
+#define ADCI_TEMP    0
+#define ADCI_UBAT    1
+#define ADCI_MAP     2
+#define ADCI_KNOCK   3
+#define ADCI_CARB    7             //!< TPS on SECU-3T
+
+/**Edge of signal of one of sensors, position is in degrees of engine cycle */
+typedef struct
+{
+ double angle;
+ uint8_t port, bit, level;
+}edge_t;
+
+/**Settings of model, see eng_set() for names */
+static struct
+{
+ //geometry, the first six values are taken from parameters of firmware (see eng_init())
+ double cogs, miss, cogs_btdc, cyl, edge_type, ref_s_edge;
+ double cam_angle, cam_width;      //!< pulse of cam sensor (deg of cycle), width 0 - no cam sensor
+ //speed
+ double rpm, ramp;                 //!< target RPM and rate of its change (RPM/s, 0 - step)
+ double dyn;                       //!< 1 - speed is calculated from torques
+ double inertia;                   //!< moment of inertia (kg*m^2)
+ double starter;                   //!< 1 - starter is cranking
+ double crank_rpm;                 //!< RPM of cranking
+ double tq_map;                    //!< indicated torque per kPa of MAP (N*m/kPa) at MBT
+ double mbt0, mbt_rpm;             //!< MBT = mbt0 + mbt_rpm * rpm/1000 (deg)
+ double eff_width;                 //!< deviation from MBT which halves torque (deg)
+ double fric0, fric1;              //!< friction torque: fric0 + fric1 * rpm (N*m)
+ double load;                      //!< external load torque (N*m)
+ double air_idle;                  //!< idle air bypass (relative area, throttle fully open = 1)
+ double air_choke;                 //!< extra air from choke/idle air valve (relative area)
+ double choke_air;                 //!< air added by choke at full closing (relative area), 0 - no choke
+ double choke_init;                //!< initial position of choke (0 - open, 1 - closed)
+ double air_k;                     //!< MAP_ss = baro * A/(A + air_k * rpm/1000)
+ double map_tau;                   //!< time constant of intake manifold (s)
+ //sensors
+ double map;                       //!< MAP (kPa) if mode is not "dyn"
+ double baro;                      //!< atmospheric pressure (kPa)
+ double map_puls;                  //!< amplitude of pulsation of MAP (kPa)
+ double temp, ubat, tps;           //!< coolant temperature (C), voltage (V), throttle (%)
+ double knock_limit;               //!< advance angle above which engine knocks (deg)
+ double knock_gain;                //!< voltage of knock signal per degree above limit (V/deg)
+ double knock_noise;               //!< amplitude of background noise of knock signal (V)
+ double adc[ADC_CHANNELS];         //!< voltages on pins of ADC (< 0 - calculated by model)
+}cfg = {
+ 60, 2, 20, 4, 0, 0,
+ 660, 0,
+ 0, 0,
+ 0, 0.15, 0, 200, 1.3, 12, 4, 25, 30, 0.004, 0, 0.02, 0, 0, 0.5, 0.05, 0.03,
+ 100, 100, 0, 80, 13.8, 0,
+ 90, 0.3, 0.1,
+ {-1, -1, -1, -1, -1, -1, -1, -1}
+};
+
+/**State of model */
+static struct
+{
+ edge_t ev[MAX_EVENTS];            //!< edges over engine cycle sorted by angle
+ int nev, iev;                     //!< number of edges, index of the next one
+ double theta;                     //!< crank angle at t_upd (deg of cycle)
+ uint64_t t_upd;                   //!< time of last update
+ double rpm;                       //!< current RPM
+ double map;                       //!< current MAP (kPa), dynamic mode
+ uint64_t t_next;                  //!< time of the next edge
+ double tdc1;                      //!< angle of TDC of the 1st cylinder
+ double last_adv;                  //!< last measured advance angle
+ uint64_t t_spark;                 //!< time of last spark
+ uint64_t t_dwell[IGN_CHANNELS];   //!< beginning of dwell in each channel
+ uint8_t ign_level[IGN_CHANNELS];
+ double adv_sum, adv_sqsum;        //!< statistics of measured advance angles
+ unsigned sparks;
+ uint64_t t_hold;                  //!< time when knock integrator was switched to hold, 0 - measured
+ uint64_t knock_delay_max;         //!< maximum delay of measurement of held knock signal (cycles)
+ uint64_t knock_delay_sum;         //!< sum of delays of measurement of held knock signal (cycles)
+ unsigned knock_meas, knock_lost;  //!< numbers of measured and lost (not measured until next integration) values
+ double choke;                     //!< position of choke (0 - open, 1 - closed)
+ int16_t sm_pos;                   //!< last seen position counter of firmware's stepper motor
+ uint8_t sm_seen;                  //!< sm_pos is valid
+}st;
+
+static double deg_per_cycle(void)
+{
+ return st.rpm * 6.0 / HOST_F_CPU; //rpm*360/60 degrees per second
+}
+
+static int edge_cmp(const void* a, const void* b)
+{
+ double d = ((const edge_t*)a)->angle - ((const edge_t*)b)->angle;
+ return (d > 0) - (d < 0);
+}
+
+static void add_edge(double angle, uint8_t port, uint8_t bit, uint8_t level)
+{
+ if (st.nev >= MAX_EVENTS)
+  return;
+ angle = fmod(angle, 720.0);
+ if (angle < 0)
+  angle+= 720.0;
+ st.ev[st.nev].angle = angle;
+ st.ev[st.nev].port = port;
+ st.ev[st.nev].bit = bit;
+ st.ev[st.nev].level = level;
+ ++st.nev;
+}
+
+/**Builds list of edges of crankshaft, cam and reference sensors */
+static void build_edges(void)
+{
+ int n = (int)cfg.cogs, m = (int)cfg.miss, k, rev;
+ double pitch = 360.0 / n;
+ uint8_t act = cfg.edge_type ? 1 : 0;
+ st.nev = 0;
+ for(rev = 0; rev < 2; ++rev)
+  for(k = 0; k < n - m; ++k)
+  { //CKP sensor, ICP1 (PD6)
+   add_edge(rev * 360.0 + k * pitch, HP_D, 6, act);
+   add_edge(rev * 360.0 + (k + 0.5) * pitch, HP_D, 6, !act);
+  }
+ if (cfg.cam_width > 0)
+ { //Hall cam sensor, INT1 (PD3)
+  add_edge(cfg.cam_angle, HP_D, 3, 0);
+  add_edge(cfg.cam_angle + cfg.cam_width, HP_D, 3, 1);
+ }
+ if (0 == m)
+ { //reference VR sensor, REF_S - INT0 (PD2), just before the 1st tooth
+  uint8_t ract = cfg.ref_s_edge ? 1 : 0;
+  for(rev = 0; rev < 2; ++rev)
+  {
+   add_edge(rev * 360.0 - pitch / 2, HP_D, 2, ract);
+   add_edge(rev * 360.0 - pitch / 4, HP_D, 2, !ract);
+  }
+ }
+ qsort(st.ev, st.nev, sizeof(edge_t), edge_cmp);
+ st.tdc1 = (cfg.cogs_btdc - 1) * pitch;
+}
+
+/**Finds the first edge after current angle */
+static void seek_edge(void)
+{
+ st.iev = 0;
+ while(st.iev < st.nev && st.ev[st.iev].angle <= st.theta)
+  ++st.iev;
+}
+
+static void schedule(void)
+{
+ double dpc = deg_per_cycle(), angle;
+ if (!st.nev || dpc <= 0)
+ {
+  st.t_next = HOST_NEVER;
+  return;
+ }
+ angle = (st.iev < st.nev) ? st.ev[st.iev].angle : 720.0 + st.ev[0].angle;
+ st.t_next = st.t_upd + (uint64_t)ceil((angle - st.theta) / dpc);
+ if (st.t_next <= st.t_upd)
+  st.t_next = st.t_upd + 1;
+}
+
+/**Crank angle at specified time (t >= time of last update) */
+static double angle_at(uint64_t t)
+{
+ return fmod(st.theta + (double)(t - st.t_upd) * deg_per_cycle(), 720.0);
+}
+
+/**Efficiency of combustion as function of advance angle */
+static double efficiency(double adv)
+{
+ double d = (adv - (cfg.mbt0 + cfg.mbt_rpm * st.rpm / 1000.0)) / cfg.eff_width;
+ return 1.0 / (1.0 + d * d);
+}
+
+/**Moves choke by steps done by firmware since the last call */
+static void choke_update(void)
+{
+ int16_t pos;
+ uint16_t steps;
+ if (!glue_get_stepper(&pos, &steps) || !steps)
+  return;
+ if (st.sm_seen)
+  st.choke = fmin(fmax(st.choke + (int16_t)(pos - st.sm_pos) / (double)steps, 0), 1);
+ st.sm_pos = pos;
+ st.sm_seen = 1;
+}
+
+/**Advances state of crankshaft and intake manifold to specified time */
+static void update(uint64_t t)
+{
+ double dt = (double)(t - st.t_upd) / HOST_F_CPU;
+ st.theta = angle_at(t);
+ st.t_upd = t;
+ if (dt <= 0)
+  return;
+
+ if (cfg.dyn)
+ {
+  double area, map_ss, tq;
+  choke_update();
+  area = cfg.tps / 100.0 + cfg.air_idle + cfg.air_choke + cfg.choke_air * st.choke;
+  map_ss = cfg.baro * area / (area + cfg.air_k * st.rpm / 1000.0);
+  st.map+= (map_ss - st.map) * (1.0 - exp(-dt / cfg.map_tau));
+  //engine produces torque only if there are sparks (two strokes at least)
+  tq = 0;
+  if (st.sparks && st.rpm > 0 && (double)(t - st.t_spark) / HOST_F_CPU < 2 * 120.0 / (st.rpm * cfg.cyl))
+   tq = cfg.tq_map * st.map * efficiency(st.last_adv);
+  tq-= cfg.fric0 + cfg.fric1 * st.rpm + cfg.load;
+  st.rpm+= tq / cfg.inertia * dt * 60.0 / (2 * M_PI);
+  if (cfg.starter && st.rpm < cfg.crank_rpm)
+   st.rpm = cfg.crank_rpm;
+  if (st.rpm < 0)
+   st.rpm = 0;
+ }
+ else if (cfg.ramp > 0)
+ {
+  double step = cfg.ramp * dt;
+  if (fabs(cfg.rpm - st.rpm) <= step)
+   st.rpm = cfg.rpm;
+  else
+   st.rpm+= (cfg.rpm > st.rpm) ? step : -step;
+ }
+ else
+  st.rpm = cfg.rpm;
+}
+
+uint64_t eng_next_event(void)
+{
+ return st.t_next;
+}
+
+void eng_process(void)
+{
+ edge_t* e;
+ if (HOST_NEVER == st.t_next)
+  return;
+ update(st.t_next);
+ if (st.iev >= st.nev)
+ { //next cycle
+  st.iev = 0;
+ }
+ e = &st.ev[st.iev];
+ st.theta = e->angle; //avoid accumulation of rounding errors
+ hcpu_set_pin(e->port, e->bit, e->level, st.t_upd);
+ ++st.iev;
+ schedule();
+}
+
+void eng_init(void)
+{
+ static const char* const geo[] = {"ckps_cogs_num", "ckps_miss_num", "ckps_cogs_btdc",
+  "ckps_engine_cyl", "ckps_edge_type", "ref_s_edge_type"};
+ double* dst[] = {&cfg.cogs, &cfg.miss, &cfg.cogs_btdc, &cfg.cyl, &cfg.edge_type, &cfg.ref_s_edge};
+ size_t i;
+ for(i = 0; i < sizeof(geo) / sizeof(geo[0]); ++i)
+  *dst[i] = glue_get_param(geo[i]);
+ memset(&st, 0, sizeof(st));
+ st.map = cfg.baro;
+ st.last_adv = cfg.mbt0;
+ st.choke = cfg.choke_init;
+ build_edges();
+ //initial levels of sensors' outputs (inactive state)
+ hcpu_set_pin(HP_D, 6, cfg.edge_type ? 0 : 1, 0);
+ st.theta = 720.0 - 360.0 / cfg.cogs / 4; //just before tooth 0
+ seek_edge();
+ st.rpm = cfg.dyn ? (cfg.starter ? cfg.crank_rpm : 0) : (cfg.ramp > 0 ? 0 : cfg.rpm);
+ schedule();
+}
+
+int eng_set(const char* key, double value)
+{
+ static const struct { const char* name; double* var; int geo; } vars[] = {
+  {"cam_angle", &cfg.cam_angle, 1}, {"cam_width", &cfg.cam_width, 1},
+  {"rpm", &cfg.rpm, 0}, {"ramp", &cfg.ramp, 0}, {"dyn", &cfg.dyn, 0},
+  {"inertia", &cfg.inertia, 0}, {"starter", &cfg.starter, 0}, {"crank_rpm", &cfg.crank_rpm, 0},
+  {"tq_map", &cfg.tq_map, 0}, {"mbt0", &cfg.mbt0, 0}, {"mbt_rpm", &cfg.mbt_rpm, 0},
+  {"eff_width", &cfg.eff_width, 0}, {"fric0", &cfg.fric0, 0}, {"fric1", &cfg.fric1, 0},
+  {"load", &cfg.load, 0}, {"air_idle", &cfg.air_idle, 0}, {"air_choke", &cfg.air_choke, 0},
+  {"choke_air", &cfg.choke_air, 0}, {"choke_init", &cfg.choke_init, 0},
+  {"air_k", &cfg.air_k, 0}, {"map_tau", &cfg.map_tau, 0},
+  {"map", &cfg.map, 0}, {"baro", &cfg.baro, 0}, {"map_puls", &cfg.map_puls, 0},
+  {"temp", &cfg.temp, 0}, {"ubat", &cfg.ubat, 0}, {"tps", &cfg.tps, 0},
+  {"knock_limit", &cfg.knock_limit, 0}, {"knock_gain", &cfg.knock_gain, 0},
+  {"knock_noise", &cfg.knock_noise, 0},
+  {"adc0", &cfg.adc[0], 0}, {"adc1", &cfg.adc[1], 0}, {"adc2", &cfg.adc[2], 0},
+  {"adc3", &cfg.adc[3], 0}, {"adc4", &cfg.adc[4], 0}, {"adc5", &cfg.adc[5], 0},
+  {"adc6", &cfg.adc[6], 0}, {"adc7", &cfg.adc[7], 0}};
+ size_t i;
+ for(i = 0; i < sizeof(vars) / sizeof(vars[0]); ++i)
+  if (!strcmp(key, vars[i].name))
+  {
+   if (st.nev)
+    update(host_now > st.t_upd ? host_now : st.t_upd);
+   *vars[i].var = value;
+   if (vars[i].geo && st.nev)
+   {
+    build_edges();
+    seek_edge();
+   }
+   if (!cfg.dyn && cfg.ramp <= 0 && st.nev)
+    st.rpm = cfg.rpm;
+   if (st.nev)
+   {
+    schedule();
+    hcpu_reschedule();
+   }
+   return 1;
+  }
+ return 0;
+}
+
+double eng_get_rpm(void)
+{
+ return st.rpm;
+}
+
+double eng_get_map(void)
+{
+ return cfg.dyn ? st.map : cfg.map;
+}
+
+double eng_get_choke(void)
+{
+ return st.choke;
+}
+
+void eng_get_knock_stat(unsigned* count, unsigned* lost, double* delay_mean, double* delay_max)
+{
+ *count = st.knock_meas;
+ *lost = st.knock_lost;
+ *delay_mean = st.knock_meas ? st.knock_delay_sum * 1e6 / HOST_F_CPU / st.knock_meas : 0;
+ *delay_max = st.knock_delay_max * 1e6 / HOST_F_CPU;
+}
+
+void eng_get_adv_stat(unsigned* count, double* mean, double* sd)
+{
+ *count = st.sparks;
+ *mean = st.sparks ? st.adv_sum / st.sparks : 0;
+ *sd = st.sparks > 1 ? sqrt(fmax(0, st.adv_sqsum / st.sparks - (*mean) * (*mean))) : 0;
+}
+
+/**Uniformly distributed noise in range -1...1 (own generator, so results are repeatable) */
+static double noise(void)
+{
+ static uint32_t seed = 12345;
+ seed = seed * 1103515245 + 12345;
+ return ((seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+}
+
+uint16_t eng_adc(uint8_t channel, uint64_t t)
+{
+ double v;
+ channel&= 7;
+ if (cfg.adc[channel] >= 0)
+  v = cfg.adc[channel] / (ADC_VREF / 1024);
+ else if (ADCI_KNOCK == channel)
+ {
+  double over = st.last_adv - cfg.knock_limit;
+  if (st.t_hold)
+  { //conversion samples held value of integrator
+   if (t - st.t_hold > st.knock_delay_max)
+    st.knock_delay_max = t - st.t_hold;
+   st.knock_delay_sum+= t - st.t_hold;
+   ++st.knock_meas;
+   st.t_hold = 0;
+  }
+  v = cfg.knock_noise * (1.0 + noise()) / 2 + ((over > 0) ? cfg.knock_gain * over : 0);
+  v/= 2 * ADC_VREF / 1024; //input divider 1/2, firmware multiplies code by 2 (see measure.c)
+ }
+ else if (ADCI_MAP == channel)
+ {
+  double p = eng_get_map();
+  if (cfg.map_puls && st.rpm > 0)
+   p+= cfg.map_puls * sin(angle_at(t > st.t_upd ? t : st.t_upd) * cfg.cyl / 2 * M_PI / 180.0);
+  return glue_adc_code(channel, p);
+ }
+ else if (ADCI_UBAT == channel)
+  return glue_adc_code(channel, cfg.ubat);
+ else if (ADCI_TEMP == channel)
+  return glue_adc_code(channel, cfg.temp);
+ else if (ADCI_CARB == channel)
+  return glue_adc_code(channel, cfg.tps);
+ else
+  v = 0;
+ if (v < 0)
+  v = 0;
+ return (v > 1023) ? 1023 : (uint16_t)(v + 0.5);
+}
+
+/**\return index of ignition channel connected to specified pin, -1 - not an ignition output */
+static int ign_channel(uint8_t port, uint8_t bit)
+{
+ if (HP_D == port && (4 == bit || 5 == bit))
+  return bit - 4;
+ if (HP_C == port && bit < 2)
+  return bit + 2;
+ return -1;
+}
+
+void eng_port_edge(uint8_t port, uint8_t bit, uint8_t level, uint64_t t)
+{
+ int ch = ign_channel(port, bit);
+ double theta, adv, stroke, dwell;
+ if (HP_C == port && 4 == bit)
+ { //INT/HOLD of knock signal processor (SECU-3T), 0 - hold. Only holds after sparks are counted,
+   //firmware also holds integrator during initialization
+  if (st.t_hold)
+   ++st.knock_lost;
+  st.t_hold = (level || !st.sparks) ? 0 : t;
+  return;
+ }
+ if (ch < 0)
+  return;
+ st.ign_level[ch] = level;
+ if (!level)
+ { //beginning of dwell
+  st.t_dwell[ch] = t;
+  return;
+ }
+ if (st.rpm <= 0 || !st.nev || t < st.t_upd)
+  return;
+ theta = angle_at(t);
+ stroke = 720.0 / cfg.cyl;
+ adv = fmod(st.tdc1 - theta + 720.0 * 2, stroke);
+ if (adv > stroke / 2)
+  adv-= stroke;
+ dwell = st.t_dwell[ch] ? (double)(t - st.t_dwell[ch]) * 1000.0 / HOST_F_CPU : 0;
+ st.t_dwell[ch] = 0;
+ st.last_adv = adv;
+ st.t_spark = t;
+ ++st.sparks;
+ st.adv_sum+= adv;
+ st.adv_sqsum+= adv * adv;
+ sim_spark((uint8_t)ch, t, st.rpm, adv, dwell);
+}
@@ -0,0 +1,257 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file fwglue.c
+ * Access of host simulator to data of firmware. This file is compiled with the same options as
+ * firmware (packed structures, the same compile options), but it is not instrumented, so it does
+ * not consume time of simulated CPU.
+ *
+ * Parameters given by scenario are applied right after firmware has loaded its parameters:
+ * simulator is linked with --wrap=load_eeprom_params, so call from main() comes here.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "port/avrio.h"
+#include "adc.h"
+#include "ckps.h"
+#include "crc16.h"
+#include "params.h"
+#include "secu3.h"
+#include "tables.h"
+#include "hostsim.h"
+
+#define MAX_OVERRIDES 64
+
+/**Describes field of params_t */
+typedef struct
+{
+ const char* name;
+ uint16_t offset;
+ uint8_t size;
+ uint8_t is_signed;
+}param_desc_t;
+
+#define PD(f) {#f, offsetof(params_t, f), sizeof(((params_t*)0)->f), \
+ (__typeof__(((params_t*)0)->f))-1 < 0}
+
+static const param_desc_t param_desc[] = {
+ PD(tmp_use), PD(carb_invers), PD(idl_regul), PD(fn_gasoline), PD(fn_gas), PD(map_lower_pressure),
+ PD(ie_lot), PD(ie_hit), PD(starter_off), PD(map_upper_pressure), PD(smap_abandon), PD(max_angle),
+ PD(min_angle), PD(angle_corr), PD(idling_rpm), PD(ifac1), PD(ifac2), PD(MINEFR), PD(vent_on),
+ PD(vent_off), PD(map_adc_factor), PD(map_adc_correction), PD(ubat_adc_factor),
+ PD(ubat_adc_correction), PD(temp_adc_factor), PD(temp_adc_correction), PD(ckps_edge_type),
+ PD(ckps_cogs_btdc), PD(ckps_ignit_cogs), PD(angle_dec_spead), PD(angle_inc_spead),
+ PD(idlreg_min_angle), PD(idlreg_max_angle), PD(map_curve_offset), PD(map_curve_gradient),
+ PD(fe_on_threshold), PD(ie_lot_g), PD(ie_hit_g), PD(shutoff_delay), PD(uart_divisor),
+ PD(uart_period_t_ms), PD(ckps_engine_cyl), PD(knock_use_knock_channel), PD(knock_bpf_frequency),
+ PD(knock_k_wnd_begin_angle), PD(knock_k_wnd_end_angle), PD(knock_int_time_const),
+ PD(knock_retard_step), PD(knock_advance_step), PD(knock_max_retard), PD(knock_threshold),
+ PD(knock_recovery_delay), PD(vent_pwm), PD(ign_cutoff), PD(ign_cutoff_thrd), PD(zero_adv_ang),
+ PD(merge_ign_outs), PD(hop_start_cogs), PD(hop_durat_cogs), PD(cts_use_map), PD(ckps_cogs_num),
+ PD(ckps_miss_num), PD(ref_s_edge_type), PD(tps_adc_factor), PD(tps_adc_correction),
+ PD(ai1_adc_factor), PD(ai1_adc_correction), PD(ai2_adc_factor), PD(ai2_adc_correction),
+ PD(tps_curve_offset), PD(tps_curve_gradient), PD(tps_threshold), PD(sm_steps),
+ PD(idlreg_turn_on_temp), PD(map_samp_mode), PD(map_samp_num), PD(map_samp_offset), PD(baro_mode)
+};
+
+/**Parameters given by scenario */
+static struct
+{
+ const param_desc_t* desc;
+ long value;
+}overrides[MAX_OVERRIDES];
+static uint8_t overrides_num;
+
+static uint8_t params_loaded;      //!< parameters have been loaded by firmware
+
+static const param_desc_t* find_param(const char* name)
+{
+ size_t i;
+ for(i = 0; i < sizeof(param_desc) / sizeof(param_desc[0]); ++i)
+  if (!strcmp(name, param_desc[i].name))
+   return &param_desc[i];
+ return NULL;
+}
+
+static void put_value(params_t* p, const param_desc_t* d, long value)
+{
+ uint8_t* f = ((uint8_t*)p) + d->offset;
+ switch(d->size)
+ {
+  case 1: *f = (uint8_t)value; break;
+  case 2: { uint16_t v = (uint16_t)value; memcpy(f, &v, 2); } break;
+  case 4: { uint32_t v = (uint32_t)value; memcpy(f, &v, 4); } break;
+ }
+}
+
+static long get_value(const params_t* p, const param_desc_t* d)
+{
+ const uint8_t* f = ((const uint8_t*)p) + d->offset;
+ switch(d->size)
+ {
+  case 1: return d->is_signed ? (long)(int8_t)*f : (long)*f;
+  case 2: { uint16_t v; memcpy(&v, f, 2); return d->is_signed ? (long)(int16_t)v : (long)v; }
+  case 4: { uint32_t v; memcpy(&v, f, 4); return d->is_signed ? (long)(int32_t)v : (long)v; }
+ }
+ return 0;
+}
+
+void __real_load_eeprom_params(struct ecudata_t* d);
+
+void __wrap_load_eeprom_params(struct ecudata_t* d)
+{
+ uint8_t i;
+ __real_load_eeprom_params(d);
+ for(i = 0; i < overrides_num; ++i)
+  put_value(&d->param, overrides[i].desc, overrides[i].value);
+ update_params_crc(d);
+ params_loaded = 1;
+}
+
+int glue_set_param(const char* name, long value)
+{
+ const param_desc_t* d = find_param(name);
+ uint8_t i;
+ if (!d)
+  return 0;
+ if (params_loaded)
+ { //firmware is running, change parameter in RAM as it would be changed via UART
+  put_value(&edat.param, d, value);
+  update_params_crc(&edat);
+  return 1;
+ }
+ for(i = 0; i < overrides_num; ++i)
+  if (overrides[i].desc == d)
+   break;
+ if (i >= MAX_OVERRIDES)
+  return 0;
+ overrides[i].desc = d;
+ overrides[i].value = value;
+ if (i == overrides_num)
+  ++overrides_num;
+ return 1;
+}
+
+long glue_get_param(const char* name)
+{
+ const param_desc_t* d = find_param(name);
+ uint8_t i;
+ if (!d)
+  return 0;
+ if (params_loaded)
+  return get_value(&edat.param, d);
+ for(i = 0; i < overrides_num; ++i)
+  if (overrides[i].desc == d)
+   return overrides[i].value;
+ return get_value(&fw_data.def_param, d); //firmware will use reserve parameters (EEPROM is empty)
+}
+
+#ifdef SM_CONTROL
+extern volatile int16_t sm_pos;
+#endif
+
+int glue_get_stepper(int16_t* pos, uint16_t* steps)
+{
+#ifdef SM_CONTROL
+ if (!params_loaded)
+  return 0;
+ *pos = sm_pos;
+ *steps = edat.param.sm_steps;
+ return 1;
+#else
+ (void)pos; (void)steps;
+ return 0;
+#endif
+}
+
+void glue_get_state(glue_state_t* s)
+{
+ s->engine_mode = edat.engine_mode;
+ s->rpm = edat.sens.frequen;
+ s->inst_rpm = edat.sens.inst_frq;
+ s->map = edat.sens.map / (double)MAP_PHYSICAL_MAGNITUDE_MULTIPLAYER;
+ s->temp = edat.sens.temperat / (double)TEMP_PHYSICAL_MAGNITUDE_MULTIPLAYER;
+ s->voltage = edat.sens.voltage / (double)UBAT_PHYSICAL_MAGNITUDE_MULTIPLAYER;
+ s->tps = edat.sens.tps / (double)TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER;
+ s->curr_angle = edat.curr_angle / (double)ANGLE_MULTIPLAYER;
+ s->knock_retard = edat.knock_retard / (double)ANGLE_MULTIPLAYER;
+ s->knock_k = edat.sens.knock_k * ADC_DISCRETE;
+ s->ce_errors = edat.ecuerrors_for_transfer;
+}
+
+/**Inverse of adc_compensate()
+ * \param value compensated value
+ * \param factor, correction factors of compensation
+ * \param mult multiplier applied to ADC code before compensation
+ */
+static long uncompensate(double value, int16_t factor, int32_t correction, double mult)
+{
+ double x = (value * 16384.0 - correction) / factor;
+ return (long)(x / mult + 0.5);
+}
+
+uint16_t glue_adc_code(uint8_t channel, double value)
+{
+ const params_t* p = params_loaded ? &edat.param : &fw_data.def_param;
+ long code = 0;
+ double raw;
+ switch(channel)
+ {
+  case 2: //MAP, see map_adc_to_kpa()
+   raw = (value * MAP_PHYSICAL_MAGNITUDE_MULTIPLAYER * 128.0) / p->map_curve_gradient - p->map_curve_offset;
+   code = uncompensate(raw, p->map_adc_factor, p->map_adc_correction, 2);
+   break;
+  case 1: //voltage
+   code = uncompensate(value * UBAT_PHYSICAL_MAGNITUDE_MULTIPLAYER, p->ubat_adc_factor, p->ubat_adc_correction, 6);
+   break;
+  case 0: //coolant temperature, linear sensor, see temp_adc_to_c()
+   raw = value * TEMP_PHYSICAL_MAGNITUDE_MULTIPLAYER + (TSENS_ZERO_POINT / ADC_DISCRETE);
+   code = uncompensate(raw, p->temp_adc_factor, p->temp_adc_correction, 5.0 / 3);
+   break;
+  case 7: //TPS (SECU-3T), see tps_adc_to_pc()
+   raw = (value * TPS_PHYSICAL_MAGNITUDE_MULTIPLAYER * 8192.0) / p->tps_curve_gradient - p->tps_curve_offset;
+   code = uncompensate(raw, p->tps_adc_factor, p->tps_adc_correction, 2);
+   break;
+  default: //voltage on the pin
+   code = (long)(value / ADC_DISCRETE + 0.5);
+   break;
+ }
+ if (code < 0)
+  code = 0;
+ return (code > 1023) ? 1023 : (uint16_t)code;
+}
+
+void glue_fix_code_crc(uint8_t* flash)
+{
+ uint16_t crc = crc16_part(0xFFFF, flash, CODE_SIZE - 2), target = fw_data.code_crc;
+ uint32_t v;
+ //the last two bytes of checked area are chosen so that CRC of code is equal to reference one
+ for(v = 0; v < 0x10000; ++v)
+ {
+  uint8_t tail[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+  if (crc16_part(crc, tail, 2) == target)
+  {
+   memcpy(flash + CODE_SIZE - 2, tail, 2);
+   break;
+  }
+ }
+}
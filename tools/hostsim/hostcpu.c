@@ -0,0 +1,909 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file hostcpu.c
+ * Model of ATmega32 for firmware compiled for the host.
+ *
+ * Time: firmware is compiled with -fsanitize-coverage=trace-pc, so __sanitizer_cov_trace_pc() is
+ * called in each basic block. Each call charges host_block_cycles CPU cycles. It is a coarse model
+ * of execution time of main loop, but all timing critical things are done by timers, and timers
+ * are modeled exactly: events happen at exact CPU cycle and interrupt is entered at the nearest
+ * basic block (or register access) after that.
+ *
+ * Registers: firmware gets address of register's storage from host_reg(). Registers accessed since
+ * the last synchronization are remembered, and their values are compared with shadow copies at the
+ * next basic block (or register access), so each write is seen by the model before time advances.
+ * Registers with "write one to clear" bits and data registers, which start an action when written
+ * (TIFR, GIFR, UDR, SPDR), keep marker in the high byte. Firmware writes 8-bit values, so write is
+ * detected by absence of marker even if the same value is written.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostcpu.h"
+#include "hostsim.h"
+
+//Values of bits (the same as in avr/io.h, which can not be included here)
+#define B(n) (1u << (n))
+#define SREG_I  B(7)
+#define MARKER  0x100
+
+#define ISR_ENTRY_CYCLES 24        //response, jump and prologue
+#define ISR_EXIT_CYCLES  20        //epilogue and RETI
+#define EE_WRITE_CYCLES  (HOST_F_CPU / 1000 * 85 / 10) //8.5ms
+#define FLASH_SIZE       0x8000
+
+uint64_t host_now = 0;
+uint32_t host_block_cycles = 8;
+uint8_t host_eeprom[HOST_E2SIZE];
+hcpu_stat_t hcpu_stat;
+
+static uint16_t regs[HR_NUMBER];   //storage of registers, seen by firmware
+static uint16_t shadow[HR_NUMBER]; //last values known by model
+static uint8_t touched[HR_NUMBER]; //list of registers accessed since last synchronization
+static uint8_t touched_flag[HR_NUMBER];
+static uint8_t ntouched;
+static uint8_t udr_accessed;       //UDR was accessed (read if it was not written)
+
+static uint64_t next_event = HOST_NEVER;
+static uint64_t end_time;
+static jmp_buf stop_jmp;
+static const char* stop_reason;
+static int running;
+
+static uint8_t flash[FLASH_SIZE];  //image of code
+
+/**Timer/counter */
+typedef struct
+{
+ uint32_t mask;                    //0xFF or 0xFFFF
+ uint32_t presc;                   //prescaler, 0 - timer is stopped
+ uint64_t t0;                      //time of last change of counter
+ uint32_t cnt0;                    //value of counter at t0
+}tmr_t;
+
+static tmr_t tmr0 = {0xFF}, tmr1 = {0xFFFF}, tmr2 = {0xFF};
+static uint64_t t_tov0, t_ocf0, t_tov1, t_ocf1a, t_ocf1b, t_tov2, t_ocf2;
+static uint8_t ocr2_buf;           //OCR2 is double buffered in PWM modes
+
+static uint64_t t_adc;             //end of ADC conversion
+static uint16_t adc_result;
+static uint64_t t_ee;              //end of EEPROM programming
+static uint64_t t_spi;             //end of SPI transfer
+static uint8_t spi_byte;
+static uint64_t t_wdt;             //expiration of watchdog
+
+/**UART */
+static struct
+{
+ uint32_t bit_cycles;
+ uint64_t t_tx;                    //end of transmission of byte in shift register
+ int tx_shift;                     //byte in shift register (-1 - empty)
+ int tx_buf;                       //byte in data register (-1 - empty)
+ uint8_t rx_fifo[2];               //receive buffer of AVR
+ uint8_t rx_cnt;
+ uint8_t* rx_queue;                //bytes which will come from the line
+ size_t rx_size, rx_head, rx_alloc;
+ uint64_t t_rx;                    //time of arrival of the next byte
+}uart = {0, HOST_NEVER, -1, -1};
+
+static uint8_t pin_ext[HP_NUMBER] = {0xFF, 0xFF, 0xFF, 0xFF}; //levels driven from outside
+static uint8_t pin_prev[HP_NUMBER];//last known levels of output pins
+
+typedef void (*isr_t)(void);
+
+//Handlers of interrupts, firmware defines only some of them
+#define VECT(name) extern void name(void) __attribute__((weak));
+VECT(host_vect_int0) VECT(host_vect_int1) VECT(host_vect_int2) VECT(host_vect_timer2_comp)
+VECT(host_vect_timer2_ovf) VECT(host_vect_timer1_capt) VECT(host_vect_timer1_compa)
+VECT(host_vect_timer1_compb) VECT(host_vect_timer1_ovf) VECT(host_vect_timer0_comp)
+VECT(host_vect_timer0_ovf) VECT(host_vect_spi_stc) VECT(host_vect_usart_rxc)
+VECT(host_vect_usart_udre) VECT(host_vect_usart_txc) VECT(host_vect_adc) VECT(host_vect_ee_rdy)
+
+static void sync(void);
+static void run_events(void);
+static void check_irq(void);
+
+//----------------------------------------------------------------------------------------------
+//Timers
+
+static uint32_t tmr_count(const tmr_t* t)
+{
+ if (!t->presc)
+  return t->cnt0;
+ return (t->cnt0 + (uint32_t)(host_now / t->presc - t->t0 / t->presc)) & t->mask;
+}
+
+static void tmr_set(tmr_t* t, uint32_t cnt, uint32_t presc)
+{
+ t->cnt0 = cnt & t->mask;
+ t->t0 = host_now;
+ t->presc = presc;
+}
+
+/**\return time when counter will change to specified value (strictly after current time) */
+static uint64_t tmr_when(const tmr_t* t, uint32_t value)
+{
+ uint32_t ticks;
+ if (!t->presc)
+  return HOST_NEVER;
+ ticks = (value - tmr_count(t)) & t->mask;
+ if (!ticks)
+  ticks = t->mask + 1;
+ return (host_now / t->presc + ticks) * t->presc;
+}
+
+static uint32_t presc01(uint8_t cs)
+{
+ static const uint32_t p[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+ return p[cs & 7];
+}
+
+static uint32_t presc2(uint8_t cs)
+{
+ static const uint32_t p[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+ return p[cs & 7];
+}
+
+//compare match flag is set at the timer clock following the match
+static void tmr0_sched(void)
+{
+ t_tov0 = tmr_when(&tmr0, 0);
+ t_ocf0 = tmr_when(&tmr0, regs[HR_OCR0] + 1);
+}
+
+static void tmr1_sched(void)
+{
+ t_tov1 = tmr_when(&tmr1, 0);
+ t_ocf1a = tmr_when(&tmr1, regs[HR_OCR1A] + 1);
+ t_ocf1b = tmr_when(&tmr1, regs[HR_OCR1B] + 1);
+}
+
+static uint8_t tmr2_pwm(void)
+{
+ return (regs[HR_TCCR2] & B(6)) != 0; //WGM20
+}
+
+static void tmr2_sched(void)
+{
+ t_tov2 = tmr_when(&tmr2, 0);
+ t_ocf2 = tmr_when(&tmr2, (tmr2_pwm() ? ocr2_buf : regs[HR_OCR2]) + 1);
+}
+
+//----------------------------------------------------------------------------------------------
+//Pins
+
+static uint8_t pin_level(uint8_t port)
+{
+ uint8_t ddr = (uint8_t)regs[HR_DDRA + port];
+ return (regs[HR_PORTA + port] & ddr) | (pin_ext[port] & ~ddr);
+}
+
+static void check_outputs(uint8_t port)
+{
+ uint8_t level = pin_level(port), ddr = (uint8_t)regs[HR_DDRA + port];
+ uint8_t changed = (level ^ pin_prev[port]) & ddr, bit;
+ pin_prev[port] = level;
+ for(bit = 0; changed; ++bit, changed>>= 1)
+  if (changed & 1)
+  {
+   eng_port_edge(port, bit, (level >> bit) & 1, host_now);
+   rpl_port_edge(port, bit, (level >> bit) & 1, host_now);
+  }
+}
+
+static void set_flag(uint8_t id, uint8_t mask)
+{
+ regs[id]|= mask;
+ shadow[id]|= mask;
+}
+
+static void clr_flag(uint8_t id, uint8_t mask)
+{
+ regs[id]&= ~mask;
+ shadow[id]&= ~mask;
+}
+
+void hcpu_set_pin(uint8_t port, uint8_t bit, uint8_t level, uint64_t t)
+{
+ uint8_t old = (pin_ext[port] >> bit) & 1, isc;
+ if (old == level)
+  return;
+ pin_ext[port] = (pin_ext[port] & ~B(bit)) | (level << bit);
+ if (HP_D != port)
+  return;
+ if (6 == bit) //ICP1
+ {
+  if (level == ((regs[HR_TCCR1B] & B(6)) != 0)) //ICES1
+  {
+   uint64_t now = host_now;
+   host_now = t + ((regs[HR_TCCR1B] & B(7)) ? 4 : 0); //noise canceler delays capture by 4 cycles
+   regs[HR_ICR1] = shadow[HR_ICR1] = (uint16_t)tmr_count(&tmr1);
+   host_now = now;
+   set_flag(HR_TIFR, B(5)); //ICF1
+  }
+ }
+ else if (2 == bit || 3 == bit) //INT0, INT1
+ {
+  isc = (regs[HR_MCUCR] >> ((2 == bit) ? 0 : 2)) & 3;
+  if (1 == isc || (2 == isc && !level) || (3 == isc && level) || (0 == isc && !level))
+   set_flag(HR_GIFR, (2 == bit) ? B(6) : B(7));
+ }
+}
+
+uint8_t hcpu_get_pins(uint8_t port)
+{
+ return pin_level(port);
+}
+
+uint64_t hcpu_timer1_when(uint16_t value)
+{
+ return tmr_when(&tmr1, value);
+}
+
+//----------------------------------------------------------------------------------------------
+//UART
+
+static void uart_sched_rx(uint64_t after)
+{
+ if (uart.rx_head < uart.rx_size && uart.bit_cycles)
+ {
+  uint64_t t = after + uart.bit_cycles * 10;
+  if (HOST_NEVER == uart.t_rx || t > uart.t_rx)
+   uart.t_rx = t;
+ }
+ else
+  uart.t_rx = HOST_NEVER;
+}
+
+void hcpu_uart_rx(const uint8_t* data, size_t size)
+{
+ if (uart.rx_size + size > uart.rx_alloc)
+ {
+  uart.rx_alloc = (uart.rx_size + size) * 2;
+  uart.rx_queue = realloc(uart.rx_queue, uart.rx_alloc);
+ }
+ memcpy(uart.rx_queue + uart.rx_size, data, size);
+ uart.rx_size+= size;
+ if (HOST_NEVER == uart.t_rx)
+  uart_sched_rx(host_now);
+ hcpu_reschedule();
+}
+
+uint32_t hcpu_uart_byte_cycles(void)
+{
+ return uart.bit_cycles * 10;
+}
+
+static void uart_update_flags(void)
+{
+ if (uart.rx_cnt)
+  set_flag(HR_UCSRA, B(7));                           //RXC
+ else
+  clr_flag(HR_UCSRA, B(7));
+ if (uart.tx_buf < 0)
+  set_flag(HR_UCSRA, B(5));                           //UDRE
+ else
+  clr_flag(HR_UCSRA, B(5));
+ regs[HR_UDR] = (uart.rx_cnt ? uart.rx_fifo[0] : 0) | MARKER;
+}
+
+static void uart_baud(void)
+{
+ uint32_t ubrr = ((regs[HR_UBRRH] & 0x0F) << 8) | (regs[HR_UBRRL] & 0xFF);
+ uart.bit_cycles = ((regs[HR_UCSRA] & B(1)) ? 8 : 16) * (ubrr + 1);
+}
+
+static void uart_tx_start(void)
+{
+ uart.tx_shift = uart.tx_buf;
+ uart.tx_buf = -1;
+ uart.t_tx = host_now + uart.bit_cycles * 10;
+}
+
+//----------------------------------------------------------------------------------------------
+//Processing of writes
+
+static void reg_written(uint8_t id)
+{
+ uint16_t v = regs[id], old = shadow[id];
+
+ switch(id)
+ {
+  case HR_TIFR:
+  case HR_GIFR:
+   if (!(v & MARKER))
+    shadow[id]&= ~v;                                   //write one to clear
+   regs[id] = shadow[id] | MARKER;
+   return;
+
+  case HR_UDR:
+   if (!(v & MARKER))
+   {
+    if (regs[HR_UCSRB] & B(3)) //TXEN
+    {
+     if (uart.tx_buf < 0)
+     {
+      uart.tx_buf = v & 0xFF;
+      if (uart.tx_shift < 0)
+       uart_tx_start();
+     }
+    }
+   }
+   else if (udr_accessed && uart.rx_cnt)
+   { //read: remove byte from receive buffer
+    uart.rx_fifo[0] = uart.rx_fifo[1];
+    --uart.rx_cnt;
+   }
+   udr_accessed = 0;
+   uart_update_flags();
+   hcpu_reschedule();
+   return;
+
+  case HR_SPDR:
+   if (!(v & MARKER) && (regs[HR_SPCR] & (B(6) | B(4))) == (B(6) | B(4))) //SPE, MSTR
+   {
+    static const uint32_t div[4] = {4, 16, 64, 128};
+    uint32_t d = div[regs[HR_SPCR] & 3];
+    if (regs[HR_SPSR] & B(0)) //SPI2X
+     d/= 2;
+    spi_byte = v & 0xFF;     //knock signal processor echoes received byte (SO is active)
+    t_spi = host_now + 8 * d;
+   }
+   regs[id] = shadow[id] = (shadow[id] & 0xFF) | MARKER;
+   hcpu_reschedule();
+   return;
+ }
+
+ if (v == old)
+  return;
+
+ switch(id)
+ {
+  case HR_SREG:
+   break;
+
+  case HR_TCNT0:
+   tmr_set(&tmr0, v, tmr0.presc);
+   tmr0_sched();
+   break;
+  case HR_TCCR0:
+   tmr_set(&tmr0, tmr_count(&tmr0), presc01(v));
+   tmr0_sched();
+   break;
+  case HR_OCR0:
+   tmr0_sched();
+   break;
+
+  case HR_TCNT1:
+   tmr_set(&tmr1, v, tmr1.presc);
+   tmr1_sched();
+   break;
+  case HR_TCCR1B:
+   tmr_set(&tmr1, tmr_count(&tmr1), presc01(v));
+   tmr1_sched();
+   break;
+  case HR_OCR1A:
+  case HR_OCR1B:
+   tmr1_sched();
+   break;
+
+  case HR_TCNT2:
+   tmr_set(&tmr2, v, tmr2.presc);
+   tmr2_sched();
+   break;
+  case HR_TCCR2:
+   tmr_set(&tmr2, tmr_count(&tmr2), presc2(v));
+   tmr2_sched();
+   break;
+  case HR_OCR2:
+   if (!tmr2_pwm())
+    ocr2_buf = (uint8_t)v;
+   tmr2_sched();
+   break;
+
+  case HR_PORTA: case HR_PORTB: case HR_PORTC: case HR_PORTD:
+  case HR_DDRA: case HR_DDRB: case HR_DDRC: case HR_DDRD:
+   shadow[id] = v;
+   check_outputs((id >= HR_PORTA) ? id - HR_PORTA : id - HR_DDRA);
+   break;
+
+  case HR_PINA: case HR_PINB: case HR_PINC: case HR_PIND:
+  case HR_ADC:
+   regs[id] = old; //read only
+   return;
+
+  case HR_ADCSRA:
+   if (v & old & B(4))
+    v&= ~B(4);                                         //ADIF, write one to clear
+   else
+    v = (v & ~B(4)) | (old & B(4));
+   if (t_adc != HOST_NEVER)
+    v|= B(6);                                          //conversion is running
+   else if ((v & B(6)) && (v & B(7)))                  //ADSC, ADEN
+   {
+    static const uint32_t div[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+    adc_result = eng_adc(regs[HR_ADMUX] & 0x1F, host_now);
+    t_adc = host_now + 13 * div[v & 7];
+   }
+   else
+    v&= ~B(6);
+   regs[id] = v;
+   break;
+
+  case HR_EECR:
+   if (v & B(0)) //EERE
+   {
+    if (HOST_NEVER == t_ee)
+     regs[HR_EEDR] = shadow[HR_EEDR] = host_eeprom[regs[HR_EEAR] % HOST_E2SIZE];
+    v&= ~B(0);
+    host_now+= 4;
+   }
+   if ((v & B(1)) && !(old & B(1))) //EEWE
+   {
+    if (((v | old) & B(2)) && HOST_NEVER == t_ee) //EEMWE
+    {
+     host_eeprom[regs[HR_EEAR] % HOST_E2SIZE] = (uint8_t)regs[HR_EEDR];
+     t_ee = host_now + EE_WRITE_CYCLES;
+     ++hcpu_stat.ee_writes;
+     host_now+= 2;
+    }
+    else
+     v&= ~B(1);
+    v&= ~B(2);
+   }
+   else if (old & B(1))
+    v|= B(1);                                          //EEWE can not be cleared by software
+   regs[id] = v;
+   break;
+
+  case HR_SPSR:
+   regs[id] = (old & ~B(0)) | (v & B(0));              //only SPI2X is writable
+   break;
+
+  case HR_UCSRA:
+   v = (v & (B(1) | B(0))) | (old & ~(B(1) | B(0)) & ~((v & B(6)) ? B(6) : 0)); //TXC write one to clear
+   regs[id] = v;
+   uart_baud();
+   break;
+  case HR_UBRRH:
+  case HR_UBRRL:
+   uart_baud();
+   break;
+  case HR_UCSRB:
+   if (!(v & B(4))) //RXEN
+    uart.rx_cnt = 0;
+   break;
+
+  case HR_WDTCR:
+   if ((v & B(3)) && HOST_NEVER == t_wdt) //WDE
+    t_wdt = host_now + ((uint64_t)16384 << (v & 7)) * (HOST_F_CPU / 1000000);
+   break;
+ }
+ shadow[id] = regs[id];
+ if (HR_UCSRA == id || HR_UCSRB == id)
+  uart_update_flags();
+ hcpu_reschedule();
+}
+
+static void sync(void)
+{
+ while(ntouched)
+ {
+  uint8_t id = touched[--ntouched];
+  touched_flag[id] = 0;
+  reg_written(id);
+ }
+ check_irq();
+}
+
+//----------------------------------------------------------------------------------------------
+//Interrupts
+
+static void dispatch(isr_t isr, const char* name)
+{
+ uint64_t t = host_now;
+ if (!isr)
+ {
+  fprintf(stderr, "hostcpu: interrupt %s has no handler\n", name);
+  hcpu_stop("bad interrupt");
+ }
+ regs[HR_SREG]&= ~SREG_I;
+ shadow[HR_SREG] = regs[HR_SREG];
+ host_now+= ISR_ENTRY_CYCLES;
+ isr();
+ if (ntouched)
+  sync();
+ host_now+= ISR_EXIT_CYCLES;
+ regs[HR_SREG]|= SREG_I; //RETI
+ shadow[HR_SREG] = regs[HR_SREG];
+ ++hcpu_stat.isr_count;
+ hcpu_stat.isr_cycles+= host_now - t;
+}
+
+/**Finds pending interrupt with the highest priority, clears its flag and calls handler */
+static int dispatch_pending(void)
+{
+ uint16_t timsk = regs[HR_TIMSK], tifr = shadow[HR_TIFR];
+ uint16_t gicr = regs[HR_GICR], gifr = shadow[HR_GIFR];
+
+ if ((gicr & B(6)) && (gifr & B(6)))
+ {
+  clr_flag(HR_GIFR, B(6)); regs[HR_GIFR]|= MARKER;
+  dispatch(host_vect_int0, "INT0");
+ }
+ else if ((gicr & B(7)) && (gifr & B(7)))
+ {
+  clr_flag(HR_GIFR, B(7)); regs[HR_GIFR]|= MARKER;
+  dispatch(host_vect_int1, "INT1");
+ }
+ else if (timsk & tifr & (B(7) | B(6) | B(5) | B(4) | B(3) | B(2) | B(1) | B(0)))
+ { //flags of timers have the same positions as bits of enable, order of bits is order of priority
+  static const struct { uint8_t bit; const char* name; } tv[8] = {
+   {7, "TIMER2_COMP"}, {6, "TIMER2_OVF"}, {5, "TIMER1_CAPT"}, {4, "TIMER1_COMPA"},
+   {3, "TIMER1_COMPB"}, {2, "TIMER1_OVF"}, {1, "TIMER0_COMP"}, {0, "TIMER0_OVF"}};
+  isr_t isrs[8] = {host_vect_timer2_comp, host_vect_timer2_ovf, host_vect_timer1_capt,
+   host_vect_timer1_compa, host_vect_timer1_compb, host_vect_timer1_ovf, host_vect_timer0_comp,
+   host_vect_timer0_ovf};
+  int i = 0;
+  while(!(timsk & tifr & B(tv[i].bit)))
+   ++i;
+  clr_flag(HR_TIFR, B(tv[i].bit)); regs[HR_TIFR]|= MARKER;
+  dispatch(isrs[i], tv[i].name);
+ }
+ else if ((regs[HR_SPCR] & B(7)) && (regs[HR_SPSR] & B(7)))
+ {
+  clr_flag(HR_SPSR, B(7));
+  dispatch(host_vect_spi_stc, "SPI_STC");
+ }
+ else if ((regs[HR_UCSRB] & B(7)) && (regs[HR_UCSRA] & B(7))) //level
+  dispatch(host_vect_usart_rxc, "USART_RXC");
+ else if ((regs[HR_UCSRB] & B(5)) && (regs[HR_UCSRA] & B(5))) //level
+  dispatch(host_vect_usart_udre, "USART_UDRE");
+ else if ((regs[HR_UCSRB] & B(6)) && (regs[HR_UCSRA] & B(6)))
+ {
+  clr_flag(HR_UCSRA, B(6));
+  dispatch(host_vect_usart_txc, "USART_TXC");
+ }
+ else if ((regs[HR_ADCSRA] & B(3)) && (regs[HR_ADCSRA] & B(4)))
+ {
+  clr_flag(HR_ADCSRA, B(4));
+  dispatch(host_vect_adc, "ADC");
+ }
+ else if ((regs[HR_EECR] & B(3)) && !(regs[HR_EECR] & B(1))) //level
+  dispatch(host_vect_ee_rdy, "EE_RDY");
+ else
+  return 0;
+ return 1;
+}
+
+static void check_irq(void)
+{
+ while((regs[HR_SREG] & SREG_I) && (shadow[HR_SREG] & SREG_I) && dispatch_pending());
+}
+
+//----------------------------------------------------------------------------------------------
+//Events
+
+void hcpu_reschedule(void)
+{
+ uint64_t t = end_time, e;
+#define MINT(x) if ((x) < t) t = (x)
+ MINT(t_tov0); MINT(t_ocf0);
+ MINT(t_tov1); MINT(t_ocf1a); MINT(t_ocf1b);
+ MINT(t_tov2); MINT(t_ocf2);
+ MINT(t_adc); MINT(t_ee); MINT(t_spi); MINT(t_wdt);
+ MINT(uart.t_tx); MINT(uart.t_rx);
+ e = eng_next_event(); MINT(e);
+ e = sim_next_event(); MINT(e);
+ e = rpl_next_event(); MINT(e);
+#undef MINT
+ next_event = t;
+}
+
+/**Processes one event with the lowest time */
+static void process_event(void)
+{
+ uint64_t now = host_now, t = next_event;
+ host_now = t;
+
+ if (t >= end_time)
+ {
+  host_now = now;
+  hcpu_stop(NULL);
+ }
+ else if (t == t_tov1)
+ {
+  set_flag(HR_TIFR, B(2));
+  t_tov1 = tmr_when(&tmr1, 0);
+ }
+ else if (t == t_ocf1a)
+ {
+  set_flag(HR_TIFR, B(4));
+  t_ocf1a = tmr_when(&tmr1, regs[HR_OCR1A] + 1);
+ }
+ else if (t == t_ocf1b)
+ {
+  set_flag(HR_TIFR, B(3));
+  t_ocf1b = tmr_when(&tmr1, regs[HR_OCR1B] + 1);
+ }
+ else if (t == t_tov0)
+ {
+  set_flag(HR_TIFR, B(0));
+  t_tov0 = tmr_when(&tmr0, 0);
+ }
+ else if (t == t_ocf0)
+ {
+  set_flag(HR_TIFR, B(1));
+  t_ocf0 = tmr_when(&tmr0, regs[HR_OCR0] + 1);
+ }
+ else if (t == t_tov2)
+ {
+  set_flag(HR_TIFR, B(6));
+  if (tmr2_pwm())
+   ocr2_buf = (uint8_t)regs[HR_OCR2]; //update of double buffered register at the bottom
+  tmr2_sched();
+ }
+ else if (t == t_ocf2)
+ {
+  set_flag(HR_TIFR, B(7));
+  t_ocf2 = tmr_when(&tmr2, (tmr2_pwm() ? ocr2_buf : regs[HR_OCR2]) + 1);
+ }
+ else if (t == t_adc)
+ {
+  regs[HR_ADC] = shadow[HR_ADC] = adc_result;
+  clr_flag(HR_ADCSRA, B(6));
+  set_flag(HR_ADCSRA, B(4));
+  t_adc = HOST_NEVER;
+ }
+ else if (t == t_ee)
+ {
+  clr_flag(HR_EECR, B(1));
+  t_ee = HOST_NEVER;
+ }
+ else if (t == t_spi)
+ {
+  regs[HR_SPDR] = shadow[HR_SPDR] = spi_byte | MARKER;
+  set_flag(HR_SPSR, B(7));
+  t_spi = HOST_NEVER;
+ }
+ else if (t == t_wdt)
+ {
+  host_now = now;
+  hcpu_stop("watchdog reset");
+ }
+ else if (t == uart.t_tx)
+ {
+  sim_uart_tx((uint8_t)uart.tx_shift, t);
+  ++hcpu_stat.uart_tx_bytes;
+  uart.tx_shift = -1;
+  uart.t_tx = HOST_NEVER;
+  if (uart.tx_buf >= 0)
+   uart_tx_start();
+  else
+   set_flag(HR_UCSRA, B(6)); //TXC
+  uart_update_flags();
+ }
+ else if (t == uart.t_rx)
+ {
+  uint8_t byte = uart.rx_queue[uart.rx_head++];
+  if (regs[HR_UCSRB] & B(4)) //RXEN
+  {
+   if (uart.rx_cnt < 2)
+    uart.rx_fifo[uart.rx_cnt++] = byte;
+   else
+   {
+    set_flag(HR_UCSRA, B(3)); //DOR
+    ++hcpu_stat.uart_overruns;
+   }
+  }
+  uart.t_rx = HOST_NEVER;
+  uart_sched_rx(t);
+  uart_update_flags();
+ }
+ else if (t == eng_next_event())
+  eng_process();
+ else if (t == sim_next_event())
+  sim_process();
+ else if (t == rpl_next_event())
+  rpl_process();
+
+ if (host_now < now)
+  host_now = now;
+ hcpu_reschedule();
+}
+
+static void run_events(void)
+{
+ while(host_now >= next_event)
+  process_event();
+ check_irq();
+}
+
+//----------------------------------------------------------------------------------------------
+//Interface to firmware
+
+void __sanitizer_cov_trace_pc(void)
+{
+ host_now+= host_block_cycles;
+ if (!running)
+  return;
+ if (ntouched)
+  sync();
+ if (host_now >= next_event)
+  run_events();
+}
+
+static void reg_read(uint8_t id)
+{
+ switch(id)
+ {
+  case HR_TCNT0:
+   regs[id] = shadow[id] = (uint16_t)tmr_count(&tmr0);
+   break;
+  case HR_TCNT1:
+   regs[id] = shadow[id] = (uint16_t)tmr_count(&tmr1);
+   break;
+  case HR_TCNT2:
+   regs[id] = shadow[id] = (uint16_t)tmr_count(&tmr2);
+   break;
+  case HR_PINA: case HR_PINB: case HR_PINC: case HR_PIND:
+   regs[id] = shadow[id] = pin_level(id - HR_PINA);
+   break;
+  case HR_UDR:
+   udr_accessed = 1;
+   break;
+  case HR_SPDR: //access to data register clears flag
+   clr_flag(HR_SPSR, B(7));
+   break;
+ }
+}
+
+volatile uint16_t* host_reg(uint8_t id)
+{
+ if (running)
+ {
+  if (ntouched)
+   sync();
+  if (host_now >= next_event)
+   run_events();
+ }
+ reg_read(id);
+ if (!touched_flag[id])
+ {
+  touched_flag[id] = 1;
+  touched[ntouched++] = id;
+ }
+ return &regs[id];
+}
+
+void host_delay_cycles(uint32_t cycles)
+{
+ uint64_t end = host_now + cycles;
+ while(host_now < end)
+ {
+  uint64_t step = end - host_now;
+  if (step > host_block_cycles)
+   step = host_block_cycles;
+  host_now+= step;
+  if (running && host_now >= next_event)
+   run_events();
+ }
+}
+
+void host_wdr(void)
+{
+ if (t_wdt != HOST_NEVER)
+ {
+  t_wdt = host_now + ((uint64_t)16384 << (regs[HR_WDTCR] & 7)) * (HOST_F_CPU / 1000000);
+  hcpu_reschedule();
+ }
+}
+
+void host_call_address(uint16_t addr)
+{
+ fprintf(stderr, "hostcpu: call of code at 0x%04X (boot loader)\n", addr);
+ hcpu_stop("call of boot loader");
+}
+
+uint8_t host_pgm_read_byte(const void* addr)
+{
+ if ((uintptr_t)addr < FLASH_SIZE)
+  return flash[(uintptr_t)addr];
+ return *(const uint8_t*)addr;
+}
+
+uint16_t host_pgm_read_word(const void* addr)
+{
+ const uint8_t* p = (const uint8_t*)addr;
+ return host_pgm_read_byte(p) | (host_pgm_read_byte(p + 1) << 8);
+}
+
+uint32_t host_pgm_read_dword(const void* addr)
+{
+ const uint8_t* p = (const uint8_t*)addr;
+ return host_pgm_read_word(p) | ((uint32_t)host_pgm_read_word(p + 2) << 16);
+}
+
+void* host_memcpy_P(void* dest, const void* src, uint16_t size)
+{
+ uint8_t* d = (uint8_t*)dest;
+ const uint8_t* s = (const uint8_t*)src;
+ while(size--)
+  *d++ = host_pgm_read_byte(s++);
+ return dest;
+}
+
+//----------------------------------------------------------------------------------------------
+//Control of simulation
+
+void hcpu_stop(const char* reason)
+{
+ stop_reason = reason;
+ running = 0;
+ longjmp(stop_jmp, 1);
+}
+
+static void reset(void)
+{
+ memset(regs, 0, sizeof(regs));
+ regs[HR_SPH] = 0x08;
+ regs[HR_SPL] = 0x5F;
+ regs[HR_UCSRA] = B(5);   //UDRE
+ regs[HR_UCSRC] = 0x86;
+ regs[HR_TIFR] = MARKER;
+ regs[HR_GIFR] = MARKER;
+ regs[HR_UDR] = MARKER;
+ regs[HR_SPDR] = MARKER;
+ memcpy(shadow, regs, sizeof(regs));
+ regs[HR_TIFR] = MARKER;
+ shadow[HR_TIFR] = 0;
+ shadow[HR_GIFR] = 0;
+ ntouched = 0;
+ memset(touched_flag, 0, sizeof(touched_flag));
+ t_tov0 = t_ocf0 = t_tov1 = t_ocf1a = t_ocf1b = t_tov2 = t_ocf2 = HOST_NEVER;
+ t_adc = t_ee = t_spi = t_wdt = HOST_NEVER;
+ uart.bit_cycles = 16;
+ uart.t_tx = uart.t_rx = HOST_NEVER;
+ uart.tx_shift = uart.tx_buf = -1;
+ uart.rx_cnt = 0;
+ memset(pin_prev, 0, sizeof(pin_prev));
+ memset(flash, 0xFF, sizeof(flash));
+}
+
+const char* hcpu_run(void (*entry)(void), uint64_t end)
+{
+ reset();
+ glue_fix_code_crc(flash);
+ host_now = 0;
+ end_time = end;
+ hcpu_reschedule();
+ if (!setjmp(stop_jmp))
+ {
+  running = 1;
+  entry();
+  stop_reason = "firmware returned from main()";
+ }
+ running = 0;
+ return stop_reason;
+}
@@ -0,0 +1,75 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file hostcpu.h
+ * Interface between firmware compiled for the host and model of ATmega32 (host simulator).
+ * Firmware accesses I/O registers through host_reg(), so model knows about each access and
+ * advances peripherals before it. Time of CPU is advanced by coverage hook of compiler, which
+ * is called in each basic block of firmware's code (see hostcpu.c).
+ */
+
+#ifndef _HOSTCPU_H_
+#define _HOSTCPU_H_
+
+#include <stdint.h>
+
+/**Identifiers of I/O registers of ATmega32 */
+enum
+{
+ HR_ACSR, HR_ADC, HR_ADCSRA, HR_ADMUX, HR_ASSR,
+ HR_DDRA, HR_DDRB, HR_DDRC, HR_DDRD,
+ HR_EEAR, HR_EECR, HR_EEDR,
+ HR_GICR, HR_GIFR, HR_ICR1, HR_MCUCR, HR_MCUCSR,
+ HR_OCR0, HR_OCR1A, HR_OCR1B, HR_OCR2, HR_OSCCAL,
+ HR_PINA, HR_PINB, HR_PINC, HR_PIND,
+ HR_PORTA, HR_PORTB, HR_PORTC, HR_PORTD,
+ HR_SFIOR, HR_SPCR, HR_SPDR, HR_SPH, HR_SPL, HR_SPSR, HR_SREG,
+ HR_TCCR0, HR_TCCR1A, HR_TCCR1B, HR_TCCR2, HR_TCNT0, HR_TCNT1, HR_TCNT2,
+ HR_TIFR, HR_TIMSK,
+ HR_TWAR, HR_TWBR, HR_TWCR, HR_TWDR, HR_TWSR,
+ HR_UBRRH, HR_UBRRL, HR_UCSRA, HR_UCSRB, HR_UCSRC, HR_UDR,
+ HR_WDTCR,
+ HR_NUMBER
+};
+
+/**Returns address of storage of specified I/O register. Registers are 16-bit wide on the host
+ * (some of them keep special marker in the high byte, see hostcpu.c)
+ * \param id identifier of register (HR_xxx)
+ */
+volatile uint16_t* host_reg(uint8_t id);
+
+/**Busy wait for specified number of CPU cycles (_DELAY_CYCLES) */
+void host_delay_cycles(uint32_t cycles);
+
+/**Watchdog reset instruction (wdr) */
+void host_wdr(void);
+
+/**Call of code at specified address of FLASH (e.g. boot loader). Stops simulation */
+void host_call_address(uint16_t addr);
+
+/**Reading of program memory. Addresses below FLASHEND are treated as addresses of code and
+ * are read from the image of FLASH, other ones are pointers to constant objects of firmware */
+uint8_t host_pgm_read_byte(const void* addr);
+uint16_t host_pgm_read_word(const void* addr);
+uint32_t host_pgm_read_dword(const void* addr);
+void* host_memcpy_P(void* dest, const void* src, uint16_t size);
+
+#endif //_HOSTCPU_H_
@@ -0,0 +1,354 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file hostsim.c
+ * Host simulator of SECU-3: runs firmware compiled for the host against model of engine in
+ * closed loop. Scenario and logging.
+ *
+ * Usage: hostsim [-o log] [-e eeprom_in] [-s eeprom_out] scenario [key=value ...]
+ *
+ * Scenario is a text file, one command per line, '#' begins comment:
+ *  [at TIME] set KEY VALUE       - setting of model of engine (see engine.c)
+ *  [at TIME] param NAME VALUE    - parameter of firmware (name of field of params_t)
+ *  [at TIME] uart TEXT           - bytes to be received by firmware (C escapes: \r \n \xHH)
+ *  [at TIME] uart_hex HH HH ...  - the same, given by hex codes
+ *  replay FILE [START]           - replay of captured trace (see replay.c) beginning at START seconds
+ *                                  (default 0.5), simulation ends with the trace. Model of engine
+ *                                  must be stopped (rpm 0, default)
+ *  log spark|uart 0|1            - logging of sparks (on by default) and of transmitted bytes
+ *  log period SECONDS            - period of telemetry lines (0 - off)
+ *  cycles N                      - CPU cycles per basic block of firmware (default 8)
+ *  run SECONDS                   - duration of simulation
+ * TIME is in seconds. Arguments key=value given in command line are applied as "set" commands
+ * at time 0 after scenario.
+ *
+ * Lines of log (times are in microseconds):
+ *  S t ch rpm adv_meas adv_cmd knock_retard dwell_ms - spark
+ *  T t mode rpm rpm_model map temp ubat tps adv knock_k knock_retard ce_errors choke_% - telemetry
+ *  U t HH                                           - byte transmitted by firmware
+ *  R tick ch adv_meas adv_cmd knock_retard dwell_ms - spark during replay (see replay.c)
+ *  E t reason sparks adv_mean adv_sd isr_load_% ee_writes uart_overruns knock_meas knock_lost
+ *    knock_delay_mean_us knock_delay_max_us          - end of simulation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hostsim.h"
+
+#define MAX_LINE   1024
+
+/**Command of scenario delayed until specified time */
+typedef struct
+{
+ uint64_t t;
+ char* text;
+}sim_cmd_t;
+
+static sim_cmd_t* cmds;
+static size_t cmds_num, cmds_alloc, cmds_next;
+
+static FILE* log_file;
+static int log_spark = 1, log_uart = 0;
+static uint64_t log_period, t_log = HOST_NEVER;
+static uint64_t t_end = HOST_CYCLES(1.0);
+
+static double t_us(uint64_t t)
+{
+ return t / (HOST_F_CPU / 1000000.0);
+}
+
+static void fatal(const char* msg, const char* arg)
+{
+ fprintf(stderr, "hostsim: %s%s\n", msg, arg ? arg : "");
+ exit(1);
+}
+
+/**Converts string with C escapes into bytes
+ * \return number of bytes */
+static size_t unescape(const char* s, uint8_t* out)
+{
+ size_t n = 0;
+ while(*s)
+ {
+  if ('\\' == *s && s[1])
+  {
+   ++s;
+   switch(*s)
+   {
+    case 'r': out[n++] = '\r'; ++s; break;
+    case 'n': out[n++] = '\n'; ++s; break;
+    case 't': out[n++] = '\t'; ++s; break;
+    case 's': out[n++] = ' '; ++s; break;
+    case 'x': out[n++] = (uint8_t)strtoul(s + 1, (char**)&s, 16); break;
+    default: out[n++] = (uint8_t)*s++; break;
+   }
+  }
+  else
+   out[n++] = (uint8_t)*s++;
+ }
+ return n;
+}
+
+/**Executes command which does not depend on time
+ * \return 0 - unknown command */
+static int exec_cmd(char* line)
+{
+ char* cmd = strtok(line, " \t\r\n"), *a1, *a2;
+ if (!cmd || '#' == *cmd)
+  return 1;
+ a1 = strtok(NULL, " \t\r\n");
+ a2 = strtok(NULL, "\r\n");
+ if (!strcmp(cmd, "set") && a1 && a2)
+ {
+  if (!eng_set(a1, atof(a2)))
+   fatal("unknown setting: ", a1);
+ }
+ else if (!strcmp(cmd, "param") && a1 && a2)
+ {
+  if (!glue_set_param(a1, strtol(a2, NULL, 0)))
+   fatal("unknown parameter: ", a1);
+ }
+ else if (!strcmp(cmd, "uart") && a1)
+ {
+  uint8_t buf[MAX_LINE];
+  char text[MAX_LINE];
+  snprintf(text, sizeof(text), "%s%s%s", a1, a2 ? " " : "", a2 ? a2 : "");
+  hcpu_uart_rx(buf, unescape(text, buf));
+ }
+ else if (!strcmp(cmd, "uart_hex") && a1)
+ {
+  uint8_t buf[MAX_LINE];
+  size_t n = 0;
+  char* p = a1;
+  buf[n++] = (uint8_t)strtoul(p, NULL, 16);
+  for(p = a2 ? strtok(a2, " \t") : NULL; p && n < MAX_LINE; p = strtok(NULL, " \t"))
+   buf[n++] = (uint8_t)strtoul(p, NULL, 16);
+  hcpu_uart_rx(buf, n);
+ }
+ else if (!strcmp(cmd, "log") && a1 && a2)
+ {
+  if (!strcmp(a1, "spark"))
+   log_spark = atoi(a2);
+  else if (!strcmp(a1, "uart"))
+   log_uart = atoi(a2);
+  else if (!strcmp(a1, "period"))
+   log_period = HOST_CYCLES(atof(a2));
+  else
+   fatal("unknown log option: ", a1);
+ }
+ else if (!strcmp(cmd, "replay") && a1)
+ {
+  uint64_t start = a2 ? HOST_CYCLES(atof(a2)) : HOST_CYCLES(0.5);
+  const char* err = rpl_open(a1, (start > host_now) ? start : host_now, log_file);
+  if (err)
+  {
+   char msg[MAX_LINE];
+   snprintf(msg, sizeof(msg), "%s: ", err);
+   fatal(msg, a1);
+  }
+  t_end = HOST_NEVER;
+ }
+ else if (!strcmp(cmd, "cycles") && a1)
+  host_block_cycles = (uint32_t)atoi(a1);
+ else if (!strcmp(cmd, "run") && a1)
+  t_end = HOST_CYCLES(atof(a1));
+ else
+  return 0;
+ return 1;
+}
+
+static void add_cmd(uint64_t t, const char* text)
+{
+ size_t i;
+ if (cmds_num == cmds_alloc)
+ {
+  cmds_alloc = cmds_alloc ? cmds_alloc * 2 : 64;
+  cmds = realloc(cmds, cmds_alloc * sizeof(sim_cmd_t));
+ }
+ //keep list sorted by time, commands with the same time keep their order
+ for(i = cmds_num; i > 0 && cmds[i - 1].t > t; --i)
+  cmds[i] = cmds[i - 1];
+ cmds[i].t = t;
+ cmds[i].text = strdup(text);
+ ++cmds_num;
+}
+
+static void load_scenario(const char* name)
+{
+ char line[MAX_LINE];
+ FILE* f = strcmp(name, "-") ? fopen(name, "r") : stdin;
+ if (!f)
+  fatal("can not open scenario: ", name);
+ while(fgets(line, sizeof(line), f))
+ {
+  char* p = line;
+  while(' ' == *p || '\t' == *p)
+   ++p;
+  if (!strncmp(p, "at ", 3))
+  {
+   char* end;
+   double t = strtod(p + 3, &end);
+   if (end == p + 3)
+    fatal("bad time: ", line);
+   while(' ' == *end || '\t' == *end)
+    ++end;
+   add_cmd(HOST_CYCLES(t), end);
+  }
+  else if (!exec_cmd(p))
+   fatal("unknown command: ", line);
+ }
+ if (f != stdin)
+  fclose(f);
+}
+
+uint64_t sim_next_event(void)
+{
+ uint64_t t = (cmds_next < cmds_num) ? cmds[cmds_next].t : HOST_NEVER;
+ return (t_log < t) ? t_log : t;
+}
+
+static void log_telemetry(uint64_t t)
+{
+ glue_state_t s;
+ glue_get_state(&s);
+ fprintf(log_file, "T %.1f %d %u %.0f %.1f %.1f %.2f %.1f %.2f %.3f %.2f %04X %.1f\n", t_us(t),
+   s.engine_mode, s.rpm, eng_get_rpm(), s.map, s.temp, s.voltage, s.tps, s.curr_angle,
+   s.knock_k, s.knock_retard, s.ce_errors, eng_get_choke() * 100);
+}
+
+void sim_process(void)
+{
+ if (t_log <= host_now && t_log <= ((cmds_next < cmds_num) ? cmds[cmds_next].t : HOST_NEVER))
+ {
+  log_telemetry(t_log);
+  t_log+= log_period;
+ }
+ else if (cmds_next < cmds_num)
+ {
+  char line[MAX_LINE];
+  strncpy(line, cmds[cmds_next++].text, sizeof(line) - 1);
+  line[sizeof(line) - 1] = 0;
+  if (!exec_cmd(line))
+   fatal("unknown command: ", line);
+ }
+ hcpu_reschedule();
+}
+
+void sim_spark(uint8_t ch, uint64_t t, double rpm, double adv, double dwell)
+{
+ glue_state_t s;
+ if (!log_spark)
+  return;
+ glue_get_state(&s);
+ fprintf(log_file, "S %.1f %u %.0f %.2f %.2f %.2f %.3f\n", t_us(t), ch, rpm, adv, s.curr_angle,
+   s.knock_retard, dwell);
+}
+
+void sim_uart_tx(uint8_t byte, uint64_t t)
+{
+ if (log_uart)
+  fprintf(log_file, "U %.1f %02X\n", t_us(t), byte);
+}
+
+static void load_eeprom(const char* name)
+{
+ FILE* f = fopen(name, "rb");
+ if (!f)
+  fatal("can not open EEPROM file: ", name);
+ if (fread(host_eeprom, 1, HOST_E2SIZE, f) != HOST_E2SIZE)
+  fatal("EEPROM file is too short: ", name);
+ fclose(f);
+}
+
+static void save_eeprom(const char* name)
+{
+ FILE* f = fopen(name, "wb");
+ if (!f || fwrite(host_eeprom, 1, HOST_E2SIZE, f) != HOST_E2SIZE)
+  fatal("can not write EEPROM file: ", name);
+ fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+ const char* scenario = NULL, *ee_in = NULL, *ee_out = NULL, *reason;
+ clock_t wall;
+ unsigned sparks, knock_meas, knock_lost;
+ double adv_mean, adv_sd, wall_s, knock_delay, knock_delay_max;
+ int i;
+
+ log_file = stdout;
+ memset(host_eeprom, 0xFF, sizeof(host_eeprom)); //erased EEPROM
+ for(i = 1; i < argc; ++i)
+ {
+  if (!strcmp(argv[i], "-o") && i + 1 < argc)
+  {
+   if (!(log_file = fopen(argv[++i], "w")))
+    fatal("can not create log: ", argv[i]);
+  }
+  else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+   ee_in = argv[++i];
+  else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+   ee_out = argv[++i];
+  else if (!scenario && !strchr(argv[i], '='))
+   scenario = argv[i];
+  else
+   break;
+ }
+ if (!scenario)
+ {
+  fprintf(stderr, "usage: hostsim [-o log] [-e eeprom_in] [-s eeprom_out] scenario [key=value ...]\n");
+  return 1;
+ }
+ if (ee_in)
+  load_eeprom(ee_in);
+ load_scenario(scenario);
+ for(; i < argc; ++i)
+ {
+  char line[MAX_LINE], *eq = strchr(argv[i], '=');
+  if (!eq)
+   fatal("bad argument: ", argv[i]);
+  snprintf(line, sizeof(line), "set %.*s %s", (int)(eq - argv[i]), argv[i], eq + 1);
+  if (!exec_cmd(line))
+   fatal("bad argument: ", argv[i]);
+ }
+ if (log_period)
+  t_log = log_period;
+
+ eng_init();
+ wall = clock();
+ reason = hcpu_run(secu3_main, t_end);
+ wall_s = (double)(clock() - wall) / CLOCKS_PER_SEC;
+
+ eng_get_adv_stat(&sparks, &adv_mean, &adv_sd);
+ eng_get_knock_stat(&knock_meas, &knock_lost, &knock_delay, &knock_delay_max);
+ fprintf(log_file, "E %.1f %s %u %.2f %.2f %.2f %u %u %u %u %.1f %.1f\n", t_us(host_now), reason ? reason : "end",
+   sparks, adv_mean, adv_sd, host_now ? 100.0 * hcpu_stat.isr_cycles / host_now : 0,
+   hcpu_stat.ee_writes, hcpu_stat.uart_overruns, knock_meas, knock_lost, knock_delay, knock_delay_max);
+ fprintf(stderr, "hostsim: %.3f s simulated in %.3f s of wall time, %u sparks, %s\n",
+   host_now / (double)HOST_F_CPU, wall_s, sparks, reason ? reason : "end");
+ if (log_file != stdout)
+  fclose(log_file);
+ if (ee_out)
+  save_eeprom(ee_out);
+ return reason ? 2 : 0;
+}
@@ -0,0 +1,234 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file hostsim.h
+ * Internal interfaces of host simulator: model of microcontroller (hostcpu.c), model of engine
+ * and sensors (engine.c), scenario and logging (hostsim.c) and access to data of firmware
+ * (fwglue.c). Time is measured in CPU cycles (16MHz) from reset.
+ */
+
+#ifndef _HOSTSIM_H_
+#define _HOSTSIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//fwglue.c is compiled with packed structures (as firmware), but structures declared here are shared
+//with other files of simulator
+#pragma pack(push, 8)
+
+#define HOST_F_CPU    16000000UL   //!< clock of CPU (Hz)
+#define HOST_NEVER    UINT64_MAX   //!< time of event which will never happen
+#define HOST_E2SIZE   1024         //!< size of EEPROM (bytes)
+
+/**Converts time in seconds into CPU cycles */
+#define HOST_CYCLES(s) ((uint64_t)((s) * HOST_F_CPU + 0.5))
+
+/**Indexes of I/O ports */
+enum { HP_A, HP_B, HP_C, HP_D, HP_NUMBER };
+
+//----------------------------------------------------------------------------------------------
+//Model of microcontroller (hostcpu.c)
+
+extern uint64_t host_now;          //!< current time (CPU cycles)
+extern uint32_t host_block_cycles; //!< number of CPU cycles charged per basic block of firmware
+extern uint8_t host_eeprom[HOST_E2SIZE]; //!< content of EEPROM
+
+/**Statistics collected by model */
+typedef struct
+{
+ uint64_t isr_count;               //!< number of executed interrupts
+ uint64_t isr_cycles;              //!< number of CPU cycles spent in interrupts
+ uint32_t ee_writes;               //!< number of programmed bytes of EEPROM
+ uint32_t uart_overruns;           //!< number of bytes lost by receiver of UART (DOR)
+ uint32_t uart_tx_bytes;           //!< number of bytes sent by firmware
+}hcpu_stat_t;
+
+extern hcpu_stat_t hcpu_stat;
+
+/**Runs firmware from reset until simulation is stopped
+ * \param entry entry point of firmware
+ * \param end time of end of simulation
+ * \return reason of stop (static string), NULL if end time was reached
+ */
+const char* hcpu_run(void (*entry)(void), uint64_t end);
+
+/**Stops simulation (does not return)
+ * \param reason description of reason (static string)
+ */
+void hcpu_stop(const char* reason);
+
+/**Must be called when time of the next event of engine or scenario has changed */
+void hcpu_reschedule(void);
+
+/**Drives input pin from outside
+ * \param port index of port (HP_x), bit number of bit
+ * \param level logic level (0, 1)
+ * \param t time of change (not later than current time)
+ */
+void hcpu_set_pin(uint8_t port, uint8_t bit, uint8_t level, uint64_t t);
+
+/**\return current logic levels of pins of specified port */
+uint8_t hcpu_get_pins(uint8_t port);
+
+/**Queues bytes to be received by UART. Bytes follow each other at the baud rate of UART */
+void hcpu_uart_rx(const uint8_t* data, size_t size);
+
+/**\return duration of transfer of one byte by UART at current baud rate (CPU cycles) */
+uint32_t hcpu_uart_byte_cycles(void);
+
+/**\return time when counter of timer 1 will change to specified value (strictly after current
+ * time), HOST_NEVER if timer is stopped */
+uint64_t hcpu_timer1_when(uint16_t value);
+
+//----------------------------------------------------------------------------------------------
+//Model of engine and sensors (engine.c)
+
+/**Initializes model (geometry of trigger wheel is taken from parameters of firmware) */
+void eng_init(void);
+
+/**Sets value of named setting of model (see engine.c)
+ * \return 0 - unknown name */
+int eng_set(const char* key, double value);
+
+/**\return current RPM of crankshaft */
+double eng_get_rpm(void);
+
+/**\return current MAP (kPa) */
+double eng_get_map(void);
+
+/**\return position of choke (0 - open, 1 - closed) */
+double eng_get_choke(void);
+
+/**Statistics of measured advance angles: number of sparks, mean and standard deviation (deg) */
+void eng_get_adv_stat(unsigned* count, double* mean, double* sd);
+
+/**Statistics of measurements of knock signal: number of measured values, number of values lost
+ * (integration began again before measurement), mean and maximum delay between switching of
+ * integrator to hold mode and sampling of its output by ADC (us) */
+void eng_get_knock_stat(unsigned* count, unsigned* lost, double* delay_mean, double* delay_max);
+
+/**\return time of the next event of engine model */
+uint64_t eng_next_event(void);
+
+/**Processes the next event of engine model (time of event <= current time) */
+void eng_process(void);
+
+/**\return ADC code (0...1023) of specified channel of ADC at specified time */
+uint16_t eng_adc(uint8_t channel, uint64_t t);
+
+/**Called when level of output pin of microcontroller changes */
+void eng_port_edge(uint8_t port, uint8_t bit, uint8_t level, uint64_t t);
+
+//----------------------------------------------------------------------------------------------
+//Scenario, logging (hostsim.c)
+
+/**\return time of the next event of scenario */
+uint64_t sim_next_event(void);
+
+/**Processes the next event of scenario (time of event <= current time) */
+void sim_process(void);
+
+/**Called for each spark
+ * \param ch ignition channel (0...3)
+ * \param t time of spark
+ * \param rpm RPM of crankshaft
+ * \param adv measured advance angle (deg BTDC)
+ * \param dwell measured dwell time (ms), 0 if unknown
+ */
+void sim_spark(uint8_t ch, uint64_t t, double rpm, double adv, double dwell);
+
+/**Called for each byte transmitted by UART of firmware */
+void sim_uart_tx(uint8_t byte, uint64_t t);
+
+//----------------------------------------------------------------------------------------------
+//Replay of captured trace of input events (replay.c)
+
+/**Loads trace (see sources/trace.h) and schedules its replay
+ * \param name name of file
+ * \param t time of beginning of replay
+ * \param log file for lines of log
+ * \return NULL - success, otherwise description of error (static string)
+ */
+const char* rpl_open(const char* name, uint64_t t, FILE* log);
+
+/**\return time of the next event of replay */
+uint64_t rpl_next_event(void);
+
+/**Processes the next event of replay (time of event <= current time) */
+void rpl_process(void);
+
+/**Called when level of output pin of microcontroller changes */
+void rpl_port_edge(uint8_t port, uint8_t bit, uint8_t level, uint64_t t);
+
+//----------------------------------------------------------------------------------------------
+//Access to data of firmware (fwglue.c, compiled with the same options as firmware)
+
+/**Entry point of firmware (MAIN() in secu3.c) */
+void secu3_main(void);
+
+/**Sets parameter of firmware in RAM (see table of names in fwglue.c) and updates CRC of parameters
+ * \return 0 - unknown name */
+int glue_set_param(const char* name, long value);
+
+/**\return value of named parameter (0 if unknown) */
+long glue_get_param(const char* name);
+
+/**Snapshot of state of firmware used for logging */
+typedef struct
+{
+ int engine_mode;                  //!< EM_xxx
+ unsigned rpm;                     //!< averaged RPM (sens.frequen)
+ unsigned inst_rpm;                //!< instant RPM (sens.inst_frq)
+ double map;                       //!< MAP (kPa)
+ double temp;                      //!< coolant temperature (C)
+ double voltage;                   //!< board voltage (V)
+ double tps;                       //!< TPS (%)
+ double curr_angle;                //!< current advance angle (deg)
+ double knock_retard;              //!< knock retard (deg)
+ double knock_k;                   //!< level of knock signal (V)
+ unsigned ce_errors;               //!< bits of current CE errors
+}glue_state_t;
+
+void glue_get_state(glue_state_t* s);
+
+/**Position counter of stepper motor of firmware (CCW steps increment it, see smcontrol.c)
+ * \param pos position counter
+ * \param steps total number of steps of motor (parameter sm_steps)
+ * \return 0 - firmware is built without SM_CONTROL or has not loaded parameters yet */
+int glue_get_stepper(int16_t* pos, uint16_t* steps);
+
+/**Converts physical value of sensor into ADC code using parameters of firmware (inverse of
+ * conversion done by firmware), physical values: MAP - kPa, TEMP - C, UBAT - V, TPS - %, other
+ * channels - V
+ * \param channel ADC channel
+ * \param value physical value
+ */
+uint16_t glue_adc_code(uint8_t channel, double value);
+
+/**Ensures that CRC of code in the image of FLASH is correct (integrity check of firmware)
+ * \param flash image of FLASH (FLASHEND+1 bytes) */
+void glue_fix_code_crc(uint8_t* flash);
+
+#pragma pack(pop)
+
+#endif //_HOSTSIM_H_
@@ -0,0 +1,371 @@
+/* SECU-3  - An open source, free engine control unit
+   Copyright (C) 2007 Alexey A. Shabelnikov. Ukraine, Gorlovka
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   contacts:
+              http://secu-3.org
+              email: shabelnikov@secu-3.org
+*/
+
+/** \file replay.c
+ * Replay of trace of input events captured by firmware (see sources/trace.h) instead of model of
+ * engine. Timestamps of records are values of timer 1, so replay begins at the moment when timer 1
+ * of simulated CPU reaches timestamp of the first record; after that teeth are captured by ICP1
+ * with exactly the same values of ICR1 as in the trace (16-bit timestamps are unwrapped).
+ *
+ * - TRC_TOOTH: pulse on ICP1 (PD6), active edge at the timestamp
+ * - TRC_CAM:   pulse on INT1 (PD3, cam sensor) or on INT0 (PD2, REF_S), active edge at the timestamp
+ *              (timestamp was taken in the interrupt, so edge is replayed a bit later than it was)
+ * - TRC_ADC:   result of the next conversion of the channel (value becomes effective just before
+ *              the previous conversion of the same channel has been completed)
+ * - TRC_UART:  frame is sent so that its last byte is received at the timestamp
+ * - TRC_LOST:  is logged, measurement of angles is restarted after it
+ *
+ * Each spark produces line of log:
+ *  R tick ch adv_meas adv_cmd knock_retard dwell_ms
+ * where tick is time from the first record of trace in ticks of timer 1 (4us), adv_meas is
+ * advance angle measured from replayed teeth (geometry of trigger wheel is taken from parameters),
+ * adv_cmd and knock_retard are values of firmware. These lines do not depend on the time it took
+ * firmware to start, so logs of different builds of firmware can be compared by diff.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostsim.h"
+
+#define TICK_CYCLES  64            //!< tick of timer 1 (prescaler 64)
+#define PULSE_CYCLES 32            //!< width of pulses generated for teeth and cam events
+#define END_DELAY    HOST_CYCLES(0.02) //!< simulation continues after the last record
+#define GAP_BARRIER  1.5           //!< ratio of periods which means missing teeth
+#define K_UNKNOWN    -1            //!< position of crankshaft is unknown
+#define K_REFS       -2            //!< REF_S has come, the next tooth is tooth 0
+
+//Types of records, see trace.h
+#define TRC_TOOTH    1
+#define TRC_CAM      2
+#define TRC_ADC      3
+#define TRC_UART     4
+#define TRC_LOST     0x0F
+
+/**Kinds of events of replay */
+enum { RE_TOOTH, RE_REFS, RE_HALL, RE_PIN, RE_ADC, RE_UART, RE_LOST, RE_END };
+
+typedef struct
+{
+ int64_t t;                        //!< time from the first record (CPU cycles)
+ uint32_t seq;                     //!< order of creation (events with the same time keep it)
+ uint8_t kind;                     //!< RE_xxx
+ uint8_t port, bit, level;         //!< input and its state (1 - active, 0 - inactive)
+ uint16_t value;                   //!< ADC: code, LOST: count, UART: size of frame
+ uint8_t channel;                  //!< ADC channel
+ uint32_t offset;                  //!< UART: offset of frame in the trace
+}rpl_event_t;
+
+static struct
+{
+ uint8_t* data;                    //!< content of trace file
+ rpl_event_t* ev;                  //!< events sorted by time
+ size_t nev, iev, alloc;
+ uint64_t t_start;                 //!< time of replay command
+ uint64_t t_base;                  //!< time of the first record (0 - not started yet)
+ uint16_t ts0;                     //!< timestamp of the first record
+ FILE* log;
+ //measurement of advance angle
+ double pitch, tdc1, stroke, gap;
+ uint8_t act[8];                   //!< active levels of inputs of port D
+ int cogs;                         //!< number of present teeth (N-M)
+ int k;                            //!< index of last tooth from the gap (K_xxx - unknown)
+ uint64_t t_tooth;                 //!< time of last tooth
+ double period;                    //!< period of teeth (CPU cycles)
+ uint64_t t_dwell[4];
+ unsigned sparks, records, lost;
+}rpl = {NULL, NULL, 0, 0, 0, HOST_NEVER};
+
+static rpl_event_t* add_event(int64_t t, uint8_t kind)
+{
+ rpl_event_t* e;
+ if (rpl.nev == rpl.alloc)
+ {
+  rpl.alloc = rpl.alloc ? rpl.alloc * 2 : 1024;
+  rpl.ev = realloc(rpl.ev, rpl.alloc * sizeof(rpl_event_t));
+ }
+ e = &rpl.ev[rpl.nev];
+ memset(e, 0, sizeof(*e));
+ e->t = t;
+ e->seq = (uint32_t)rpl.nev++;
+ e->kind = kind;
+ return e;
+}
+
+/**Adds pulse on input, active edge at specified time (level of event: 1 - active, 0 - inactive) */
+static void add_pulse(int64_t t, uint8_t kind, uint8_t bit)
+{
+ rpl_event_t* e = add_event(t, kind);
+ e->port = HP_D, e->bit = bit, e->level = 1;
+ e = add_event(t + PULSE_CYCLES, RE_PIN);
+ e->port = HP_D, e->bit = bit, e->level = 0;
+}
+
+static int event_cmp(const void* a, const void* b)
+{
+ const rpl_event_t* x = a, *y = b;
+ if (x->t != y->t)
+  return (x->t > y->t) - (x->t < y->t);
+ return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+ return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**Converts records of trace into events */
+static const char* parse(size_t size)
+{
+ int64_t t = 0, t_adc[8] = {0};
+ uint16_t ts_prev = 0;
+ size_t i = 0;
+
+ if (size >= 3)
+  rpl.ts0 = ts_prev = get16(rpl.data + 1);
+ while(i + 3 <= size)
+ {
+  uint8_t type = rpl.data[i] >> 4, aux = rpl.data[i] & 0x0F;
+  uint16_t ts = get16(rpl.data + i + 1);
+  rpl_event_t* e;
+  //records are not strictly ordered by time (timestamp of tooth is taken by hardware)
+  t+= (int16_t)(ts - ts_prev) * (int64_t)TICK_CYCLES;
+  ts_prev = ts;
+  i+= 3;
+  ++rpl.records;
+  switch(type)
+  {
+   case TRC_TOOTH:
+    add_pulse(t, RE_TOOTH, 6);
+    break;
+   case TRC_CAM:
+    if (aux)
+     add_pulse(t, RE_REFS, 2);
+    else
+     add_pulse(t, RE_HALL, 3);
+    break;
+   case TRC_ADC:
+    if (i + 2 > size)
+     return "trace is truncated";
+    e = add_event(t_adc[aux & 7], RE_ADC);
+    e->channel = aux & 7;
+    e->value = get16(rpl.data + i);
+    t_adc[aux & 7] = t - TICK_CYCLES;
+    i+= 2;
+    break;
+   case TRC_UART:
+    if (i + 1 > size || i + 1 + rpl.data[i] > size)
+     return "trace is truncated";
+    e = add_event(t, RE_UART);
+    e->offset = (uint32_t)(i + 1);
+    e->value = rpl.data[i];
+    i+= 1 + rpl.data[i];
+    break;
+   case TRC_LOST:
+    if (i + 1 > size)
+     return "trace is truncated";
+    e = add_event(t, RE_LOST);
+    e->value = aux ? 0 : rpl.data[i];
+    ++i;
+    break;
+   default:
+    return "unknown type of record";
+  }
+ }
+ add_event(t + END_DELAY, RE_END);
+ qsort(rpl.ev, rpl.nev, sizeof(rpl_event_t), event_cmp);
+ return NULL;
+}
+
+const char* rpl_open(const char* name, uint64_t t, FILE* log)
+{
+ FILE* f = fopen(name, "rb");
+ long size;
+ if (!f)
+  return "can not open trace";
+ fseek(f, 0, SEEK_END);
+ size = ftell(f);
+ fseek(f, 0, SEEK_SET);
+ rpl.data = malloc(size > 0 ? size : 1);
+ if (size < 0 || fread(rpl.data, 1, size, f) != (size_t)size)
+ {
+  fclose(f);
+  return "can not read trace";
+ }
+ fclose(f);
+ rpl.log = log;
+ rpl.t_start = t;
+ rpl.k = K_UNKNOWN;
+ return parse((size_t)size);
+}
+
+/**\return absolute time of event, events which are before the beginning are executed at once */
+static uint64_t event_time(const rpl_event_t* e)
+{
+ int64_t t = e->t;
+ if (RE_UART == e->kind)
+  t-= (int64_t)(e->value + 2) * hcpu_uart_byte_cycles(); //'!', frame, '\r'
+ if (t < 0)
+  t = 0;
+ return rpl.t_base + (uint64_t)t;
+}
+
+uint64_t rpl_next_event(void)
+{
+ if (!rpl.t_base)
+  return rpl.t_start;
+ return (rpl.iev < rpl.nev) ? event_time(&rpl.ev[rpl.iev]) : HOST_NEVER;
+}
+
+/**Initial levels of inputs, synchronization with timer 1 */
+static void start(void)
+{
+ const char* geo[] = {"ckps_cogs_num", "ckps_miss_num", "ckps_cogs_btdc", "ckps_engine_cyl"};
+ double v[4];
+ size_t i;
+ for(i = 0; i < 4; ++i)
+  v[i] = glue_get_param(geo[i]);
+ rpl.pitch = 360.0 / v[0];
+ rpl.cogs = (int)(v[0] - v[1]);
+ rpl.gap = v[1];
+ rpl.tdc1 = (v[2] - 1) * rpl.pitch;
+ rpl.stroke = 720.0 / (v[3] ? v[3] : 1);
+
+ rpl.act[6] = glue_get_param("ckps_edge_type") ? 1 : 0;  //CKP sensor, ICP1
+ rpl.act[2] = glue_get_param("ref_s_edge_type") ? 1 : 0; //REF_S, INT0
+ rpl.act[3] = 1;                                         //cam sensor, INT1 (rising edge)
+ hcpu_set_pin(HP_D, 6, !rpl.act[6], host_now);          //inactive levels
+ hcpu_set_pin(HP_D, 2, !rpl.act[2], host_now);
+ hcpu_set_pin(HP_D, 3, !rpl.act[3], host_now);
+ rpl.t_base = hcpu_timer1_when(rpl.ts0);
+ if (HOST_NEVER == rpl.t_base)
+  hcpu_stop("replay: timer 1 is not running");
+}
+
+/**Position of crankshaft from the active edge of tooth 0 (deg), < 0 - unknown */
+static double crank_angle(uint64_t t)
+{
+ if (rpl.k < 0 || rpl.period <= 0)
+  return -1;
+ return (rpl.k + (double)(t - rpl.t_tooth) / rpl.period) * rpl.pitch;
+}
+
+static void tooth(uint64_t t)
+{
+ double period = rpl.t_tooth ? (double)(t - rpl.t_tooth) : 0;
+ if (rpl.gap && rpl.period > 0 && period > GAP_BARRIER * rpl.period)
+  rpl.k = 0;                       //the first tooth after missing teeth
+ else if (K_REFS == rpl.k)
+  rpl.k = 0;
+ else if (rpl.k >= 0)
+ {
+  if (++rpl.k >= rpl.cogs && rpl.gap)
+   rpl.k = K_UNKNOWN;              //missing teeth were not detected
+ }
+ if (!rpl.gap || period <= GAP_BARRIER * rpl.period || rpl.period <= 0)
+  rpl.period = period;
+ rpl.t_tooth = t;
+}
+
+void rpl_process(void)
+{
+ rpl_event_t* e;
+ if (!rpl.t_base)
+ {
+  start();
+  hcpu_reschedule();
+  return;
+ }
+ e = &rpl.ev[rpl.iev++];
+ switch(e->kind)
+ {
+  case RE_TOOTH:
+   tooth(host_now);
+  //fall through
+  case RE_HALL:
+  case RE_PIN:
+   hcpu_set_pin(e->port, e->bit, e->level ? rpl.act[e->bit] : !rpl.act[e->bit], host_now);
+   break;
+  case RE_REFS:
+   rpl.k = K_REFS;                 //REF_S is just before tooth 0
+   hcpu_set_pin(e->port, e->bit, rpl.act[e->bit], host_now);
+   break;
+  case RE_ADC:
+  {
+   char key[8];
+   snprintf(key, sizeof(key), "adc%u", e->channel);
+   eng_set(key, e->value * (2.56 / 1024)); //model of engine converts voltage back to the same code
+   break;
+  }
+  case RE_UART:
+  {
+   uint8_t frame[258];
+   frame[0] = '!';
+   memcpy(frame + 1, rpl.data + e->offset, e->value);
+   frame[e->value + 1] = '\r';
+   hcpu_uart_rx(frame, e->value + 2);
+   break;
+  }
+  case RE_LOST:
+   ++rpl.lost;
+   rpl.k = K_UNKNOWN;
+   rpl.t_tooth = 0;
+   fprintf(rpl.log, "R %.2f lost %u\n", (double)(host_now - rpl.t_base) / TICK_CYCLES, e->value);
+   break;
+  case RE_END:
+   fprintf(rpl.log, "R %.2f end %u records, %u sparks\n", (double)(host_now - rpl.t_base) / TICK_CYCLES,
+     rpl.records, rpl.sparks);
+   hcpu_stop(NULL);
+   break;
+ }
+ hcpu_reschedule();
+}
+
+void rpl_port_edge(uint8_t port, uint8_t bit, uint8_t level, uint64_t t)
+{
+ glue_state_t s;
+ double theta, adv = 0, dwell;
+ int ch = (HP_D == port && (4 == bit || 5 == bit)) ? bit - 4 : ((HP_C == port && bit < 2) ? bit + 2 : -1);
+ if (ch < 0 || !rpl.t_base || HOST_NEVER == rpl.t_base)
+  return;
+ if (!level)
+ { //beginning of dwell
+  rpl.t_dwell[ch] = t;
+  return;
+ }
+ theta = crank_angle(t);
+ if (theta >= 0)
+ { //TDCs are stroke degrees apart, so position within one revolution is enough
+  adv = fmod(rpl.tdc1 - theta + 720.0 * 2, rpl.stroke);
+  if (adv > rpl.stroke / 2)
+   adv-= rpl.stroke;
+ }
+ dwell = rpl.t_dwell[ch] ? (double)(t - rpl.t_dwell[ch]) * 1000.0 / HOST_F_CPU : 0;
+ rpl.t_dwell[ch] = 0;
+ ++rpl.sparks;
+ glue_get_state(&s);
+ if (theta >= 0)
+  fprintf(rpl.log, "R %.2f %d %.2f %.2f %.2f %.3f\n", (double)(t - rpl.t_base) / TICK_CYCLES, ch, adv,
+    s.curr_angle, s.knock_retard, dwell);
+ else
+  fprintf(rpl.log, "R %.2f %d - %.2f %.2f %.3f\n", (double)(t - rpl.t_base) / TICK_CYCLES, ch,
+    s.curr_angle, s.knock_retard, dwell);
+}
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+#
+# SECU-3  - An open source, free engine control unit
+# Build time report of static RAM used by each module of firmware (GCC toolchain).
+#
+# Usage: ramreport.py [--mcu atmega32] [--stack 256] [--symbols 10] [--nm avr-nm] FILE.o [FILE.o ...]
+#
+# Sizes of .data, .bss and .noinit sections of each object file are taken from avr-nm (symbols with
+# sizes), so statically allocated variables are reported per module, largest first. Total is compared
+# with size of SRAM of selected MCU: memory which is left must be enough for stack(s), its minimum is
+# given by --stack. Exit code is 1 if total plus reserve for stack does not fit into SRAM, so the report
+# can be used as a check in the build. Runtime usage of stack is monitored by stackmon.c.
+
+import argparse
+import collections
+import os
+import subprocess
+import sys
+
+SRAM_SIZE = {'atmega16': 1024, 'atmega32': 2048, 'atmega64': 4096}
+
+# nm types of symbols placed in RAM: b/B - .bss (and .noinit), C - common (goes to .bss), d/D - .data
+RAM_TYPES = set('bBCdD')
+
+
+def module_symbols(nm, path):
+    """Returns list of (size, name, type) of symbols of object file which are placed in RAM"""
+    out = subprocess.run([nm, '-S', '--size-sort', path], check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2] in RAM_TYPES:
+            syms.append((int(parts[1], 16), parts[3], parts[2]))
+    return syms
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Report of static RAM used by modules of SECU-3 firmware')
+    ap.add_argument('objects', nargs='+', help='object files of firmware')
+    ap.add_argument('--mcu', default='atmega32', choices=sorted(SRAM_SIZE))
+    ap.add_argument('--stack', type=int, default=256, help='minimum memory which must be left for stack')
+    ap.add_argument('--symbols', type=int, default=5, help='number of the largest symbols listed per module')
+    ap.add_argument('--nm', default='avr-nm')
+    args = ap.parse_args()
+
+    modules = collections.OrderedDict()
+    for path in args.objects:
+        syms = module_symbols(args.nm, path)
+        modules[os.path.basename(path)] = sorted(syms, reverse=True)
+
+    total = 0
+    print('%-16s %6s %6s %6s' % ('module', 'data', 'bss', 'total'))
+    for name, syms in sorted(modules.items(), key=lambda m: -sum(s[0] for s in m[1])):
+        data = sum(s[0] for s in syms if s[2] in 'dD')
+        bss = sum(s[0] for s in syms if s[2] in 'bBC')
+        if not data + bss:
+            continue
+        total += data + bss
+        print('%-16s %6d %6d %6d' % (name, data, bss, data + bss))
+        for size, sym, kind in syms[:args.symbols]:
+            print('    %6d %s%s' % (size, sym, '' if kind.isupper() else ' (static)'))
+
+    sram = SRAM_SIZE[args.mcu]
+    left = sram - total
+    print('total static RAM: %d of %d bytes (%s), left for stack: %d' % (total, sram, args.mcu, left))
+    if left < args.stack:
+        print('ERROR: less than %d bytes are left for stack' % args.stack)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
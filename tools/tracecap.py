@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+#
+# SECU-3  - An open source, free engine control unit
+# Host side part of trace capture (see sources/trace.h, firmware must be built with TRACE_CAPTURE).
+#
+#   tracecap.py capture PORT FILE [--baud 57600] [--time 60]
+#       Starts capture (OP_COMP_NC, OPCODE_TRACE_CAPTURE), reassembles stream of records from TRACE_DAT
+#       packets and writes it into FILE (raw records, the same format as in trace.h). Packets lost on
+#       the link are marked by TRC_LOST record with aux = 1 and zero count, stream is resynchronized on
+#       the first record of the next packet.
+#   tracecap.py dump FILE
+#       Prints records of trace as text, one record per line (diffable).
+#
+# Requires pyserial for capturing.
+
+import argparse
+import struct
+import sys
+import time
+
+OP_COMP_NC = 'u'
+TRACE_DAT = '*'
+CHANGEMODE = 'h'
+SENSOR_DAT = 'q'
+OPCODE_TRACE_CAPTURE = 11
+TRACE_NO_RECORD = 0xFF
+
+TRC_TOOTH, TRC_CAM, TRC_ADC, TRC_UART, TRC_LOST = 1, 2, 3, 4, 0x0F
+HEAD_SIZE = 3                    # header byte and 16-bit timestamp
+LINK_LOST = bytes([(TRC_LOST << 4) | 1, 0, 0, 0])
+
+
+class Reassembler:
+    """Reassembles stream of records from TRACE_DAT packets (frames are given without terminating CR)"""
+
+    def __init__(self, out):
+        self.out = out
+        self.prev_seq, self.synced, self.packets, self.lost = None, False, 0, 0
+
+    def feed(self, frame):
+        at = frame.rfind(b'@')
+        if at < 0 or frame[at + 1:at + 2] != TRACE_DAT.encode() or len(frame) < at + 6:
+            return
+        try:
+            data = bytes.fromhex(frame[at + 2:].decode('latin-1'))
+        except ValueError:
+            return                       # broken packet, next one will be treated as lost
+        seq, first, body = data[0], data[1], data[2:]
+        self.packets += 1
+        if self.prev_seq is not None and seq != ((self.prev_seq + 1) & 0xFF):
+            self.lost += (seq - self.prev_seq - 1) & 0xFF
+            if self.synced:
+                self.out.write(LINK_LOST)
+            self.synced = False
+        self.prev_seq = seq
+        if not self.synced:
+            if first == TRACE_NO_RECORD:
+                return                   # tail of record which beginning was lost
+            body = body[first:]
+            self.synced = True
+        self.out.write(body)
+
+
+def capture(args):
+    import serial
+    ser = serial.Serial(args.port, args.baud, timeout=0.05)
+    out = open(args.file, 'wb')
+    ser.write(('!%s%02X%02X\r' % (OP_COMP_NC, 1, OPCODE_TRACE_CAPTURE)).encode('latin-1'))
+    rx, ra = b'', Reassembler(out)
+    end = time.time() + args.time
+    try:
+        while time.time() < end:
+            rx += ser.read(256)
+            while b'\r' in rx:
+                frame, rx = rx.split(b'\r', 1)
+                ra.feed(frame)
+    except KeyboardInterrupt:
+        pass
+    ser.write(('!%s%02X%02X\r' % (OP_COMP_NC, 0, OPCODE_TRACE_CAPTURE)).encode('latin-1'))
+    ser.write(('!%s%s\r' % (CHANGEMODE, SENSOR_DAT)).encode('latin-1'))
+    out.close()
+    print('%d packets received, %d lost' % (ra.packets, ra.lost))
+
+
+def dump(args):
+    data = open(args.file, 'rb').read()
+    i = 0
+    while i + HEAD_SIZE <= len(data):
+        hdr = data[i]
+        kind, aux = hdr >> 4, hdr & 0x0F
+        ts = struct.unpack_from('<H', data, i + 1)[0]
+        i += HEAD_SIZE
+        if kind == TRC_TOOTH:
+            text = 'tooth'
+        elif kind == TRC_CAM:
+            text = 'cam %s' % ('refs' if aux else 'hall')
+        elif kind == TRC_ADC:
+            text = 'adc %d %d' % (aux, struct.unpack_from('<H', data, i)[0])
+            i += 2
+        elif kind == TRC_UART:
+            size = data[i]
+            text = 'uart %s' % data[i + 1:i + 1 + size].decode('latin-1')
+            i += 1 + size
+        elif kind == TRC_LOST:
+            text = 'lost-link' if aux else 'lost %d' % data[i]
+            i += 1
+        else:
+            sys.exit('unknown record 0x%02X at offset %d' % (hdr, i - HEAD_SIZE))
+        print('%5u %s' % (ts, text))
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Capture and dump of trace of input events of SECU-3 firmware')
+    sub = ap.add_subparsers(dest='cmd', required=True)
+    cap = sub.add_parser('capture')
+    cap.add_argument('port')
+    cap.add_argument('file')
+    cap.add_argument('--baud', type=int, default=57600)
+    cap.add_argument('--time', type=float, default=60, help='duration of capture, s')
+    dmp = sub.add_parser('dump')
+    dmp.add_argument('file')
+    args = ap.parse_args()
+    capture(args) if args.cmd == 'capture' else dump(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+#
+# SECU-3  - An open source, free engine control unit
+# Host side fuzz and throughput test of the UART receiver of firmware.
+#
+# Test is run against real unit (on the bench, engine must be stopped!) connected to the serial port:
+#   1. Parameters are read back from the unit (reference copy).
+#   2. Throughput: back-to-back valid frames (CHANGEMODE) are pushed at full baud rate, rate of frames
+#      and number of frames dropped because ring buffer was full are reported.
+#   3. Fuzz: invalid frames (wrong size, garbage symbols, too long frames, unknown descriptors) are
+#      pushed. Each of them must be dropped and counted by firmware.
+#   4. Parameters are read back again, they must be unchanged.
+# Counters of dropped frames are taken from SUBSCR_DAT (SBSF_RECV_ERRS field). Counters saturate at
+# 255 and are reset by power cycle only, so run the test just after power up.
+#
+# Usage: uartfuzz.py PORT [--baud 57600] [--frames 2000] [--fuzz 200] [--seed N]
+# Requires pyserial.
+# The same test is run against simulated unit (no hardware, repeatable) by "hostsim.py fuzz".
+
+import argparse
+import random
+import sys
+import time
+
+CHANGEMODE = 'h'
+SUBSCR_PAR = '<'
+SUBSCR_DAT = '>'
+SENSOR_DAT = 'q'
+EDITAB_PAR = '{'
+SBSF_RECV_ERRS = 15
+SBSF_NUMBER = 16
+RECV_FRAME_SIZE = 73             # UART_RECV_FRAME_SIZE (descriptor and data)
+
+# sizes of data (without descriptor) of frames of parameters, see check_recv_size() in uart.c
+PARAM_SIZES = {
+    'j': 11, 'k': 25, 'l': 29, 'm': 21, 'n': 29, 'o': 8, 'r': 72,
+    't': 18, 'w': 31, 'z': 15, '%': 5, 'u': 4, 'x': 4,
+}
+# descriptors known by firmware (frames with them must never be generated as unknown ones)
+KNOWN = set(PARAM_SIZES) | set('hi<{|^')
+HEX = '0123456789ABCDEF'
+NOT_HEX = [chr(c) for c in range(0x21, 0x7F) if not ('0' <= chr(c) <= '?' or 'A' <= chr(c) <= 'F')]
+
+
+class Link:
+    def __init__(self, port, baud):
+        import serial                # not needed by users of bad_frame(), e.g. hostsim.py fuzz
+        self.ser = serial.Serial(port, baud, timeout=0.05)
+        self.rx = b''
+
+    def send(self, descriptor, data=''):
+        self.ser.write(('!' + descriptor + data + '\r').encode('latin-1'))
+
+    def packets(self, timeout):
+        """Yields received packets (descriptor, data) until timeout expires"""
+        end = time.time() + timeout
+        while time.time() < end:
+            self.rx += self.ser.read(256)
+            while b'\r' in self.rx:
+                frame, self.rx = self.rx.split(b'\r', 1)
+                at = frame.rfind(b'@')
+                if at >= 0 and len(frame) > at + 1:
+                    text = frame[at + 1:].decode('latin-1')
+                    yield text[0], text[1:]
+
+    def wait_packet(self, descriptor, timeout=2.0):
+        for desc, data in self.packets(timeout):
+            if desc == descriptor:
+                return data
+        return None
+
+
+def read_params(link):
+    """Reads all packets of parameters, returns dictionary descriptor -> data"""
+    params = {}
+    for desc in sorted(PARAM_SIZES):
+        if desc in 'ux':
+            continue                 # not parameters
+        link.send(CHANGEMODE, desc)
+        data = link.wait_packet(desc)
+        if data is None:
+            sys.exit('no answer for %s, check connection and baud rate' % desc)
+        params[desc] = data
+    return params
+
+
+def read_counters(link):
+    """Subscribes to counters of dropped frames, returns (overflows, errors)"""
+    decim = '1' * SBSF_NUMBER
+    link.send(SUBSCR_PAR, '1' + '%04X' % (1 << SBSF_RECV_ERRS) + decim)
+    data = link.wait_packet(SUBSCR_DAT)
+    if data is None or len(data) < 8:
+        sys.exit('no SUBSCR_DAT packets, firmware does not support SBSF_RECV_ERRS?')
+    value = int(data[4:8], 16)
+    return value >> 8, value & 0xFF
+
+
+def bad_frame(rnd):
+    """Generates frame which firmware must drop, returns (descriptor, data)"""
+    kind = rnd.randrange(5)
+    desc = rnd.choice(sorted(PARAM_SIZES))
+    size = PARAM_SIZES[desc]
+    if kind == 0:                    # wrong size
+        wrong = rnd.choice([s for s in range(1, RECV_FRAME_SIZE) if s != size])
+        return desc, ''.join(rnd.choice(HEX) for _ in range(wrong))
+    if kind == 1:                    # valid size, but garbage inside
+        data = [rnd.choice(HEX) for _ in range(size)]
+        data[rnd.randrange(size)] = rnd.choice(NOT_HEX)
+        return desc, ''.join(data)
+    if kind == 2:                    # too long frame
+        return desc, ''.join(rnd.choice(HEX) for _ in range(RECV_FRAME_SIZE + rnd.randrange(1, 40)))
+    if kind == 3:                    # unknown descriptor
+        unknown = [c for c in map(chr, range(0x21, 0x7F)) if c not in KNOWN and c not in '!@']
+        return rnd.choice(unknown), ''.join(rnd.choice(HEX) for _ in range(rnd.randrange(0, 30)))
+    # EDITAB_PAR: wrong size for type of data (RPM grid needs exactly 32 symbols, source of load - 5)
+    state = rnd.choice('57')
+    need = 32 if state == '5' else 5
+    wrong = rnd.choice([s for s in range(0, 60) if s != need])
+    return EDITAB_PAR, '0' + state + '00' + ''.join(rnd.choice(HEX) for _ in range(wrong))
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Fuzz and throughput test of UART receiver of SECU-3 firmware')
+    ap.add_argument('port')
+    ap.add_argument('--baud', type=int, default=57600)
+    ap.add_argument('--frames', type=int, default=2000, help='number of frames in throughput test')
+    ap.add_argument('--fuzz', type=int, default=200, help='number of invalid frames (<= 250)')
+    ap.add_argument('--seed', type=int, default=None)
+    args = ap.parse_args()
+    rnd = random.Random(args.seed)
+    link = Link(args.port, args.baud)
+    failed = False
+
+    ref = read_params(link)
+    ovf0, err0 = read_counters(link)
+    print('counters at start: overflows %d, errors %d' % (ovf0, err0))
+
+    # throughput: valid frames back to back, unit switches between two kinds of packets
+    burst = ''.join('!' + CHANGEMODE + (SENSOR_DAT if i & 1 else SUBSCR_DAT) + '\r' for i in range(args.frames))
+    start = time.time()
+    link.ser.write(burst.encode('latin-1'))
+    link.ser.flush()
+    elapsed = time.time() - start
+    for _ in link.packets(0.5):
+        pass
+    ovf1, err1 = read_counters(link)
+    print('throughput: %d frames in %.2f s (%.0f frames/s), dropped by overflow: %d, errors: %d'
+          % (args.frames, elapsed, args.frames / elapsed, ovf1 - ovf0, err1 - err0))
+    if err1 != err0:
+        print('FAIL: valid frames were counted as errors')
+        failed = True
+
+    # fuzz: frames are sent in small groups, so ring buffer never overflows
+    count = min(args.fuzz, 250 - err1)
+    for i in range(count):
+        desc, data = bad_frame(rnd)
+        link.send(desc, data)
+        if i % 4 == 3:
+            time.sleep(0.05)
+    for _ in link.packets(0.5):
+        pass
+    ovf2, err2 = read_counters(link)
+    print('fuzz: %d invalid frames, counted as errors: %d, overflows: %d' % (count, err2 - err1, ovf2 - ovf1))
+    if err2 - err1 != count:
+        print('FAIL: some invalid frames were not dropped (or ring buffer overflowed)')
+        failed = True
+
+    if read_params(link) != ref:
+        print('FAIL: parameters were changed by invalid frames')
+        failed = True
+
+    link.send(CHANGEMODE, SENSOR_DAT)
+    print('FAILED' if failed else 'PASSED')
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())